@@ -45,6 +45,7 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 
 #include <limits>
 #include <algorithm>
+#include <vector>
 
 #include <glm/gtx/norm.hpp>
 
@@ -59,6 +60,9 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 
 static const float MIN_RADIUS = 110.0f;
 
+// Searches through fewer clusters than this don't use the hierarchy.
+static const size_t HIERARCHY_MIN_CLUSTERS = 3;
+
 #define frnd() (1.0f - 2 * rnd())
 
 const float PathFinder::HEURISTIC_MIN = 0.0f;
@@ -71,21 +75,22 @@ const float PathFinder::HEIGHT_DEFAULT = 0.0f;
 class PathFinder::Node {
 	
 	NodeId id;
-	const Node * parent;
+	size_t parent;
 	
 	float cost;
 	float distance;
 	
 public:
 	
-	Node(long _id, const Node * _parent, float _distance, float _remaining)
+	Node(NodeId _id, size_t _parent, float _distance, float _remaining)
 		: id(_id), parent(_parent), cost(_distance + _remaining), distance(_distance) { }
 	
 	inline NodeId getId() const {
 		return id;
 	}
 	
-	inline const Node * getParent() const {
+	//! @return the pool index of the parent node or NodePool::None
+	inline size_t getParent() const {
 		return parent;
 	}
 	
@@ -97,7 +102,7 @@ public:
 		return distance;
 	}
 	
-	inline void newParent(const Node * _parent, float _distance) {
+	inline void newParent(size_t _parent, float _distance) {
 		parent = _parent;
 		cost = cost - distance + _distance;
 		distance = _distance;
@@ -105,88 +110,163 @@ public:
 	
 };
 
-class PathFinder::OpenNodeList {
+/*!
+ * Storage for all nodes created during a single search.
+ * Nodes are referenced by their index so that the pool can grow without
+ * invalidating references, and are all freed at once when the search is done.
+ */
+class PathFinder::NodePool {
 	
-	typedef std::vector<Node*> NodeList;
+	typedef std::vector<Node> NodeList;
 	NodeList nodes;
 	
 public:
 	
-	~OpenNodeList() {
-		for(NodeList::iterator i = nodes.begin(); i != nodes.end(); ++i) {
-			delete *i;
+	static const size_t None = size_t(-1);
+	
+	explicit NodePool(size_t capacity) {
+		nodes.reserve(capacity);
+	}
+	
+	size_t add(NodeId id, size_t parent, float distance, float remaining) {
+		nodes.push_back(Node(id, parent, distance, remaining));
+		return nodes.size() - 1;
+	}
+	
+	Node & operator[](size_t i) {
+		return nodes[i];
+	}
+	
+	const Node & operator[](size_t i) const {
+		return nodes[i];
+	}
+	
+};
+
+const size_t PathFinder::NodePool::None;
+
+/*!
+ * Binary min-heap of pool indices ordered by node cost.
+ * Nodes with equal cost are ordered by their creation order so that the
+ * search expands nodes in the same order as a linear scan would.
+ */
+class PathFinder::OpenNodeList {
+	
+	NodePool & pool;
+	
+	std::vector<size_t> heap;
+	
+	//! Position in the heap + 1 for each map node, 0 if not in the open list
+	std::vector<size_t> index;
+	
+	bool isBetter(size_t a, size_t b) const {
+		float ca = pool[a].getCost(), cb = pool[b].getCost();
+		return ca < cb || (ca == cb && a < b);
+	}
+	
+	void place(size_t pos, size_t node) {
+		heap[pos] = node;
+		index[pool[node].getId()] = pos + 1;
+	}
+	
+	void siftUp(size_t pos) {
+		size_t node = heap[pos];
+		while(pos > 0) {
+			size_t parent = (pos - 1) / 2;
+			if(!isBetter(node, heap[parent])) {
+				break;
+			}
+			place(pos, heap[parent]);
+			pos = parent;
+		}
+		place(pos, node);
+	}
+	
+	void siftDown(size_t pos) {
+		size_t node = heap[pos];
+		size_t size = heap.size();
+		while(true) {
+			size_t child = 2 * pos + 1;
+			if(child >= size) {
+				break;
+			}
+			if(child + 1 < size && isBetter(heap[child + 1], heap[child])) {
+				child++;
+			}
+			if(!isBetter(heap[child], node)) {
+				break;
+			}
+			place(pos, heap[child]);
+			pos = child;
 		}
+		place(pos, node);
 	}
 	
+public:
+	
+	OpenNodeList(size_t map_size, NodePool & _pool) : pool(_pool), index(map_size, 0) { }
+	
 	/*!
 	 * If a node with the same ID exists, update it.
 	 * Otherwise add a new node.
 	 * Assumes that remaining never changes for the same node id.
 	 */
-	inline void add(NodeId id, const Node * parent, float distance, float remaining) {
+	inline void add(NodeId id, size_t parent, float distance, float remaining) {
 		
 		// Check if node is already in open list.
-		for(NodeList::iterator i = nodes.begin(); i != nodes.end(); ++i) {
-			if((*i)->getId() == id) {
-				if((*i)->getDistance() > distance) {
-					(*i)->newParent(parent, distance);
-				}
-				return;
+		if(index[id]) {
+			size_t pos = index[id] - 1;
+			Node & node = pool[heap[pos]];
+			if(node.getDistance() > distance) {
+				node.newParent(parent, distance);
+				siftUp(pos);
 			}
+			return;
 		}
 		
-		nodes.push_back(new Node(id, parent, distance, remaining));
+		heap.push_back(pool.add(id, parent, distance, remaining));
+		siftUp(heap.size() - 1);
 	}
 	
-	Node * extractBestNode() {
-		// TODO use a better datastructure
+	/*!
+	 * @return the pool index of the best node (lowest cost) or NodePool::None
+	 *         if the list is empty
+	 */
+	size_t extractBestNode() {
 		
-		if(nodes.empty()) {
-			return NULL;
+		if(heap.empty()) {
+			return NodePool::None;
 		}
 		
-		NodeList::iterator best = nodes.begin();
-		float cost = std::numeric_limits<float>::max();
-		for(NodeList::iterator i = nodes.begin(); i != nodes.end(); ++i) {
-			if((*i)->getCost() < cost) {
-				cost = (*i)->getCost();
-				best = i;
-			}
-		}
+		size_t best = heap.front();
+		index[pool[best].getId()] = 0;
 		
-		Node * node = *best;
-		nodes.erase(best);
+		size_t last = heap.back();
+		heap.pop_back();
+		if(!heap.empty()) {
+			heap.front() = last;
+			siftDown(0);
+		}
 		
-		return node;
+		return best;
 	}
 	
 };
 
 class PathFinder::ClosedNodeList {
 	
-	typedef std::vector<Node*> NodeList;
-	NodeList nodes;
+	std::vector<bool> closed;
 	
 public:
 	
-	~ClosedNodeList() {
-		for(NodeList::iterator i = nodes.begin(); i != nodes.end(); ++i) {
-			delete *i;
-		}
-	}
+	explicit ClosedNodeList(size_t map_size) : closed(map_size, false) { }
 	
-	void add(Node * node) {
-		nodes.push_back(node);
+	void add(NodeId id) {
+		closed[id] = true;
 	}
 	
 	bool contains(NodeId id) const {
-		// TODO better datastructure: set of closed node ids
-		for(NodeList::const_iterator i = nodes.begin(); i != nodes.end(); ++i) {
-			if((*i)->getId() == id) {
-				return true;
-			}
-		}
-		return false;
+		return closed[id];
 	}
 	
 };
@@ -194,7 +274,8 @@ public:
 PathFinder::PathFinder(size_t map_size, const ANCHOR_DATA * map_data,
                        size_t slight_count, const EERIE_LIGHT * const * slight_list)
 	: radius(RADIUS_DEFAULT), height(HEIGHT_DEFAULT), heuristic(HEURISTIC_DEFAULT),
-	  map_s(map_size), map_d(map_data), slight_c(slight_count), slight_l(slight_list) { }
+	  map_s(map_size), map_d(map_data), slight_c(slight_count), slight_l(slight_list),
+	  hierarchy(NULL) { }
 
 void PathFinder::setHeuristic(float _heuristic) {
 	if(_heuristic >= HEURISTIC_MAX) {
@@ -211,6 +292,10 @@ void PathFinder::setCylinder(float _radius, float _height) {
 	height = _height;
 }
 
+void PathFinder::setHierarchy(const PathHierarchy * _hierarchy) {
+	hierarchy = _hierarchy;
+}
+
 bool PathFinder::move(NodeId from, NodeId to, Result & rlist, bool stealth) const {
 	
 	if(from == to) {
@@ -218,25 +303,40 @@ bool PathFinder::move(NodeId from, NodeId to, Result & rlist, bool stealth) cons
 		return true;
 	}
 	
-	// Create start node and put it on open list
-	Node * node = new Node(from, NULL, 0.0f, 0.0f);
-	if(!node) {
-		return false;
+	// For long paths, first select the clusters to go through and then only
+	// search the anchors in those. Fall back to searching the whole map if
+	// there is no path through the corridor.
+	if(hierarchy) {
+		PathHierarchy::Corridor corridor;
+		if(hierarchy->getCorridor(from, to, HIERARCHY_MIN_CLUSTERS, corridor)
+		   && search(from, to, rlist, stealth, &corridor)) {
+			return true;
+		}
 	}
 	
+	return search(from, to, rlist, stealth, NULL);
+}
+
+bool PathFinder::search(NodeId from, NodeId to, Result & rlist, bool stealth,
+                        const PathHierarchy::Corridor * corridor) const {
+	
+	// Create start node
+	NodePool pool(map_s);
+	size_t node = pool.add(from, NodePool::None, 0.0f, 0.0f);
+	
 	// A* main loop
-	OpenNodeList open;
-	ClosedNodeList close;
+	OpenNodeList open(map_s, pool);
+	ClosedNodeList close(map_s);
 	do {
 		
-		// Put node onto close list as we have now examined this node.
-		close.add(node);
+		NodeId nid = pool[node].getId();
 		
-		NodeId nid = node->getId();
+		// Put node onto close list as we have now examined this node.
+		close.add(nid);
 		
 		// If it's the goal node then we're done.
 		if(nid == to) {
-			buildPath(*node, rlist);
+			buildPath(pool, node, rlist);
 			return true;
 		}
 		
@@ -254,13 +354,20 @@ bool PathFinder::move(NodeId from, NodeId to, Result & rlist, bool stealth) cons
 				continue;
 			}
 			
+			if(corridor) {
+				long cluster = hierarchy->getCluster(cid);
+				if(cluster >= 0 && !(*corridor)[cluster]) {
+					continue;
+				}
+			}
+			
 			// Cost to reach this node.
 			float distance = fdist(map_d[cid].pos, map_d[nid].pos);
 			if(stealth) {
 				distance += getIlluminationCost(map_d[cid].pos);
 			}
 			distance *= heuristic;
-			distance += node->getDistance();
+			distance += pool[node].getDistance();
 			
 			// Estimated cost to get from this node to the destination.
 			float remaining = (1.0f - heuristic) * fdist(map_d[cid].pos, map_d[to].pos);
@@ -269,7 +376,7 @@ bool PathFinder::move(NodeId from, NodeId to, Result & rlist, bool stealth) cons
 		}
 	
 		node = open.extractBestNode();
-	} while(node);
+	} while(node != NodePool::None);
 	
 	// No path found!
 	return false;
@@ -285,28 +392,26 @@ bool PathFinder::flee(NodeId from, const Vec3f & danger, float safeDist, Result
 		return true;
 	}
 	
-	// Create start node and put it on open list
-	Node * node = new Node(from, NULL, 0.0f, 0.0f);
-	if(!node) {
-		return false;
-	}
+	// Create start node
+	NodePool pool(map_s);
+	size_t node = pool.add(from, NodePool::None, 0.0f, 0.0f);
 	
 	// A* main loop
-	OpenNodeList open;
-	ClosedNodeList close;
+	OpenNodeList open(map_s, pool);
+	ClosedNodeList close(map_s);
 	do {
 		
+		NodeId nid = pool[node].getId();
+		
 		// Put node onto close list as we have now examined this node.
-		close.add(node);
+		close.add(nid);
 		
 		// If it's the goal node then we're done.
-		if(node->getCost() == node->getDistance()) {
-			buildPath(*node, rlist);
+		if(pool[node].getCost() == pool[node].getDistance()) {
+			buildPath(pool, node, rlist);
 			return true;
 		}
 		
-		NodeId nid = node->getId();
-		
 		// Otherwise, generate child from current node.
 		for(short i(0); i < map_d[nid].nblinked; i++) {
 			
@@ -322,7 +427,7 @@ bool PathFinder::flee(NodeId from, const Vec3f & danger, float safeDist, Result
 			}
 			
 			// Cost to reach this node.
-			float distance = node->getDistance() + fdist(map_d[cid].pos, map_d[nid].pos);
+			float distance = pool[node].getDistance() + fdist(map_d[cid].pos, map_d[nid].pos);
 			if(stealth) {
 				distance += getIlluminationCost(map_d[cid].pos);
 			}
@@ -335,7 +440,7 @@ bool PathFinder::flee(NodeId from, const Vec3f & danger, float safeDist, Result
 		}
 		
 		node = open.extractBestNode();
-	} while(node);
+	} while(node != NodePool::None);
 	
 	// No path found!
 	return false;
@@ -451,15 +556,12 @@ bool PathFinder::lookFor(NodeId from, const Vec3f & pos, float radius, Result &
 	return true;
 }
 
-void PathFinder::buildPath(const Node & node, Result & rlist) {
-	
-	const Node * next = &node;
+void PathFinder::buildPath(const NodePool & pool, size_t node, Result & rlist) {
 	
 	size_t s = rlist.size();
 	
-	while(next) {
-		rlist.push_back(next->getId());
-		next = next->getParent();
+	for(size_t next = node; next != NodePool::None; next = pool[next].getParent()) {
+		rlist.push_back(pool[next].getId());
 	}
 	
 	std::reverse(rlist.begin() + s, rlist.end());
@@ -47,6 +47,7 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include <stddef.h>
 #include <vector>
 
+#include "ai/PathHierarchy.h"
 #include "math/Types.h"
 
 struct ANCHOR_DATA;
@@ -90,6 +91,14 @@ public:
 	 */
 	void setCylinder(float radius, float height);
 	
+	/*!
+	 * Set a cluster hierarchy to speed up long searches in move().
+	 * The hierarchy must have been built for the same map data and is not copied.
+	 * Paths found using the hierarchy may be slightly longer than the optimal path.
+	 * The default is to not use a hierarchy.
+	 */
+	void setHierarchy(const PathHierarchy * hierarchy);
+	
 	/*!
 	 * Find a path between two nodes.
 	 * @param from The index of the start node into the provided map_data.
@@ -135,13 +144,23 @@ public:
 private:
 	
 	class Node;
+	class NodePool;
 	class OpenNodeList;
 	class ClosedNodeList;
 	
 	/*!
-	 * @return the best node (lowest cost) from open list or NULL if the list is empty
+	 * Append the path ending at the given node to rlist.
+	 * @param node Pool index of the last node in the path.
 	 */
-	static void buildPath(const Node & node, Result & rlist);
+	static void buildPath(const NodePool & pool, size_t node, Result & rlist);
+	
+	/*!
+	 * Find a path between two nodes, optionally only visiting the anchors
+	 * in the given hierarchy clusters.
+	 */
+	bool search(NodeId from, NodeId to, Result & rlist, bool stealth,
+	            const PathHierarchy::Corridor * corridor) const;
+	
 	float getIlluminationCost(const Vec3f & pos) const;
 	NodeId getNearestNode(const Vec3f & pos) const;
 	
@@ -153,6 +172,7 @@ private:
 	const ANCHOR_DATA * map_d; // Map data
 	size_t slight_c; // Light count
 	const EERIE_LIGHT * const * slight_l; // Light data
+	const PathHierarchy * hierarchy;
 	
 };
 
@@ -46,20 +46,29 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 
 #include "ai/PathFinderManager.h"
 
-#include <cstring>
 #include <cstdlib>
 #include <algorithm>
+#include <list>
+#include <string>
+#include <vector>
+
+#include <boost/lexical_cast.hpp>
+#include <boost/unordered_map.hpp>
 
 #include "ai/PathFinder.h"
+#include "ai/PathHierarchy.h"
 #include "game/Entity.h"
 #include "game/NPC.h"
 #include "graphics/Math.h"
+#include "io/log/Logger.h"
 #include "platform/Thread.h"
 #include "platform/Lock.h"
+#include "platform/Profiler.h"
+#include "platform/WorkerPool.h"
 #include "physics/Anchors.h"
+#include "scene/Interactive.h"
 #include "scene/Light.h"
-
-using std::memcpy;
+#include "scene/Scene.h"
 
 
 static const float PATHFINDER_HEURISTIC_MIN = 0.2f;
@@ -69,176 +78,263 @@ static const float PATHFINDER_HEURISTIC_RANGE = PATHFINDER_HEURISTIC_MAX
 static const float PATHFINDER_DISTANCE_MAX = 5000.0f;
 
 // Pathfinder Definitions
-static unsigned long PATHFINDER_UPDATE_INTERVAL = 10;
+static const unsigned PATHFINDER_UPDATE_INTERVAL = 10; // How long idle workers sleep
+static const unsigned PATHFINDER_MAX_WORKERS = 8;
 
-PATHFINDER_REQUEST pr;
 long PATHFINDER_WORKING = 0;
 
+namespace {
+
+/*!
+ * A queued request together with a snapshot of the NPC state it depends on.
+ * Workers only ever read this snapshot and never touch the entity itself.
+ */
+struct PathFinderJob {
+	PATHFINDER_REQUEST req;
+	unsigned long serial;
+	Behaviour behavior;
+	float behavior_param;
+	float radius;
+	float height;
+	Vec3f pos;
+	Vec3f target;
+};
+
+struct PathFinderResult {
+	PATHFINDER_REQUEST req;
+	unsigned long serial;
+	PathFinder::Result path;
+};
+
+typedef std::list<PathFinderJob> JobQueue;
+typedef boost::unordered_map<const Entity *, JobQueue::iterator> PendingJobs;
+typedef boost::unordered_map<const Entity *, unsigned long> LatestSerials;
+typedef std::vector<PathFinderResult> ResultList;
+
 class PathFinderThread : public StoppableThread {
 	
 	void run();
 	
 };
 
-static PathFinderThread * pathfinder = NULL;
-static Lock * mutex = NULL;
+} // anonymous namespace
 
-struct PATHFINDER_QUEUE_ELEMENT {
-	PATHFINDER_REQUEST req;
-	PATHFINDER_QUEUE_ELEMENT * next;
-	long valid;
-};
+static std::vector<PathFinderThread *> workers;
+static Lock * mutex = NULL;
 
-static PATHFINDER_QUEUE_ELEMENT * pathfinder_queue_start = NULL;
+// MOVE_TO, FLEE and LOOK_FOR requests are processed before all other requests.
+static JobQueue priorityQueue;
+static JobQueue normalQueue;
+static long queuedCount = 0;
 
 // An Io can request Pathfinding only once so we insure that it's always the case.
 // A new pathfinder request from the same IO will overwrite the precedent.
-static PATHFINDER_QUEUE_ELEMENT * PATHFINDER_Find_ioid(Entity * io) {
-	
-	if (!pathfinder_queue_start) return NULL;
+static PendingJobs pending;
 
-	PATHFINDER_QUEUE_ELEMENT * cur = pathfinder_queue_start;
+// Serial of the last request for each IO - results for older requests are dropped.
+static LatestSerials latest;
+static unsigned long nextSerial = 0;
 
-	while(cur) {
-		if (cur->req.ioid == io) return cur->valid ? cur : NULL;
-		
-		cur = cur->next;
-	}
+static ResultList results;
 
-	return NULL;
+static PathHierarchy hierarchy;
+
+// Anchor changes are applied to the hierarchy only while no search is reading it.
+static std::vector<long> changedAnchors;
+static bool allAnchorsChanged = false;
+
+static bool EERIE_PATHFINDER_Has_Anchor_Updates() {
+	return allAnchorsChanged || !changedAnchors.empty();
+}
+
+// Must be called with the mutex held and no search running.
+static void EERIE_PATHFINDER_Apply_Anchor_Updates() {
+	
+	arx_assert(PATHFINDER_WORKING == 0);
+	
+	if(allAnchorsChanged) {
+		hierarchy.updateAll();
+	} else {
+		for(size_t i = 0; i < changedAnchors.size(); i++) {
+			hierarchy.updateAnchor(changedAnchors[i]);
+		}
+	}
+	
+	changedAnchors.clear();
+	allAnchorsChanged = false;
 }
 
 // Adds a Pathfinder Search Element to the pathfinder queue.
 bool EERIE_PATHFINDER_Add_To_Queue(PATHFINDER_REQUEST * req) {
 	
-	if(!pathfinder) {
+	if(workers.empty() || !req->ioid || !req->ioid->_npcdata) {
 		return false;
 	}
 	
+	const Entity * io = req->ioid;
+	
 	Autolock lock(mutex);
-
-	PATHFINDER_QUEUE_ELEMENT * cur = pathfinder_queue_start;
-
-	PATHFINDER_QUEUE_ELEMENT * temp;
-
-	// If this NPC is already requesting a Pathfinding then either
-	// try to Override it or add it to queue if it is currently being
-	// processed.
-	temp = PATHFINDER_Find_ioid(req->ioid);
-
-	if(temp && temp->valid && temp != pathfinder_queue_start) {
-		temp->valid = 0;
-		memcpy(&temp->req, req, sizeof(PATHFINDER_REQUEST));
-		temp->valid = 1;
-		return true;
-	}
-
-	// Create a New element for the queue
-	temp = (PATHFINDER_QUEUE_ELEMENT *)malloc(sizeof(PATHFINDER_QUEUE_ELEMENT));
-
-	if(!temp) {
-		return false;
-	}
-
-	// Fill this New element with new request
-	memcpy(&temp->req, req, sizeof(PATHFINDER_REQUEST));
-	temp->valid = 1;
-
-	// No queue start ? then this element becomes the queue start
-	if(!cur) {
-		temp->next = NULL;
-		pathfinder_queue_start = temp;
-		
-	} else if((req->ioid->_npcdata->behavior & (BEHAVIOUR_MOVE_TO | BEHAVIOUR_FLEE
-	                                            | BEHAVIOUR_LOOK_FOR)) && cur->next) {
-		// priority: insert as second element of queue
-		temp->next = cur->next;
-		cur->next = temp;
-		
+	
+	PendingJobs::iterator it = pending.find(io);
+	
+	JobQueue::iterator job;
+	if(it != pending.end()) {
+		// If this NPC is already requesting a Pathfinding then override it.
+		job = it->second;
 	} else {
-		
-		// add to end of queue
-		temp->next = NULL;
-		
-		if(!pathfinder_queue_start) {
-			pathfinder_queue_start = temp;
-			return true;
-		} else {
-			while(cur->next) {
-				cur = cur->next;
-			}
-			cur->next = temp;
-		}
+		JobQueue & queue = (io->_npcdata->behavior & (BEHAVIOUR_MOVE_TO | BEHAVIOUR_FLEE
+		                                              | BEHAVIOUR_LOOK_FOR))
+		                   ? priorityQueue : normalQueue;
+		job = queue.insert(queue.end(), PathFinderJob());
+		pending[io] = job;
+		queuedCount++;
 	}
 	
+	job->req = *req;
+	job->serial = nextSerial++;
+	job->behavior = io->_npcdata->behavior;
+	job->behavior_param = io->_npcdata->behavior_param;
+	job->radius = io->physics.cyl.radius;
+	job->height = io->physics.cyl.height;
+	job->pos = io->pos;
+	job->target = io->target;
+	
+	latest[io] = job->serial;
+	
 	return true;
 }
 
 long EERIE_PATHFINDER_Get_Queued_Number() {
-	if(!mutex)
+	
+	if(!mutex) {
 		return 0;
-
+	}
+	
 	Autolock lock(mutex);
 	
-	PATHFINDER_QUEUE_ELEMENT * cur = pathfinder_queue_start;
-
-	long count = 0;
-
-	while (cur) cur = cur->next, count++;
-
-	return count;
+	return queuedCount;
 }
 
 static void EERIE_PATHFINDER_Clear_Private() {
 	
-	PATHFINDER_QUEUE_ELEMENT * cur = pathfinder_queue_start;
-	PATHFINDER_QUEUE_ELEMENT * next;
+	priorityQueue.clear();
+	normalQueue.clear();
+	queuedCount = 0;
+	pending.clear();
 	
-	while(cur) {
-		next = cur->next;
-		free(cur);
-		cur = next;
-	}
-	
-	pathfinder_queue_start = NULL;
+	// Results of requests that are currently being processed will be discarded.
+	latest.clear();
+	results.clear();
 	
 }
 
-
 void EERIE_PATHFINDER_Clear() {
 	
-	if(!pathfinder) {
+	if(workers.empty()) {
 		return;
 	}
 	
-	Autolock lock(mutex);
+	{
+		Autolock lock(mutex);
+		EERIE_PATHFINDER_Clear_Private();
+	}
 	
-	EERIE_PATHFINDER_Clear_Private();
+	// Searches that are already running still read the anchors, which callers may free
+	// as soon as we return.
+	EERIE_PATHFINDER_Wait();
 	
+	Autolock lock(mutex);
+	results.clear();
+	
+	if(EERIE_PATHFINDER_Has_Anchor_Updates()) {
+		EERIE_PATHFINDER_Apply_Anchor_Updates();
+	}
 }
 
 // Retrieves & Removes next Pathfind request from queue
-static bool EERIE_PATHFINDER_Get_Next_Request(PATHFINDER_REQUEST * request) {
+static bool EERIE_PATHFINDER_Get_Next_Request(PathFinderJob & job) {
 	
-	if(!request || !pathfinder_queue_start || !pathfinder_queue_start->valid) {
-		return false;
+	Autolock lock(mutex);
+	
+	if(EERIE_PATHFINDER_Has_Anchor_Updates()) {
+		if(PATHFINDER_WORKING != 0) {
+			// Let running searches finish so that the hierarchy can be updated.
+			return false;
+		}
+		EERIE_PATHFINDER_Apply_Anchor_Updates();
 	}
 	
-	PATHFINDER_QUEUE_ELEMENT * cur = pathfinder_queue_start;
-
-	if ((cur->req.ioid)
-	        && (cur->req.ioid->ioflags & IO_NPC)
-	        && (cur->req.ioid->_npcdata->behavior == BEHAVIOUR_NONE)) {
-		pathfinder_queue_start = cur->next;
-		free(cur);
-		return false;
+	while(true) {
+		
+		JobQueue & queue = priorityQueue.empty() ? normalQueue : priorityQueue;
+		if(queue.empty()) {
+			return false;
+		}
+		
+		job = queue.front();
+		pending.erase(job.req.ioid);
+		queue.pop_front();
+		queuedCount--;
+		
+		if(job.req.isvalid && job.behavior != BEHAVIOUR_NONE) {
+			PATHFINDER_WORKING++;
+			return true;
+		}
+		
+		// Dropped requests will never produce a result.
+		LatestSerials::iterator it = latest.find(job.req.ioid);
+		if(it != latest.end() && it->second == job.serial) {
+			latest.erase(it);
+		}
 	}
+}
 
-	memcpy(request, &cur->req, sizeof(PATHFINDER_REQUEST));
-	pathfinder_queue_start = cur->next;
-	free(cur);
+static float EERIE_PATHFINDER_Get_Heuristic(float distance) {
+	
+	if(distance < PATHFINDER_DISTANCE_MAX) {
+		return PATHFINDER_HEURISTIC_MIN
+		       + PATHFINDER_HEURISTIC_RANGE * (distance / PATHFINDER_DISTANCE_MAX);
+	}
+	
+	return PATHFINDER_HEURISTIC_MAX;
+}
 
-	return true;
+static void EERIE_PATHFINDER_Process(PathFinder & pathfinder, const PathFinderJob & job,
+                                     PathFinder::Result & result) {
+	
+	pathfinder.setCylinder(job.radius, job.height);
+	
+	bool stealth = (job.behavior & (BEHAVIOUR_SNEAK | BEHAVIOUR_HIDE))
+	               == (BEHAVIOUR_SNEAK | BEHAVIOUR_HIDE);
+	
+	if(job.behavior & (BEHAVIOUR_MOVE_TO | BEHAVIOUR_GO_HOME)) {
+		
+		float distance = fdist(ACTIVEBKG->anchors[job.req.from].pos,
+		                       ACTIVEBKG->anchors[job.req.to].pos);
+		
+		pathfinder.setHeuristic(EERIE_PATHFINDER_Get_Heuristic(distance));
+		pathfinder.move(job.req.from, job.req.to, result, stealth);
+		
+	} else if(job.behavior & BEHAVIOUR_WANDER_AROUND) {
+		
+		pathfinder.setHeuristic(EERIE_PATHFINDER_Get_Heuristic(job.behavior_param));
+		pathfinder.wanderAround(job.req.from, job.behavior_param, result, stealth);
+		
+	} else if(job.behavior & (BEHAVIOUR_FLEE | BEHAVIOUR_HIDE)) {
+		
+		pathfinder.setHeuristic(EERIE_PATHFINDER_Get_Heuristic(job.behavior_param));
+		float safedist = job.behavior_param + fdist(job.target, job.pos);
+		pathfinder.flee(job.req.from, job.target, safedist, result, stealth);
+		
+	} else if(job.behavior & BEHAVIOUR_LOOK_FOR) {
+		
+		float distance = fdist(job.pos, job.target);
+		
+		pathfinder.setHeuristic(EERIE_PATHFINDER_Get_Heuristic(distance));
+		pathfinder.lookFor(job.req.from, job.target, job.behavior_param, result, stealth);
+		
+	}
+	
 }
 
 // Pathfinder Thread
@@ -247,123 +343,183 @@ void PathFinderThread::run() {
 	EERIE_BACKGROUND * eb = ACTIVEBKG;
 	PathFinder pathfinder(eb->nbanchors, eb->anchors,
 	                      MAX_LIGHTS, (EERIE_LIGHT **)GLight);
-
+	pathfinder.setHierarchy(&hierarchy);
+	
+	PathFinderJob job;
+	PathFinder::Result path;
+	
 	while(!isStopRequested()) {
 		
-		mutex->lock();
+		if(!EERIE_PATHFINDER_Get_Next_Request(job)) {
+			sleep(PATHFINDER_UPDATE_INTERVAL);
+			continue;
+		}
+		
+		path.clear();
+		{
+			ARX_PROFILE("Pathfinder");
+			EERIE_PATHFINDER_Process(pathfinder, job, path);
+		}
+		
+		Autolock lock(mutex);
+		
+		results.push_back(PathFinderResult());
+		results.back().req = job.req;
+		results.back().serial = job.serial;
+		results.back().path.swap(path);
+		
+		PATHFINDER_WORKING--;
+	}
+	
+}
 
-		PATHFINDER_WORKING = 1;
+void EERIE_PATHFINDER_Update() {
+	
+	if(!mutex) {
+		return;
+	}
+	
+	static ResultList finished;
+	
+	{
+		Autolock lock(mutex);
+		
+		if(results.empty()) {
+			return;
+		}
+		
+		finished.swap(results);
+		
+		for(ResultList::iterator i = finished.begin(); i != finished.end(); ++i) {
+			LatestSerials::iterator it = latest.find(i->req.ioid);
+			if(it != latest.end() && it->second == i->serial) {
+				latest.erase(it);
+			} else {
+				// The IO has made a newer request or the queue has been cleared.
+				i->req.isvalid = false;
+			}
+		}
+	}
+	
+	for(ResultList::const_iterator i = finished.begin(); i != finished.end(); ++i) {
+		
+		const PATHFINDER_REQUEST & req = i->req;
+		if(!req.isvalid || !ValidIOAddress(req.ioid) || !req.ioid->_npcdata
+		   || req.ioid->_npcdata->behavior == BEHAVIOUR_NONE) {
+			continue;
+		}
+		
+		if(!i->path.empty()) {
+			unsigned short * list = (unsigned short *)malloc(i->path.size() * sizeof(unsigned short));
+			std::copy(i->path.begin(), i->path.end(), list);
+			*(req.returnlist) = list;
+		}
+		*(req.returnnumber) = i->path.size();
+	}
+	
+	finished.clear();
+}
 
-		if (EERIE_PATHFINDER_Get_Next_Request(&pr) && pr.isvalid)
+void EERIE_PATHFINDER_Wait() {
+	
+	if(workers.empty()) {
+		return;
+	}
+	
+	while(true) {
 		{
-
-			PATHFINDER_REQUEST curpr;
-			memcpy(&curpr, &pr, sizeof(PATHFINDER_REQUEST));
-			PATHFINDER_WORKING = 2;
-
-			if (curpr.ioid && curpr.ioid->_npcdata)
-			{
-				float heuristic(PATHFINDER_HEURISTIC_MAX);
-
-				pathfinder.setCylinder(curpr.ioid->physics.cyl.radius, curpr.ioid->physics.cyl.height);
-
-				bool stealth = (curpr.ioid->_npcdata->behavior & (BEHAVIOUR_SNEAK | BEHAVIOUR_HIDE))
-				                == (BEHAVIOUR_SNEAK | BEHAVIOUR_HIDE);
-
-				
-				PathFinder::Result result;
-				
-				if ((curpr.ioid->_npcdata->behavior & BEHAVIOUR_MOVE_TO)
-				        || (curpr.ioid->_npcdata->behavior & BEHAVIOUR_GO_HOME))
-				{
-					float distance = fdist(ACTIVEBKG->anchors[curpr.from].pos, ACTIVEBKG->anchors[curpr.to].pos);
-
-					if (distance < PATHFINDER_DISTANCE_MAX)
-						heuristic = PATHFINDER_HEURISTIC_MIN
-						            + PATHFINDER_HEURISTIC_RANGE * (distance / PATHFINDER_DISTANCE_MAX);
-
-					pathfinder.setHeuristic(heuristic);
-					pathfinder.move(curpr.from, curpr.to, result, stealth);
-				}
-				else if (curpr.ioid->_npcdata->behavior & BEHAVIOUR_WANDER_AROUND)
-				{
-					if (curpr.ioid->_npcdata->behavior_param < PATHFINDER_DISTANCE_MAX)
-						heuristic = PATHFINDER_HEURISTIC_MIN
-						            + PATHFINDER_HEURISTIC_RANGE
-						              * (curpr.ioid->_npcdata->behavior_param / PATHFINDER_DISTANCE_MAX);
-
-					pathfinder.setHeuristic(heuristic);
-					pathfinder.wanderAround(curpr.from, curpr.ioid->_npcdata->behavior_param, result, stealth);
-				}
-				else if (curpr.ioid->_npcdata->behavior & (BEHAVIOUR_FLEE | BEHAVIOUR_HIDE))
-				{
-					if (curpr.ioid->_npcdata->behavior_param < PATHFINDER_DISTANCE_MAX)
-						heuristic = PATHFINDER_HEURISTIC_MIN
-						            + PATHFINDER_HEURISTIC_RANGE
-						              * (curpr.ioid->_npcdata->behavior_param / PATHFINDER_DISTANCE_MAX);
-
-					pathfinder.setHeuristic(heuristic);
-					float safedist = curpr.ioid->_npcdata->behavior_param
-					                 + fdist(curpr.ioid->target, curpr.ioid->pos);
-
-					pathfinder.flee(curpr.from, curpr.ioid->target, safedist, result, stealth);
-				}
-				else if (curpr.ioid->_npcdata->behavior & BEHAVIOUR_LOOK_FOR)
-				{
-					float distance = fdist(curpr.ioid->pos, curpr.ioid->target);
-
-					if (distance < PATHFINDER_DISTANCE_MAX)
-						heuristic = PATHFINDER_HEURISTIC_MIN
-						            + PATHFINDER_HEURISTIC_RANGE * (distance / PATHFINDER_DISTANCE_MAX);
-
-					pathfinder.setHeuristic(heuristic);
-					pathfinder.lookFor(curpr.from, curpr.ioid->target,
-					                   curpr.ioid->_npcdata->behavior_param, result, stealth);
-				}
-				
-				if(!result.empty()) {
-					unsigned short * list = (unsigned short*)malloc(result.size() * sizeof(unsigned short));
-					std::copy(result.begin(), result.end(), list);
-					*(curpr.returnlist) = list;
-				}
-				*(curpr.returnnumber) = result.size();
-				
+			Autolock lock(mutex);
+			if(queuedCount == 0 && PATHFINDER_WORKING == 0) {
+				return;
 			}
 		}
+		Thread::sleep(1);
+	}
+}
 
+void EERIE_PATHFINDER_Release() {
+	
+	if(workers.empty()) {
+		return;
+	}
+	
+	for(size_t i = 0; i < workers.size(); i++) {
+		workers[i]->stop();
+		delete workers[i];
+	}
+	workers.clear();
+	
+	{
+		Autolock lock(mutex);
+		EERIE_PATHFINDER_Clear_Private();
 		PATHFINDER_WORKING = 0;
-
-		mutex->unlock();
-		sleep(PATHFINDER_UPDATE_INTERVAL);
+		changedAnchors.clear();
+		allAnchorsChanged = false;
 	}
+	
+	delete mutex, mutex = NULL;
+	
+	hierarchy.clear();
+}
 
-	// fix leaks memory but freeze characters
-	// pathfinder.Clean();
-
-	PATHFINDER_WORKING = 0;
+// Group the anchors by the portal room they are in.
+static void EERIE_PATHFINDER_Build_Hierarchy() {
+	
+	EERIE_BACKGROUND * eb = ACTIVEBKG;
+	
+	if(!portals || !eb->nbanchors) {
+		hierarchy.clear();
+		return;
+	}
+	
+	std::vector<long> rooms(eb->nbanchors, -1);
+	for(long i = 0; i < eb->nbanchors; i++) {
+		Vec3f pos = eb->anchors[i].pos;
+		rooms[i] = ARX_PORTALS_GetRoomNumForPosition(&pos);
+	}
 	
+	hierarchy.build(eb->nbanchors, eb->anchors, rooms);
+	
+	LogDebug("Pathfinder: grouped " << eb->nbanchors << " anchors into "
+	         << hierarchy.getClusterCount() << " clusters");
 }
 
-void EERIE_PATHFINDER_Release() {
+void EERIE_PATHFINDER_Update_Anchor(long anchor) {
 	
-	if(!pathfinder) {
+	if(workers.empty()) {
 		return;
 	}
 	
-	mutex->lock();
+	Autolock lock(mutex);
+	
+	if(!allAnchorsChanged) {
+		changedAnchors.push_back(anchor);
+	}
+	
+	if(PATHFINDER_WORKING == 0) {
+		EERIE_PATHFINDER_Apply_Anchor_Updates();
+	}
+}
+
+void EERIE_PATHFINDER_Update_All_Anchors() {
 	
-	EERIE_PATHFINDER_Clear_Private();
+	if(workers.empty()) {
+		return;
+	}
 	
-	pathfinder->stop();
+	Autolock lock(mutex);
 	
-	delete pathfinder, pathfinder = NULL;
+	changedAnchors.clear();
+	allAnchorsChanged = true;
 	
-	mutex->unlock(), delete mutex, mutex = NULL;
+	if(PATHFINDER_WORKING == 0) {
+		EERIE_PATHFINDER_Apply_Anchor_Updates();
+	}
 }
 
 void EERIE_PATHFINDER_Create() {
 	
-	if(pathfinder) {
+	if(!workers.empty()) {
 		EERIE_PATHFINDER_Release();
 	}
 	
@@ -371,7 +527,14 @@ void EERIE_PATHFINDER_Create() {
 		mutex = new Lock();
 	}
 	
-	pathfinder = new PathFinderThread();
-	pathfinder->setThreadName("Pathfinder");
-	pathfinder->start();
+	EERIE_PATHFINDER_Build_Hierarchy();
+	
+	unsigned count = std::min(getBackgroundWorkerCount(), PATHFINDER_MAX_WORKERS);
+	
+	for(unsigned i = 0; i < count; i++) {
+		PathFinderThread * worker = new PathFinderThread();
+		worker->setThreadName("Pathfinder " + boost::lexical_cast<std::string>(i + 1));
+		worker->start();
+		workers.push_back(worker);
+	}
 }
@@ -60,12 +60,38 @@ struct PATHFINDER_REQUEST {
 	unsigned short ** returnlist;	//must be NULL
 };
 
+//! Number of requests currently being processed by the pathfinder workers
 extern long PATHFINDER_WORKING;
-extern PATHFINDER_REQUEST pr;
 
 bool EERIE_PATHFINDER_Add_To_Queue(PATHFINDER_REQUEST * request);
 long EERIE_PATHFINDER_Get_Queued_Number();
+
+/*!
+ * Drop all queued requests and pending results.
+ * Blocks until running searches have finished, so the anchors can be freed afterwards.
+ */
 void EERIE_PATHFINDER_Clear();
+
+/*!
+ * Publish finished pathfinder results to the requesting NPCs.
+ * Results are only written to returnnumber and returnlist from this function,
+ * which must be called from the main thread.
+ */
+void EERIE_PATHFINDER_Update();
+
+/*!
+ * Block until all queued requests have been processed.
+ * The results are published by the next call to EERIE_PATHFINDER_Update().
+ */
+void EERIE_PATHFINDER_Wait();
+
+/*!
+ * Update the pathfinder cluster connectivity after the ANCHOR_FLAG_BLOCKED
+ * flag of an anchor has changed.
+ */
+void EERIE_PATHFINDER_Update_Anchor(long anchor);
+void EERIE_PATHFINDER_Update_All_Anchors();
+
 void EERIE_PATHFINDER_Create();
 void EERIE_PATHFINDER_Release();
 
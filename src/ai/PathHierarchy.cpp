@@ -0,0 +1,227 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ai/PathHierarchy.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <map>
+#include <queue>
+#include <utility>
+
+#include "graphics/Math.h"
+#include "physics/Anchors.h"
+
+void PathHierarchy::build(size_t map_size, const ANCHOR_DATA * map_data,
+                          const std::vector<long> & clusters) {
+	
+	clear();
+	
+	map_d = map_data;
+	cluster = clusters;
+	cluster.resize(map_size, -1);
+	
+	long count = 0;
+	for(size_t i = 0; i < map_size; i++) {
+		count = std::max(count, cluster[i] + 1);
+	}
+	nodes.resize(count);
+	
+	// The center of a cluster is the average position of its anchors.
+	std::vector<size_t> sizes(count, 0);
+	for(size_t i = 0; i < map_size; i++) {
+		if(cluster[i] >= 0) {
+			nodes[cluster[i]].center += map_d[i].pos;
+			sizes[cluster[i]]++;
+		}
+	}
+	for(long c = 0; c < count; c++) {
+		if(sizes[c]) {
+			nodes[c].center *= 1.f / float(sizes[c]);
+		}
+	}
+	
+	// Collect all anchor links between different clusters.
+	typedef std::map<std::pair<long, long>, size_t> LinkMap;
+	LinkMap linkIds;
+	std::vector<float> linkCosts;
+	anchorCrossings.resize(map_size);
+	for(size_t i = 0; i < map_size; i++) {
+		
+		long a = cluster[i];
+		if(a < 0) {
+			continue;
+		}
+		
+		for(short k = 0; k < map_d[i].nblinked; k++) {
+			
+			NodeId j = map_d[i].linked[k];
+			long b = getCluster(j);
+			if(b < 0 || b == a) {
+				continue;
+			}
+			
+			std::pair<long, long> key(std::min(a, b), std::max(a, b));
+			LinkMap::iterator it = linkIds.find(key);
+			if(it == linkIds.end()) {
+				it = linkIds.insert(std::make_pair(key, linkCosts.size())).first;
+				linkCosts.push_back(std::numeric_limits<float>::max());
+			}
+			
+			// The cost to go from one cluster to the other through this link.
+			Vec3f middle = (map_d[i].pos + map_d[j].pos) * 0.5f;
+			float cost = fdist(nodes[a].center, middle) + fdist(middle, nodes[b].center);
+			linkCosts[it->second] = std::min(linkCosts[it->second], cost);
+			
+			Crossing crossing;
+			crossing.a = i;
+			crossing.b = j;
+			crossing.link = it->second;
+			crossing.open = false;
+			anchorCrossings[i].push_back(crossings.size());
+			anchorCrossings[j].push_back(crossings.size());
+			crossings.push_back(crossing);
+		}
+	}
+	
+	for(LinkMap::const_iterator it = linkIds.begin(); it != linkIds.end(); ++it) {
+		Edge edge;
+		edge.cost = linkCosts[it->second];
+		edge.link = it->second;
+		edge.target = it->first.second;
+		nodes[it->first.first].edges.push_back(edge);
+		edge.target = it->first.first;
+		nodes[it->first.second].edges.push_back(edge);
+	}
+	
+	links.resize(linkCosts.size());
+	updateAll();
+}
+
+void PathHierarchy::clear() {
+	map_d = NULL;
+	cluster.clear();
+	nodes.clear();
+	links.clear();
+	crossings.clear();
+	anchorCrossings.clear();
+}
+
+bool PathHierarchy::isOpen(const Crossing & crossing) const {
+	return !(map_d[crossing.a].flags & ANCHOR_FLAG_BLOCKED)
+	       && !(map_d[crossing.b].flags & ANCHOR_FLAG_BLOCKED);
+}
+
+void PathHierarchy::updateCrossing(Crossing & crossing) {
+	bool open = isOpen(crossing);
+	if(open != crossing.open) {
+		links[crossing.link] += open ? 1 : -1;
+		crossing.open = open;
+	}
+}
+
+void PathHierarchy::updateAnchor(NodeId anchor) {
+	
+	if(anchor >= anchorCrossings.size()) {
+		return;
+	}
+	
+	const std::vector<size_t> & touching = anchorCrossings[anchor];
+	for(size_t i = 0; i < touching.size(); i++) {
+		updateCrossing(crossings[touching[i]]);
+	}
+}
+
+void PathHierarchy::updateAll() {
+	
+	std::fill(links.begin(), links.end(), 0);
+	
+	for(size_t i = 0; i < crossings.size(); i++) {
+		crossings[i].open = false;
+		updateCrossing(crossings[i]);
+	}
+}
+
+bool PathHierarchy::getCorridor(NodeId from, NodeId to, size_t minClusters,
+                                Corridor & corridor) const {
+	
+	long start = getCluster(from);
+	long goal = getCluster(to);
+	if(start < 0 || goal < 0 || start == goal) {
+		return false;
+	}
+	
+	// A* on the cluster graph - edge costs are never shorter than the straight
+	// distance between cluster centers, so that distance is a valid heuristic.
+	std::vector<float> distance(nodes.size(), std::numeric_limits<float>::max());
+	std::vector<long> parent(nodes.size(), -1);
+	std::vector<bool> closed(nodes.size(), false);
+	
+	typedef std::pair<float, long> Entry;
+	std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > open;
+	
+	distance[start] = 0.f;
+	open.push(Entry(fdist(nodes[start].center, nodes[goal].center), start));
+	
+	while(!open.empty()) {
+		
+		long c = open.top().second;
+		open.pop();
+		
+		if(closed[c]) {
+			continue;
+		}
+		closed[c] = true;
+		
+		if(c == goal) {
+			break;
+		}
+		
+		const std::vector<Edge> & edges = nodes[c].edges;
+		for(size_t i = 0; i < edges.size(); i++) {
+			
+			const Edge & edge = edges[i];
+			if(links[edge.link] <= 0 || closed[edge.target]) {
+				continue;
+			}
+			
+			float d = distance[c] + edge.cost;
+			if(d < distance[edge.target]) {
+				distance[edge.target] = d;
+				parent[edge.target] = c;
+				float remaining = fdist(nodes[edge.target].center, nodes[goal].center);
+				open.push(Entry(d + remaining, long(edge.target)));
+			}
+		}
+	}
+	
+	if(!closed[goal]) {
+		return false;
+	}
+	
+	size_t count = 0;
+	corridor.assign(nodes.size(), false);
+	for(long c = goal; c >= 0; c = parent[c]) {
+		corridor[c] = true;
+		count++;
+	}
+	
+	return count >= minClusters;
+}
@@ -0,0 +1,126 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARX_AI_PATHHIERARCHY_H
+#define ARX_AI_PATHHIERARCHY_H
+
+#include <stddef.h>
+#include <vector>
+
+#include "math/Types.h"
+
+struct ANCHOR_DATA;
+
+/*!
+ * Coarse cluster graph on top of the anchor graph used to plan long paths.
+ * 
+ * Each anchor is assigned to a cluster (usually the portal room it lies in).
+ * Two clusters are connected if at least one unblocked anchor link crosses
+ * between them. Long searches first find a route in the (much smaller)
+ * cluster graph and then only refine the path through the anchors in the
+ * clusters along that route.
+ */
+class PathHierarchy {
+	
+public:
+	
+	typedef unsigned long NodeId;
+	
+	//! A flag for each cluster, true if it is part of the selected corridor.
+	typedef std::vector<bool> Corridor;
+	
+	PathHierarchy() : map_d(NULL) { }
+	
+	/*!
+	 * Build the cluster graph.
+	 * The hierarchy does not copy the anchor data and will not clean it up.
+	 * @param clusters The cluster index for each anchor or -1 if the anchor
+	 *                 does not belong to any cluster.
+	 */
+	void build(size_t map_size, const ANCHOR_DATA * map_data,
+	           const std::vector<long> & clusters);
+	
+	void clear();
+	
+	/*!
+	 * Update the connectivity after the blocked flag of an anchor has changed.
+	 */
+	void updateAnchor(NodeId anchor);
+	
+	//! Update the connectivity for all anchors.
+	void updateAll();
+	
+	//! @return the cluster of an anchor or -1
+	long getCluster(NodeId anchor) const {
+		return anchor < cluster.size() ? cluster[anchor] : -1;
+	}
+	
+	size_t getClusterCount() const {
+		return nodes.size();
+	}
+	
+	/*!
+	 * Find the clusters that a path between two anchors should pass through.
+	 * @param minClusters Fail if the route would visit fewer clusters.
+	 * @return true if the corridor is set, false if the search should be done
+	 *         without the hierarchy.
+	 */
+	bool getCorridor(NodeId from, NodeId to, size_t minClusters, Corridor & corridor) const;
+	
+private:
+	
+	struct Edge {
+		size_t target;
+		float cost;
+		size_t link; //!< Index of the link counter for this pair of clusters
+	};
+	
+	struct Node {
+		Vec3f center;
+		std::vector<Edge> edges;
+		Node() : center(0.f) { }
+	};
+	
+	//! An anchor link between two different clusters
+	struct Crossing {
+		NodeId a;
+		NodeId b;
+		size_t link;
+		bool open;
+	};
+	
+	bool isOpen(const Crossing & crossing) const;
+	void updateCrossing(Crossing & crossing);
+	
+	const ANCHOR_DATA * map_d;
+	
+	std::vector<long> cluster;
+	std::vector<Node> nodes;
+	
+	//! Number of open crossings for each pair of connected clusters
+	std::vector<long> links;
+	
+	std::vector<Crossing> crossings;
+	
+	//! Crossings touching each anchor
+	std::vector< std::vector<size_t> > anchorCrossings;
+	
+};
+
+#endif // ARX_AI_PATHHIERARCHY_H
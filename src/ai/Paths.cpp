@@ -71,6 +71,7 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include "graphics/Renderer.h"
 #include "graphics/effects/SpellEffects.h"
 #include "graphics/particle/ParticleEffects.h"
+#include "graphics/data/BackgroundBVH.h"
 #include "graphics/data/Mesh.h"
 #include "graphics/data/TextureContainer.h"
 
@@ -771,46 +772,40 @@ EERIEPOLY * CheckArrowPolyCollision(Vec3f * start, Vec3f * end) {
 	pol.v[2] = *end - Vec3f(2.f, 15.f, 2.f);
 	pol.v[1] = *end;
 	
-	long px = end->x * ACTIVEBKG->Xmul;
-	long pz = end->z * ACTIVEBKG->Zmul;
+	if(!ACTIVEBKG->bvh) {
+		return NULL;
+	}
+	
+	Vec3f min = glm::min(glm::min(pol.v[0], pol.v[1]), pol.v[2]);
+	Vec3f max = glm::max(glm::max(pol.v[0], pol.v[1]), pol.v[2]);
 	
-	long ix = std::max(px - 2, 0L);
-	long ax = std::min(px + 2, ACTIVEBKG->Xsize - 1L);
-	long iz = std::max(pz - 2, 0L);
-	long az = std::min(pz + 2, ACTIVEBKG->Zsize - 1L);
+	std::vector<EERIEPOLY *> candidates;
+	ACTIVEBKG->bvh->query(min, max, candidates);
 	
-	for(long zz = iz; zz <= az; zz++)
-		for(long xx = ix; xx <= ax; xx++) {
+	BOOST_FOREACH(EERIEPOLY * ep, candidates) {
 		
-		FAST_BKG_DATA * feg = &ACTIVEBKG->fastdata[xx][zz];
+		if(ep->type & (POLY_WATER | POLY_TRANS | POLY_NOCOL)) {
+			continue;
+		}
 		
-		for(long k = 0; k < feg->nbpolyin; k++) {
-			
-			EERIEPOLY * ep = feg->polyin[k];
-			
-			if(ep->type & (POLY_WATER | POLY_TRANS | POLY_NOCOL)) {
-				continue;
-			}
-			
-			EERIE_TRI pol2;
-			pol2.v[0] = ep->v[0].p;
-			pol2.v[1] = ep->v[1].p;
+		EERIE_TRI pol2;
+		pol2.v[0] = ep->v[0].p;
+		pol2.v[1] = ep->v[1].p;
+		pol2.v[2] = ep->v[2].p;
+		
+		if(Triangles_Intersect(&pol2, &pol)) {
+			return ep;
+		}
+		
+		if(ep->type & POLY_QUAD) {
+			pol2.v[0] = ep->v[1].p;
+			pol2.v[1] = ep->v[3].p;
 			pol2.v[2] = ep->v[2].p;
-			
 			if(Triangles_Intersect(&pol2, &pol)) {
 				return ep;
 			}
-			
-			if(ep->type & POLY_QUAD) {
-				pol2.v[0] = ep->v[1].p;
-				pol2.v[1] = ep->v[3].p;
-				pol2.v[2] = ep->v[2].p;
-				if(Triangles_Intersect(&pol2, &pol)) {
-					return ep;
-				}
-			}
-			
 		}
+		
 	}
 	
 	return NULL;
@@ -440,14 +440,12 @@ static bool EERIE_ANIMMANAGER_AddAltAnim(ANIM_HANDLE * ah, const res::path & pat
 		return false;
 	}
 	
-	size_t FileSize;
-	char * adr = resources->readAlloc(path, FileSize);
-	if(!adr) {
+	PakFileView file;
+	if(!resources->readView(path, file)) {
 		return false;
 	}
 	
-	EERIE_ANIM * temp = TheaToEerie(adr, FileSize, path);
-	free(adr);
+	EERIE_ANIM * temp = TheaToEerie(file.data(), file.size(), path);
 	if(!temp) {
 		return false;
 	}
@@ -483,18 +481,15 @@ ANIM_HANDLE * EERIE_ANIMMANAGER_Load_NoWarning(const res::path & path) {
 			continue;
 		}
 		
-		size_t FileSize;
-		char * adr = resources->readAlloc(path, FileSize);
-		if(!adr) {
+		PakFileView file;
+		if(!resources->readView(path, file)) {
 			return NULL;
 		}
 		
 		animations[i].anims = (EERIE_ANIM **)malloc(sizeof(EERIE_ANIM *));
-		animations[i].anims[0] = TheaToEerie(adr, FileSize, path);
+		animations[i].anims[0] = TheaToEerie(file.data(), file.size(), path);
 		animations[i].alt_nb = 1;
 		
-		free(adr);
-		
 		if(!animations[i].anims[0]) {
 			return NULL;
 		}
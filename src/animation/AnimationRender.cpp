@@ -56,6 +56,7 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 
 #include "game/Damage.h"
 #include "game/Equipment.h"
+#include "game/EntityGrid.h"
 #include "game/EntityManager.h"
 #include "game/NPC.h"
 #include "game/Player.h"
@@ -65,8 +66,10 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include "graphics/GraphicsTypes.h"
 #include "graphics/Draw.h"
 #include "graphics/Math.h"
+#include "graphics/RenderQueue.h"
 #include "graphics/Renderer.h"
 #include "graphics/Vertex.h"
+#include "graphics/VertexLighting.h"
 #include "graphics/data/Mesh.h"
 #include "graphics/data/MeshManipulation.h"
 #include "graphics/data/TextureContainer.h"
@@ -80,6 +83,7 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include "physics/Collisions.h"
 
 #include "platform/Platform.h"
+#include "platform/Profiler.h"
 
 #include "scene/Light.h"
 #include "scene/GameSound.h"
@@ -137,52 +141,50 @@ static void PopOneTriangleList(TextureContainer *_pTex) {
 
 }
 
-static void PopOneTriangleListTransparency(TextureContainer *_pTex) {
+static void QueueOneTriangleList(TextureContainer *_pTex) {
 
-	if(!_pTex->count[TextureContainer::Blended]
-	   && !_pTex->count[TextureContainer::Additive]
-	   && !_pTex->count[TextureContainer::Subtractive]
-	   && !_pTex->count[TextureContainer::Multiplicative]) {
+	if(!_pTex->count[TextureContainer::Opaque]) {
 		return;
 	}
 
-	GRenderer->SetTexture(0, _pTex);
+	RenderQueue::Material material(_pTex);
+	material.lateMip = (_pTex->userflags & POLY_LATE_MIP) != 0;
 
-	if(_pTex->count[TextureContainer::Blended]) {
-		GRenderer->SetBlendFunc(Renderer::BlendDstColor, Renderer::BlendSrcColor);
-		if(_pTex->count[TextureContainer::Blended]) {
-			EERIEDRAWPRIM(Renderer::TriangleList, _pTex->list[TextureContainer::Blended],
-						  _pTex->count[TextureContainer::Blended]);
-			_pTex->count[TextureContainer::Blended]=0;
-		}
-	}
+	g_renderQueue.add(material, 0.f, _pTex->list[TextureContainer::Opaque],
+	                  _pTex->count[TextureContainer::Opaque]);
 
-	if(_pTex->count[TextureContainer::Additive]) {
-		GRenderer->SetBlendFunc(Renderer::BlendOne, Renderer::BlendOne);
-		if(_pTex->count[TextureContainer::Additive]) {
-			EERIEDRAWPRIM(Renderer::TriangleList, _pTex->list[TextureContainer::Additive],
-						  _pTex->count[TextureContainer::Additive]);
-			_pTex->count[TextureContainer::Additive]=0;
-		}
-	}
+	// The vertices stay valid until the next PushVertexInTable() call
+	_pTex->count[TextureContainer::Opaque] = 0;
+}
 
-	if(_pTex->count[TextureContainer::Subtractive]) {
-		GRenderer->SetBlendFunc(Renderer::BlendZero, Renderer::BlendInvSrcColor);
-		if(_pTex->count[TextureContainer::Subtractive]) {
-			EERIEDRAWPRIM(Renderer::TriangleList, _pTex->list[TextureContainer::Subtractive],
-						  _pTex->count[TextureContainer::Subtractive]);
-			_pTex->count[TextureContainer::Subtractive]=0;
-		}
-	}
+static void QueueOneTriangleListTransparency(TextureContainer *_pTex, unsigned order,
+                                             TextureContainer::TransparencyType type,
+                                             Renderer::PixelBlendingFactor srcFactor,
+                                             Renderer::PixelBlendingFactor dstFactor) {
 
-	if(_pTex->count[TextureContainer::Multiplicative]) {
-		GRenderer->SetBlendFunc(Renderer::BlendOne, Renderer::BlendOne);
-		if(_pTex->count[TextureContainer::Multiplicative]) {
-			EERIEDRAWPRIM(Renderer::TriangleList, _pTex->list[TextureContainer::Multiplicative],
-						  _pTex->count[TextureContainer::Multiplicative]);
-			_pTex->count[TextureContainer::Multiplicative] = 0;
-		}
+	if(!_pTex->count[type]) {
+		return;
 	}
+
+	RenderQueue::Material material(_pTex);
+	material.setBlendFunc(srcFactor, dstFactor);
+	material.order = order;
+
+	g_renderQueue.add(material, 0.f, _pTex->list[type], _pTex->count[type]);
+
+	_pTex->count[type] = 0;
+}
+
+// The passes are drawn in this order, all items are queued at the same depth.
+static void QueueOneTriangleListTransparency(TextureContainer *_pTex) {
+	QueueOneTriangleListTransparency(_pTex, 0, TextureContainer::Blended,
+	                                 Renderer::BlendDstColor, Renderer::BlendSrcColor);
+	QueueOneTriangleListTransparency(_pTex, 1, TextureContainer::Additive,
+	                                 Renderer::BlendOne, Renderer::BlendOne);
+	QueueOneTriangleListTransparency(_pTex, 2, TextureContainer::Subtractive,
+	                                 Renderer::BlendZero, Renderer::BlendInvSrcColor);
+	QueueOneTriangleListTransparency(_pTex, 3, TextureContainer::Multiplicative,
+	                                 Renderer::BlendOne, Renderer::BlendOne);
 }
 
 void PopAllTriangleList() {
@@ -191,9 +193,11 @@ void PopAllTriangleList() {
 
 	TextureContainer * pTex = GetTextureList();
 	while(pTex) {
-		PopOneTriangleList(pTex);
+		QueueOneTriangleList(pTex);
 		pTex = pTex->m_pNext;
 	}
+	g_renderQueue.flush();
+
 	GRenderer->SetAlphaFunc(Renderer::CmpNotEqual, 0.f);
 }
 
@@ -252,15 +256,17 @@ void PopAllTriangleListTransparency() {
 	PopOneTriangleList(&TexSpecialColor);
 
 	TextureContainer * pTex = GetTextureList();
+	while(pTex) {
+		QueueOneTriangleListTransparency(pTex);
+		pTex = pTex->m_pNext;
+	}
+	g_renderQueue.flush();
 
-	while(pTex)
-	{
-		PopOneTriangleListTransparency(pTex);
-
-		//ZMAP
+	//ZMAP
+	pTex = GetTextureList();
+	while(pTex) {
 		PopOneInterZMapp(pTex);
-
-		pTex=pTex->m_pNext;
+		pTex = pTex->m_pNext;
 	}
 
 	GRenderer->SetFogColor(ulBKGColor);
@@ -562,46 +568,84 @@ bool Cedric_IO_Visible(const Vec3f & pos) {
 	return true;
 }
 
+//! Lights selected by the last UpdateLlights() call, loaded once per object
+static VertexLighting vertexLighting;
+static std::vector<ColorBGRA> vertexColors;
+
+//! Light the vertices queued in vertexLighting
+static const ColorBGRA * ApplyVertexLighting(const ColorMod & colorMod, float materialDiffuse = 1.f) {
+	
+	vertexColors.resize(vertexLighting.size());
+	if(vertexColors.empty()) {
+		return NULL;
+	}
+	
+	vertexLighting.apply(colorMod, materialDiffuse, &vertexColors[0]);
+	
+	return &vertexColors[0];
+}
+
 /* Object dynamic lighting */
 static void Cedric_ApplyLighting(EERIE_3DOBJ * eobj, EERIE_C_DATA * obj, const ColorMod & colorMod) {
 
 	/* Apply light on all vertices */
+	vertexLighting.clear();
 	for(int i = 0; i != obj->nb_bones; i++) {
 
 		EERIE_QUAT *quat = &obj->bones[i].anim.quat;
 
-		/* Get light value for each vertex */
 		for(int v = 0; v != obj->bones[i].nb_idxvertices; v++) {
 			size_t vertexIndex = obj->bones[i].idxvertices[v];
 
 			Vec3f & position = eobj->vertexlist3[vertexIndex].v;
 			Vec3f & normal = eobj->vertexlist[vertexIndex].norm;
 
-			eobj->vertexlist3[vertexIndex].vert.color = ApplyLight(quat, position, normal, colorMod);
+			vertexLighting.add(quat, position, normal);
+		}
+	}
+
+	/* Get light value for each vertex */
+	const ColorBGRA * colors = ApplyVertexLighting(colorMod);
+	for(int i = 0; i != obj->nb_bones; i++) {
+		for(int v = 0; v != obj->bones[i].nb_idxvertices; v++) {
+			size_t vertexIndex = obj->bones[i].idxvertices[v];
+			eobj->vertexlist3[vertexIndex].vert.color = *colors++;
 		}
 	}
 }
 
 void MakeCLight(const EERIE_QUAT *quat, EERIE_3DOBJ * eobj, const ColorMod & colorMod) {
-		
+	
+	vertexLighting.clear();
 	for(size_t i = 0; i < eobj->vertexlist.size(); i++) {
 
 		Vec3f & position = eobj->vertexlist3[i].v;
 		Vec3f & normal = eobj->vertexlist[i].norm;
 
-		eobj->vertexlist3[i].vert.color = ApplyLight(quat, position, normal, colorMod);
+		vertexLighting.add(quat, position, normal);
+	}
+
+	const ColorBGRA * colors = ApplyVertexLighting(colorMod);
+	for(size_t i = 0; i < eobj->vertexlist.size(); i++) {
+		eobj->vertexlist3[i].vert.color = colors[i];
 	}
 }
 
 void MakeCLight2(const EERIE_QUAT *quat, EERIE_3DOBJ *eobj, long ii, const ColorMod & colorMod) {
 	
+	vertexLighting.clear();
 	for(long i = 0; i < 3; i++) {
 		size_t vertexIndex = eobj->facelist[ii].vid[i];
 
 		Vec3f & position = eobj->vertexlist3[vertexIndex].v;
 		Vec3f & normal = eobj->facelist[ii].norm;
 
-		eobj->vertexlist3[vertexIndex].vert.color = ApplyLight(quat, position, normal, colorMod, 0.5f);
+		vertexLighting.add(quat, position, normal);
+	}
+
+	const ColorBGRA * colors = ApplyVertexLighting(colorMod, 0.5f);
+	for(long i = 0; i < 3; i++) {
+		eobj->vertexlist3[eobj->facelist[ii].vid[i]].vert.color = colors[i];
 	}
 }
 
@@ -714,6 +758,7 @@ void DrawEERIEInter_Render(EERIE_3DOBJ *eobj, const TransformInfo &t, Entity *io
 		tv.y -= 90.f;
 
 	UpdateLlights(tv);
+	LoadLlights(vertexLighting);
 
 
 	// Precalc local lights for this object then interpolate
@@ -955,6 +1000,7 @@ void DrawEERIEInter(EERIE_3DOBJ *eobj, const TransformInfo &t, Entity *io, bool
 	DrawEERIEInter_ModelTransform(eobj, t);
 	if(io) {
 		UpdateBbox3d(eobj, io->bbox3D);
+		entityGrid.update(io);
 	}
 
 	DrawEERIEInter_ViewProjectTransform(eobj);
@@ -1282,6 +1328,7 @@ void Cedric_AnimateDrawEntityRender(EERIE_3DOBJ *eobj, const Vec3f & pos, Entity
 		tv.y -= 90.f;
 
 	UpdateLlights(tv);
+	LoadLlights(vertexLighting);
 
 	Cedric_ApplyLighting(eobj, obj, colorMod);
 
@@ -1624,6 +1671,8 @@ void Cedric_AnimateDrawEntity(EERIE_C_DATA & rig, ANIM_USE * animlayer, EERIE_EX
 }
 
 void EERIEDrawAnimQuatUpdate(EERIE_3DOBJ *eobj, ANIM_USE * animlayer,const Anglef & angle, const Vec3f & pos, unsigned long time, Entity *io, bool update_movement) {
+	
+	ARX_PROFILE("Animation");
 
 	if(io) {
 		float speedfactor = io->basespeed + io->speed_modif;
@@ -1694,6 +1743,7 @@ void EERIEDrawAnimQuatUpdate(EERIE_3DOBJ *eobj, ANIM_USE * animlayer,const Angle
 	Cedric_TransformVerts(eobj, pos);
 	if(io) {
 		UpdateBbox3d(eobj, io->bbox3D);
+		entityGrid.update(io);
 	}
 
 	Cedric_ViewProjectTransform(io, eobj);
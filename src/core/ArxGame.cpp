@@ -64,10 +64,12 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include "core/Config.h"
 #include "core/GameTime.h"
 #include "core/Localisation.h"
+#include "core/Replay.h"
 #include "core/SaveGame.h"
 #include "core/Version.h"
 
 #include "game/Damage.h"
+#include "game/EntityGrid.h"
 #include "game/EntityManager.h"
 #include "game/Inventory.h"
 #include "game/Levels.h"
@@ -85,6 +87,7 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include "graphics/GraphicsModes.h"
 #include "graphics/GraphicsTypes.h"
 #include "graphics/Math.h"
+#include "graphics/RenderQueue.h"
 #include "graphics/Renderer.h"
 #include "graphics/Vertex.h"
 #include "graphics/VertexBuffer.h"
@@ -114,7 +117,9 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include "math/Vector.h"
 
 #include "io/fs/FilePath.h"
+#include "io/fs/FileStream.h"
 #include "io/fs/SystemPaths.h"
+#include "io/resource/PakReadThreads.h"
 #include "io/resource/PakReader.h"
 #include "io/Screenshot.h"
 #include "io/log/Logger.h"
@@ -122,6 +127,9 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include "platform/Process.h"
 #include "platform/Flags.h"
 #include "platform/Platform.h"
+#include "platform/Profiler.h"
+#include "platform/ProgramOptions.h"
+#include "platform/WorkerPool.h"
 
 #include "scene/ChangeLevel.h"
 #include "scene/Interactive.h"
@@ -131,9 +139,12 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include "scene/Object.h"
 #include "scene/Scene.h"
 
+#include "script/ScriptEvent.h"
+
 #include "Configure.h"
 #include "core/URLConstants.h"
 
+#include "window/HeadlessWindow.h"
 #if ARX_HAVE_SDL
 #include "window/SDLWindow.h"
 #endif
@@ -228,6 +239,9 @@ bool ArxGame::initialize()
 		return false;
 	}
 	
+	// Per-frame work is split between the main thread and the workers.
+	g_workerPool = new WorkerPool(getFrameWorkerCount());
+	
 	init = initGameData();
 	if(!init) {
 		LogCritical << "Failed to initialize the game data.";
@@ -342,6 +356,17 @@ bool ArxGame::initWindow() {
 	
 	arx_assert(m_MainWindow == NULL);
 	
+	if(replay::isPlaying() || config.window.framework == "headless") {
+		// Replays and the headless framework run without a display.
+		RenderWindow * window = new HeadlessWindow;
+		if(!initWindow(window)) {
+			delete window;
+			LogCritical << "Graphics initialization failed.";
+			return false;
+		}
+		return true;
+	}
+	
 	bool autoFramework = (config.window.framework == "auto");
 	
 	for(int i = 0; i < 2 && !m_MainWindow; i++) {
@@ -385,6 +410,11 @@ bool ArxGame::initInput() {
 
 bool ArxGame::initSound() {
 	
+	if(replay::isPlaying()) {
+		LogInfo << "Sound disabled for replay";
+		return true;
+	}
+	
 	LogDebug("Sound init");
 	bool init = ARX_SOUND_Init();
 	if(!init) {
@@ -423,6 +453,10 @@ bool ArxGame::addPaks() {
 	
 	resources = new PakReader;
 	
+	// Decompress prefetched files in the background.
+	PakReadQueue & queue = resources->getReadQueue();
+	queue.setWorkers(new PakReadThreads(queue, getLoadingWorkerCount()));
+	
 	// Load required pak files
 	std::vector<size_t> missing;
 	for(size_t i = 0; i < ARRAY_SIZE(default_paks); i++) {
@@ -567,6 +601,11 @@ void ArxGame::run() {
 	
 	beforeRun();
 	
+	if(!replay::start()) {
+		LogCritical << "Failed to start replay";
+		return;
+	}
+	
 	while(m_RunLoop) {
 		
 		m_MainWindow->tick();
@@ -575,22 +614,101 @@ void ArxGame::run() {
 		}
 		
 		if(m_MainWindow->hasFocus() && m_bReady) {
+			replay::beginFrame();
+			
 			doFrame();
 			
 			// Show the frame on the primary surface.
 			m_MainWindow->showFrame();
+			
+			replay::endFrame();
 		}
 	}
+	
+	replay::stop();
+}
+
+#if BUILD_PROFILER
+
+static void enableProfiler(const std::string & frames) {
+	
+	std::istringstream iss(frames);
+	u64 first = 0, last = 0;
+	char separator = '-';
+	if(!(iss >> first) || (!iss.eof() && (!(iss >> separator >> last) || separator != '-'))
+	   || !iss.eof() || first == 0) {
+		throw util::cmdline::error(util::cmdline::error::invalid_value,
+		                           "invalid frame range: " + frames);
+	}
+	
+	profiler::setFrames(first, std::max(first, last));
+}
+
+ARX_PROGRAM_OPTION("profile", "", "Record a trace of the given frames to profile.json",
+                   &enableProfiler, "FIRST[-LAST]");
+
+#endif // BUILD_PROFILER
+
+//! Record per-frame counters for the previous frame.
+static void recordFrameCounters() {
+	
+	static long lastScriptEvents = 0;
+	long scriptEvents = ScriptEvent::totalCount - lastScriptEvents;
+	if(scriptEvents < 0) {
+		// The counter has been reset
+		scriptEvents = ScriptEvent::totalCount;
+	}
+	lastScriptEvents = ScriptEvent::totalCount;
+	
+	RenderQueue::Stats renderStats = g_renderQueue.getStats();
+	g_renderQueue.resetStats();
+	
+	if(!profiler::isRecording()) {
+		return;
+	}
+	
+	profiler::counter("Polys drawn", EERIEDrawnPolys);
+	profiler::counter("IOs treated", TREATZONE_CUR);
+	profiler::counter("Script events", scriptEvents);
+	profiler::counter("Pathfinder queue", EERIE_PATHFINDER_Get_Queued_Number());
+	profiler::counter("Render queue items", renderStats.items);
+	profiler::counter("Render state changes", renderStats.stateChanges);
+	profiler::counter("Render state changes saved", renderStats.savedStateChanges);
+}
+
+static void writeProfile() {
+	
+	fs::path file = fs::paths.user / "profile.json";
+	
+	fs::ofstream ofs(file);
+	if(!ofs.is_open()) {
+		LogError << "Could not write profile to " << file;
+		return;
+	}
+	
+	profiler::writeTrace(ofs);
+	
+	LogInfo << "Wrote profile to " << file;
 }
 
 /*!
  * \brief Draws the scene.
  */
 void ArxGame::doFrame() {
-		
+	
+	recordFrameCounters();
+	if(profiler::frame()) {
+		writeProfile();
+	}
+	
+	ARX_PROFILE("Frame");
+	
 	updateTime();
 
 	updateInput();
+	
+	// Show saves in the list once they have been written or checked in the background.
+	Menu2_UpdateSavegames();
 
 	if(wasResized) {
 		LogDebug("was resized");
@@ -1310,6 +1428,8 @@ void ArxGame::renderCinematic() {
 extern int iHighLight;
 
 void ArxGame::updateLevel() {
+	
+	ARX_PROFILE_FUNC();
 
 	if(!PLAYER_PARALYSED) {
 		manageEditorControls();
@@ -1420,8 +1540,16 @@ void ArxGame::updateLevel() {
 		ARX_INTERACTIVE_Show_Hide_1st(entities.player(), 1);
 	}
 
-	PrepareIOTreatZone();
-	ARX_PHYSICS_Apply();
+	{
+		ARX_PROFILE("Treat zone");
+		PrepareIOTreatZone();
+		entityGrid.sync();
+	}
+	EERIE_PATHFINDER_Update();
+	{
+		ARX_PROFILE("Physics");
+		ARX_PHYSICS_Apply();
+	}
 
 	PrecalcIOLighting(&ACTIVECAM->orgTrans.pos, ACTIVECAM->cdepth * 0.6f);
 
@@ -1430,6 +1558,7 @@ void ArxGame::updateLevel() {
 	ARX_SCENE_Update();
 
 	if(pParticleManager) {
+		ARX_PROFILE("Particles");
 		pParticleManager->Update(static_cast<long>(framedelay));
 	}
 
@@ -1471,6 +1600,8 @@ void ArxGame::updateLevel() {
 }
 
 void ArxGame::renderLevel() {
+	
+	ARX_PROFILE_FUNC();
 
 	// Clear screen & Z buffers
 	if(desired.flags & GMOD_DCOLOR) {
@@ -1529,15 +1660,19 @@ void ArxGame::renderLevel() {
 
 	// Begin Particles
 	
-	if(pParticleManager) {
-		pParticleManager->Render();
+	{
+		ARX_PROFILE("Particles");
+		
+		if(pParticleManager) {
+			pParticleManager->Render();
+		}
+		
+		GRenderer->SetBlendFunc(Renderer::BlendOne, Renderer::BlendOne);
+		GRenderer->SetRenderState(Renderer::DepthWrite, false);
+		GRenderer->SetRenderState(Renderer::AlphaBlending, true);
+		
+		ARX_PARTICLES_Render(&subj);
 	}
-	
-	GRenderer->SetBlendFunc(Renderer::BlendOne, Renderer::BlendOne);
-	GRenderer->SetRenderState(Renderer::DepthWrite, false);
-	GRenderer->SetRenderState(Renderer::AlphaBlending, true);
-
-	ARX_PARTICLES_Render(&subj);
 
 	GRenderer->SetBlendFunc(Renderer::BlendOne, Renderer::BlendOne);
 	GRenderer->SetRenderState(Renderer::DepthWrite, false);
@@ -1602,7 +1737,9 @@ void ArxGame::renderLevel() {
 
 	// Draw game interface if needed
 	if(ARXmenu.currentmode == AMCM_OFF && !CINEMASCOPE) {
-	
+		
+		ARX_PROFILE("Interface");
+		
 		GRenderer->GetTextureStage(0)->setWrapMode(TextureStage::WrapClamp);
 		GRenderer->SetRenderState(Renderer::DepthTest, false);
 		
@@ -1880,7 +2017,7 @@ void ArxGame::update2DFX()
 				}
 
 				if(ltvv.p.z > fZFar ||
-					EERIELaunchRay3(&ACTIVECAM->orgTrans.pos, &ee3dlv, &hit, tp, 1) ||
+					EERIELaunchRay3(&ACTIVECAM->orgTrans.pos, &ee3dlv, &hit, tp) ||
 					GetFirstInterAtPos(&ees2dlv, 3, &ee3dlv, pTableIO, &nNbInTableIO )
 					)
 				{
@@ -1992,6 +2129,8 @@ bool ArxGame::finalCleanup() {
 	ARX_INPUT_Release();
 	ARX_SOUND_Release();
 	
+	delete g_workerPool, g_workerPool = NULL;
+	
 	return true;
 }
 
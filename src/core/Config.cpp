@@ -67,7 +67,8 @@ const int
 	ambianceVolume = 10,
 	mouseSensitivity = 6,
 	migration = Config::OriginalAssets,
-	quicksaveSlots = 3;
+	quicksaveSlots = 3,
+	scriptEventBudget = 2000;
 
 const bool
 	fullscreen = true,
@@ -230,6 +231,7 @@ const string
 	forceToggle = "forcetoggle",
 	migration = "migration",
 	quicksaveSlots = "quicksave_slots",
+	scriptEventBudget = "script_event_budget",
 	debugLevels = "debug";
 
 } // namespace Key
@@ -417,6 +419,7 @@ bool Config::save() {
 	writer.writeKey(Key::forceToggle, misc.forceToggle);
 	writer.writeKey(Key::migration, misc.migration);
 	writer.writeKey(Key::quicksaveSlots, misc.quicksaveSlots);
+	writer.writeKey(Key::scriptEventBudget, misc.scriptEventBudget);
 	writer.writeKey(Key::debugLevels, misc.debug);
 	
 	return writer.flush();
@@ -500,6 +503,7 @@ bool Config::init(const fs::path & file) {
 	misc.forceToggle = reader.getKey(Section::Misc, Key::forceToggle, Default::forceToggle);
 	misc.migration = (MigrationStatus)reader.getKey(Section::Misc, Key::migration, Default::migration);
 	misc.quicksaveSlots = std::max(reader.getKey(Section::Misc, Key::quicksaveSlots, Default::quicksaveSlots), 1);
+	misc.scriptEventBudget = std::max(reader.getKey(Section::Misc, Key::scriptEventBudget, Default::scriptEventBudget), 0);
 	misc.debug = reader.getKey(Section::Misc, Key::debugLevels, Default::debugLevels);
 	
 	return loaded;
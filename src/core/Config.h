@@ -173,6 +173,9 @@ public:
 		
 		int quicksaveSlots;
 		
+		//! Time in microseconds to spend on queued script events each frame
+		int scriptEventBudget;
+		
 		std::string debug; //!< Logger debug levels.
 		
 	} misc;
@@ -72,10 +72,12 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include "core/ArxGame.h"
 #include "core/Config.h"
 #include "core/Localisation.h"
+#include "core/Replay.h"
 #include "core/GameTime.h"
 #include "core/Version.h"
 
 #include "game/Damage.h"
+#include "game/EntityGrid.h"
 #include "game/EntityManager.h"
 #include "game/Equipment.h"
 #include "game/Inventory.h"
@@ -1740,6 +1742,7 @@ void FirstFrameHandling() {
 
 	FirstFrame=false;
 	PrepareIOTreatZone(1);
+	entityGrid.sync();
 	CURRENTLEVEL=GetLevelNumByName(LastLoadedScene.string());
 	
 	if(!NO_TIME_INIT)
@@ -1791,6 +1794,7 @@ void FirstFrameHandling() {
 		for(size_t i = 0; i < io->obj->vertexlist.size(); i++) {
 			io->obj->vertexlist3[i].v = io->obj->vertexlist[i].v + io->pos;
 		}
+		entityGrid.update(io);
 		WILL_RESTORE_PLAYER_POSITION_FLAG = 0;
 	}
 	
@@ -2792,6 +2796,10 @@ bool HandleGameFlowTransitions() {
 	return false;
 }
 
+bool isInGame() {
+	return GameFlow::getTransition() == GameFlow::NoTransition && !FirstFrame;
+}
+
 void LaunchWaitingCine() {
 	
 	LogDebug("LaunchWaitingCine " << CINE_PRELOAD);
@@ -3014,6 +3022,13 @@ void ShowInfoText() {
 	}
 	hFontDebug->draw(70, 94, tex, Color::white);
 
+	const ScriptEventQueueStats & queue = ARX_SCRIPT_EventStackGetStats();
+	sprintf(tex, "Queued %lu (peak %lu) Latency avg %.1fms max %.1fms",
+			(unsigned long)queue.depth, (unsigned long)queue.peakDepth,
+			queue.executed ? float(queue.totalLatency) / queue.executed / 1000.f : 0.f,
+			float(queue.maxLatency) / 1000.f);
+	hFontDebug->draw(300, 114, tex, Color::white);
+
 	io = ARX_SCRIPT_Get_IO_Max_Events_Sent();
 
 	if(io) {
@@ -3239,7 +3254,10 @@ void shutdownGame() {
 	
 	delete ControlCinematique, ControlCinematique = NULL;
 	
-	config.save();
+	// Don't store the settings of the headless replay window.
+	if(!replay::isPlaying()) {
+		config.save();
+	}
 	
 	RoomDrawRelease();
 	EXITING=1;
@@ -143,6 +143,9 @@ void ReMappDanaeButton();
 void AdjustMousePosition();
 void DANAE_StartNewQuest();
 bool HandleGameFlowTransitions();
+//! @return true if a level is loaded and no game flow transition is pending
+bool isInGame();
+void loadLevel(u32 lvl);
 void DANAE_Manage_Cinematic();
 void DanaeRestoreFullScreen();
 void FirstFrameHandling();
@@ -99,7 +99,7 @@ namespace arx
 			if (is_paused() && use_pause) {
 				delta_time_us = Time::getElapsedUs(start_time, pause_time);
 			} else {
-				delta_time_us = Time::getElapsedUs(start_time);
+				delta_time_us = Time::getElapsedUs(start_time, now());
 			}
 		}
 
@@ -146,7 +146,29 @@ namespace arx
 			last_frame_time_us = frame_time_us;
 		}
 
+		/*!
+		 * Decouple the game time from the wall clock.
+		 * While a fixed step is set, time only advances when step() is called.
+		 * \param step_us the amount to advance per step, or 0 to use the wall clock again
+		 */
+		void set_fixed_step(u64 step_us);
+
+		inline bool has_fixed_step() const {
+			return fixed_step_us != 0;
+		}
+
+		//! Advance the time by one fixed step.
+		inline void step() {
+			virtual_time_us += fixed_step_us;
+		}
+
 	private:
+
+		//! Current absolute time, either from the wall clock or from the fixed step timeline.
+		inline u64 now() const {
+			return has_fixed_step() ? virtual_time_us : Time::getUs();
+		}
+
 		bool paused;
 
 		// these values are expected to wrap
@@ -162,6 +184,9 @@ namespace arx
 		u64 frame_time_us;
 		float frame_delay_ms;
 
+		u64 fixed_step_us;
+		u64 virtual_time_us;
+
 		/* TODO RFC (adejr: safe to allow varied precision?)
 		** since these values and their accessors are isolated in this class, 
 		** last_frame_time and frame_time could be replaced with u64 values 
@@ -0,0 +1,476 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "core/Replay.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+
+#include "ai/PathFinderManager.h"
+#include "core/Application.h"
+#include "core/Core.h"
+#include "core/GameTime.h"
+#include "game/Entity.h"
+#include "game/EntityManager.h"
+#include "game/NPC.h"
+#include "game/Player.h"
+#include "graphics/Renderer.h"
+#include "graphics/null/NullRenderer.h"
+#include "input/Input.h"
+#include "input/Keyboard.h"
+#include "input/Mouse.h"
+#include "io/fs/FilePath.h"
+#include "io/fs/FileStream.h"
+#include "io/fs/SystemPaths.h"
+#include "io/log/Logger.h"
+#include "math/Random.h"
+#include "platform/ProgramOptions.h"
+#include "platform/Time.h"
+
+namespace {
+
+enum Mode {
+	Disabled,
+	Playing,
+	Recording
+};
+
+struct FrameResult {
+	u64 time;
+	u32 checksum;
+	NullRenderer::Stats stats;
+};
+
+Mode g_mode = Disabled;
+std::string g_file;
+std::string g_output;
+
+u32 g_level = 0;
+u32 g_seed = 0;
+u64 g_timestep = 16666;
+u64 g_frames = 0;
+
+std::vector<replay::InputEvent> g_events;
+size_t g_eventsBegin = 0;
+size_t g_eventsEnd = 0;
+
+bool g_started = false; //!< The level has loaded and frames are being counted.
+bool g_finished = false;
+u64 g_frame = 0;
+u64 g_frameStart = 0;
+
+std::vector<FrameResult> g_results;
+
+fs::ofstream g_recording;
+
+void setMode(Mode mode, const std::string & file) {
+	
+	if(g_mode != Disabled) {
+		throw util::cmdline::error(util::cmdline::error::invalid_value,
+		                           "cannot play and record a replay at the same time");
+	}
+	
+	g_mode = mode;
+	g_file = file;
+}
+
+void playReplay(const std::string & file) {
+	setMode(Playing, file);
+}
+
+void recordReplay(const std::string & file) {
+	setMode(Recording, file);
+}
+
+void setReplayOutput(const std::string & file) {
+	g_output = file;
+}
+
+bool isEarlier(const replay::InputEvent & a, const replay::InputEvent & b) {
+	return a.frame < b.frame;
+}
+
+bool isMouseButton(int key) {
+	return key >= Mouse::ButtonBase && key < Mouse::ButtonMax;
+}
+
+bool isInputKey(int key) {
+	return (key >= Keyboard::KeyBase && key < Keyboard::KeyMax) || isMouseButton(key);
+}
+
+bool parseEvent(u64 frame, std::istringstream & iss, replay::InputEvent & event) {
+	
+	event.frame = frame;
+	event.key = -1;
+	std::fill_n(event.data, ARRAY_SIZE(event.data), 0);
+	
+	std::string type;
+	iss >> type;
+	
+	size_t count;
+	if(type == "key" || type == "click") {
+		std::string name;
+		iss >> name;
+		event.key = Input::getKeyId(name);
+		// Click counts are only tracked for mouse buttons
+		if(type == "click" ? !isMouseButton(event.key) : !isInputKey(event.key)) {
+			return false;
+		}
+		event.type = (type == "key") ? replay::InputEvent::Key : replay::InputEvent::Click;
+		count = (type == "key") ? 1 : 2;
+	} else if(type == "mouse") {
+		event.type = replay::InputEvent::Mouse;
+		count = 4;
+	} else if(type == "wheel") {
+		event.type = replay::InputEvent::Wheel;
+		count = 1;
+	} else {
+		return false;
+	}
+	
+	for(size_t i = 0; i < count; i++) {
+		iss >> event.data[i];
+	}
+	
+	return !iss.fail();
+}
+
+bool loadReplay(const fs::path & file) {
+	
+	fs::ifstream ifs(file);
+	if(!ifs.is_open()) {
+		LogError << "Could not open replay " << file;
+		return false;
+	}
+	
+	std::string line;
+	for(size_t lineno = 1; std::getline(ifs, line); lineno++) {
+		
+		std::istringstream iss(line);
+		std::string directive;
+		if(!(iss >> directive) || directive[0] == '#') {
+			continue;
+		}
+		
+		bool valid;
+		if(directive == "level") {
+			valid = !(iss >> g_level).fail();
+		} else if(directive == "seed") {
+			valid = !(iss >> g_seed).fail();
+		} else if(directive == "timestep") {
+			valid = !(iss >> g_timestep).fail() && g_timestep != 0;
+		} else if(directive == "frames") {
+			valid = !(iss >> g_frames).fail();
+		} else {
+			std::istringstream fiss(directive);
+			u64 frame;
+			replay::InputEvent event;
+			valid = !(fiss >> frame).fail() && fiss.eof() && parseEvent(frame, iss, event);
+			if(valid) {
+				g_events.push_back(event);
+			}
+		}
+		
+		if(!valid) {
+			LogError << "Invalid line " << lineno << " in replay " << file << ": " << line;
+			return false;
+		}
+	}
+	
+	std::stable_sort(g_events.begin(), g_events.end(), isEarlier);
+	
+	if(g_frames == 0) {
+		g_frames = g_events.empty() ? 1 : g_events.back().frame + 1;
+	}
+	
+	LogInfo << "Loaded replay " << file << ": level " << g_level << ", " << g_frames
+	        << " frames, " << g_events.size() << " input events";
+	
+	return true;
+}
+
+void writeEvent(const replay::InputEvent & event) {
+	
+	g_recording << event.frame;
+	
+	size_t count = 0;
+	switch(event.type) {
+		case replay::InputEvent::Key: {
+			g_recording << " key " << Input::getKeyName(event.key);
+			count = 1;
+			break;
+		}
+		case replay::InputEvent::Click: {
+			g_recording << " click " << Input::getKeyName(event.key);
+			count = 2;
+			break;
+		}
+		case replay::InputEvent::Mouse: {
+			g_recording << " mouse";
+			count = 4;
+			break;
+		}
+		case replay::InputEvent::Wheel: {
+			g_recording << " wheel";
+			count = 1;
+			break;
+		}
+	}
+	
+	for(size_t i = 0; i < count; i++) {
+		g_recording << ' ' << event.data[i];
+	}
+	
+	g_recording << '\n';
+}
+
+template <class T>
+void hashValue(u32 & crc, const T & value) {
+	crc = crc32(crc, reinterpret_cast<const Bytef *>(&value), sizeof(value));
+}
+
+//! Checksum of the entity state that any divergence in the simulation will show up in.
+u32 getStateChecksum() {
+	
+	u32 crc = crc32(0, NULL, 0);
+	
+	for(size_t i = 0; i < entities.size(); i++) {
+		
+		const Entity * io = entities[i];
+		if(!io) {
+			continue;
+		}
+		
+		hashValue(crc, u32(i));
+		hashValue(crc, io->pos.x);
+		hashValue(crc, io->pos.y);
+		hashValue(crc, io->pos.z);
+		hashValue(crc, io->angle.getYaw());
+		hashValue(crc, io->angle.getPitch());
+		hashValue(crc, io->angle.getRoll());
+		hashValue(crc, s32(io->show));
+		if(io->_npcdata) {
+			hashValue(crc, io->_npcdata->life);
+		}
+	}
+	
+	hashValue(crc, player.life);
+	hashValue(crc, player.mana);
+	
+	return crc;
+}
+
+u64 getPercentile(const std::vector<u64> & sorted, size_t percent) {
+	return sorted[std::min(sorted.size() * percent / 100, sorted.size() - 1)];
+}
+
+void writeResults() {
+	
+	fs::path file = g_output.empty() ? fs::paths.user / "replay.csv" : fs::path(g_output);
+	
+	fs::ofstream ofs(file);
+	if(!ofs.is_open()) {
+		LogError << "Could not write replay results to " << file;
+	} else {
+		ofs << "frame,time_us,checksum,draws,vertices,indices,texture_binds,state_changes\n";
+		for(size_t i = 0; i < g_results.size(); i++) {
+			const NullRenderer::Stats & stats = g_results[i].stats;
+			ofs << i << ',' << g_results[i].time << ','
+			    << std::hex << std::setfill('0') << std::setw(8) << g_results[i].checksum
+			    << std::dec << ',' << stats.draws << ',' << stats.vertices << ','
+			    << stats.indices << ',' << stats.textureBinds << ',' << stats.stateChanges << '\n';
+		}
+		LogInfo << "Wrote replay results to " << file;
+	}
+	
+	if(g_results.empty()) {
+		LogWarning << "Replay ended before the level was loaded";
+		return;
+	}
+	
+	std::vector<u64> times(g_results.size());
+	u64 total = 0;
+	for(size_t i = 0; i < g_results.size(); i++) {
+		times[i] = g_results[i].time;
+		total += times[i];
+	}
+	std::sort(times.begin(), times.end());
+	
+	std::ostringstream checksum;
+	checksum << std::hex << std::setfill('0') << std::setw(8) << g_results.back().checksum;
+	
+	LogInfo << "Replay: " << g_results.size() << " frames, mean " << (total / times.size())
+	        << " us, median " << getPercentile(times, 50) << " us, 95th percentile "
+	        << getPercentile(times, 95) << " us, max " << times.back()
+	        << " us, final checksum " << checksum.str();
+}
+
+} // anonymous namespace
+
+ARX_PROGRAM_OPTION("replay", "", "Run a recorded input replay headless at a fixed time step",
+                   &playReplay, "FILE");
+ARX_PROGRAM_OPTION("replay-output", "", "Write replay frame times and checksums to FILE",
+                   &setReplayOutput, "FILE");
+ARX_PROGRAM_OPTION("record-replay", "", "Use a fixed time step and record the input to FILE",
+                   &recordReplay, "FILE");
+
+namespace replay {
+
+bool isPlaying() {
+	return g_mode == Playing;
+}
+
+bool isRecording() {
+	return g_mode == Recording;
+}
+
+bool start() {
+	
+	if(g_mode == Disabled) {
+		return true;
+	}
+	
+	if(g_mode == Playing) {
+		if(!loadReplay(g_file)) {
+			return false;
+		}
+		loadLevel(g_level);
+	} else {
+		g_recording.open(g_file);
+		if(!g_recording.is_open()) {
+			LogError << "Could not open " << g_file << " for recording";
+			return false;
+		}
+		g_recording << "# Arx Libertatis input replay\n";
+		g_recording << "seed " << g_seed << '\n';
+		g_recording << "timestep " << g_timestep << '\n';
+		LogInfo << "Recording input to " << g_file;
+	}
+	
+	arxtime.set_fixed_step(g_timestep);
+	
+	return true;
+}
+
+bool hasStarted() {
+	return g_started;
+}
+
+void beginFrame() {
+	
+	if(g_mode == Disabled) {
+		return;
+	}
+	
+	arxtime.step();
+	
+	if(g_started) {
+		g_frame++;
+	} else if(isInGame()) {
+		// Start from the same state no matter what happened before the level was loaded.
+		g_started = true;
+		g_frame = 0;
+		Random::seed(g_seed);
+		srand(g_seed);
+		if(g_mode == Recording) {
+			g_recording << "level " << CURRENTLEVEL << '\n';
+		}
+	} else {
+		return;
+	}
+	
+	g_eventsBegin = g_eventsEnd;
+	while(g_eventsEnd < g_events.size() && g_events[g_eventsEnd].frame <= g_frame) {
+		g_eventsEnd++;
+	}
+	
+	g_frameStart = Time::getUs();
+}
+
+void endFrame() {
+	
+	if(!g_started || g_finished) {
+		return;
+	}
+	
+	u64 time = Time::getElapsedUs(g_frameStart);
+	
+	// Pathfinder results must not depend on how fast the worker threads are.
+	EERIE_PATHFINDER_Wait();
+	
+	if(g_mode != Playing) {
+		return;
+	}
+	
+	FrameResult result;
+	result.time = time;
+	result.checksum = getStateChecksum();
+	// Replays always use the HeadlessWindow, which has already ended the renderer frame.
+	result.stats = static_cast<NullRenderer *>(GRenderer)->getLastFrameStats();
+	g_results.push_back(result);
+	
+	if(g_results.size() >= g_frames) {
+		g_finished = true;
+		writeResults();
+		mainApp->quit();
+	}
+}
+
+void stop() {
+	
+	if(g_mode == Playing && !g_finished) {
+		g_finished = true;
+		LogWarning << "Replay aborted after " << g_results.size() << " of " << g_frames
+		           << " frames";
+		writeResults();
+	}
+	
+	if(g_mode == Recording && g_recording.is_open()) {
+		if(g_started) {
+			g_recording << "frames " << (g_frame + 1) << '\n';
+		}
+		g_recording.close();
+		LogInfo << "Recorded input to " << g_file;
+	}
+}
+
+void getEvents(const InputEvent * & begin, const InputEvent * & end) {
+	if(g_eventsBegin == g_eventsEnd) {
+		begin = end = NULL;
+	} else {
+		begin = &g_events[g_eventsBegin];
+		end = begin + (g_eventsEnd - g_eventsBegin);
+	}
+}
+
+void record(const InputEvent & event) {
+	if(g_recording.is_open()) {
+		InputEvent e = event;
+		e.frame = g_frame;
+		writeEvent(e);
+	}
+}
+
+} // namespace replay
@@ -0,0 +1,103 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARX_CORE_REPLAY_H
+#define ARX_CORE_REPLAY_H
+
+#include "platform/Platform.h"
+
+/*!
+ * Deterministic input replays for benchmarking.
+ *
+ * With --replay=FILE the game runs without a window, sound or real input: it loads the
+ * level named in the replay file, steps the game time by a fixed amount each frame and
+ * feeds the recorded input to the game. Per-frame timings and a checksum of the entity
+ * state are written to a CSV file when the replay ends, after which the game quits.
+ * The CSV file also lists the draw calls, vertices, indices, texture binds and state
+ * changes counted by the NullRenderer for each frame.
+ * With --record-replay=FILE the same fixed time step is used while playing normally and
+ * the input is written to FILE.
+ *
+ * Replay files are plain text with one directive per line:
+ *  - level N: the level to load (default 0)
+ *  - seed N: seed for the random number generators (default 0)
+ *  - timestep US: game time per frame in microseconds (default 16666)
+ *  - frames N: number of frames to run (default: one frame after the last event)
+ *  - F key NAME 0|1: key or mouse button NAME was released / pressed in frame F
+ *  - F click NAME CLICKS UNCLICKS: mouse button click counts for frame F
+ *  - F mouse X Y DX DY: absolute mouse position and movement in frame F
+ *  - F wheel DIR: mouse wheel movement in frame F
+ * NAME is a key name as used in the config file. Empty lines and lines starting with
+ * '#' are ignored. Frames are counted from the first frame after the level has loaded.
+ */
+namespace replay {
+
+struct InputEvent {
+	
+	enum Type {
+		Key,
+		Click,
+		Mouse,
+		Wheel
+	};
+	
+	u64 frame;
+	Type type;
+	int key;     //!< Keyboard or mouse button id for Key and Click events
+	int data[4]; //!< Type-specific values in the order of the replay file
+	
+};
+
+//! @return true if a replay is being played back
+bool isPlaying();
+
+//! @return true if input is being recorded
+bool isRecording();
+
+/*!
+ * Load the replay or open the recording file selected on the command line.
+ * Must be called once after initialization before the first frame.
+ * @return false if the replay could not be started
+ */
+bool start();
+
+//! @return true once the level has been loaded and frames are being counted
+bool hasStarted();
+
+//! Called at the start of each frame before any other game code.
+void beginFrame();
+
+//! Called at the end of each frame.
+void endFrame();
+
+//! Write the results of an unfinished replay or close the recording.
+void stop();
+
+/*!
+ * Get the input events for the current frame.
+ * The range is empty before the level has been loaded.
+ */
+void getEvents(const InputEvent * & begin, const InputEvent * & end);
+
+//! Add an input event for the current frame to the recording.
+void record(const InputEvent & event);
+
+} // namespace replay
+
+#endif // ARX_CORE_REPLAY_H
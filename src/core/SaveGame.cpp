@@ -24,10 +24,15 @@
 #include <algorithm>
 
 #include "core/Config.h"
+#include "io/IniReader.h"
+#include "io/IniWriter.h"
+#include "io/fs/FileStream.h"
 #include "io/fs/Filesystem.h"
 #include "io/fs/SystemPaths.h"
 #include "io/log/Logger.h"
 #include "io/resource/PakReader.h"
+#include "platform/Lock.h"
+#include "platform/Thread.h"
 #include "scene/ChangeLevel.h"
 
 using std::string;
@@ -37,6 +42,7 @@ namespace {
 static const fs::path SAVEGAME_NAME = "gsave.sav";
 static const fs::path SAVEGAME_DIR = "save";
 static const fs::path SAVEGAME_THUMBNAIL = "gsave.bmp";
+static const fs::path SAVEGAME_INDEX = "index.ini";
 static const std::string QUICKSAVE_ID = "ARX_QUICK_ARX";
 
 enum SaveGameChange {
@@ -53,16 +59,237 @@ static int saveTimeCompare(const SaveGame & a, const SaveGame & b) {
 
 SaveGameList savegames;
 
+class SaveGameList::Scanner : public Thread {
+	
+public:
+	
+	typedef std::vector<std::pair<fs::path, IndexEntry> > Results;
+	
+	explicit Scanner(const Results & _pending) : pending(_pending), finished(false) {
+		setThreadName("Savegame Scanner");
+	}
+	
+	void run() {
+		
+		for(;;) {
+			
+			std::pair<fs::path, IndexEntry> item;
+			{
+				Autolock lock(mutex);
+				if(pending.empty()) {
+					finished = true;
+					return;
+				}
+				item = pending.front();
+				pending.erase(pending.begin());
+			}
+			
+			check(item.first, item.second);
+			
+			Autolock lock(mutex);
+			results.push_back(item);
+		}
+	}
+	
+	/*!
+	 * Queue more savegames to check.
+	 * @return false if the scanner has already finished, the savegames are not queued then.
+	 */
+	bool add(const Results & more) {
+		Autolock lock(mutex);
+		if(finished) {
+			return false;
+		}
+		pending.insert(pending.end(), more.begin(), more.end());
+		return true;
+	}
+	
+	//! Get the savegames that have been checked since the last call.
+	Results take(bool & done) {
+		Results taken;
+		Autolock lock(mutex);
+		taken.swap(results);
+		done = finished;
+		return taken;
+	}
+	
+private:
+	
+	Results pending;
+	
+	Lock mutex;
+	Results results;
+	bool finished;
+	
+};
+
+void SaveGameList::check(const fs::path & savefile, IndexEntry & entry) {
+	entry.valid = (ARX_CHANGELEVEL_GetInfo(savefile, entry.name, entry.version,
+	                                       entry.level, entry.gametime) != -1);
+	entry.thumbnail = fs::exists(savefile.parent() / SAVEGAME_THUMBNAIL);
+}
+
+SaveGameList::~SaveGameList() {
+	if(scanner) {
+		scanner->waitForCompletion();
+		delete scanner;
+	}
+}
+
+void SaveGameList::loadIndex() {
+	
+	indexLoaded = true;
+	
+	fs::path savedir = fs::paths.user / SAVEGAME_DIR;
+	
+	fs::ifstream ifs(savedir / SAVEGAME_INDEX);
+	if(!ifs.is_open()) {
+		return;
+	}
+	
+	IniReader reader;
+	if(!reader.read(ifs)) {
+		LogWarning << "Errors while reading " << (savedir / SAVEGAME_INDEX);
+	}
+	
+	const std::string empty;
+	for(IniReader::iterator si = reader.begin(); si != reader.end(); ++si) {
+		
+		const std::string & section = si->first;
+		
+		const std::string & dirname = reader.getKey(section, "dir", empty);
+		std::istringstream iss(reader.getKey(section, "mtime", empty));
+		IndexEntry entry;
+		if(dirname.empty() || !(iss >> entry.stime)) {
+			continue;
+		}
+		
+		entry.valid = reader.getKey(section, "valid", false);
+		entry.name = reader.getKey(section, "name", empty);
+		entry.level = reader.getKey(section, "level", 0);
+		entry.gametime = (unsigned long)reader.getKey(section, "gametime", 0);
+		entry.version = reader.getKey(section, "version", 0.f);
+		entry.thumbnail = reader.getKey(section, "thumbnail", false);
+		
+		cache[savedir / dirname / SAVEGAME_NAME] = entry;
+	}
+	
+	LogDebug("Loaded " << cache.size() << " entries from the savegame index");
+}
+
+void SaveGameList::saveIndex() {
+	
+	fs::path savedir = fs::paths.user / SAVEGAME_DIR;
+	fs::path indexfile = savedir / SAVEGAME_INDEX;
+	fs::path tempfile = indexfile;
+	tempfile.append(".tmp");
+	
+	{
+		fs::ofstream ofs(tempfile, fs::fstream::out | fs::fstream::trunc);
+		if(!ofs.is_open()) {
+			LogWarning << "Could not write " << indexfile;
+			return;
+		}
+		
+		IniWriter writer(ofs);
+		
+		size_t i = 0;
+		for(Index::const_iterator entry = cache.begin(); entry != cache.end(); ++entry) {
+			
+			std::ostringstream section, mtime;
+			section << "save" << i++;
+			mtime << entry->second.stime;
+			
+			writer.beginSection(section.str());
+			writer.writeKey("dir", entry->first.parent().filename());
+			writer.writeKey("mtime", mtime.str());
+			writer.writeKey("valid", entry->second.valid);
+			writer.writeKey("name", entry->second.name);
+			writer.writeKey("level", int(entry->second.level));
+			writer.writeKey("gametime", int(entry->second.gametime));
+			writer.writeKey("version", entry->second.version);
+			writer.writeKey("thumbnail", entry->second.thumbnail);
+		}
+		
+		if(!writer.flush()) {
+			LogWarning << "Could not write " << indexfile;
+			return;
+		}
+	}
+	
+	if(!fs::rename(tempfile, indexfile, true)) {
+		LogWarning << "Could not write " << indexfile;
+		fs::remove(tempfile);
+	}
+}
+
+size_t SaveGameList::add(const fs::path & savefile, const IndexEntry & entry, size_t i) {
+	
+	if(i == size_t(-1)) {
+		// Make another save game slot at the end
+		i = savelist.size();
+		savelist.resize(savelist.size() + 1);
+	}
+	
+	SaveGame * save = &savelist[i];
+	
+	save->name = entry.name;
+	save->level = entry.level;
+	save->stime = entry.stime;
+	save->gametime = entry.gametime;
+	save->savefile = savefile;
+	
+	save->quicksave = (entry.name == QUICKSAVE_ID || entry.name == "ARX_QUICK_ARX1");
+	
+	fs::path thumbnail = savefile.parent() / SAVEGAME_THUMBNAIL;
+	if(entry.thumbnail) {
+		// Resource paths must be lowercase (for now), but filesystem paths can be
+		// mixed case and case sensitive, so we can't just convert the save dirname
+		// to lowercase and expect to not get collisions.
+		// Instead, choose a unique number.
+		res::path thumbnail_res;
+		size_t n = 0;
+		std::ostringstream oss;
+		do {
+			oss.clear();
+			oss << "thumbnail" << n << SAVEGAME_THUMBNAIL.ext();
+			thumbnail_res = res::path("save") / oss.str();
+			n++;
+		} while(resources->getFile(thumbnail_res));
+		resources->addFiles(thumbnail, thumbnail_res);
+		save->thumbnail = thumbnail_res.remove_ext();
+	} else {
+		save->thumbnail.clear();
+	}
+	
+	const struct tm & t = *localtime(&save->stime);
+	std::ostringstream oss;
+	oss << std::setfill('0') << (t.tm_year + 1900) << "-" << std::setw(2) << (t.tm_mon + 1)
+	    << "-" << std::setw(2) << t.tm_mday << "   " << std::setfill(' ') << std::setw(2)
+	    << t.tm_hour << ":" << std::setfill('0') << std::setw(2) << t.tm_min << ":"
+	    << std::setw(2) << t.tm_sec;
+	save->time = oss.str();
+	
+	return i;
+}
+
 void SaveGameList::update(bool verbose) {
 	
 	LogDebug("SaveGameList::update()");
 	
+	if(!indexLoaded) {
+		loadIndex();
+	}
+	
+	// Add what the background scan found so far, without waiting for the rest.
+	poll();
+	
 	size_t old_count = savelist.size();
 	std::vector<SaveGameChange> found(old_count, SaveGameRemoved);
 	
 	bool new_saves = false;
 	
-	size_t max_name_length = 0;
+	maxNameLength = 0;
 	
 	fs::path savedir = fs::paths.user / SAVEGAME_DIR;
 	
@@ -70,6 +297,10 @@ void SaveGameList::update(bool verbose) {
 		LogInfo << "Using save game dir " << savedir;
 	}
 	
+	Index newIndex;
+	Scanner::Results pending;
+	Scanning newScanning;
+	
 	for(fs::directory_iterator it(savedir); !it.end(); ++it) {
 		
 		fs::path dirname = it.name();
@@ -87,69 +318,47 @@ void SaveGameList::update(bool verbose) {
 				index = i;
 			}
 		}
+		
+		// Check savegames that have changed since they were indexed in the background.
+		Index::const_iterator cached = cache.find(path);
+		if(cached == cache.end() || cached->second.stime != stime) {
+			Scanning::const_iterator queued = scanning.find(path);
+			if(queued == scanning.end() || queued->second != stime) {
+				IndexEntry entry;
+				entry.stime = stime;
+				pending.push_back(std::make_pair(path, entry));
+			}
+			newScanning[path] = stime;
+			if(index != (size_t)-1) {
+				// Keep the old entry until the scan is done.
+				found[index] = SaveGameUnchanged;
+			}
+			continue;
+		}
+		
+		const IndexEntry & entry = cached->second;
+		newIndex[path] = entry;
+		
 		if(index != (size_t)-1 && savelist[index].stime == stime) {
 			found[index] = SaveGameUnchanged;
 			continue;
 		}
 		
-		string name;
-		float version;
-		long level;
-		unsigned long ignored;
-		if(ARX_CHANGELEVEL_GetInfo(path, name, version, level, ignored) == -1) {
+		if(!entry.valid) {
 			LogWarning << "Unable to get save file info for " << path;
 			continue;
 		}
 		
 		new_saves = true;
 		
-		if(index == (size_t)-1) {
-			// Make another save game slot at the end
-			index = savelist.size();
-			savelist.resize(savelist.size() + 1);
-		} else {
+		if(index != (size_t)-1) {
 			found[index] = SaveGameChanged;
 		}
 		
-		SaveGame * save = &savelist[index];
-		
-		save->name = name;
-		save->level = level;
-		save->stime = stime;
-		save->savefile = path;
-		
-		save->quicksave = (name == QUICKSAVE_ID || name == "ARX_QUICK_ARX1");
-		
-		fs::path thumbnail = path.parent() / SAVEGAME_THUMBNAIL;
-		if(fs::exists(thumbnail)) {
-			// Resource paths must be lowercase (for now), but filesystem paths can be
-			// mixed case and case sensitive, so we can't just convert the save dirname
-			// to lowercase and expect to not get collisions.
-			// Instead, choose a unique number.
-			res::path thumbnail_res;
-			size_t i = 0;
-			std::ostringstream oss;
-			do {
-				oss.clear();
-				oss << "thumbnail" << i << SAVEGAME_THUMBNAIL.ext();
-				thumbnail_res = res::path("save") / oss.str();
-				i++;
-			} while(resources->getFile(thumbnail_res));
-			resources->addFiles(thumbnail, thumbnail_res);
-			save->thumbnail = thumbnail_res.remove_ext();
-		} else {
-			save->thumbnail.clear();
-		}
-		
-		max_name_length = std::max(save->quicksave ? 9 : name.length(), max_name_length);
+		index = add(path, entry, index);
 		
-		const struct tm & t = *localtime(&stime);
-		std::ostringstream oss;
-		oss << std::setfill('0') << (t.tm_year + 1900) << "-" << std::setw(2) << (t.tm_mon + 1)
-		    << "-" << std::setw(2) << t.tm_mday << "   " << std::setfill(' ') << std::setw(2)
-		    << t.tm_hour << ":" << std::setfill('0') << std::setw(2) << t.tm_min << ":"
-		    << std::setw(2) << t.tm_sec;
-		save->time = oss.str();
+		const SaveGame & save = savelist[index];
+		maxNameLength = std::max(save.quicksave ? 9 : save.name.length(), maxNameLength);
 	}
 	
 	size_t o = 0;
@@ -158,14 +367,6 @@ void SaveGameList::update(bool verbose) {
 		// print new savegames
 		if(verbose || i >= old_count || found[i] == SaveGameChanged) {
 			
-			std::ostringstream oss;
-			if(savelist[i].quicksave) {
-				oss << "(quicksave)" << std::setw(max_name_length - 8) << ' ';
-			} else {
-				oss << "\"" << savelist[i].name << "\""
-						<< std::setw(max_name_length - savelist[i].name.length() + 1) << ' ';
-			}
-			
 			const char * lead = """Found save ";
 			if(verbose) {
 				if(i + 1 == savelist.size()) {
@@ -175,7 +376,7 @@ void SaveGameList::update(bool verbose) {
 				}
 			}
 			
-			LogInfo << lead << oss.str() << "  " << savelist[i].time;
+			LogInfo << lead << getPaddedName(savelist[i]) << "  " << savelist[i].time;
 		}
 		
 		if(i >= old_count || found[i] != SaveGameRemoved) {
@@ -195,9 +396,115 @@ void SaveGameList::update(bool verbose) {
 		std::sort(savelist.begin(), savelist.end(), saveTimeCompare);
 	}
 	
+	bool indexChanged = (newIndex.size() != cache.size());
+	cache.swap(newIndex);
+	
+	// Results for savegames that have been removed or changed again are ignored by poll().
+	scanning.swap(newScanning);
+	
+	if(!pending.empty()) {
+		LogDebug("Checking " << pending.size() << " changed savegames");
+		if(scanner && !scanner->add(pending)) {
+			// The scanner finished just now - collect its last results
+			poll();
+			arx_assert(!scanner);
+		}
+		if(!scanner) {
+			scanner = new Scanner(pending);
+			scanner->start();
+		}
+	} else if(indexChanged && !scanner) {
+		saveIndex();
+	}
+	
 	LogDebug("Found " << savelist.size() << " savegames");
 }
 
+bool SaveGameList::poll(std::vector<fs::path> * oldOrder) {
+	
+	if(!scanner) {
+		return false;
+	}
+	
+	bool done;
+	Scanner::Results results = scanner->take(done);
+	
+	bool changed = false;
+	for(Scanner::Results::const_iterator i = results.begin(); i != results.end(); ++i) {
+		
+		Scanning::iterator queued = scanning.find(i->first);
+		if(queued == scanning.end() || queued->second != i->second.stime) {
+			// Removed or changed again since the scan was started
+			continue;
+		}
+		scanning.erase(queued);
+		
+		cache[i->first] = i->second;
+		
+		size_t idx = (size_t)-1;
+		for(size_t j = 0; j < savelist.size(); j++) {
+			if(savelist[j].savefile == i->first) {
+				idx = j;
+			}
+		}
+		
+		if(!i->second.valid) {
+			LogWarning << "Unable to get save file info for " << i->first;
+			continue;
+		}
+		
+		if(!changed && oldOrder) {
+			oldOrder->clear();
+			oldOrder->reserve(savelist.size());
+			for(size_t j = 0; j < savelist.size(); j++) {
+				oldOrder->push_back(savelist[j].savefile);
+			}
+		}
+		
+		idx = add(i->first, i->second, idx);
+		changed = true;
+		
+		const SaveGame & save = savelist[idx];
+		maxNameLength = std::max(save.quicksave ? 9 : save.name.length(), maxNameLength);
+		LogInfo << "Found save " << getPaddedName(save) << "  " << save.time;
+	}
+	
+	if(changed) {
+		std::sort(savelist.begin(), savelist.end(), saveTimeCompare);
+	}
+	
+	if(done) {
+		scanner->waitForCompletion();
+		delete scanner, scanner = NULL;
+		saveIndex();
+	}
+	
+	return changed;
+}
+
+size_t SaveGameList::find(const fs::path & savefile) const {
+	
+	for(size_t i = 0; i < savelist.size(); i++) {
+		if(savelist[i].savefile == savefile) {
+			return i;
+		}
+	}
+	
+	return size_t(-1);
+}
+
+std::string SaveGameList::getPaddedName(const SaveGame & save) const {
+	
+	std::ostringstream oss;
+	if(save.quicksave) {
+		oss << "(quicksave)" << std::setw(maxNameLength - 8) << ' ';
+	} else {
+		oss << "\"" << save.name << "\"" << std::setw(maxNameLength - save.name.length() + 1) << ' ';
+	}
+	
+	return oss.str();
+}
+
 void SaveGameList::remove(iterator save) {
 	
 	arx_assert(save >= begin() && save < end());
@@ -238,6 +545,14 @@ bool SaveGameList::save(const string & name, iterator overwrite, const Image & t
 		LogWarning << "Failed to save screenshot to " << (savefile.parent() / SAVEGAME_THUMBNAIL);
 	}
 	
+	// Index the new savegame right away so that it is listed without waiting for the scanner.
+	if(!indexLoaded) {
+		loadIndex();
+	}
+	IndexEntry & entry = cache[savefile];
+	entry.stime = fs::last_write_time(savefile);
+	check(savefile, entry);
+	
 	update();
 	
 	return true;
@@ -274,7 +589,7 @@ SaveGameList::iterator SaveGameList::quickload() {
 		return end();
 	}
 	
-	// update() already sorts the savegame list so we can just return the first one.
+	// update() and poll() already sort the savegame list so we can just return the first one.
 	
 	return begin();
 }
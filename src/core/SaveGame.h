@@ -22,6 +22,7 @@
 
 #include <stddef.h>
 #include <vector>
+#include <map>
 #include <string>
 #include <ctime>
 
@@ -40,10 +41,11 @@ struct SaveGame {
 	
 	long level;
 	std::time_t stime;
+	unsigned long gametime; //!< Seconds played, as stored in the savegame.
 	
 	std::string time;
 	
-	SaveGame() : level(0) { }
+	SaveGame() : level(0), gametime(0) { }
 };
 
 //! Central management of the list of savegames.
@@ -53,9 +55,29 @@ public:
 	
 	typedef std::vector<SaveGame>::const_iterator iterator;
 	
-	//! Update the savegame list. This is automatically called by save() and remove()
+	SaveGameList() : indexLoaded(false), scanner(NULL), maxNameLength(0) { }
+	~SaveGameList();
+	
+	/*!
+	 * Update the savegame list. This is automatically called by save() and remove()
+	 *
+	 * Savegames that are unchanged since they were last added to the index are listed
+	 * immediately. Other savegames are checked in the background and added by poll().
+	 */
 	void update(bool verbose = false);
 	
+	/*!
+	 * Add savegames that have been checked in the background since the last call.
+	 * The list is sorted again afterwards, so indices of existing savegames may change.
+	 * @param oldOrder if not NULL and the list changed, receives the savefiles of all
+	 *                 savegames in the order they had before the call.
+	 * @return true if the list was changed.
+	 */
+	bool poll(std::vector<fs::path> * oldOrder = NULL);
+	
+	//! @return the index of the savegame stored in savefile, or size_t(-1) if not listed.
+	size_t find(const fs::path & savefile) const;
+	
 	/*! Save the current game state
 	 * @param name The name of the new savegame.
 	 * @param overwrite A savegame to overwrite with this save or end()
@@ -92,8 +114,51 @@ public:
 	
 private:
 	
+	//! Savegame information stored in the index file.
+	struct IndexEntry {
+		
+		std::time_t stime;
+		bool valid; //!< false if the savegame could not be read.
+		std::string name;
+		long level;
+		unsigned long gametime;
+		float version;
+		bool thumbnail;
+		
+		IndexEntry()
+			: stime(0), valid(false), level(0), gametime(0), version(0.f), thumbnail(false) { }
+		
+	};
+	
+	typedef std::map<fs::path, IndexEntry> Index;
+	
+	//! Modification time of savegames queued for the background scan, by savefile path.
+	typedef std::map<fs::path, std::time_t> Scanning;
+	
+	class Scanner;
+	
+	void loadIndex();
+	void saveIndex();
+	
+	//! Add or update a savegame in the list. @return the index of the savegame
+	size_t add(const fs::path & savefile, const IndexEntry & entry, size_t index);
+	
+	//! Read the savegame information for an index entry.
+	static void check(const fs::path & savefile, IndexEntry & entry);
+	
+	//! Name of a savegame padded to maxNameLength for the log.
+	std::string getPaddedName(const SaveGame & save) const;
+	
 	std::vector<SaveGame> savelist;
 	
+	Index cache; //!< Savegame information by savefile path.
+	bool indexLoaded;
+	
+	Scanner * scanner;
+	Scanning scanning;
+	
+	size_t maxNameLength; //!< Longest savegame name logged so far.
+	
 };
 
 extern SaveGameList savegames;
@@ -55,6 +55,7 @@
 #include "io/fs/SystemPaths.h"
 #include "io/log/CriticalLogger.h"
 #include "io/log/FileLogger.h"
+#include "io/log/LogThread.h"
 #include "io/log/Logger.h"
 #include "math/Random.h"
 #include "platform/Compiler.h"
@@ -145,6 +146,7 @@ INT WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR lpCmdLine,
 	Logger::initialize();
 	CrashHandler::registerCrashCallback(Logger::quickShutdown);
 	Logger::add(new logger::CriticalErrorDialog);
+	logger::startThread();
 	
 	// Parse the command line and process options
 	ExitStatus status = parseCommandLine(argc, argv);
@@ -177,6 +179,7 @@ INT WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR lpCmdLine,
 	
 	// Shutdown the logging system
 	// If there has been a critical error, a dialog will be shown now
+	logger::stopThread();
 	Logger::shutdown();
 	
 	CrashHandler::shutdown();
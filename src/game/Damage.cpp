@@ -49,7 +49,6 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include <cstring>
 #include <cstdio>
 #include <algorithm>
-#include <limits>
 #include <string>
 #include <vector>
 
@@ -58,6 +57,8 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include "core/GameTime.h"
 #include "core/Core.h"
 
+#include "game/DamageArea.h"
+#include "game/EntityGrid.h"
 #include "game/EntityManager.h"
 #include "game/Equipment.h"
 #include "game/Inventory.h"
@@ -985,9 +986,14 @@ void ARX_DAMAGES_UpdateDamage(long j, float tim) {
 
 		bool validsource = ValidIONum(damages[j].source);
 		float divradius = 1.f / damages[j].radius;
+		
+		// CheckIOInSphere() ignores entities that are farther away than this
+		std::vector<size_t> found;
+		entityGrid.query(damages[j].pos, damages[j].radius + 15.f + 500.f, found);
 
 		// checking for IO damages
-		for(size_t i = 0; i < entities.size(); i++) {
+		for(size_t n = 0; n < found.size(); n++) {
+			size_t i = found[n];
 			Entity * io = entities[i];
 
 			if ((io)
@@ -1191,6 +1197,9 @@ bool SphereInIO(Entity * io, Vec3f * pos, float radius)
 {
 	if(!io || !io->obj)
 		return false;
+	
+	if(!entityGrid.mayTouch(io, *pos, radius))
+		return false;
 
 	long step;
 
@@ -1212,8 +1221,13 @@ bool SphereInIO(Entity * io, Vec3f * pos, float radius)
 bool ARX_DAMAGES_TryToDoDamage(Vec3f * pos, float dmg, float radius, long source)
 {
 	bool ret = false;
+	
+	// Nothing farther away than the largest threshold can be damaged
+	std::vector<size_t> found;
+	entityGrid.query(*pos, 510.f, found);
 
-	for(size_t i = 0; i < entities.size(); i++) {
+	for(size_t n = 0; n < found.size(); n++) {
+		size_t i = found[n];
 		Entity * io = entities[i];
 
 		if(io != NULL
@@ -1278,8 +1292,11 @@ void CheckForIgnition(Vec3f * pos, float radius, bool mode, long flag) {
 			}
 		}
 
-	for(size_t i = 0; i < entities.size(); i++) {
-		Entity * io = entities[i];
+	std::vector<size_t> found;
+	entityGrid.query(*pos, radius, found);
+	
+	for(size_t n = 0; n < found.size(); n++) {
+		Entity * io = entities[found[n]];
 
 		if(io && io->show == 1 && io->obj && !(io->ioflags & IO_UNDERWATER) && io->obj->fastaccess.fire >= 0) {
 			
@@ -1322,8 +1339,13 @@ bool DoSphericDamage(Vec3f * pos, float dmg, float radius, DamageArea flags, Dam
 
 	float rad = 1.f / radius;
 	bool validsource = ValidIONum(numsource);
+	
+	// Only entities with a vertex inside the radius are affected
+	std::vector<size_t> found;
+	entityGrid.query(*pos, radius, found);
 
-	for(size_t i = 0; i < entities.size(); i++) {
+	for(size_t n = 0; n < found.size(); n++) {
+		size_t i = found[n];
 		Entity * ioo = entities[i];
 
 		if((ioo) && (long(i) != numsource) && (ioo->obj)) {
@@ -1333,38 +1355,19 @@ bool DoSphericDamage(Vec3f * pos, float dmg, float radius, DamageArea flags, Dam
 
 			if((ioo->ioflags & IO_CAMERA) || (ioo->ioflags & IO_MARKER))
 				continue;
+			
+			if(!entityGrid.mayTouch(ioo, *pos, radius))
+				continue;
 
-			long count = 0;
-			long count2 = 0;
-			float mindist = std::numeric_limits<float>::max();
-
-			for(size_t k = 0; k < ioo->obj->vertexlist.size(); k += 1) {
-				if(ioo->obj->vertexlist.size() < 120) {
-					for(size_t kk = 0; kk < ioo->obj->vertexlist.size(); kk += 1) {
-						if(kk != k) {
-							Vec3f posi = (entities[i]->obj->vertexlist3[k].v
-							              + entities[i]->obj->vertexlist3[kk].v) * 0.5f;
-							float dist = fdist(*pos, posi);
-							if(dist <= radius) {
-								count2++;
-								if(dist < mindist)
-									mindist = dist;
-							}
-						}
-					}
-				}
-
-				{
-					float dist = fdist(*pos, entities[i]->obj->vertexlist3[k].v);
-
-					if(dist <= radius) {
-						count++;
-
-						if(dist < mindist)
-							mindist = dist;
-					}
-				}
-			}
+			if(ioo->obj->vertexlist.empty())
+				continue;
+			
+			DamageAreaOverlap overlap = ARX_DAMAGES_GetAreaOverlap(&ioo->obj->vertexlist3[0],
+			                                                       ioo->obj->vertexlist.size(),
+			                                                       *pos, radius);
+			long count = overlap.count;
+			long count2 = overlap.count2;
+			float mindist = overlap.mindist;
 
 			float ratio = ((float)count / ((float)ioo->obj->vertexlist.size() * ( 1.0f / 2 )));
 
@@ -0,0 +1,172 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "game/DamageArea.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "graphics/Math.h"
+#include "graphics/Vertex.h"
+#include "math/Vector.h"
+
+namespace {
+
+//! Vertex pairs are only tested for meshes with less vertices than this
+const size_t MaxPairVertices = 120;
+
+const size_t ClusterSize = 8;
+
+//! Room for rounding differences between the cluster bounds and the exact midpoints
+const float Slack = 0.1f;
+
+struct Cluster {
+	size_t begin;
+	size_t end;
+	Vec3f min;
+	Vec3f max;
+};
+
+struct CompareX {
+	
+	const EERIE_VERTEX * vertices;
+	
+	explicit CompareX(const EERIE_VERTEX * _vertices) : vertices(_vertices) { }
+	
+	bool operator()(size_t a, size_t b) const {
+		return vertices[a].v.x < vertices[b].v.x;
+	}
+	
+};
+
+/*!
+ * Lower bound of fdist() from pos to any point in the box.
+ * fdist() uses an approximated square root, but it is monotonic.
+ */
+float getMinDist(const Vec3f & min, const Vec3f & max, const Vec3f & pos) {
+	Vec3f d = glm::max(Vec3f_ZERO, glm::max(min - pos, pos - max));
+	float dist = std::max(0.f, std::sqrt(d.x * d.x + d.y * d.y + d.z * d.z) - Slack);
+	return ffsqrt(dist * dist);
+}
+
+//! Upper bound of fdist() from pos to any point in the box
+float getMaxDist(const Vec3f & min, const Vec3f & max, const Vec3f & pos) {
+	Vec3f d = glm::max(pos - min, max - pos);
+	float dist = std::sqrt(d.x * d.x + d.y * d.y + d.z * d.z) + Slack;
+	return ffsqrt(dist * dist);
+}
+
+} // anonymous namespace
+
+DamageAreaOverlap ARX_DAMAGES_GetAreaOverlap(const EERIE_VERTEX * vertices, size_t count,
+                                             const Vec3f & pos, float radius) {
+	
+	DamageAreaOverlap result;
+	result.count = 0;
+	result.count2 = 0;
+	result.mindist = std::numeric_limits<float>::max();
+	
+	for(size_t k = 0; k < count; k++) {
+		float dist = fdist(pos, vertices[k].v);
+		if(dist <= radius) {
+			result.count++;
+			if(dist < result.mindist) {
+				result.mindist = dist;
+			}
+		}
+	}
+	
+	if(count >= MaxPairVertices) {
+		return result;
+	}
+	
+	// Group vertices that are close along the x axis.
+	size_t order[MaxPairVertices];
+	for(size_t i = 0; i < count; i++) {
+		order[i] = i;
+	}
+	std::sort(order, order + count, CompareX(vertices));
+	
+	Cluster clusters[(MaxPairVertices + ClusterSize - 1) / ClusterSize];
+	size_t nclusters = 0;
+	for(size_t begin = 0; begin < count; begin += ClusterSize) {
+		Cluster & cluster = clusters[nclusters++];
+		cluster.begin = begin;
+		cluster.end = std::min(begin + ClusterSize, count);
+		cluster.min = cluster.max = vertices[order[begin]].v;
+		for(size_t i = begin + 1; i < cluster.end; i++) {
+			cluster.min = glm::min(cluster.min, vertices[order[i]].v);
+			cluster.max = glm::max(cluster.max, vertices[order[i]].v);
+		}
+	}
+	
+	// Once this many pairs are found the damage ratio can not get any larger.
+	long maxCount2 = long(count);
+	
+	for(size_t a = 0; a < nclusters; a++) {
+		for(size_t b = a; b < nclusters; b++) {
+			
+			const Cluster & ca = clusters[a];
+			const Cluster & cb = clusters[b];
+			
+			// All midpoints of pairs from the two clusters are in this box.
+			Vec3f min = (ca.min + cb.min) * 0.5f;
+			Vec3f max = (ca.max + cb.max) * 0.5f;
+			
+			bool counting = (result.count2 < maxCount2);
+			float mindist = getMinDist(min, max, pos);
+			if(mindist > (counting ? radius : std::min(radius, result.mindist))) {
+				continue;
+			}
+			
+			if(counting && getMaxDist(min, max, pos) <= radius) {
+				long na = long(ca.end - ca.begin);
+				long nb = long(cb.end - cb.begin);
+				result.count2 += (a == b) ? na * (na - 1) : 2 * na * nb;
+				if(mindist > result.mindist) {
+					continue;
+				}
+				counting = false;
+			}
+			
+			for(size_t i = ca.begin; i < ca.end; i++) {
+				const Vec3f & v = vertices[order[i]].v;
+				for(size_t j = (a == b) ? i + 1 : cb.begin; j < cb.end; j++) {
+					Vec3f posi = (v + vertices[order[j]].v) * 0.5f;
+					float dist = fdist(pos, posi);
+					if(dist <= radius) {
+						if(counting) {
+							// Both (i, j) and (j, i)
+							result.count2 += 2;
+						}
+						if(dist < result.mindist) {
+							result.mindist = dist;
+						}
+					}
+				}
+			}
+			
+		}
+	}
+	
+	result.count2 = std::min(result.count2, maxCount2);
+	
+	return result;
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARX_GAME_DAMAGEAREA_H
+#define ARX_GAME_DAMAGEAREA_H
+
+#include <stddef.h>
+
+#include "math/Types.h"
+
+struct EERIE_VERTEX;
+
+//! How much of a mesh is inside the sphere of an area damage
+struct DamageAreaOverlap {
+	
+	//! Number of vertices inside the sphere
+	long count;
+	
+	/*!
+	 * Number of ordered vertex pairs whose midpoint is inside the sphere.
+	 * Pairs are only sampled for meshes with less than 120 vertices, and counting stops
+	 * once the number of vertices is reached as the damage ratio is capped there.
+	 */
+	long count2;
+	
+	//! Distance to the closest vertex or midpoint inside the sphere, or the largest float
+	float mindist;
+	
+};
+
+/*!
+ * Measure the overlap of a mesh with a damage sphere for DoSphericDamage().
+ *
+ * Vertices are tested in a single pass. Vertex pairs are tested in clusters of nearby
+ * vertices: pairs of clusters whose midpoints are all outside the sphere (or farther away
+ * than the closest point found so far) are skipped, and pairs of clusters whose midpoints
+ * are all inside the sphere are counted without testing the individual pairs.
+ *
+ * The results are the same as testing each vertex and each pair of vertices.
+ */
+DamageAreaOverlap ARX_DAMAGES_GetAreaOverlap(const EERIE_VERTEX * vertices, size_t count,
+                                             const Vec3f & pos, float radius);
+
+#endif // ARX_GAME_DAMAGEAREA_H
@@ -53,6 +53,7 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include "core/Core.h"
 
 #include "game/Camera.h"
+#include "game/EntityGrid.h"
 #include "game/EntityManager.h"
 #include "game/Inventory.h"
 #include "game/Item.h"
@@ -75,6 +76,7 @@ Entity::Entity(const res::path & classPath)
 	  m_classPath(classPath) {
 	
 	m_index = entities.add(this);
+	entityGrid.add(m_index);
 	
 	ioflags = 0;
 	lastpos = Vec3f_ZERO;
@@ -294,6 +296,7 @@ Entity::~Entity() {
 	free(inventory);
 	
 	if(m_index != size_t(-1)) {
+		entityGrid.remove(m_index);
 		entities.remove(m_index);
 	}
 	
@@ -0,0 +1,264 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "game/EntityGrid.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "game/Entity.h"
+#include "game/EntityManager.h"
+#include "graphics/data/Mesh.h"
+#include "math/Vector.h"
+
+EntityGrid entityGrid;
+
+const float EntityGrid::CellSize = 256.f;
+const float EntityGrid::Margin = 100.f;
+
+//! Entities covering more cells are not stored in the grid but returned by every query
+static const int MaxEntityCells = 64;
+
+//! Queries covering more cells check all entities instead
+static const int MaxQueryCells = 256;
+
+EntityGrid::EntityGrid() { }
+
+int EntityGrid::getCell(float pos) {
+	float cell = std::floor(pos * (1.f / CellSize));
+	return int(std::max(-32768.f, std::min(cell, 32767.f)));
+}
+
+EntityGrid::CellKey EntityGrid::getKey(int x, int z) {
+	return (CellKey(x + 32768) << 16) | CellKey(z + 32768);
+}
+
+void EntityGrid::clear() {
+	m_entries.clear();
+	m_cells.clear();
+	m_unbounded.clear();
+}
+
+void EntityGrid::sync() {
+	
+	for(Cells::iterator it = m_cells.begin(); it != m_cells.end(); ++it) {
+		it->second.clear();
+	}
+	m_unbounded.clear();
+	
+	m_entries.assign(entities.size(), Entry());
+	
+	for(size_t i = 0; i < entities.size(); i++) {
+		if(entities[i]) {
+			link(i, entities[i]);
+		}
+	}
+}
+
+void EntityGrid::add(size_t index) {
+	
+	if(index >= m_entries.size()) {
+		m_entries.resize(index + 1);
+	}
+	
+	unlink(index);
+	
+	m_entries[index] = Entry();
+	m_entries[index].indexed = true;
+	m_entries[index].unbounded = true;
+	m_unbounded.push_back(index);
+}
+
+void EntityGrid::update(const Entity * io) {
+	
+	size_t index = io->index();
+	if(index >= m_entries.size()) {
+		m_entries.resize(index + 1);
+	}
+	
+	unlink(index);
+	link(index, io);
+}
+
+void EntityGrid::remove(size_t index) {
+	
+	if(index >= m_entries.size()) {
+		return;
+	}
+	
+	unlink(index);
+	m_entries[index] = Entry();
+}
+
+void EntityGrid::link(size_t index, const Entity * io) {
+	
+	Entry & entry = m_entries[index];
+	
+	entry.io = io;
+	entry.obj = io->obj;
+	entry.vertexCount = 0;
+	
+	entry.minx = entry.maxx = io->pos.x;
+	entry.minz = entry.maxz = io->pos.z;
+	
+	if(io->obj && !io->obj->vertexlist3.empty()) {
+		
+		const std::vector<EERIE_VERTEX> & vlist = io->obj->vertexlist3;
+		entry.vertexCount = vlist.size();
+		
+		entry.vertices.reset();
+		for(size_t i = 0; i < vlist.size(); i++) {
+			entry.vertices.add(vlist[i].v);
+		}
+		
+		entry.minx = std::min(entry.minx, entry.vertices.min.x);
+		entry.minz = std::min(entry.minz, entry.vertices.min.z);
+		entry.maxx = std::max(entry.maxx, entry.vertices.max.x);
+		entry.maxz = std::max(entry.maxz, entry.vertices.max.z);
+	}
+	
+	entry.minx -= Margin, entry.minz -= Margin;
+	entry.maxx += Margin, entry.maxz += Margin;
+	
+	entry.indexed = true;
+	
+	// This also catches invalid (NaN) positions.
+	if(!(entry.minx <= entry.maxx && entry.minz <= entry.maxz)) {
+		entry.unbounded = true;
+		m_unbounded.push_back(index);
+		return;
+	}
+	
+	entry.cellMinX = getCell(entry.minx), entry.cellMaxX = getCell(entry.maxx);
+	entry.cellMinZ = getCell(entry.minz), entry.cellMaxZ = getCell(entry.maxz);
+	
+	int count = (entry.cellMaxX - entry.cellMinX + 1) * (entry.cellMaxZ - entry.cellMinZ + 1);
+	if(count > MaxEntityCells) {
+		entry.unbounded = true;
+		m_unbounded.push_back(index);
+		return;
+	}
+	
+	entry.unbounded = false;
+	for(int z = entry.cellMinZ; z <= entry.cellMaxZ; z++) {
+		for(int x = entry.cellMinX; x <= entry.cellMaxX; x++) {
+			m_cells[getKey(x, z)].push_back(index);
+		}
+	}
+}
+
+void EntityGrid::unlink(size_t index) {
+	
+	Entry & entry = m_entries[index];
+	if(!entry.indexed) {
+		return;
+	}
+	entry.indexed = false;
+	
+	if(entry.unbounded) {
+		std::vector<size_t>::iterator it = std::find(m_unbounded.begin(), m_unbounded.end(), index);
+		if(it != m_unbounded.end()) {
+			*it = m_unbounded.back();
+			m_unbounded.pop_back();
+		}
+		return;
+	}
+	
+	for(int z = entry.cellMinZ; z <= entry.cellMaxZ; z++) {
+		for(int x = entry.cellMinX; x <= entry.cellMaxX; x++) {
+			Cells::iterator cell = m_cells.find(getKey(x, z));
+			if(cell == m_cells.end()) {
+				continue;
+			}
+			Cell::iterator it = std::find(cell->second.begin(), cell->second.end(), index);
+			if(it != cell->second.end()) {
+				*it = cell->second.back();
+				cell->second.pop_back();
+			}
+		}
+	}
+}
+
+void EntityGrid::query(const Vec3f & center, float radius, std::vector<size_t> & result) const {
+	
+	result.clear();
+	
+	float radius2 = radius * radius;
+	
+	int minx = getCell(center.x - radius), maxx = getCell(center.x + radius);
+	int minz = getCell(center.z - radius), maxz = getCell(center.z + radius);
+	
+	bool scan = !(radius >= 0.f) || (maxx - minx + 1) * (maxz - minz + 1) > MaxQueryCells;
+	
+	if(scan) {
+		// Not worth looking up the individual cells.
+		for(size_t i = 0; i < m_entries.size(); i++) {
+			if(m_entries[i].indexed) {
+				result.push_back(i);
+			}
+		}
+		return;
+	}
+	
+	for(int z = minz; z <= maxz; z++) {
+		for(int x = minx; x <= maxx; x++) {
+			
+			Cells::const_iterator cell = m_cells.find(getKey(x, z));
+			if(cell == m_cells.end()) {
+				continue;
+			}
+			
+			for(Cell::const_iterator it = cell->second.begin(); it != cell->second.end(); ++it) {
+				const Entry & entry = m_entries[*it];
+				float dx = std::max(0.f, std::max(entry.minx - center.x, center.x - entry.maxx));
+				float dz = std::max(0.f, std::max(entry.minz - center.z, center.z - entry.maxz));
+				if(dx * dx + dz * dz <= radius2) {
+					result.push_back(*it);
+				}
+			}
+			
+		}
+	}
+	
+	result.insert(result.end(), m_unbounded.begin(), m_unbounded.end());
+	
+	std::sort(result.begin(), result.end());
+	result.erase(std::unique(result.begin(), result.end()), result.end());
+}
+
+bool EntityGrid::mayTouch(const Entity * io, const Vec3f & center, float radius) const {
+	
+	size_t index = io->index();
+	if(index >= m_entries.size()) {
+		return true;
+	}
+	
+	const Entry & entry = m_entries[index];
+	if(!entry.indexed || entry.io != io || entry.obj != io->obj || !entry.vertexCount
+	   || !io->obj || entry.vertexCount != io->obj->vertexlist3.size()) {
+		return true;
+	}
+	
+	Vec3f d = glm::max(Vec3f_ZERO, glm::max(entry.vertices.min - center, center - entry.vertices.max));
+	
+	// Leave some room for rounding differences with the exact per-vertex tests.
+	float limit = radius + 1.f;
+	
+	return d.x * d.x + d.y * d.y + d.z * d.z <= limit * limit;
+}
@@ -0,0 +1,133 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARX_GAME_ENTITYGRID_H
+#define ARX_GAME_ENTITYGRID_H
+
+#include <stddef.h>
+#include <vector>
+
+#include <boost/unordered_map.hpp>
+
+#include "graphics/BaseGraphicsTypes.h"
+#include "math/Types.h"
+#include "platform/Platform.h"
+
+class Entity;
+struct EERIE_3DOBJ;
+
+/*!
+ * Uniform grid over the horizontal (x/z) positions of all entities.
+ *
+ * Each entity is stored in every cell touched by the bounding box of its position and its
+ * world-space vertices (vertexlist3), enlarged by a margin so that entities that move a
+ * little between updates are still found.
+ *
+ * The grid is rebuilt once per frame by sync(). Code that moves the vertices of an entity
+ * in between (rendering, teleporting) calls update() for that entity. Entities created
+ * after the last sync() are returned by every query until the next one.
+ */
+class EntityGrid {
+	
+public:
+	
+	//! Size of a grid cell
+	static const float CellSize;
+	
+	//! How far an entity may move between two updates and still be found
+	static const float Margin;
+	
+	EntityGrid();
+	
+	void clear();
+	
+	//! Re-index all entities
+	void sync();
+	
+	//! Register a new entity that has no position yet
+	void add(size_t index);
+	
+	//! Re-index one entity after its position or vertices changed
+	void update(const Entity * io);
+	
+	//! Forget an entity that is being destroyed
+	void remove(size_t index);
+	
+	/*!
+	 * Find all entities that may be horizontally closer than radius to center.
+	 *
+	 * This includes every entity with a position or vertex within the radius, but
+	 * may contain other entities as well.
+	 *
+	 * @param result receives the entity indices in ascending order
+	 */
+	void query(const Vec3f & center, float radius, std::vector<size_t> & result) const;
+	
+	/*!
+	 * Check if any of the world-space vertices of an entity (or any point inside their
+	 * bounding box) can be closer than radius to center.
+	 * Always returns true for entities that have not been indexed yet.
+	 */
+	bool mayTouch(const Entity * io, const Vec3f & center, float radius) const;
+	
+private:
+	
+	typedef u32 CellKey;
+	typedef std::vector<size_t> Cell;
+	typedef boost::unordered_map<CellKey, Cell> Cells;
+	
+	struct Entry {
+		
+		const Entity * io;
+		const EERIE_3DOBJ * obj;
+		size_t vertexCount;
+		
+		//! Bounding box of the world-space vertices, valid if vertexCount is not zero
+		EERIE_3D_BBOX vertices;
+		
+		//! Horizontal area covered by the entity, including the margin
+		float minx, minz, maxx, maxz;
+		
+		//! Range of cells the entity is stored in
+		int cellMinX, cellMinZ, cellMaxX, cellMaxZ;
+		
+		bool indexed;
+		bool unbounded;
+		
+		Entry() : io(NULL), obj(NULL), vertexCount(0), indexed(false), unbounded(false) { }
+		
+	};
+	
+	static int getCell(float pos);
+	static CellKey getKey(int x, int z);
+	
+	void link(size_t index, const Entity * io);
+	void unlink(size_t index);
+	
+	std::vector<Entry> m_entries;
+	Cells m_cells;
+	
+	//! Entities that are returned by all queries
+	std::vector<size_t> m_unbounded;
+	
+};
+
+extern EntityGrid entityGrid;
+
+#endif // ARX_GAME_ENTITYGRID_H
@@ -51,6 +51,31 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 
 EntityManager entities;
 
+/*!
+ * Parse the instance number of an entity name, as formatted by Entity::long_name().
+ * Only accepts the exact representation: at least four digits, with no additional
+ * leading zeros.
+ */
+static bool parseIdent(const std::string & name, size_t start, long & ident) {
+	
+	size_t digits = name.length() - start;
+	
+	// Larger instance numbers are never created.
+	if(digits < 4 || digits > 9 || (digits > 4 && name[start] == '0')) {
+		return false;
+	}
+	
+	ident = 0;
+	for(size_t i = start; i < name.length(); i++) {
+		if(name[i] < '0' || name[i] > '9') {
+			return false;
+		}
+		ident = ident * 10 + (name[i] - '0');
+	}
+	
+	return true;
+}
+
 EntityManager::EntityManager() : minfree(0) { }
 
 EntityManager::~EntityManager() {
@@ -68,6 +93,7 @@ void EntityManager::init() {
 	arx_assert(size() == 0);
 	entries.resize(1);
 	entries[0] = NULL;
+	generations.resize(1);
 	minfree = 0;
 }
 
@@ -93,16 +119,25 @@ long EntityManager::getById(const std::string & name) const {
 		return 0; // player is an IO with index 0
 	}
 	
-	for(size_t i = 0 ; i < size() ; i++) {
-		if(entries[i] != NULL && entries[i]->ident > -1) {
-			// TODO this check is inefficient!
-			if(name == entries[i]->long_name()) {
-				return i;
-			}
+	// Entity names are the class name followed by the instance number, see Entity::long_name()
+	size_t sep = name.find_last_of('_');
+	long ident;
+	if(sep == std::string::npos || !parseIdent(name, sep + 1, ident)) {
+		return -1;
+	}
+	
+	typedef std::pair<ClassIndex::const_iterator, ClassIndex::const_iterator> Range;
+	Range range = classes.equal_range(name.substr(0, sep));
+	
+	// Instance numbers can change after the entity has been added, so check them here.
+	long index = -1;
+	for(ClassIndex::const_iterator it = range.first; it != range.second; ++it) {
+		if(entries[it->second]->ident == ident && (index == -1 || long(it->second) < index)) {
+			index = long(it->second);
 		}
 	}
 	
-	return -1;
+	return index;
 }
 
 Entity * EntityManager::getById(const std::string & name, Entity * self) const {
@@ -110,19 +145,36 @@ Entity * EntityManager::getById(const std::string & name, Entity * self) const {
 	return (index == -1) ? NULL : (index == -2) ? self : entries[index]; 
 }
 
+EntityHandle EntityManager::getHandle(const Entity * entity) const {
+	
+	if(!contains(entity)) {
+		return EntityHandle();
+	}
+	
+	return EntityHandle(entity->index(), generations[entity->index()]);
+}
+
 size_t EntityManager::add(Entity * entity) {
 	
-	for(size_t i = minfree; i < size(); i++) {
-		if(entries[i] == NULL) {
-			entries[i] = entity;
-			minfree = i + 1;
-			return i;
+	size_t i = minfree;
+	while(i < size() && entries[i] != NULL) {
+		i++;
+	}
+	
+	if(i == size()) {
+		entries.push_back(entity);
+		if(generations.size() < size()) {
+			generations.push_back(0);
 		}
+	} else {
+		entries[i] = entity;
 	}
 	
-	size_t i = size();
-	entries.push_back(entity);
 	minfree = i + 1;
+	
+	classes.insert(std::make_pair(entity->short_name(), i));
+	addresses.insert(entity);
+	
 	return i;
 }
 
@@ -136,5 +188,17 @@ void EntityManager::remove(size_t index) {
 		minfree = index;
 	}
 	
+	typedef std::pair<ClassIndex::iterator, ClassIndex::iterator> Range;
+	Range range = classes.equal_range(entries[index]->short_name());
+	for(ClassIndex::iterator it = range.first; it != range.second; ++it) {
+		if(it->second == index) {
+			classes.erase(it);
+			break;
+		}
+	}
+	
+	addresses.erase(entries[index]);
+	generations[index]++;
+	
 	entries[index] = NULL;
 }
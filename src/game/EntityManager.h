@@ -24,8 +24,28 @@
 #include <string>
 #include <vector>
 
+#include <boost/unordered_map.hpp>
+#include <boost/unordered_set.hpp>
+
 class Entity;
 
+/*!
+ * Weak reference to an entity.
+ *
+ * Unlike raw pointers or indices, handles are not affected by aliasing when an entity is
+ * freed and its memory or index is reused for a new entity.
+ */
+struct EntityHandle {
+	
+	size_t index;
+	unsigned generation;
+	
+	EntityHandle() : index(size_t(-1)), generation(0) { }
+	
+	EntityHandle(size_t index_, unsigned generation_) : index(index_), generation(generation_) { }
+	
+};
+
 class EntityManager {
 	
 	typedef std::vector<Entity *> Entries;
@@ -45,6 +65,23 @@ public:
 	long getById(const std::string & name) const;
 	Entity * getById(const std::string & name, Entity * self) const;
 	
+	/*!
+	 * Check if a pointer refers to an existing entity.
+	 * The pointer is never dereferenced, so it is safe to pass stale pointers.
+	 */
+	bool contains(const Entity * entity) const {
+		return addresses.find(entity) != addresses.end();
+	}
+	
+	//! Get a weak handle for an entity, or an invalid handle if the entity does not exist
+	EntityHandle getHandle(const Entity * entity) const;
+	
+	//! @return the entity referenced by the handle, or NULL if it has been freed
+	Entity * get(EntityHandle handle) const {
+		return (handle.index < size() && generations[handle.index] == handle.generation)
+		       ? entries[handle.index] : NULL;
+	}
+	
 	Entity * operator[](size_t index) const {
 		return entries[index];
 	}
@@ -71,9 +108,20 @@ public:
 	
 private:
 	
+	typedef boost::unordered_multimap<std::string, size_t> ClassIndex;
+	typedef boost::unordered_set<const Entity *> Addresses;
+	
 	Entries entries;
 	size_t minfree; // first unused index (value == NULL)
 	
+	//! Incremented each time an index is freed to invalidate handles, never shrinks
+	std::vector<unsigned> generations;
+	
+	//! Maps class names (Entity::short_name()) to the indices of entities of that class
+	ClassIndex classes;
+	
+	Addresses addresses;
+	
 	size_t add(Entity * entity);
 	
 	void remove(size_t index);
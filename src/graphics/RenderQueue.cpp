@@ -0,0 +1,274 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "graphics/RenderQueue.h"
+
+#include <algorithm>
+
+#include "core/Application.h"
+#include "graphics/Draw.h"
+#include "graphics/Vertex.h"
+#include "graphics/VertexBuffer.h"
+#include "graphics/texture/TextureStage.h"
+
+RenderQueue g_renderQueue;
+
+namespace {
+
+const float LateMipBias = -2.2f;
+
+/*
+ * Sort key layout, from the most significant bit:
+ *  opaque:  0 | texture (24) | state (8) | depth (16) | unused (15)
+ *  blended: 1 | inverted depth (16) | order (3) | source factor (4) | destination factor (4)
+ *             | depth bias (4) | texture (24) | state (8)
+ *
+ * The blend functions used by the transparent passes do not commute, so the pass order
+ * must stay above the blend factors.
+ */
+
+u64 getTextureBits(const TextureContainer * texture) {
+	// Only used to group items, a collision costs at most an extra texture change.
+	return (u64(reinterpret_cast<size_t>(texture)) >> 4) & 0xffffff;
+}
+
+u64 getStateBits(const RenderQueue::Material & material) {
+	return (u64((material.colorOp + 1) & 0xf) << 4) | (u64(material.lateMip) << 2)
+	       | u64(material.blend);
+}
+
+} // anonymous namespace
+
+void RenderQueue::add(const Material & material, float depth, VertexBuffer<SMY_VERTEX> * buffer,
+                      size_t offset, size_t count, unsigned short * indices, size_t nbindices) {
+	
+	arx_assert(buffer != NULL && indices != NULL);
+	
+	Item item;
+	item.material = material;
+	item.buffer = buffer;
+	item.vertices = NULL;
+	item.offset = offset;
+	item.count = count;
+	item.indices = indices;
+	item.nbindices = nbindices;
+	
+	add(item, depth);
+}
+
+void RenderQueue::add(const Material & material, float depth, const TexturedVertex * vertices,
+                      size_t count) {
+	
+	arx_assert(vertices != NULL);
+	
+	Item item;
+	item.material = material;
+	item.buffer = NULL;
+	item.vertices = vertices;
+	item.offset = 0;
+	item.count = count;
+	item.indices = NULL;
+	item.nbindices = 0;
+	
+	add(item, depth);
+}
+
+void RenderQueue::add(const Item & item, float depth) {
+	
+	SortEntry entry;
+	entry.key = getSortKey(item.material, depth);
+	entry.item = u32(items.size());
+	
+	items.push_back(item);
+	entries.push_back(entry);
+}
+
+u64 RenderQueue::getSortKey(const Material & material, float depth) const {
+	
+	arx_assert(maxDepth > 0.f);
+	
+	float normalized = std::min(std::max(depth / maxDepth, 0.f), 1.f);
+	u64 depthBits = u64(normalized * 65535.f);
+	
+	u64 textureBits = getTextureBits(material.texture);
+	u64 stateBits = getStateBits(material);
+	
+	if(material.blend != Blending) {
+		return (textureBits << 38) | (stateBits << 30) | (depthBits << 14);
+	}
+	
+	arx_assert(material.order <= MaxOrder);
+	
+	return (u64(1) << 63) | ((0xffff - depthBits) << 47) | (u64(material.order) << 44)
+	       | (u64(material.blendSrc & 0xf) << 40) | (u64(material.blendDst & 0xf) << 36)
+	       | (u64((material.depthBias + 1) & 0xf) << 32) | (textureBits << 8) | stateBits;
+}
+
+void RenderQueue::sort() {
+	
+	size_t count = entries.size();
+	if(count < 2) {
+		return;
+	}
+	
+	// Bytes that are the same in all keys do not change the order and can be skipped.
+	u64 first = entries[0].key;
+	u64 differences = 0;
+	for(size_t i = 1; i < count; i++) {
+		differences |= entries[i].key ^ first;
+	}
+	
+	scratch.resize(count);
+	SortEntry * src = &entries[0];
+	SortEntry * dst = &scratch[0];
+	
+	// Stable LSD radix sort, one byte at a time
+	for(unsigned shift = 0; shift < 64; shift += 8) {
+		
+		if(((differences >> shift) & 0xff) == 0) {
+			continue;
+		}
+		
+		size_t offsets[256];
+		std::fill_n(offsets, 256, 0);
+		for(size_t i = 0; i < count; i++) {
+			offsets[(src[i].key >> shift) & 0xff]++;
+		}
+		
+		size_t total = 0;
+		for(size_t digit = 0; digit < 256; digit++) {
+			size_t size = offsets[digit];
+			offsets[digit] = total;
+			total += size;
+		}
+		
+		for(size_t i = 0; i < count; i++) {
+			dst[offsets[(src[i].key >> shift) & 0xff]++] = src[i];
+		}
+		
+		std::swap(src, dst);
+	}
+	
+	if(src != &entries[0]) {
+		entries.swap(scratch);
+	}
+}
+
+void RenderQueue::flush() {
+	
+	sort();
+	
+	current = Material();
+	textureKnown = false;
+	blendFuncKnown = false;
+	
+	for(size_t i = 0; i < entries.size(); i++) {
+		
+		const Item & item = items[entries[i].item];
+		
+		apply(item.material);
+		
+		if(item.buffer) {
+			item.buffer->drawIndexed(Renderer::TriangleList, item.count, item.offset,
+			                         item.indices, item.nbindices);
+		} else {
+			EERIEDRAWPRIM(Renderer::TriangleList, item.vertices, item.count);
+		}
+	}
+	
+	if(current.lateMip) {
+		GRenderer->GetTextureStage(0)->setMipMapLODBias(0.f);
+	}
+	
+	stats.items += items.size();
+	items.clear();
+	entries.clear();
+}
+
+void RenderQueue::apply(const Material & material) {
+	
+	bool changed = !textureKnown || material.texture != current.texture;
+	if(changed) {
+		if(material.texture) {
+			GRenderer->SetTexture(0, material.texture);
+		} else {
+			GRenderer->ResetTexture(0);
+		}
+		current.texture = material.texture;
+		textureKnown = true;
+	}
+	countChange(changed);
+	
+	if(material.blend != KeepBlending) {
+		changed = (material.blend != current.blend);
+		if(changed) {
+			bool enable = (material.blend == Blending);
+			GRenderer->SetRenderState(Renderer::AlphaBlending, enable);
+			GRenderer->SetRenderState(Renderer::DepthWrite, !enable);
+			current.blend = material.blend;
+		}
+		countChange(changed);
+		countChange(changed);
+	}
+	
+	if(material.blend == Blending) {
+		changed = !blendFuncKnown || material.blendSrc != current.blendSrc
+		          || material.blendDst != current.blendDst;
+		if(changed) {
+			GRenderer->SetBlendFunc(material.blendSrc, material.blendDst);
+			current.blendSrc = material.blendSrc;
+			current.blendDst = material.blendDst;
+			blendFuncKnown = true;
+		}
+		countChange(changed);
+	}
+	
+	if(material.depthBias != KeepState) {
+		changed = (material.depthBias != current.depthBias);
+		if(changed) {
+			SetZBias(material.depthBias);
+			current.depthBias = material.depthBias;
+		}
+		countChange(changed);
+	}
+	
+	if(material.colorOp != KeepState) {
+		changed = (material.colorOp != current.colorOp);
+		if(changed) {
+			GRenderer->GetTextureStage(0)->setColorOp(TextureStage::TextureOp(material.colorOp));
+			current.colorOp = material.colorOp;
+		}
+		countChange(changed);
+	}
+	
+	// The bias is only changed for items that need it and reset afterwards.
+	if(material.lateMip != current.lateMip) {
+		GRenderer->GetTextureStage(0)->setMipMapLODBias(material.lateMip ? LateMipBias : 0.f);
+		current.lateMip = material.lateMip;
+		countChange(true);
+	}
+}
+
+void RenderQueue::countChange(bool changed) {
+	if(changed) {
+		stats.stateChanges++;
+	} else {
+		stats.savedStateChanges++;
+	}
+}
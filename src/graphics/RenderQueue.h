@@ -0,0 +1,172 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARX_GRAPHICS_RENDERQUEUE_H
+#define ARX_GRAPHICS_RENDERQUEUE_H
+
+#include <stddef.h>
+#include <vector>
+
+#include "graphics/Renderer.h"
+#include "platform/Platform.h"
+
+class TextureContainer;
+struct TexturedVertex;
+struct SMY_VERTEX;
+template <class Vertex> class VertexBuffer;
+
+/*!
+ * Draw calls that are sorted by a packed 64-bit key before they are submitted.
+ *
+ * Opaque items are grouped by texture and state and then ordered front to back.
+ * Blended items are drawn after all opaque items, back to front, then in the pass order
+ * given by Material::order, and only then grouped by blend function and texture.
+ * Blended items are only ordered by the depth they are added with: the scene passes one
+ * depth per room, so back to front holds between rooms but not between the polygons of
+ * a room.
+ *
+ * While submitting, the state of the previous item is remembered so that only the
+ * render state, blend function and texture changes that are actually needed reach the
+ * renderer. Nothing is assumed about the renderer state when flush() starts.
+ *
+ * Items only store pointers to the vertex and index data, which must stay valid until
+ * the queue is flushed.
+ */
+class RenderQueue {
+	
+public:
+	
+	//! Value for Material::depthBias and Material::colorOp to leave the state unchanged
+	static const int KeepState = -1;
+	
+	//! Largest value for Material::order
+	static const unsigned MaxOrder = 7;
+	
+	enum BlendState {
+		KeepBlending, //!< Leave alpha blending and depth writes as they are
+		NoBlending,   //!< Disable alpha blending, enable depth writes
+		Blending      //!< Enable alpha blending with the material's blend function, disable depth writes
+	};
+	
+	struct Material {
+		
+		TextureContainer * texture; //!< Texture for stage 0 or NULL to draw untextured
+		
+		BlendState blend;
+		Renderer::PixelBlendingFactor blendSrc;
+		Renderer::PixelBlendingFactor blendDst;
+		
+		//! Blended items at the same depth are drawn in increasing order (0 to MaxOrder)
+		unsigned order;
+		
+		int depthBias; //!< Passed to SetZBias() or KeepState
+		int colorOp; //!< TextureStage::TextureOp for stage 0 or KeepState
+		
+		bool lateMip; //!< Sharpen the texture with a negative mipmap LOD bias (POLY_LATE_MIP)
+		
+		explicit Material(TextureContainer * _texture = NULL)
+			: texture(_texture), blend(KeepBlending),
+			  blendSrc(Renderer::BlendOne), blendDst(Renderer::BlendZero), order(0),
+			  depthBias(KeepState), colorOp(KeepState), lateMip(false) { }
+		
+		void setBlendFunc(Renderer::PixelBlendingFactor src, Renderer::PixelBlendingFactor dst) {
+			blend = Blending, blendSrc = src, blendDst = dst;
+		}
+		
+	};
+	
+	struct Stats {
+		
+		size_t items;
+		size_t stateChanges; //!< State changes sent to the renderer
+		size_t savedStateChanges; //!< State changes skipped because they were already set
+		
+		Stats() : items(0), stateChanges(0), savedStateChanges(0) { }
+		
+	};
+	
+	RenderQueue() : maxDepth(1.f), textureKnown(false), blendFuncKnown(false) { }
+	
+	/*!
+	 * Set the distance from the camera that maps to the back of the depth range.
+	 * Items that are further away are sorted as if they were at this distance.
+	 */
+	void setMaxDepth(float depth) { maxDepth = depth; }
+	
+	//! Queue indexed triangles from a vertex buffer
+	void add(const Material & material, float depth, VertexBuffer<SMY_VERTEX> * buffer,
+	         size_t offset, size_t count, unsigned short * indices, size_t nbindices);
+	
+	//! Queue a triangle list
+	void add(const Material & material, float depth, const TexturedVertex * vertices, size_t count);
+	
+	bool empty() const { return items.empty(); }
+	
+	//! Sort and draw all queued items and clear the queue.
+	void flush();
+	
+	//! Counters since the last call to resetStats()
+	const Stats & getStats() const { return stats; }
+	void resetStats() { stats = Stats(); }
+	
+private:
+	
+	struct Item {
+		
+		Material material;
+		
+		VertexBuffer<SMY_VERTEX> * buffer; //!< NULL to draw vertices directly
+		const TexturedVertex * vertices;
+		size_t offset;
+		size_t count;
+		unsigned short * indices;
+		size_t nbindices;
+		
+	};
+	
+	struct SortEntry {
+		u64 key;
+		u32 item;
+	};
+	
+	void add(const Item & item, float depth);
+	u64 getSortKey(const Material & material, float depth) const;
+	void sort();
+	void apply(const Material & material);
+	void countChange(bool changed);
+	
+	float maxDepth;
+	
+	// Renderer state set by the items submitted so far in flush()
+	Material current;
+	bool textureKnown;
+	bool blendFuncKnown;
+	
+	std::vector<Item> items;
+	std::vector<SortEntry> entries;
+	std::vector<SortEntry> scratch;
+	
+	Stats stats;
+	
+};
+
+//! Queue shared by the scene and entity rendering code
+extern RenderQueue g_renderQueue;
+
+#endif // ARX_GRAPHICS_RENDERQUEUE_H
@@ -0,0 +1,279 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "graphics/VertexLighting.h"
+
+#include <cmath>
+
+#include "graphics/Math.h"
+#include "platform/Architecture.h"
+#include "platform/Platform.h"
+#include "scene/Light.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+// SSE2 is enabled for the whole build
+#include <emmintrin.h>
+#define ARX_HAVE_SSE2 1
+#define ARX_SSE2_TARGET
+#elif ARX_ARCH == ARX_ARCH_X86 && ARX_COMPILER_MSVC
+// SSE2 intrinsics can be used without /arch:SSE2, but the CPU must be checked at runtime
+#include <emmintrin.h>
+#include <intrin.h>
+#define ARX_HAVE_SSE2 1
+#define ARX_HAVE_SSE2_CPUID 1
+#define ARX_SSE2_TARGET
+#elif ARX_ARCH == ARX_ARCH_X86 && (defined(__clang__) \
+      || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+// Only accumulateSSE2() is compiled for SSE2, the CPU must be checked at runtime
+#include <cpuid.h>
+#include <emmintrin.h>
+#define ARX_HAVE_SSE2 1
+#define ARX_HAVE_SSE2_CPUID 1
+#define ARX_SSE2_TARGET __attribute__((target("sse2")))
+#else
+#define ARX_HAVE_SSE2 0
+#endif
+
+#ifndef ARX_HAVE_SSE2_CPUID
+#define ARX_HAVE_SSE2_CPUID 0
+#endif
+
+#if ARX_HAVE_SSE2_CPUID
+static bool cpuHasSSE2() {
+#if ARX_COMPILER_MSVC
+	int info[4];
+	__cpuid(info, 1);
+	return (info[3] & (1 << 26)) != 0;
+#else
+	unsigned int eax, ebx, ecx, edx;
+	return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (edx & bit_SSE2);
+#endif
+}
+#endif
+
+bool VertexLighting::isSupported(Implementation implementation) {
+	switch(implementation) {
+		case Scalar: return true;
+		case SSE2: {
+#if ARX_HAVE_SSE2_CPUID
+			static const bool supported = cpuHasSSE2();
+			return supported;
+#else
+			return ARX_HAVE_SSE2;
+#endif
+		}
+	}
+	return false;
+}
+
+VertexLighting::VertexLighting()
+	: m_implementation(isSupported(SSE2) ? SSE2 : Scalar), m_count(0) { }
+
+void VertexLighting::setImplementation(Implementation implementation) {
+	m_implementation = isSupported(implementation) ? implementation : Scalar;
+}
+
+void VertexLighting::setLights(EERIE_LIGHT * const * lights, size_t count) {
+	
+	m_lx.clear(), m_ly.clear(), m_lz.clear();
+	m_fallstart.clear(), m_fallend.clear(), m_falldiffmul.clear(), m_precalc.clear();
+	m_lr.clear(), m_lg.clear(), m_lb.clear();
+	
+	for(size_t i = 0; i < count && lights[i]; i++) {
+		const EERIE_LIGHT & light = *lights[i];
+		m_lx.push_back(light.pos.x);
+		m_ly.push_back(light.pos.y);
+		m_lz.push_back(light.pos.z);
+		m_fallstart.push_back(light.fallstart);
+		m_fallend.push_back(light.fallend);
+		m_falldiffmul.push_back(light.falldiffmul);
+		m_precalc.push_back(light.precalc);
+		m_lr.push_back(light.rgb255.r);
+		m_lg.push_back(light.rgb255.g);
+		m_lb.push_back(light.rgb255.b);
+	}
+}
+
+void VertexLighting::add(const EERIE_QUAT * quat, const Vec3f & position, const Vec3f & normal) {
+	
+	if(m_count == m_px.size()) {
+		size_t size = m_count + 4;
+		m_px.resize(size), m_py.resize(size), m_pz.resize(size);
+		m_nx.resize(size), m_ny.resize(size), m_nz.resize(size);
+		m_r.resize(size), m_g.resize(size), m_b.resize(size);
+	}
+	
+	// dot(normal, inverse(quat) * v) == dot(quat * normal, v)
+	Vec3f rotated = TransformVertexQuat(*quat, normal);
+	
+	m_px[m_count] = position.x, m_py[m_count] = position.y, m_pz[m_count] = position.z;
+	m_nx[m_count] = rotated.x, m_ny[m_count] = rotated.y, m_nz[m_count] = rotated.z;
+	
+	m_count++;
+}
+
+void VertexLighting::apply(const ColorMod & colorMod, float materialDiffuse, ColorBGRA * colors) {
+	
+	for(size_t i = 0; i < m_count; i++) {
+		m_r[i] = colorMod.ambientColor.r;
+		m_g[i] = colorMod.ambientColor.g;
+		m_b[i] = colorMod.ambientColor.b;
+	}
+	
+	// accumulateSSE2() also lights the padding after the last vertex, which may still hold
+	// old data. Repeat the last position so that the padding computes nothing the real
+	// vertices don't, and use a zero normal so that no light is visible there.
+	size_t padded = (m_count + 3) & ~size_t(3);
+	for(size_t i = m_count; i < padded; i++) {
+		m_px[i] = m_px[m_count - 1], m_py[i] = m_py[m_count - 1], m_pz[i] = m_pz[m_count - 1];
+		m_nx[i] = m_ny[i] = m_nz[i] = 0.f;
+		m_r[i] = m_g[i] = m_b[i] = 0.f;
+	}
+	
+	if(m_implementation == SSE2) {
+		accumulateSSE2(materialDiffuse);
+	} else {
+		accumulateScalar(materialDiffuse);
+	}
+	
+	for(size_t i = 0; i < m_count; i++) {
+		
+		Color3f tempColor(m_r[i], m_g[i], m_b[i]);
+		tempColor *= colorMod.factor;
+		tempColor += colorMod.term;
+		
+		u8 ir = clipByte255(tempColor.r);
+		u8 ig = clipByte255(tempColor.g);
+		u8 ib = clipByte255(tempColor.b);
+		
+		colors[i] = (0xFF000000L | (ir << 16) | (ig << 8) | (ib));
+	}
+}
+
+void VertexLighting::accumulateScalar(float materialDiffuse) {
+	
+	for(size_t l = 0; l < m_lx.size(); l++) {
+		for(size_t i = 0; i < m_count; i++) {
+			
+			float dx = m_lx[l] - m_px[i];
+			float dy = m_ly[l] - m_py[i];
+			float dz = m_lz[l] - m_pz[i];
+			
+			float distance2 = dx * dx + dy * dy + dz * dz;
+			float cosangle = (m_nx[i] * dx + m_ny[i] * dy + m_nz[i] * dz) / std::sqrt(distance2);
+			
+			// Same approximation as fdist()
+			float distance = ffsqrt(distance2);
+			
+			// If light visible
+			if(cosangle > 0.f) {
+				
+				// Evaluate its intensity depending on the distance Light<->Object
+				if(distance <= m_fallstart[l]) {
+					cosangle *= m_precalc[l];
+				} else {
+					float p = (m_fallend[l] - distance) * m_falldiffmul[l];
+					if(p <= 0.f) {
+						cosangle = 0.f;
+					} else {
+						cosangle *= p * m_precalc[l];
+					}
+				}
+				
+				cosangle *= materialDiffuse;
+				
+				m_r[i] += m_lr[l] * cosangle;
+				m_g[i] += m_lg[l] * cosangle;
+				m_b[i] += m_lb[l] * cosangle;
+			}
+			
+		}
+	}
+	
+}
+
+#if ARX_HAVE_SSE2
+
+ARX_SSE2_TARGET void VertexLighting::accumulateSSE2(float materialDiffuse) {
+	
+	// Same operations as accumulateScalar(), for four vertices at a time.
+	
+	const __m128 zero = _mm_setzero_ps();
+	const __m128i one = _mm_set1_epi32(0x3f800000);
+	const __m128 diffuse = _mm_set1_ps(materialDiffuse);
+	
+	for(size_t i = 0; i < m_count; i += 4) {
+		
+		const __m128 px = _mm_loadu_ps(&m_px[i]);
+		const __m128 py = _mm_loadu_ps(&m_py[i]);
+		const __m128 pz = _mm_loadu_ps(&m_pz[i]);
+		const __m128 nx = _mm_loadu_ps(&m_nx[i]);
+		const __m128 ny = _mm_loadu_ps(&m_ny[i]);
+		const __m128 nz = _mm_loadu_ps(&m_nz[i]);
+		
+		__m128 r = _mm_loadu_ps(&m_r[i]);
+		__m128 g = _mm_loadu_ps(&m_g[i]);
+		__m128 b = _mm_loadu_ps(&m_b[i]);
+		
+		for(size_t l = 0; l < m_lx.size(); l++) {
+			
+			__m128 dx = _mm_sub_ps(_mm_set1_ps(m_lx[l]), px);
+			__m128 dy = _mm_sub_ps(_mm_set1_ps(m_ly[l]), py);
+			__m128 dz = _mm_sub_ps(_mm_set1_ps(m_lz[l]), pz);
+			
+			__m128 distance2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)),
+			                              _mm_mul_ps(dz, dz));
+			__m128 cosangle = _mm_div_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, dx), _mm_mul_ps(ny, dy)),
+			                                        _mm_mul_ps(nz, dz)), _mm_sqrt_ps(distance2));
+			
+			__m128i bits = _mm_sub_epi32(_mm_castps_si128(distance2), one);
+			__m128 distance = _mm_castsi128_ps(_mm_add_epi32(_mm_srli_epi32(bits, 1), one));
+			
+			__m128 precalc = _mm_set1_ps(m_precalc[l]);
+			
+			__m128 p = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(m_fallend[l]), distance),
+			                      _mm_set1_ps(m_falldiffmul[l]));
+			__m128 outer = _mm_andnot_ps(_mm_cmple_ps(p, zero), _mm_mul_ps(cosangle, _mm_mul_ps(p, precalc)));
+			__m128 inner = _mm_mul_ps(cosangle, precalc);
+			
+			__m128 isInner = _mm_cmple_ps(distance, _mm_set1_ps(m_fallstart[l]));
+			__m128 factor = _mm_or_ps(_mm_and_ps(isInner, inner), _mm_andnot_ps(isInner, outer));
+			
+			// Lanes where the light is not visible add zero.
+			factor = _mm_and_ps(_mm_cmpgt_ps(cosangle, zero), _mm_mul_ps(factor, diffuse));
+			
+			r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(m_lr[l]), factor));
+			g = _mm_add_ps(g, _mm_mul_ps(_mm_set1_ps(m_lg[l]), factor));
+			b = _mm_add_ps(b, _mm_mul_ps(_mm_set1_ps(m_lb[l]), factor));
+		}
+		
+		_mm_storeu_ps(&m_r[i], r);
+		_mm_storeu_ps(&m_g[i], g);
+		_mm_storeu_ps(&m_b[i], b);
+	}
+	
+}
+
+#else
+
+void VertexLighting::accumulateSSE2(float materialDiffuse) {
+	accumulateScalar(materialDiffuse);
+}
+
+#endif
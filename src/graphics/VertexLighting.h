@@ -0,0 +1,100 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARX_GRAPHICS_VERTEXLIGHTING_H
+#define ARX_GRAPHICS_VERTEXLIGHTING_H
+
+#include <stddef.h>
+#include <vector>
+
+#include "graphics/Color.h"
+#include "math/Types.h"
+
+struct ColorMod;
+struct EERIE_LIGHT;
+struct EERIE_QUAT;
+
+/*!
+ * Batched dynamic lighting for the vertices of animated models.
+ *
+ * Gives the same colors as lighting each vertex separately with the lights selected by
+ * UpdateLlights(), up to rounding differences of at most one unit per channel. Instead of
+ * rotating the direction to each light into model space, the normal of each vertex is
+ * rotated into world space once when it is added.
+ * Light parameters are copied into a structure of arrays once per object, and vertices are
+ * lit in blocks of four.
+ */
+class VertexLighting {
+	
+public:
+	
+	enum Implementation {
+		Scalar,
+		SSE2
+	};
+	
+	//! Check if an implementation is available in this build and on this CPU
+	static bool isSupported(Implementation implementation);
+	
+	//! Create a batch using the fastest supported implementation
+	VertexLighting();
+	
+	void setImplementation(Implementation implementation);
+	Implementation getImplementation() const { return m_implementation; }
+	
+	//! Set the lights to apply - the list ends after count lights or at the first NULL entry
+	void setLights(EERIE_LIGHT * const * lights, size_t count);
+	
+	//! Remove all queued vertices
+	void clear() { m_count = 0; }
+	
+	//! Queue a vertex with a world-space position and a normal that is rotated by quat
+	void add(const EERIE_QUAT * quat, const Vec3f & position, const Vec3f & normal);
+	
+	size_t size() const { return m_count; }
+	
+	/*!
+	 * Light all queued vertices.
+	 * @param colors receives one color for each vertex, in the order the vertices were added
+	 */
+	void apply(const ColorMod & colorMod, float materialDiffuse, ColorBGRA * colors);
+	
+private:
+	
+	//! Accumulate the light contributions for all queued vertices into m_r, m_g and m_b
+	void accumulateScalar(float materialDiffuse);
+	void accumulateSSE2(float materialDiffuse);
+	
+	Implementation m_implementation;
+	
+	size_t m_count;
+	
+	// Vertex data, padded to a multiple of four entries
+	std::vector<float> m_px, m_py, m_pz;
+	std::vector<float> m_nx, m_ny, m_nz;
+	std::vector<float> m_r, m_g, m_b;
+	
+	// Light data
+	std::vector<float> m_lx, m_ly, m_lz;
+	std::vector<float> m_fallstart, m_fallend, m_falldiffmul, m_precalc;
+	std::vector<float> m_lr, m_lg, m_lb;
+	
+};
+
+#endif // ARX_GRAPHICS_VERTEXLIGHTING_H
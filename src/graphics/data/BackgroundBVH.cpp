@@ -0,0 +1,334 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "graphics/data/BackgroundBVH.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "graphics/data/Mesh.h"
+
+namespace {
+
+//! Maximum number of triangles in a leaf node.
+const size_t LeafSize = 4;
+
+//! Enough for any tree built with median splits.
+const size_t MaxDepth = 64;
+
+inline bool hitsBox(const Vec3f & min, const Vec3f & max, const Vec3f & origin,
+                    const Vec3f & invDir, float tmax) {
+	
+	float t1 = (min.x - origin.x) * invDir.x;
+	float t2 = (max.x - origin.x) * invDir.x;
+	float tnear = std::min(t1, t2), tfar = std::max(t1, t2);
+	
+	t1 = (min.y - origin.y) * invDir.y;
+	t2 = (max.y - origin.y) * invDir.y;
+	tnear = std::max(tnear, std::min(t1, t2)), tfar = std::min(tfar, std::max(t1, t2));
+	
+	t1 = (min.z - origin.z) * invDir.z;
+	t2 = (max.z - origin.z) * invDir.z;
+	tnear = std::max(tnear, std::min(t1, t2)), tfar = std::min(tfar, std::max(t1, t2));
+	
+	return tfar >= std::max(tnear, 0.f) && tnear <= tmax;
+}
+
+inline bool overlapsBox(const Vec3f & amin, const Vec3f & amax,
+                        const Vec3f & bmin, const Vec3f & bmax) {
+	return amin.x <= bmax.x && amax.x >= bmin.x
+	       && amin.y <= bmax.y && amax.y >= bmin.y
+	       && amin.z <= bmax.z && amax.z >= bmin.z;
+}
+
+inline float safeInverse(float d) {
+	// Avoid infinities, 0 * inf would give NaN for origins on a slab boundary.
+	const float big = 1e30f;
+	if(d == 0.f) {
+		return big;
+	}
+	return 1.f / d;
+}
+
+} // anonymous namespace
+
+struct BackgroundBVH::BuildItem {
+	
+	Triangle triangle;
+	Vec3f min;
+	Vec3f max;
+	Vec3f center;
+	
+	BuildItem(EERIEPOLY * ep, size_t a, size_t b, size_t c) {
+		const Vec3f & v0 = ep->v[a].p, & v1 = ep->v[b].p, & v2 = ep->v[c].p;
+		triangle.v0 = v0;
+		triangle.e1 = v1 - v0;
+		triangle.e2 = v2 - v0;
+		triangle.poly = ep;
+		triangle.type = ep->type;
+		min = glm::min(glm::min(v0, v1), v2);
+		max = glm::max(glm::max(v0, v1), v2);
+		center = (min + max) * 0.5f;
+	}
+	
+};
+
+namespace {
+
+struct CenterLess {
+	
+	int axis;
+	
+	explicit CenterLess(int _axis) : axis(_axis) { }
+	
+	template <class T>
+	bool operator()(const T & a, const T & b) const {
+		return a.center[axis] < b.center[axis];
+	}
+	
+};
+
+} // anonymous namespace
+
+struct BackgroundBVH::Packet {
+	
+	size_t size;
+	Vec3f origin[MaxPacketSize];
+	Vec3f dir[MaxPacketSize];
+	Vec3f invDir[MaxPacketSize];
+	Hit * hits;
+	
+};
+
+void BackgroundBVH::build(const EERIE_BACKGROUND & bkg) {
+	
+	clear();
+	
+	std::vector<BuildItem> items;
+	for(long i = 0; i < bkg.Xsize * bkg.Zsize; i++) {
+		const EERIE_BKG_INFO & eg = bkg.Backg[i];
+		for(long k = 0; k < eg.nbpoly; k++) {
+			EERIEPOLY * ep = &eg.polydata[k];
+			items.push_back(BuildItem(ep, 0, 1, 2));
+			if(ep->type & POLY_QUAD) {
+				items.push_back(BuildItem(ep, 1, 2, 3));
+			}
+		}
+	}
+	
+	if(items.empty()) {
+		return;
+	}
+	
+	nodes.reserve(2 * (items.size() / LeafSize + 1));
+	nodes.resize(1);
+	build(items, 0, 0, items.size());
+	
+	triangles.reserve(items.size());
+	for(size_t i = 0; i < items.size(); i++) {
+		triangles.push_back(items[i].triangle);
+	}
+}
+
+void BackgroundBVH::build(std::vector<BuildItem> & items, size_t node,
+                          size_t begin, size_t end) {
+	
+	Vec3f min = items[begin].min, max = items[begin].max;
+	Vec3f cmin = items[begin].center, cmax = items[begin].center;
+	for(size_t i = begin + 1; i < end; i++) {
+		min = glm::min(min, items[i].min);
+		max = glm::max(max, items[i].max);
+		cmin = glm::min(cmin, items[i].center);
+		cmax = glm::max(cmax, items[i].center);
+	}
+	nodes[node].min = min;
+	nodes[node].max = max;
+	
+	Vec3f extent = cmax - cmin;
+	int axis = (extent.x >= extent.y && extent.x >= extent.z) ? 0 : (extent.y >= extent.z ? 1 : 2);
+	
+	if(end - begin <= LeafSize || extent[axis] == 0.f) {
+		nodes[node].first = u32(begin);
+		nodes[node].count = u32(end - begin);
+		return;
+	}
+	
+	size_t mid = begin + (end - begin) / 2;
+	std::nth_element(items.begin() + begin, items.begin() + mid, items.begin() + end,
+	                 CenterLess(axis));
+	
+	size_t child = nodes.size();
+	nodes.resize(child + 2);
+	nodes[node].first = u32(child);
+	nodes[node].count = 0;
+	
+	build(items, child, begin, mid);
+	build(items, child + 1, mid, end);
+}
+
+void BackgroundBVH::clear() {
+	nodes.clear();
+	triangles.clear();
+}
+
+BackgroundBVH::Hit BackgroundBVH::intersect(const Vec3f & start, const Vec3f & end,
+                                            PolyType ignore) const {
+	Segment segment;
+	segment.start = start;
+	segment.end = end;
+	Hit hit;
+	intersect(&segment, 1, &hit, ignore);
+	return hit;
+}
+
+void BackgroundBVH::intersect(const Segment * segments, size_t count, Hit * hits,
+                              PolyType ignore) const {
+	
+	for(size_t i = 0; i < count; i++) {
+		hits[i].poly = NULL;
+		hits[i].t = 1.f;
+	}
+	
+	if(empty()) {
+		return;
+	}
+	
+	Packet packet;
+	for(size_t begin = 0; begin < count; begin += MaxPacketSize) {
+		packet.size = std::min(count - begin, MaxPacketSize);
+		packet.hits = hits + begin;
+		for(size_t i = 0; i < packet.size; i++) {
+			const Segment & segment = segments[begin + i];
+			packet.origin[i] = segment.start;
+			packet.dir[i] = segment.end - segment.start;
+			packet.invDir[i] = Vec3f(safeInverse(packet.dir[i].x), safeInverse(packet.dir[i].y),
+			                         safeInverse(packet.dir[i].z));
+		}
+		intersect(packet, ignore);
+	}
+}
+
+void BackgroundBVH::intersect(Packet & packet, PolyType ignore) const {
+	
+	u32 stack[MaxDepth];
+	size_t depth = 0;
+	stack[depth++] = 0;
+	
+	while(depth) {
+		
+		const Node & node = nodes[stack[--depth]];
+		
+		bool visible = false;
+		for(size_t i = 0; i < packet.size && !visible; i++) {
+			visible = hitsBox(node.min, node.max, packet.origin[i], packet.invDir[i],
+			                  packet.hits[i].t);
+		}
+		if(!visible) {
+			continue;
+		}
+		
+		if(node.count == 0) {
+			// Visit the child closer to the start of the first segment first.
+			const Node & a = nodes[node.first], & b = nodes[node.first + 1];
+			Vec3f offset = (b.min + b.max) - (a.min + a.max);
+			bool swap = glm::dot(offset, packet.dir[0]) < 0.f;
+			stack[depth++] = node.first + (swap ? 0 : 1);
+			stack[depth++] = node.first + (swap ? 1 : 0);
+			continue;
+		}
+		
+		for(u32 k = node.first; k < node.first + node.count; k++) {
+			
+			const Triangle & tri = triangles[k];
+			if(tri.type & ignore) {
+				continue;
+			}
+			
+			for(size_t i = 0; i < packet.size; i++) {
+				
+				// Möller-Trumbore, without culling
+				Vec3f p = glm::cross(packet.dir[i], tri.e2);
+				float det = glm::dot(tri.e1, p);
+				if(det == 0.f) {
+					continue;
+				}
+				float invDet = 1.f / det;
+				
+				Vec3f s = packet.origin[i] - tri.v0;
+				float u = glm::dot(s, p) * invDet;
+				if(u < 0.f || u > 1.f) {
+					continue;
+				}
+				
+				Vec3f q = glm::cross(s, tri.e1);
+				float v = glm::dot(packet.dir[i], q) * invDet;
+				if(v < 0.f || u + v > 1.f) {
+					continue;
+				}
+				
+				float t = glm::dot(tri.e2, q) * invDet;
+				if(t >= 0.f && t < packet.hits[i].t) {
+					packet.hits[i].t = t;
+					packet.hits[i].poly = tri.poly;
+				}
+			}
+		}
+	}
+}
+
+void BackgroundBVH::query(const Vec3f & min, const Vec3f & max,
+                          std::vector<EERIEPOLY *> & result) const {
+	
+	result.clear();
+	
+	if(empty()) {
+		return;
+	}
+	
+	u32 stack[MaxDepth];
+	size_t depth = 0;
+	stack[depth++] = 0;
+	
+	while(depth) {
+		
+		const Node & node = nodes[stack[--depth]];
+		if(!overlapsBox(node.min, node.max, min, max)) {
+			continue;
+		}
+		
+		if(node.count == 0) {
+			stack[depth++] = node.first + 1;
+			stack[depth++] = node.first;
+			continue;
+		}
+		
+		for(u32 k = node.first; k < node.first + node.count; k++) {
+			const Triangle & tri = triangles[k];
+			Vec3f v1 = tri.v0 + tri.e1, v2 = tri.v0 + tri.e2;
+			if(overlapsBox(glm::min(glm::min(tri.v0, v1), v2), glm::max(glm::max(tri.v0, v1), v2),
+			               min, max)) {
+				result.push_back(tri.poly);
+			}
+		}
+	}
+	
+	// Both triangles of a quad may have been added.
+	std::sort(result.begin(), result.end());
+	result.erase(std::unique(result.begin(), result.end()), result.end());
+}
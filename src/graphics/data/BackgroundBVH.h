@@ -0,0 +1,109 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARX_GRAPHICS_DATA_BACKGROUNDBVH_H
+#define ARX_GRAPHICS_DATA_BACKGROUNDBVH_H
+
+#include <stddef.h>
+#include <vector>
+
+#include "graphics/GraphicsTypes.h"
+#include "math/Types.h"
+#include "platform/Platform.h"
+
+struct EERIE_BACKGROUND;
+
+/*!
+ * Static bounding volume hierarchy over all background polygons.
+ *
+ * Quads are split into the same two triangles used by the rest of the collision code
+ * (0, 1, 2 and 1, 2, 3). All tests are double-sided.
+ *
+ * The tree must be rebuilt whenever background polygons are added, removed or moved.
+ */
+class BackgroundBVH {
+	
+public:
+	
+	struct Segment {
+		Vec3f start;
+		Vec3f end;
+	};
+	
+	struct Hit {
+		EERIEPOLY * poly; //!< The first polygon hit or NULL.
+		float t; //!< Relative position of the hit on the segment, 0 at start and 1 at end.
+	};
+	
+	//! Maximum number of segments traversed together by intersect(const Segment *, ...)
+	static const size_t MaxPacketSize = 16;
+	
+	void build(const EERIE_BACKGROUND & bkg);
+	
+	void clear();
+	
+	bool empty() const { return nodes.empty(); }
+	
+	/*!
+	 * Find the first polygon crossed by a segment.
+	 * Polygons that have any of the ignore flags set are skipped.
+	 */
+	Hit intersect(const Vec3f & start, const Vec3f & end, PolyType ignore = PolyType()) const;
+	
+	/*!
+	 * Find the first polygon crossed by each of several segments.
+	 * Segments are processed in packets of up to MaxPacketSize that share a single traversal
+	 * of the tree, which is much faster than separate queries for segments that are close
+	 * together, such as rays from one light to the vertices of a polygon.
+	 */
+	void intersect(const Segment * segments, size_t count, Hit * hits,
+	               PolyType ignore = PolyType()) const;
+	
+	//! Collect all polygons with a triangle that overlaps the given box.
+	void query(const Vec3f & min, const Vec3f & max, std::vector<EERIEPOLY *> & result) const;
+	
+private:
+	
+	struct Node {
+		Vec3f min;
+		u32 first; //!< First triangle for leaves or first child for inner nodes.
+		Vec3f max;
+		u32 count; //!< Number of triangles, 0 for inner nodes.
+	};
+	
+	struct Triangle {
+		Vec3f v0;
+		Vec3f e1;
+		Vec3f e2;
+		EERIEPOLY * poly;
+		PolyType type;
+	};
+	
+	struct BuildItem;
+	struct Packet;
+	
+	void build(std::vector<BuildItem> & items, size_t node, size_t begin, size_t end);
+	void intersect(Packet & packet, PolyType ignore) const;
+	
+	std::vector<Node> nodes;
+	std::vector<Triangle> triangles;
+	
+};
+
+#endif // ARX_GRAPHICS_DATA_BACKGROUNDBVH_H
@@ -0,0 +1,149 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "graphics/data/FastSceneFormat.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "graphics/GraphicsTypes.h"
+#include "io/Blast.h"
+#include "io/resource/PakReader.h"
+#include "io/resource/ResourcePath.h"
+
+bool FastSceneDecompress(PakReader & reader, const res::path & file,
+                         boost::scoped_array<char> & bytes,
+                         const char * & data, const char * & end) {
+	
+	try {
+		
+		// Load the whole file
+		LogDebug("Loading " << file);
+		// The compressed data is only needed until it has been decompressed, parse it in place
+		PakFileView view;
+		bool found = reader.readView(file, view);
+		data = view.data(), end = view.data() + view.size();
+		size_t size = view.size();
+		LogDebug("FTS: read " << size << " bytes");
+		if(!found || !data) {
+			LogError << "FTS: could not read " << file;
+			return false;
+		}
+		
+		
+		// Read the file header
+		const UNIQUE_HEADER * uh = fts_read<UNIQUE_HEADER>(data, end);
+		if(uh->version != FTS_VERSION) {
+			LogError << "FTS version mismatch: got " << uh->version << ", expected "
+			         << FTS_VERSION << " in " << file;
+			return false;
+		}
+		
+		
+		// Skip .scn file list
+		(void)fts_read<UNIQUE_HEADER3>(data, end, uh->count);
+		
+		
+		// Decompress the actual scene data
+		size_t input_size = end - data;
+		LogDebug("FTS: decompressing " << input_size << " -> "
+		                               << uh->uncompressedsize);
+		bytes.reset(new char[uh->uncompressedsize]);
+		if(!bytes) {
+			LogError << "FTS: can't allocate buffer for uncompressed data";
+			return false;
+		}
+		size = blastMem(data, input_size, bytes.get(), uh->uncompressedsize);
+		data = bytes.get(), end = bytes.get() + size;
+		if(!size) {
+			LogError << "FTS: error decompressing scene data in " << file;
+			return false;
+		} else if(size != size_t(uh->uncompressedsize)) {
+			LogWarning << "FTS: unexpected decompressed size: " << size << " < "
+			           << uh->uncompressedsize << " in " << file;
+		}
+		
+	} catch(file_truncated_exception) {
+		LogError << "FTS: truncated file " << file;
+		return false;
+	}
+	
+	return true;
+}
+
+void FastSceneLoadPoly(EERIEPOLY & ep2, const FAST_EERIEPOLY & ep) {
+	
+	std::memset(&ep2, 0, sizeof(EERIEPOLY));
+	
+	ep2.room = ep.room;
+	ep2.area = ep.area;
+	ep2.norm = ep.norm.toVec3();
+	ep2.norm2 = ep.norm2.toVec3();
+	
+	for(int i = 0; i < 4; i++)
+		ep2.nrml[i] = ep.nrml[i].toVec3();
+	
+	ep2.tex = NULL;
+	
+	ep2.transval = ep.transval;
+	ep2.type = PolyType::load(ep.type);
+	
+	for(size_t kk = 0; kk < 4; kk++) {
+		ep2.v[kk].color = 0xFFFFFFFF;
+		ep2.v[kk].rhw = 1;
+		ep2.v[kk].specular = 1;
+		ep2.v[kk].p.x = ep.v[kk].ssx;
+		ep2.v[kk].p.y = ep.v[kk].sy;
+		ep2.v[kk].p.z = ep.v[kk].ssz;
+		ep2.v[kk].uv.x = ep.v[kk].stu;
+		ep2.v[kk].uv.y = ep.v[kk].stv;
+	}
+	
+	std::memcpy(ep2.tv, ep2.v, sizeof(TexturedVertex) * 4);
+	
+	for(size_t kk = 0; kk < 4; kk++) {
+		ep2.tv[kk].color = 0xFF000000;
+	}
+	
+	long to = (ep.type & POLY_QUAD) ? 4 : 3;
+	float div = 1.f / to;
+	
+	ep2.center = Vec3f_ZERO;
+	for(long h = 0; h < to; h++) {
+		ep2.center += ep2.v[h].p;
+		if(h != 0) {
+			ep2.max = glm::max(ep2.max, ep2.v[h].p);
+			ep2.min = glm::min(ep2.min, ep2.v[h].p);
+		} else {
+			ep2.min = ep2.max = ep2.v[0].p;
+		}
+	}
+	ep2.center *= div;
+	
+	float dist = 0.f;
+	for(int h = 0; h < to; h++) {
+		float x = ep2.v[h].p.x - ep2.center.x;
+		float y = ep2.v[h].p.y - ep2.center.y;
+		float z = ep2.v[h].p.z - ep2.center.z;
+		float d = std::sqrt((x * x) + (y * y) + (z * z));
+		dist = std::max(dist, d);
+	}
+	ep2.v[0].rhw = dist;
+}
@@ -44,9 +44,18 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #ifndef ARX_GRAPHICS_DATA_FASTSCENEFORMAT_H
 #define ARX_GRAPHICS_DATA_FASTSCENEFORMAT_H
 
+#include <stddef.h>
+
+#include <boost/scoped_array.hpp>
+
 #include "graphics/GraphicsFormat.h"
+#include "io/log/Logger.h"
 #include "platform/Platform.h"
 
+struct EERIEPOLY;
+class PakReader;
+namespace res { class path; }
+
 
 #pragma pack(push,1)
 
@@ -190,4 +199,37 @@ struct EERIE_SAVE_ROOM_DATA {
 #pragma pack(pop)
 
 
+struct file_truncated_exception { };
+
+template <typename T>
+const T * fts_read(const char * & data, const char * end, size_t n = 1) {
+	
+	size_t toread = sizeof(T) * n;
+	
+	if(data + toread > end) {
+		LogDebug(sizeof(T) << " * " << n << " > " << (end - data));
+		throw file_truncated_exception();
+	}
+	
+	const T * result = reinterpret_cast<const T *>(data);
+	
+	data += toread;
+	
+	return result;
+}
+
+/*!
+ * Read a fast.fts file from the given resources and decompress the scene data.
+ *
+ * On success, bytes holds the decompressed data and [data, end) is the part that
+ * starts with the FAST_SCENE_HEADER.
+ */
+bool FastSceneDecompress(PakReader & reader, const res::path & file,
+                         boost::scoped_array<char> & bytes,
+                         const char * & data, const char * & end);
+
+//! Convert a polygon from the scene data, except for the texture which is set to NULL.
+void FastSceneLoadPoly(EERIEPOLY & ep2, const FAST_EERIEPOLY & ep);
+
+
 #endif // ARX_GRAPHICS_DATA_FASTSCENEFORMAT_H
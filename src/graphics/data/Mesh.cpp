@@ -46,8 +46,11 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 
 #include "graphics/data/Mesh.h"
 
+#include <algorithm>
+#include <cmath>
 #include <cstdlib>
 #include <cstdio>
+#include <limits>
 #include <map>
 
 #include <boost/scoped_array.hpp>
@@ -70,7 +73,9 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include "graphics/Math.h"
 #include "graphics/VertexBuffer.h"
 #include "graphics/GraphicsUtility.h"
+#include "graphics/data/BackgroundBVH.h"
 #include "graphics/data/TextureContainer.h"
+#include "graphics/data/TileCollision.h"
 #include "graphics/data/FastSceneFormat.h"
 #include "graphics/particle/ParticleEffects.h"
 
@@ -263,26 +268,9 @@ EERIEPOLY * CheckInPoly(float x, float y, float z, float * needY)
 
 	for(short j = pzi; j <= pza; j++) {
 		for(short i = pxi; i <= pxa; i++) {
-			FAST_BKG_DATA * feg = &ACTIVEBKG->fastdata[i][j];
-
-			for(short k = 0; k < feg->nbpolyin; k++) {
-				EERIEPOLY * ep = feg->polyin[k];
-
-				if(poss.x >= ep->min.x
-				&& poss.x <= ep->max.x
-				&& poss.z >= ep->min.z
-				&& poss.z <= ep->max.z
-				&& !(ep->type & (POLY_WATER | POLY_TRANS | POLY_NOCOL))
-				&& ep->max.y >= poss.y
-				&& ep != found
-				&& PointIn2DPolyXZ(ep, poss.x, poss.z)
-				&& GetTruePolyY(ep, &poss, &rz)
-				&& rz >= poss.y
-				&& (!found || (found && rz <= foundY))
-				) {
-					found = ep;
-					foundY = rz;
-				}
+			const TileCollision * collision = ACTIVEBKG->fastdata[i][j].polyinCollision;
+			if(collision) {
+				collision->findFloor(poss.x, poss.y, poss.z, found, foundY);
 			}
 		}
 	}
@@ -311,34 +299,11 @@ FAST_BKG_DATA * getFastBackgroundData(float x, float z) {
 EERIEPOLY * CheckTopPoly(float x, float y, float z) {
 	
 	FAST_BKG_DATA * feg = getFastBackgroundData(x, z);
-	if(!feg) {
+	if(!feg || !feg->polyinCollision) {
 		return NULL;
 	}
 	
-	EERIEPOLY * found = NULL;
-	for (long k = 0; k < feg->nbpolyin; k++) {
-		
-		EERIEPOLY * ep = feg->polyin[k];
-		
-		if((!(ep->type & (POLY_WATER | POLY_TRANS | POLY_NOCOL)))
-		   && (ep->min.y < y)
-		   && (x >= ep->min.x) && (x <= ep->max.x)
-		   && (z >= ep->min.z) && (z <= ep->max.z)
-		   && (PointIn2DPolyXZ(ep, x, z))) {
-			
-			if((EEfabs(ep->max.y - ep->min.y) > 50.f) && (y - ep->center.y < 60.f)) {
-				continue;
-			}
-			
-			if(ep->tex != NULL) {
-				if(found == NULL || ep->min.y > found->min.y) {
-					found = ep;
-				}
-			}
-		}
-	}
-	
-	return found;
+	return feg->polyinCollision->findTop(x, y, z);
 }
 
 bool IsAnyPolyThere(float x, float z) {
@@ -362,66 +327,26 @@ bool IsAnyPolyThere(float x, float z) {
 
 EERIEPOLY * GetMinPoly(float x, float y, float z) {
 	
+	ARX_UNUSED(y);
+	
 	FAST_BKG_DATA * feg = getFastBackgroundData(x, z);
-	if(!feg) {
+	if(!feg || !feg->polyinCollision) {
 		return NULL;
 	}
 	
-	Vec3f pos(x, y, z);
-	
-	EERIEPOLY * found = NULL;
-	float foundy = 0.0f;
-	for (long k = 0; k < feg->nbpolyin; k++) {
-		
-		EERIEPOLY * ep = feg->polyin[k];
-
-		if(ep->type & (POLY_WATER | POLY_TRANS | POLY_NOCOL))
-			continue;
-		
-		if(PointIn2DPolyXZ(ep, x, z)) {
-			float ret;
-			if(GetTruePolyY(ep, &pos, &ret)) {
-				if(!found || ret > foundy) {
-					found = ep;
-					foundy = ret;
-				}
-			}
-		}
-	}
-	
-	return found;
+	return feg->polyinCollision->findMinPoly(x, z);
 }
 
 EERIEPOLY * GetMaxPoly(float x, float y, float z) {
 	
+	ARX_UNUSED(y);
+	
 	FAST_BKG_DATA * feg = getFastBackgroundData(x, z);
-	if(!feg) {
+	if(!feg || !feg->polyinCollision) {
 		return NULL;
 	}
 	
-	Vec3f pos(x, y, z);
-	
-	EERIEPOLY * found = NULL;
-	float foundy = 0.0f;
-	for(long k = 0; k < feg->nbpolyin; k++) {
-		
-		EERIEPOLY * ep = feg->polyin[k];
-		
-		if(ep->type & (POLY_WATER | POLY_TRANS | POLY_NOCOL))
-			continue;
-		
-		if(PointIn2DPolyXZ(ep, x, z)) {
-			float ret;
-			if(GetTruePolyY(ep, &pos, &ret)) {
-				if(!found || ret < foundy) {
-					found = ep;
-					foundy = ret;
-				}
-			}
-		}
-	}
-	
-	return found;
+	return feg->polyinCollision->findMaxPoly(x, z);
 }
 
 EERIEPOLY * EEIsUnderWater(const Vec3f * pos) {
@@ -692,249 +617,131 @@ static bool RayIn3DPolyNoCull(Vec3f * orgn, Vec3f * dest, EERIEPOLY * epp) {
 	return false;
 }
 
-int EERIELaunchRay3(Vec3f * orgn, Vec3f * dest,  Vec3f * hit, EERIEPOLY * epp, long flag) {
-	
-	Vec3f p; //current ray pos
-	Vec3f d; // ray incs
-	Vec3f ad; // absolute ray incs
-	Vec3f i;
-	long lpx, lpz;
-	long voidlast;
-	long px, pz;
-	float pas = 1.5f;
-	
-	long iii = 0;
-	float maxstepp = 20000.f / pas;
-	*hit = p = *orgn;
-	
-	voidlast = 0;
-	lpx = lpz = -1;
-	d.x = (dest->x - orgn->x);
-	ad.x = EEfabs(d.x);
-	d.y = (dest->y - orgn->y);
-	ad.y = EEfabs(d.y);
-	d.z = (dest->z - orgn->z);
-	ad.z = EEfabs(d.z);
-	
-	if(ad.x >= ad.y && ad.x >= ad.z) {
-		i.x = (ad.x != d.x) ? (-1.f * pas) : (1.f * pas);
-		i.y = d.y / (ad.x / pas);
-		i.z = d.z / (ad.x / pas);
-	} else if(ad.y >= ad.x && ad.y >= ad.z) {
-		i.x = d.x / (ad.y / pas);
-		i.y = (ad.y != d.y) ? (-1.f * pas) : (1.f * pas);
-		i.z = d.z / (ad.y / pas);
-	} else {
-		i.x = d.x / (ad.z / pas);
-		i.y = d.y / (ad.z / pas);
-		i.z = (ad.z != d.z) ? (-1.f * pas) : (1.f * pas);
-	}
+/*!
+ * Walk the background tiles crossed by a segment, in the XZ plane.
+ * @param result set to 1 if the segment enters a tile without polygons, -1 if it leaves the
+ *               level and 0 otherwise.
+ * @return the relative position on the segment where that happens, or 1 if it doesn't.
+ */
+static float GetRayTileLimit(const Vec3f & start, const Vec3f & end, int * result) {
+	
+	const float big = std::numeric_limits<float>::max();
+	
+	float dx = end.x - start.x;
+	float dz = end.z - start.z;
 	
+	long px = long(std::floor(start.x * ACTIVEBKG->Xmul));
+	long pz = long(std::floor(start.z * ACTIVEBKG->Zmul));
+	long ex = long(std::floor(end.x * ACTIVEBKG->Xmul));
+	long ez = long(std::floor(end.z * ACTIVEBKG->Zmul));
+	
+	long sx = (dx > 0.f) ? 1 : -1;
+	long sz = (dz > 0.f) ? 1 : -1;
+	float deltax = (dx != 0.f) ? EEfabs(ACTIVEBKG->Xdiv / dx) : big;
+	float deltaz = (dz != 0.f) ? EEfabs(ACTIVEBKG->Zdiv / dz) : big;
+	float nextx = (dx != 0.f) ? ((px + (sx > 0 ? 1 : 0)) * ACTIVEBKG->Xdiv - start.x) / dx : big;
+	float nextz = (dz != 0.f) ? ((pz + (sz > 0 ? 1 : 0)) * ACTIVEBKG->Zdiv - start.z) / dz : big;
+	
+	float t = 0.f;
 	for(;;) {
 		
-		p += i;
-		
-		if(i.x == -1.f * pas && p.x <= dest->x) {
-			*hit = p;
-			return 0;
-		}
-		
-		if(i.x == 1.f * pas && p.x >= dest->x) {
-			*hit = p;
-			return 0;
-		}
-		
-		if(i.y == -1.f * pas && p.y <= dest->y) {
-			*hit = p;
-			return 0;
-		}
-		
-		if(i.y == 1.f * pas && p.y >= dest->y) {
-			*hit = p;
-			return 0;
-		}
-		
-		if(i.z == -1.f * pas && p.z <= dest->z) {
-			*hit = p;
-			return 0;
-		}
-		
-		if(i.z == 1.f * pas && p.z >= dest->z) {
-			*hit = p;
-			return 0;
-		}
-		
-		iii++;
-		
-		if(iii > maxstepp) {
-			*hit = p;
-			return -1;
+		if(px < 0 || px >= ACTIVEBKG->Xsize || pz < 0 || pz >= ACTIVEBKG->Zsize) {
+			*result = -1;
+			return t;
 		}
 		
-		px = long(p.x * ACTIVEBKG->Xmul);
-		pz = long(p.z * ACTIVEBKG->Zmul);
-		
-		if(px < 0 || px > ACTIVEBKG->Xsize - 1 || pz < 0 || pz > ACTIVEBKG->Zsize - 1) {
-			*hit = p;
-			return -1;
+		if(ACTIVEBKG->Backg[px + pz * ACTIVEBKG->Xsize].nbpoly == 0) {
+			*result = 1;
+			return t;
 		}
 		
-		if(lpx == px && lpz == pz && voidlast) {
-			continue;
+		if(px == ex && pz == ez) {
+			break;
 		}
 		
-		lpx = px;
-		lpz = pz;
-		voidlast = !flag;
-		long jx1 = clamp(px - 1l, 0l, ACTIVEBKG->Xsize - 1l);
-		long jx2 = clamp(px + 1l, 0l, ACTIVEBKG->Xsize - 1l);
-		long jz1 = clamp(pz - 1l, 0l, ACTIVEBKG->Zsize - 1l);
-		long jz2 = clamp(pz + 1l, 0l, ACTIVEBKG->Zsize - 1l);
-		
-		EERIE_BKG_INFO * eg = &ACTIVEBKG->Backg[px + pz * ACTIVEBKG->Xsize];
-		if(eg->nbpoly == 0) {
-			*hit = p;
-			return 1;
+		if(nextx < nextz) {
+			t = nextx, nextx += deltax, px += sx;
+		} else {
+			t = nextz, nextz += deltaz, pz += sz;
 		}
 		
-		for(pz = jz1; pz < jz2; pz++) for (px = jx1; px < jx2; px++) {
-			eg = &ACTIVEBKG->Backg[px + pz * ACTIVEBKG->Xsize];
-			for(long k = 0; k < eg->nbpoly; k++) {
-				EERIEPOLY * ep = &eg->polydata[k];
-				if(ep->type & POLY_TRANS) {
-					continue;
-				}
-				if(p.y < ep->min.y - 10.f || p.y > ep->max.y + 10.f
-				   || p.x < ep->min.x - 10.f || p.x > ep->max.x + 10.f
-				   || p.z < ep->min.z - 10.f || p.z > ep->max.z + 10.f) {
-					continue;
-				}
-				voidlast = 0;
-				if(RayIn3DPolyNoCull(orgn, dest, ep)) {
-					*hit = p;
-					return (ep == epp) ? 0 : 1;
-				}
-			}
+		if(t > 1.f) {
+			break;
 		}
 	}
+	
+	*result = 0;
+	return 1.f;
 }
 
-// Computes the visibility from a point to another... (sort of...)
-bool Visible(Vec3f * orgn, Vec3f * dest, EERIEPOLY * epp, Vec3f * hit)
-{
-	float ix,iy,iz;
-	long px,pz;
-	EERIEPOLY *ep;
-
-	EERIE_BKG_INFO *eg;
-	float pas = 35.f;
-
-	Vec3f found_hit = Vec3f_ZERO;
-	EERIEPOLY *found_ep = NULL;
-	float iter,t;
+int EERIELaunchRay3(Vec3f * orgn, Vec3f * dest,  Vec3f * hit, EERIEPOLY * epp) {
 	
-	//current ray pos
-	float x = orgn->x;
-	float y = orgn->y;
-	float z = orgn->z;
-
-	float distance;
-	float nearest = distance = fdist(*orgn, *dest);
-
-	if(distance < pas)
-		pas = distance * .5f;
-
-	// ray incs
-	float dx = (dest->x - orgn->x);
-	float dy = (dest->y - orgn->y);
-	float dz = (dest->z - orgn->z);
-
-	// absolute ray incs
-	float adx = EEfabs(dx);
-	float ady = EEfabs(dy);
-	float adz = EEfabs(dz);
-
-	if(adx >= ady && adx >= adz) {
-		if(adx != dx)
-			ix = -pas;
-		else
-			ix = pas;
-
-		iter = adx / pas;
-		t = 1.f / (iter);
-		iy = dy * t;
-		iz = dz * t;
-	} else if(ady >= adx && ady >= adz) {
-		if(ady != dy)
-			iy = -pas;
-		else
-			iy = pas;
-
-		iter = ady / pas;
-		t = 1.f / (iter);
-		ix = dx * t;
-		iz = dz * t;
-	} else {
-		if(adz != dz)
-			iz = -pas;
-		else
-			iz = pas;
-
-		iter = adz / pas;
-		t = 1.f / (iter);
-		ix = dx * t;
-		iy = dy * t;
+	int result;
+	float limit = GetRayTileLimit(*orgn, *dest, &result);
+	
+	// Rays are only traced up to 20000 units along their major axis
+	const float maxDistance = 20000.f;
+	Vec3f d = *dest - *orgn;
+	float major = std::max(EEfabs(d.x), std::max(EEfabs(d.y), EEfabs(d.z)));
+	if(major * limit > maxDistance) {
+		limit = maxDistance / major;
+		result = -1;
 	}
-
-	float dd;
-	x -= ix;
-	y -= iy;
-	z -= iz;
-
-	while(iter > 0.f) {
-		iter -= 1.f;
-		x += ix;
-		y += iy;
-		z += iz;
-
-		px = (long)(x * ACTIVEBKG->Xmul);
-		pz = (long)(z * ACTIVEBKG->Zmul);
-
-		if(px < 0 || px > ACTIVEBKG->Xsize - 1 || pz < 0 || pz > ACTIVEBKG->Zsize - 1)
-			break;
-
-		eg = &ACTIVEBKG->Backg[px+pz*ACTIVEBKG->Xsize];
-
-		for(long k = 0; k < eg->nbpolyin; k++) {
-			ep = eg->polyin[k];
-
-			if (ep)
-			if ((ep->min.y - pas < y) && (ep->max.y + pas > y))
-			if ((ep->min.x - pas < x) && (ep->max.x + pas > x))
-			if ((ep->min.z - pas < z) && (ep->max.z + pas > z))
-			if (RayCollidingPoly(orgn, dest, ep, hit)) {
-				dd = fdist(*orgn, *hit);
-
-				if(dd < nearest) {
-					nearest = dd;
-					found_ep = ep;
-					found_hit = *hit;
-				}
-			}
+	
+	if(ACTIVEBKG->bvh) {
+		BackgroundBVH::Hit first = ACTIVEBKG->bvh->intersect(*orgn, *dest, POLY_TRANS);
+		if(first.poly && first.t <= limit) {
+			*hit = *orgn + (*dest - *orgn) * first.t;
+			return (first.poly == epp) ? 0 : 1;
 		}
 	}
+	
+	*hit = *orgn + (*dest - *orgn) * limit;
+	
+	return result;
+}
 
-	if(!found_ep)
+// Computes the visibility from a point to another... (sort of...)
+bool Visible(Vec3f * orgn, Vec3f * dest, EERIEPOLY * epp, Vec3f * hit) {
+	
+	if(!ACTIVEBKG->bvh) {
 		return true;
-
-	if(found_ep == epp)
+	}
+	
+	BackgroundBVH::Hit first = ACTIVEBKG->bvh->intersect(*orgn, *dest);
+	if(!first.poly || first.poly == epp) {
 		return true;
+	}
 	
-	*hit = found_hit;
+	*hit = *orgn + (*dest - *orgn) * first.t;
 	
 	return false;
 }
 
+void VisibleBatch(const Vec3f & orgn, const Vec3f * dest, size_t count, EERIEPOLY * epp,
+                  bool * visible) {
+	
+	if(!ACTIVEBKG->bvh) {
+		std::fill(visible, visible + count, true);
+		return;
+	}
+	
+	BackgroundBVH::Segment segments[BackgroundBVH::MaxPacketSize];
+	BackgroundBVH::Hit hits[BackgroundBVH::MaxPacketSize];
+	
+	for(size_t begin = 0; begin < count; begin += BackgroundBVH::MaxPacketSize) {
+		size_t n = std::min(count - begin, BackgroundBVH::MaxPacketSize);
+		for(size_t i = 0; i < n; i++) {
+			segments[i].start = orgn;
+			segments[i].end = dest[begin + i];
+		}
+		ACTIVEBKG->bvh->intersect(segments, n, hits);
+		for(size_t i = 0; i < n; i++) {
+			visible[begin + i] = (!hits[i].poly || hits[i].poly == epp);
+		}
+	}
+}
+
 
 //*************************************************************************************
 // Counts total number of polys in a background
@@ -976,6 +783,8 @@ void ReleaseBKG_INFO(EERIE_BKG_INFO * eg) {
 	free(eg->polydata), eg->polydata = NULL;
 	free(eg->polyin), eg->polyin = NULL;
 	eg->nbpolyin = 0;
+	delete eg->polyinCollision;
+	delete eg->polydataCollision;
 	memset(eg, 0, sizeof(EERIE_BKG_INFO));
 }
 
@@ -1110,6 +919,8 @@ void ClearBackground(EERIE_BACKGROUND * eb) {
 	}
 	free(eb->Backg), eb->Backg = NULL;
 	
+	delete eb->bvh, eb->bvh = NULL;
+	
 	free(RoomDistance), RoomDistance = NULL;
 	NbRoomDistance = 0;
 }
@@ -1280,10 +1091,25 @@ void EERIEPOLY_Compute_PolyIn()
 			eg->tile_miny = 999999999.f;
 			eg->tile_maxy = -999999999.f;
 
+			if(!eg->polyinCollision) {
+				eg->polyinCollision = new TileCollision;
+			}
+			eg->polyinCollision->clear();
+
 			for(long kk = 0; kk < eg->nbpolyin; kk++) {
 				EERIEPOLY *ep = eg->polyin[kk];
 				eg->tile_miny = min(eg->tile_miny, ep->min.y);
 				eg->tile_maxy = max(eg->tile_maxy, ep->max.y);
+				eg->polyinCollision->add(ep);
+			}
+
+			if(!eg->polydataCollision) {
+				eg->polydataCollision = new TileCollision;
+			}
+			eg->polydataCollision->clear();
+
+			for(long l = 0; l < eg->nbpoly; l++) {
+				eg->polydataCollision->add(&eg->polydata[l]);
 			}
 
 			FAST_BKG_DATA * fbd = &ACTIVEBKG->fastdata[i][j];
@@ -1297,7 +1123,14 @@ void EERIEPOLY_Compute_PolyIn()
 			fbd->polydata = eg->polydata;
 			fbd->polyin = eg->polyin;
 			fbd->ianchors = eg->ianchors;
+			fbd->polyinCollision = eg->polyinCollision;
+			fbd->polydataCollision = eg->polydataCollision;
 		}
+	
+	if(!ACTIVEBKG->bvh) {
+		ACTIVEBKG->bvh = new BackgroundBVH;
+	}
+	ACTIVEBKG->bvh->build(*ACTIVEBKG);
 }
 
 float GetTileMinY(long i, long j) {
@@ -1615,108 +1448,23 @@ extern void LoadLevelScreen(long lev);
 extern float PROGRESS_BAR_COUNT;
 
 
-struct file_truncated_exception { };
-
-template <typename T>
-const T * fts_read(const char * & data, const char * end, size_t n = 1) {
-	
-	size_t toread = sizeof(T) * n;
-	
-	if(data + toread > end) {
-		LogDebug(sizeof(T) << " * " << n << " > " << (end - data));
-		throw file_truncated_exception();
-	}
-	
-	const T * result = reinterpret_cast<const T *>(data);
-	
-	data += toread;
-	
-	return result;
-}
-
-
 static bool loadFastScene(const res::path & file, const char * data,
                           const char * end);
 
-template <typename T>
-class scoped_malloc {
-	
-	T * data;
-	
-public:
-	
-	explicit scoped_malloc(T * data) : data(data) { }
-	
-	~scoped_malloc() { free(data); }
-	
-	T * get() { return data; }
-	const T * get() const { return data; }
-	
-};
-
 bool FastSceneLoad(const res::path & partial_path) {
 	
 	res::path file = "game" / partial_path / "fast.fts";
 	
 	const char * data = NULL, * end = NULL;
 	boost::scoped_array<char> bytes;
-	
-	try {
-		
-		// Load the whole file
-		LogDebug("Loading " << file);
-		size_t size;
-		scoped_malloc<char> dat(resources->readAlloc(file, size));
-		data = dat.get(), end = dat.get() + size;
-		// TODO use new[] instead of malloc so we can use (boost::)unique_ptr
-		LogDebug("FTS: read " << size << " bytes");
-		if(!data) {
-			LogError << "FTS: could not read " << file;
-			return false;
-		}
-		
-		
-		// Read the file header
-		const UNIQUE_HEADER * uh = fts_read<UNIQUE_HEADER>(data, end);
-		if(uh->version != FTS_VERSION) {
-			LogError << "FTS version mismatch: got " << uh->version << ", expected "
-			         << FTS_VERSION << " in " << file;
-			return false;
-		}
-		PROGRESS_BAR_COUNT += 1.f, LoadLevelScreen();
-		
-		
-		// Skip .scn file list and initialize the scene data
-		(void)fts_read<UNIQUE_HEADER3>(data, end, uh->count);
-		InitBkg(ACTIVEBKG, MAX_BKGX, MAX_BKGZ, BKG_SIZX, BKG_SIZZ);
-		PROGRESS_BAR_COUNT += 1.f, LoadLevelScreen();
-		
-		
-		// Decompress the actual scene data
-		size_t input_size = end - data;
-		LogDebug("FTS: decompressing " << input_size << " -> "
-		                               << uh->uncompressedsize);
-		bytes.reset(new char[uh->uncompressedsize]);
-		if(!bytes) {
-			LogError << "FTS: can't allocate buffer for uncompressed data";
-			return false;
-		}
-		size = blastMem(data, input_size, bytes.get(), uh->uncompressedsize);
-		data = bytes.get(), end = bytes.get() + size;
-		if(!size) {
-			LogError << "FTS: error decompressing scene data in " << file;
-			return false;
-		} else if(size != size_t(uh->uncompressedsize)) {
-			LogWarning << "FTS: unexpected decompressed size: " << size << " < "
-			           << uh->uncompressedsize << " in " << file;
-		}
-		PROGRESS_BAR_COUNT += 3.f, LoadLevelScreen();
-		
-		
-	} catch(file_truncated_exception) {
-		LogError << "FTS: truncated file " << file;
+	if(!FastSceneDecompress(*resources, file, bytes, data, end)) {
 		return false;
 	}
+	PROGRESS_BAR_COUNT += 2.f, LoadLevelScreen();
+	
+	// Initialize the scene data
+	InitBkg(ACTIVEBKG, MAX_BKGX, MAX_BKGZ, BKG_SIZX, BKG_SIZZ);
+	PROGRESS_BAR_COUNT += 3.f, LoadLevelScreen();
 	
 	try {
 		return loadFastScene(file, data, end);
@@ -1749,10 +1497,14 @@ static bool loadFastScene(const res::path & file, const char * data, const char
 	TextureContainerMap textures;
 	const FAST_TEXTURE_CONTAINER * ftc;
 	ftc = fts_read<FAST_TEXTURE_CONTAINER>(data, end, fsh->nb_textures);
+	std::vector<res::path> textureNames(fsh->nb_textures);
+	for(long k = 0; k < fsh->nb_textures; k++) {
+		textureNames[k] = res::path::load(util::loadString(ftc[k].fic)).remove_ext();
+	}
+	TextureContainer::Prefetch(textureNames);
 	for(long k = 0; k < fsh->nb_textures; k++) {
-		res::path file = res::path::load(util::loadString(ftc[k].fic)).remove_ext();
 		TextureContainer * tmpTC;
-		tmpTC = TextureContainer::Load(file, TextureContainer::Level);
+		tmpTC = TextureContainer::Load(textureNames[k], TextureContainer::Level);
 		if(tmpTC) {
 			textures[ftc[k].tc] = tmpTC;
 		}
@@ -1792,67 +1544,12 @@ static bool loadFastScene(const res::path & file, const char * data, const char
 				const FAST_EERIEPOLY * ep = &eps[k];
 				EERIEPOLY * ep2 = &bkg.polydata[k];
 				
-				memset(ep2, 0, sizeof(EERIEPOLY));
+				FastSceneLoadPoly(*ep2, *ep);
 				
-				ep2->room = ep->room;
-				ep2->area = ep->area;
-				ep2->norm = ep->norm.toVec3();
-				ep2->norm2 = ep->norm2.toVec3();
-
-				for(int i = 0; i < 4; i++)
-					ep2->nrml[i] = ep->nrml[i].toVec3();
-
 				if(ep->tex != 0) {
 					TextureContainerMap::const_iterator cit = textures.find(ep->tex);
 					ep2->tex = (cit != textures.end()) ? cit->second : NULL;
-				} else {
-					ep2->tex = NULL;
-				}
-				
-				ep2->transval = ep->transval;
-				ep2->type = PolyType::load(ep->type);
-				
-				for(size_t kk = 0; kk < 4; kk++) {
-					ep2->v[kk].color = 0xFFFFFFFF;
-					ep2->v[kk].rhw = 1;
-					ep2->v[kk].specular = 1;
-					ep2->v[kk].p.x = ep->v[kk].ssx;
-					ep2->v[kk].p.y = ep->v[kk].sy;
-					ep2->v[kk].p.z = ep->v[kk].ssz;
-					ep2->v[kk].uv.x = ep->v[kk].stu;
-					ep2->v[kk].uv.y = ep->v[kk].stv;
-				}
-				
-				memcpy(ep2->tv, ep2->v, sizeof(TexturedVertex) * 4);
-				
-				for(size_t kk = 0; kk < 4; kk++) {
-					ep2->tv[kk].color = 0xFF000000;
-				}
-				
-				long to = (ep->type & POLY_QUAD) ? 4 : 3;
-				float div = 1.f / to;
-				
-				ep2->center = Vec3f_ZERO;
-				for(long h = 0; h < to; h++) {
-					ep2->center += ep2->v[h].p;
-					if(h != 0) {
-						ep2->max = glm::max(ep2->max, ep2->v[h].p);
-						ep2->min = glm::min(ep2->min, ep2->v[h].p);
-					} else {
-						ep2->min = ep2->max = ep2->v[0].p;
-					}
-				}
-				ep2->center *= div;
-				
-				float dist = 0.f;
-				for(int h = 0; h < to; h++) {
-					float x = ep2->v[h].p.x - ep2->center.x;
-					float y = ep2->v[h].p.y - ep2->center.y;
-					float z = ep2->v[h].p.z - ep2->center.z;
-					float d = sqrt((x * x) + (y * y) + (z * z));
-					dist = max(dist, d);
 				}
-				ep2->v[0].rhw = dist;
 				
 				DeclareEGInfo(ep2->center.x, ep2->center.z);
 				DeclareEGInfo(ep2->v[0].p.x, ep2->v[0].p.z);
@@ -53,7 +53,9 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include "math/Rectangle.h"
 #include "game/Camera.h"
 
+class BackgroundBVH;
 class Entity;
+class TileCollision;
 
 struct EERIE_BKG_INFO
 {
@@ -70,6 +72,8 @@ struct EERIE_BKG_INFO
 	long				flags;
 	float				tile_miny;
 	float				tile_maxy;
+	TileCollision *		polyinCollision; //!< Solid polygons from polyin
+	TileCollision *		polydataCollision; //!< Solid polygons from polydata
 };
 
 struct EERIE_SMINMAX
@@ -94,6 +98,8 @@ struct FAST_BKG_DATA
 	EERIEPOLY *			polydata;
 	EERIEPOLY **		polyin;
 	long *				ianchors; // index on anchors list
+	TileCollision *		polyinCollision;
+	TileCollision *		polydataCollision;
 };
 #define MAX_BKGX	160
 #define MAX_BKGZ	160
@@ -119,6 +125,7 @@ struct EERIE_BACKGROUND
 	long		  nbanchors;
 	ANCHOR_DATA * anchors;
 	char		name[256];
+	BackgroundBVH * bvh; //!< Built by EERIEPOLY_Compute_PolyIn()
 };
 
 extern long EERIEDrawnPolys;
@@ -133,6 +140,14 @@ void SetActiveCamera(EERIE_CAMERA* cam);
 //	Entity Struct End
 
 bool Visible(Vec3f * orgn, Vec3f * dest,EERIEPOLY * epp,Vec3f * hit);
+
+/*!
+ * Visible() for several destinations from the same origin.
+ * The rays are traced together, which is faster than separate calls.
+ */
+void VisibleBatch(const Vec3f & orgn, const Vec3f * dest, size_t count, EERIEPOLY * epp,
+                  bool * visible);
+
 void FaceTarget(Entity * io);
 
 void DebugAddParticle(const Vec3f & position, float siz, long tim, Color color);
@@ -158,7 +173,12 @@ EERIEPOLY * GetMaxPoly(float x, float y, float z);
  
 int PointIn2DPolyXZ(const EERIEPOLY * ep, float x, float z);
 
-int EERIELaunchRay3(Vec3f * orgn, Vec3f * dest,  Vec3f * hit, EERIEPOLY * tp, long flag);
+/*!
+ * Trace a ray through the background, ignoring transparent polygons.
+ * @return 0 if the ray reaches dest or hits epp, 1 if it hits another polygon or enters a tile
+ *         without polygons and -1 if it leaves the level or is longer than 20000 units.
+ */
+int EERIELaunchRay3(Vec3f * orgn, Vec3f * dest,  Vec3f * hit, EERIEPOLY * tp);
 
 void EE_RotateY(TexturedVertex *in,TexturedVertex *out,float c, float s);
 void EE_RTP(TexturedVertex *in,TexturedVertex *out);
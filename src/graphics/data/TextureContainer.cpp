@@ -195,16 +195,20 @@ TextureContainer::~TextureContainer() {
 	ResetVertexLists(this);
 }
 
+//! Find the image file for a texture name without extension.
+static bool findTextureFile(res::path & path) {
+	bool foundPath = resources->getFile(path.append(".png")) != NULL;
+	foundPath = foundPath || resources->getFile(path.set_ext("jpg"));
+	foundPath = foundPath || resources->getFile(path.set_ext("jpeg"));
+	foundPath = foundPath || resources->getFile(path.set_ext("bmp"));
+	foundPath = foundPath || resources->getFile(path.set_ext("tga"));
+	return foundPath;
+}
+
 bool TextureContainer::LoadFile(const res::path & strPathname) {
 	
 	res::path tempPath = strPathname;
-	bool foundPath = resources->getFile(tempPath.append(".png")) != NULL;
-	foundPath = foundPath || resources->getFile(tempPath.set_ext("jpg"));
-	foundPath = foundPath || resources->getFile(tempPath.set_ext("jpeg"));
-	foundPath = foundPath || resources->getFile(tempPath.set_ext("bmp"));
-	foundPath = foundPath || resources->getFile(tempPath.set_ext("tga"));
-
-	if(!foundPath) {
+	if(!findTextureFile(tempPath)) {
 		LogError << strPathname << " not found";
 		return false;
 	}
@@ -282,6 +286,21 @@ TextureContainer * TextureContainer::Load(const res::path & name, TCFlags flags)
 	return newTexture;
 }
 
+void TextureContainer::Prefetch(const std::vector<res::path> & names) {
+	
+	std::vector<res::path> files;
+	files.reserve(names.size());
+	
+	for(std::vector<res::path>::const_iterator i = names.begin(); i != names.end(); ++i) {
+		res::path file = *i;
+		if(!Find(file) && findTextureFile(file)) {
+			files.push_back(file);
+		}
+	}
+	
+	resources->prefetch(files);
+}
+
 TextureContainer * TextureContainer::LoadUI(const res::path & strName, TCFlags flags) {
 	return Load(strName, flags | UI);
 }
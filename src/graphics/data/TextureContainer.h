@@ -108,6 +108,12 @@ public:
 	//! Load an image into a TextureContainer
 	static TextureContainer * Load(const res::path & strName, TCFlags flags = 0);
 	
+	/*!
+	 * Start decompressing the image files for textures that will be loaded soon.
+	 * Textures that are already loaded are skipped.
+	 */
+	static void Prefetch(const std::vector<res::path> & names);
+	
 	//! Load an image into a TextureContainer
 	static TextureContainer * LoadUI(const res::path & strName, TCFlags flags = 0);
 	
@@ -0,0 +1,231 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "graphics/data/TileCollision.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "graphics/GraphicsTypes.h"
+
+void TileCollision::clear() {
+	minx.clear();
+	maxx.clear();
+	miny.clear();
+	maxy.clear();
+	minz.clear();
+	maxz.clear();
+	nx.clear();
+	ny.clear();
+	nz.clear();
+	d.clear();
+	vx.clear();
+	vz.clear();
+	quad.clear();
+	polys.clear();
+}
+
+void TileCollision::add(EERIEPOLY * ep) {
+	
+	if(ep->type & (POLY_WATER | POLY_TRANS | POLY_NOCOL)) {
+		return;
+	}
+	
+	minx.push_back(ep->min.x);
+	maxx.push_back(ep->max.x);
+	miny.push_back(ep->min.y);
+	maxy.push_back(ep->max.y);
+	minz.push_back(ep->min.z);
+	maxz.push_back(ep->max.z);
+	
+	// Same operations as GetTruePolyY() so that the results are bit-identical
+	Vec3f s21 = ep->v[1].p - ep->v[0].p;
+	Vec3f s31 = ep->v[2].p - ep->v[0].p;
+	Vec3f n;
+	n.y = (s21.z * s31.x) - (s21.x * s31.z);
+	n.x = (s21.y * s31.z) - (s21.z * s31.y);
+	n.z = (s21.x * s31.y) - (s21.y * s31.x);
+	nx.push_back(n.x);
+	ny.push_back(n.y);
+	nz.push_back(n.z);
+	d.push_back(ep->v[0].p.x * n.x + ep->v[0].p.y * n.y + ep->v[0].p.z * n.z);
+	
+	for(size_t i = 0; i < 4; i++) {
+		vx.push_back(ep->v[i].p.x);
+		vz.push_back(ep->v[i].p.z);
+	}
+	quad.push_back((ep->type & POLY_QUAD) ? 1 : 0);
+	
+	polys.push_back(ep);
+}
+
+bool TileCollision::contains(size_t i, float x, float z) const {
+	
+	const float * px = &vx[i * 4];
+	const float * pz = &vz[i * 4];
+	
+	bool c = false;
+	for(size_t k = 0, l = 2; k < 3; l = k++) {
+		if(((pz[k] <= z && z < pz[l]) || (pz[l] <= z && z < pz[k]))
+		   && x < (px[l] - px[k]) * (z - pz[k]) / (pz[l] - pz[k]) + px[k]) {
+			c = !c;
+		}
+	}
+	if(c || !quad[i]) {
+		// PointIn2DPolyXZ() returns c + d, which is only zero if both are
+		return c;
+	}
+	
+	bool e = false;
+	for(size_t k = 1, l = 3; k < 4; l = k++) {
+		if(((pz[k] <= z && z < pz[l]) || (pz[l] <= z && z < pz[k]))
+		   && x < (px[l] - px[k]) * (z - pz[k]) / (pz[l] - pz[k]) + px[k]) {
+			e = !e;
+		}
+	}
+	return e;
+}
+
+bool TileCollision::getPolyY(size_t i, float x, float z, float * ret) const {
+	
+	if(ny[i] == 0.f) {
+		return false;
+	}
+	
+	float y = (d[i] - (nx[i] * x) - (nz[i] * z)) / ny[i];
+	
+	if(y < miny[i]) {
+		y = miny[i];
+	} else if(y > maxy[i]) {
+		y = maxy[i];
+	}
+	
+	*ret = y;
+	return true;
+}
+
+void TileCollision::findFloor(float x, float y, float z,
+                              EERIEPOLY *& found, float & foundY) const {
+	
+	size_t candidates[BlockSize];
+	
+	for(size_t begin = 0; begin < polys.size(); begin += BlockSize) {
+		size_t end = std::min(begin + BlockSize, polys.size());
+		
+		size_t count = 0;
+		for(size_t i = begin; i < end; i++) {
+			candidates[count] = i;
+			count += size_t((x >= minx[i]) & (x <= maxx[i]) & (z >= minz[i]) & (z <= maxz[i])
+			                & (maxy[i] >= y));
+		}
+		
+		for(size_t k = 0; k < count; k++) {
+			size_t i = candidates[k];
+			float rz;
+			if(polys[i] != found
+			   && contains(i, x, z)
+			   && getPolyY(i, x, z, &rz)
+			   && rz >= y
+			   && (!found || rz <= foundY)) {
+				found = polys[i];
+				foundY = rz;
+			}
+		}
+	}
+	
+}
+
+EERIEPOLY * TileCollision::findTop(float x, float y, float z) const {
+	
+	EERIEPOLY * found = NULL;
+	float foundMinY = 0.f;
+	
+	size_t candidates[BlockSize];
+	
+	for(size_t begin = 0; begin < polys.size(); begin += BlockSize) {
+		size_t end = std::min(begin + BlockSize, polys.size());
+		
+		size_t count = 0;
+		for(size_t i = begin; i < end; i++) {
+			candidates[count] = i;
+			count += size_t((miny[i] < y) & (x >= minx[i]) & (x <= maxx[i]) & (z >= minz[i])
+			                & (z <= maxz[i]));
+		}
+		
+		for(size_t k = 0; k < count; k++) {
+			size_t i = candidates[k];
+			
+			if(!contains(i, x, z)) {
+				continue;
+			}
+			
+			const EERIEPOLY * ep = polys[i];
+			if(float(std::fabs(maxy[i] - miny[i])) > 50.f && y - ep->center.y < 60.f) {
+				continue;
+			}
+			
+			if(ep->tex != NULL && (found == NULL || miny[i] > foundMinY)) {
+				found = polys[i];
+				foundMinY = miny[i];
+			}
+		}
+	}
+	
+	return found;
+}
+
+EERIEPOLY * TileCollision::findPolyY(float x, float z, bool largest) const {
+	
+	EERIEPOLY * found = NULL;
+	float foundY = 0.f;
+	
+	size_t candidates[BlockSize];
+	
+	for(size_t begin = 0; begin < polys.size(); begin += BlockSize) {
+		size_t end = std::min(begin + BlockSize, polys.size());
+		
+		// The crossing test in contains() can only succeed inside the Z range of the polygon
+		size_t count = 0;
+		for(size_t i = begin; i < end; i++) {
+			candidates[count] = i;
+			count += size_t((z >= minz[i]) & (z <= maxz[i]));
+		}
+		
+		for(size_t k = 0; k < count; k++) {
+			size_t i = candidates[k];
+			float y;
+			if(contains(i, x, z) && getPolyY(i, x, z, &y)) {
+				if(!found || (largest ? y > foundY : y < foundY)) {
+					found = polys[i];
+					foundY = y;
+				}
+			}
+		}
+	}
+	
+	return found;
+}
+
+EERIEPOLY * TileCollision::findMinPoly(float x, float z) const {
+	return findPolyY(x, z, true);
+}
+
+EERIEPOLY * TileCollision::findMaxPoly(float x, float z) const {
+	return findPolyY(x, z, false);
+}
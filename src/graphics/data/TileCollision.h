@@ -0,0 +1,113 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARX_GRAPHICS_DATA_TILECOLLISION_H
+#define ARX_GRAPHICS_DATA_TILECOLLISION_H
+
+#include <stddef.h>
+#include <vector>
+
+#include "math/Types.h"
+
+struct EERIEPOLY;
+
+/*!
+ * Collision-only copy of the solid polygons relevant for one background tile.
+ *
+ * The collision queries only need the bounds, the plane and the XZ outline of each polygon,
+ * which are scattered over a few hundred bytes in EERIEPOLY. Keeping them in separate arrays
+ * lets the bounds tests run over densely packed data, and the full polygon is only touched
+ * for the few candidates that pass them.
+ *
+ * Only polygons without POLY_WATER, POLY_TRANS or POLY_NOCOL are stored, in the order they
+ * were added. All queries give exactly the same results as the corresponding tests on the
+ * EERIEPOLY list.
+ */
+class TileCollision {
+	
+public:
+	
+	void clear();
+	
+	//! Add a polygon, non-solid polygons are ignored.
+	void add(EERIEPOLY * ep);
+	
+	size_t size() const { return polys.size(); }
+	bool empty() const { return polys.empty(); }
+	
+	EERIEPOLY * get(size_t i) const { return polys[i]; }
+	
+	float getMinY(size_t i) const { return miny[i]; }
+	float getMaxY(size_t i) const { return maxy[i]; }
+	size_t getVertexCount(size_t i) const { return quad[i] ? 4 : 3; }
+	Vec2f getVertex(size_t i, size_t n) const { return Vec2f(vx[i * 4 + n], vz[i * 4 + n]); }
+	
+	//! Equivalent to PointIn2DPolyXZ(get(i), x, z).
+	bool contains(size_t i, float x, float z) const;
+	
+	//! Equivalent to GetTruePolyY(get(i), pos, ret) for any pos at x, z.
+	bool getPolyY(size_t i, float x, float z, float * ret) const;
+	
+	/*!
+	 * Find the closest polygon at or below a position (CheckInPoly for one tile).
+	 * found and foundY hold the best result so far and are updated if a better
+	 * polygon is found, so several tiles can be searched in a row.
+	 */
+	void findFloor(float x, float y, float z, EERIEPOLY *& found, float & foundY) const;
+	
+	//! Find the highest textured polygon above a position (CheckTopPoly for one tile).
+	EERIEPOLY * findTop(float x, float y, float z) const;
+	
+	//! Find the polygon with the largest Y value at x, z (GetMinPoly for one tile).
+	EERIEPOLY * findMinPoly(float x, float z) const;
+	
+	//! Find the polygon with the smallest Y value at x, z (GetMaxPoly for one tile).
+	EERIEPOLY * findMaxPoly(float x, float z) const;
+	
+private:
+	
+	//! Number of polygons filtered at once, limits the candidate buffer on the stack.
+	static const size_t BlockSize = 64;
+	
+	// Axis-aligned bounds
+	std::vector<float> minx;
+	std::vector<float> maxx;
+	std::vector<float> miny;
+	std::vector<float> maxy;
+	std::vector<float> minz;
+	std::vector<float> maxz;
+	
+	// Plane equation: n.x * x + n.y * y + n.z * z = d
+	std::vector<float> nx;
+	std::vector<float> ny;
+	std::vector<float> nz;
+	std::vector<float> d;
+	
+	// XZ outline, four entries per polygon
+	std::vector<float> vx;
+	std::vector<float> vz;
+	std::vector<char> quad;
+	
+	std::vector<EERIEPOLY *> polys;
+	
+	EERIEPOLY * findPolyY(float x, float z, bool largest) const;
+	
+};
+
+#endif // ARX_GRAPHICS_DATA_TILECOLLISION_H
@@ -0,0 +1,277 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "graphics/null/NullRenderer.h"
+
+#include <cstring>
+
+#include "graphics/Vertex.h"
+#include "graphics/image/Image.h"
+#include "graphics/texture/Texture.h"
+#include "graphics/texture/TextureStage.h"
+
+namespace {
+
+class NullTexture2D : public Texture2D {
+	
+public:
+	
+	explicit NullTexture2D(u32 _id) : id(_id) { }
+	
+	bool Create() {
+		storedSize = size;
+		return true;
+	}
+	
+	void Upload() { }
+	void Destroy() { }
+	
+	u32 getId() const { return id; }
+	
+private:
+	
+	u32 id;
+	
+};
+
+class NullTextureStage : public TextureStage {
+	
+public:
+	
+	NullTextureStage(NullRenderer * _renderer, unsigned stage)
+		: TextureStage(stage), renderer(_renderer) { }
+	
+	void setTexture(Texture * texture) {
+		arx_assert(texture != NULL);
+		renderer->onBindTexture(mStage, static_cast<NullTexture2D *>(texture)->getId());
+	}
+	
+	void resetTexture() {
+		renderer->onBindTexture(mStage, 0);
+	}
+	
+	void setColorOp(TextureOp op, TextureArg arg0, TextureArg arg1) {
+		ARX_UNUSED(op), ARX_UNUSED(arg0), ARX_UNUSED(arg1);
+	}
+	void setColorOp(TextureOp op) { ARX_UNUSED(op); }
+	void setAlphaOp(TextureOp op, TextureArg arg0, TextureArg arg1) {
+		ARX_UNUSED(op), ARX_UNUSED(arg0), ARX_UNUSED(arg1);
+	}
+	void setAlphaOp(TextureOp op) { ARX_UNUSED(op); }
+	
+	void setWrapMode(WrapMode wrapMode) { ARX_UNUSED(wrapMode); }
+	
+	void setMinFilter(FilterMode filterMode) { ARX_UNUSED(filterMode); }
+	void setMagFilter(FilterMode filterMode) { ARX_UNUSED(filterMode); }
+	void setMipFilter(FilterMode filterMode) { ARX_UNUSED(filterMode); }
+	
+	void setMipMapLODBias(float bias) { ARX_UNUSED(bias); }
+	
+private:
+	
+	NullRenderer * renderer;
+	
+};
+
+// Enough stages for multitextured SMY_VERTEX3 geometry
+const size_t NullTextureStageCount = 3;
+
+u32 floatBits(float value) {
+	u32 bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+} // anonymous namespace
+
+NullRenderer::NullRenderer() : viewport(0, 0), nextTextureId(0), recording(false) {
+	
+	view.setToIdentity();
+	projection.setToIdentity();
+	
+	std::fill(stateValues, stateValues + StateSlotCount, 0);
+	std::fill(stateKnown, stateKnown + StateSlotCount, false);
+}
+
+NullRenderer::~NullRenderer() { }
+
+void NullRenderer::Initialize() {
+	
+	arx_assert(m_TextureStages.empty());
+	
+	m_TextureStages.resize(NullTextureStageCount, NULL);
+	for(size_t i = 0; i < m_TextureStages.size(); ++i) {
+		m_TextureStages[i] = new NullTextureStage(this, i);
+	}
+	
+	boundTextures.resize(NullTextureStageCount, 0);
+}
+
+void NullRenderer::SetViewMatrix(const EERIEMATRIX & matView) {
+	view = matView;
+	record(ViewCommand);
+}
+
+void NullRenderer::SetProjectionMatrix(const EERIEMATRIX & matProj) {
+	projection = matProj;
+	record(ViewCommand);
+}
+
+Texture2D * NullRenderer::CreateTexture2D() {
+	// Id 0 is reserved for "no texture"
+	return new NullTexture2D(++nextTextureId);
+}
+
+void NullRenderer::SetRenderState(RenderState renderState, bool enable) {
+	onStateChange(StateSlot(renderState), RenderStateCommand, renderState, enable);
+}
+
+void NullRenderer::SetAlphaFunc(PixelCompareFunc func, float fef) {
+	onStateChange(AlphaFuncSlot, AlphaFuncCommand, func, floatBits(fef));
+}
+
+void NullRenderer::SetBlendFunc(PixelBlendingFactor srcFactor, PixelBlendingFactor dstFactor) {
+	onStateChange(BlendFuncSlot, BlendFuncCommand, srcFactor, dstFactor);
+}
+
+void NullRenderer::SetViewport(const Rect & _viewport) {
+	viewport = _viewport;
+	record(ViewCommand);
+}
+
+void NullRenderer::Begin2DProjection(float left, float right, float bottom, float top, float zNear, float zFar) {
+	ARX_UNUSED(left), ARX_UNUSED(right), ARX_UNUSED(bottom), ARX_UNUSED(top), ARX_UNUSED(zNear), ARX_UNUSED(zFar);
+	record(ViewCommand);
+}
+
+void NullRenderer::Clear(BufferFlags bufferFlags, Color clearColor, float clearDepth, size_t nrects, Rect * rect) {
+	ARX_UNUSED(clearColor), ARX_UNUSED(clearDepth);
+	ARX_UNUSED(nrects), ARX_UNUSED(rect);
+	
+	stats.clears++;
+	record(ClearCommand, bufferFlags);
+}
+
+void NullRenderer::SetFogColor(Color color) {
+	ARX_UNUSED(color);
+	stats.stateChanges++;
+	record(FogCommand, u32(-1));
+}
+
+void NullRenderer::SetFogParams(FogMode fogMode, float fogStart, float fogEnd, float fogDensity) {
+	ARX_UNUSED(fogStart), ARX_UNUSED(fogEnd), ARX_UNUSED(fogDensity);
+	stats.stateChanges++;
+	record(FogCommand, fogMode);
+}
+
+void NullRenderer::SetAntialiasing(bool enable) {
+	ARX_UNUSED(enable);
+}
+
+void NullRenderer::SetCulling(CullingMode mode) {
+	onStateChange(CullingSlot, CullingCommand, mode);
+}
+
+void NullRenderer::SetDepthBias(int depthBias) {
+	onStateChange(DepthBiasSlot, DepthBiasCommand, u32(depthBias));
+}
+
+void NullRenderer::SetFillMode(FillMode mode) {
+	onStateChange(FillModeSlot, FillModeCommand, mode);
+}
+
+VertexBuffer<TexturedVertex> * NullRenderer::createVertexBufferTL(size_t capacity, BufferUsage usage) {
+	ARX_UNUSED(usage);
+	return new NullVertexBuffer<TexturedVertex>(this, capacity);
+}
+
+VertexBuffer<SMY_VERTEX> * NullRenderer::createVertexBuffer(size_t capacity, BufferUsage usage) {
+	ARX_UNUSED(usage);
+	return new NullVertexBuffer<SMY_VERTEX>(this, capacity);
+}
+
+VertexBuffer<SMY_VERTEX3> * NullRenderer::createVertexBuffer3(size_t capacity, BufferUsage usage) {
+	ARX_UNUSED(usage);
+	return new NullVertexBuffer<SMY_VERTEX3>(this, capacity);
+}
+
+void NullRenderer::drawIndexed(Primitive primitive, const TexturedVertex * vertices, size_t nvertices, unsigned short * indices, size_t nindices) {
+	ARX_UNUSED(vertices), ARX_UNUSED(indices);
+	onDraw(primitive, nvertices, nindices);
+}
+
+bool NullRenderer::getSnapshot(Image & image) {
+	ARX_UNUSED(image);
+	return false;
+}
+
+bool NullRenderer::getSnapshot(Image & image, size_t width, size_t height) {
+	ARX_UNUSED(image), ARX_UNUSED(width), ARX_UNUSED(height);
+	return false;
+}
+
+void NullRenderer::endFrame() {
+	lastFrameStats = stats;
+	stats.reset();
+	commands.clear();
+}
+
+void NullRenderer::onDraw(Primitive primitive, size_t nvertices, size_t nindices) {
+	
+	stats.draws++;
+	stats.vertices += nvertices;
+	stats.indices += nindices;
+	
+	record(DrawCommand, primitive, u32(nvertices), u32(nindices));
+}
+
+void NullRenderer::onBindTexture(unsigned stage, u32 texture) {
+	
+	arx_assert(stage < boundTextures.size());
+	
+	stats.textureBinds++;
+	if(boundTextures[stage] == texture) {
+		stats.redundantTextureBinds++;
+	}
+	boundTextures[stage] = texture;
+	
+	record(TextureCommand, stage, texture);
+}
+
+void NullRenderer::record(CommandType type, u32 arg0, u32 arg1, u32 arg2) {
+	if(recording) {
+		Command command = { type, arg0, arg1, arg2 };
+		commands.push_back(command);
+	}
+}
+
+void NullRenderer::onStateChange(StateSlot slot, CommandType type, u32 arg0, u32 arg1) {
+	
+	// The render state is already identified by the slot
+	u64 value = (type == RenderStateCommand) ? arg1 : ((u64(arg0) << 32) | arg1);
+	
+	stats.stateChanges++;
+	if(stateKnown[slot] && stateValues[slot] == value) {
+		stats.redundantStateChanges++;
+	}
+	stateKnown[slot] = true;
+	stateValues[slot] = value;
+	
+	record(type, arg0, arg1);
+}
@@ -0,0 +1,263 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARX_GRAPHICS_NULL_NULLRENDERER_H
+#define ARX_GRAPHICS_NULL_NULLRENDERER_H
+
+#include <algorithm>
+#include <vector>
+
+#include "graphics/BaseGraphicsTypes.h"
+#include "graphics/Renderer.h"
+#include "graphics/VertexBuffer.h"
+#include "math/Rectangle.h"
+#include "platform/Platform.h"
+
+/*!
+ * Renderer that does not draw anything.
+ *
+ * All state is accepted and matrices, viewport and buffer contents are stored so that
+ * code reading them back behaves as with a real renderer. This lets the CPU side of the
+ * rendering code run without a window or graphics driver, e.g. for headless benchmarks.
+ *
+ * Draw calls, state changes and texture binds are counted for each frame and can
+ * optionally be recorded in a command log, so that tests can check what a scene renders.
+ * A frame ends when endFrame() is called, which HeadlessWindow does in showFrame().
+ */
+class NullRenderer : public Renderer {
+	
+public:
+	
+	enum CommandType {
+		DrawCommand,        //!< arg0 = Primitive, arg1 = vertex count, arg2 = index count or 0
+		TextureCommand,     //!< arg0 = texture stage, arg1 = texture id or 0 if reset
+		RenderStateCommand, //!< arg0 = RenderState, arg1 = enable
+		AlphaFuncCommand,   //!< arg0 = PixelCompareFunc, arg1 = reference value bits
+		BlendFuncCommand,   //!< arg0 = source factor, arg1 = destination factor
+		CullingCommand,     //!< arg0 = CullingMode
+		DepthBiasCommand,   //!< arg0 = depth bias
+		FillModeCommand,    //!< arg0 = FillMode
+		FogCommand,         //!< arg0 = FogMode or -1 if only the color was changed
+		ClearCommand,       //!< arg0 = BufferFlags
+		ViewCommand,        //!< View or projection matrix or viewport changed
+	};
+	
+	struct Command {
+		CommandType type;
+		u32 arg0;
+		u32 arg1;
+		u32 arg2;
+	};
+	
+	typedef std::vector<Command> CommandLog;
+	
+	struct Stats {
+		
+		size_t draws;
+		size_t vertices;
+		size_t indices;
+		size_t textureBinds;
+		size_t redundantTextureBinds; //!< Binds of the texture that was already bound
+		size_t stateChanges;
+		size_t redundantStateChanges; //!< State changes that set the current value again
+		size_t clears;
+		
+		Stats() { reset(); }
+		
+		void reset() {
+			draws = vertices = indices = 0;
+			textureBinds = redundantTextureBinds = 0;
+			stateChanges = redundantStateChanges = 0;
+			clears = 0;
+		}
+		
+	};
+	
+	NullRenderer();
+	~NullRenderer();
+	
+	void Initialize();
+	
+	// Scene begin/end...
+	void BeginScene() { }
+	void EndScene() { }
+	
+	// Matrices
+	void SetViewMatrix(const EERIEMATRIX & matView);
+	void GetViewMatrix(EERIEMATRIX & matView) const { matView = view; }
+	void SetProjectionMatrix(const EERIEMATRIX & matProj);
+	void GetProjectionMatrix(EERIEMATRIX & matProj) const { matProj = projection; }
+	
+	// Factory
+	Texture2D * CreateTexture2D();
+	
+	// Render states
+	void SetRenderState(RenderState renderState, bool enable);
+	
+	// Alphablending & Transparency
+	void SetAlphaFunc(PixelCompareFunc func, float fef);
+	void SetBlendFunc(PixelBlendingFactor srcFactor, PixelBlendingFactor dstFactor);
+	
+	// Viewport
+	void SetViewport(const Rect & viewport);
+	Rect GetViewport() { return viewport; }
+	
+	// Projection
+	void Begin2DProjection(float left, float right, float bottom, float top, float zNear, float zFar);
+	void End2DProjection() { }
+	
+	// Render Target
+	void Clear(BufferFlags bufferFlags, Color clearColor = Color::none, float clearDepth = 1.f, size_t nrects = 0, Rect * rect = 0);
+	
+	// Fog
+	void SetFogColor(Color color);
+	void SetFogParams(FogMode fogMode, float fogStart, float fogEnd, float fogDensity = 1.0f);
+	bool isFogInEyeCoordinates() { return true; }
+	
+	// Rasterizer
+	void SetAntialiasing(bool enable);
+	void SetCulling(CullingMode mode);
+	void SetDepthBias(int depthBias);
+	void SetFillMode(FillMode mode);
+	
+	float GetMaxAnisotropy() const { return 1.f; }
+	
+	VertexBuffer<TexturedVertex> * createVertexBufferTL(size_t capacity, BufferUsage usage);
+	VertexBuffer<SMY_VERTEX> * createVertexBuffer(size_t capacity, BufferUsage usage);
+	VertexBuffer<SMY_VERTEX3> * createVertexBuffer3(size_t capacity, BufferUsage usage);
+	
+	void drawIndexed(Primitive primitive, const TexturedVertex * vertices, size_t nvertices, unsigned short * indices, size_t nindices);
+	
+	bool getSnapshot(Image & image);
+	bool getSnapshot(Image & image, size_t width, size_t height);
+	
+	/*!
+	 * Enable or disable the command log.
+	 * Statistics are always collected, the log is off by default.
+	 */
+	void setRecording(bool enable) { recording = enable; }
+	bool isRecording() const { return recording; }
+	
+	//! Commands issued since the end of the last frame, if recording is enabled
+	const CommandLog & getCommands() const { return commands; }
+	
+	//! Statistics for the commands issued since the end of the last frame
+	const Stats & getStats() const { return stats; }
+	
+	//! Statistics for the last completed frame
+	const Stats & getLastFrameStats() const { return lastFrameStats; }
+	
+	//! Finish the current frame and clear the statistics and command log.
+	void endFrame();
+	
+	// For the NullRenderer vertex buffers and texture stages
+	void onDraw(Primitive primitive, size_t nvertices, size_t nindices);
+	void onBindTexture(unsigned stage, u32 texture);
+	
+private:
+	
+	// One slot for each render state followed by the other tracked states
+	enum StateSlot {
+		AlphaFuncSlot = ZBias + 1,
+		BlendFuncSlot,
+		CullingSlot,
+		DepthBiasSlot,
+		FillModeSlot,
+		StateSlotCount
+	};
+	
+	void record(CommandType type, u32 arg0 = 0, u32 arg1 = 0, u32 arg2 = 0);
+	void onStateChange(StateSlot slot, CommandType type, u32 arg0, u32 arg1 = 0);
+	
+	EERIEMATRIX view;
+	EERIEMATRIX projection;
+	Rect viewport;
+	
+	u32 nextTextureId;
+	std::vector<u32> boundTextures;
+	
+	u64 stateValues[StateSlotCount];
+	bool stateKnown[StateSlotCount];
+	
+	bool recording;
+	CommandLog commands;
+	Stats stats;
+	Stats lastFrameStats;
+	
+};
+
+/*!
+ * Vertex buffer for the NullRenderer.
+ * The data is kept in system memory so that locked buffers can be read back.
+ */
+template <class Vertex>
+class NullVertexBuffer : public VertexBuffer<Vertex> {
+	
+public:
+	
+	using VertexBuffer<Vertex>::capacity;
+	
+	NullVertexBuffer(NullRenderer * _renderer, size_t capacity) : VertexBuffer<Vertex>(capacity), renderer(_renderer), buffer(new Vertex[capacity]) { }
+	
+	void setData(const Vertex * vertices, size_t count, size_t offset, BufferFlags flags) {
+		ARX_UNUSED(flags);
+		
+		arx_assert(offset + count <= capacity());
+		
+		std::copy(vertices, vertices + count, buffer + offset);
+	}
+	
+	Vertex * lock(BufferFlags flags, size_t offset, size_t count) {
+		ARX_UNUSED(flags), ARX_UNUSED(count);
+		return buffer + offset;
+	}
+	
+	void unlock() {
+		// nothing to do
+	}
+	
+	void draw(Renderer::Primitive primitive, size_t count, size_t offset) const {
+		ARX_UNUSED(offset);
+		
+		arx_assert(offset + count <= capacity());
+		
+		renderer->onDraw(primitive, count, 0);
+	}
+	
+	void drawIndexed(Renderer::Primitive primitive, size_t count, size_t offset, unsigned short * indices, size_t nbindices) const {
+		ARX_UNUSED(offset), ARX_UNUSED(indices);
+		
+		arx_assert(offset + count <= capacity());
+		arx_assert(indices != NULL);
+		
+		renderer->onDraw(primitive, count, nbindices);
+	}
+	
+	~NullVertexBuffer() {
+		delete[] buffer;
+	}
+	
+private:
+	
+	NullRenderer * renderer;
+	Vertex * buffer;
+	
+};
+
+#endif // ARX_GRAPHICS_NULL_NULLRENDERER_H
@@ -4675,3 +4675,99 @@ void Menu2_Close() {
 	delete pMenu, pMenu = NULL;
 	delete pMenuCursor, pMenuCursor = NULL;
 }
+
+static long RemapSavegame(long index, const std::vector<fs::path> & savefiles) {
+	
+	if(index < 0 || size_t(index) >= savefiles.size()) {
+		return -1;
+	}
+	
+	size_t newIndex = savegames.find(savefiles[index]);
+	
+	return (newIndex == size_t(-1)) ? -1 : long(newIndex);
+}
+
+//! The savegame list changed but the load and save menus have not been rebuilt yet.
+static bool savegameMenusOutdated = false;
+
+void Menu2_UpdateSavegames() {
+	
+	std::vector<fs::path> savefiles;
+	
+	bool changed = false;
+	if(ARX_CHANGELEVEL_PollSave()) {
+		savefiles.reserve(savegames.size());
+		for(SaveGameList::iterator i = savegames.begin(); i != savegames.end(); ++i) {
+			savefiles.push_back(i->savefile);
+		}
+		savegames.update();
+		changed = true;
+	} else if(savegames.poll(&savefiles)) {
+		changed = true;
+	}
+	
+	if(!pWindowMenu || !pMenu) {
+		// The menus will be built from the current list
+		savegameMenusOutdated = false;
+		return;
+	}
+	
+	if(!changed && !savegameMenusOutdated) {
+		return;
+	}
+	
+	bool hasList = false;
+	bool selected = false;
+	
+	for(size_t i = 0; i < pWindowMenu->vWindowConsoleElement.size(); i++) {
+		CWindowMenuConsole * p = pWindowMenu->vWindowConsoleElement[i];
+		
+		if(p->eMenuState == EDIT_QUEST_LOAD) {
+			hasList = true;
+			if(changed) {
+				p->lData = RemapSavegame(p->lData, savefiles);
+			}
+			selected = (p->lData != -1);
+		} else if(p->eMenuState == EDIT_QUEST_SAVE_CONFIRM) {
+			if(changed) {
+				p->lData = RemapSavegame(p->lData, savefiles);
+				if(p->MenuAllZone.vMenuZone.size() > 1) {
+					CMenuZone * name = p->MenuAllZone.vMenuZone[1];
+					name->lData = RemapSavegame(name->lData, savefiles);
+				}
+			}
+			continue;
+		} else if(p->eMenuState != EDIT_QUEST_SAVE) {
+			continue;
+		}
+		
+		if(!changed) {
+			continue;
+		}
+		
+		// Savegame list entries
+		for(size_t j = 0; j < p->MenuAllZone.vMenuZone.size(); j++) {
+			CMenuZone * zone = p->MenuAllZone.vMenuZone[j];
+			if(zone->iID == BUTTON_MENUEDITQUEST_LOAD || zone->iID == BUTTON_MENUEDITQUEST_SAVEINFO) {
+				zone->lData = RemapSavegame(zone->lData, savefiles);
+			}
+		}
+	}
+	
+	if(!hasList) {
+		savegameMenusOutdated = false;
+		return;
+	}
+	
+	if(changed) {
+		savegameMenusOutdated = true;
+	}
+	
+	// Rebuild the menus to show new savegames, unless that would drop a selected savegame
+	// or a savegame name that is being entered - the remapped entries stay valid until then.
+	if(savegameMenusOutdated && !selected
+	   && pWindowMenu->eCurrentMenuState != EDIT_QUEST_SAVE_CONFIRM) {
+		pMenu->bReInitAll = true;
+		savegameMenusOutdated = false;
+	}
+}
@@ -671,6 +671,14 @@ private:
 bool Menu2_Render();
 void Menu2_Close();
 
+/*!
+ * Add savegames that have been written or checked in the background to the list.
+ * Menu entries refer to savegames by their index in the sorted list, so they are updated
+ * to point to the same savefile afterwards. The load and save menus are rebuilt to show
+ * new savegames once no savegame is selected and no savegame name is being entered.
+ */
+void Menu2_UpdateSavegames();
+
 bool ProcessFadeInOut(bool _bFadeIn, float _fspeed);
 
 void ARX_MENU_Clicked_NEWQUEST();
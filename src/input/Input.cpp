@@ -52,8 +52,10 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include "core/Application.h"
 #include "core/Config.h"
 #include "core/GameTime.h"
+#include "core/Replay.h"
 #include "graphics/Math.h"
 #include "input/InputBackend.h"
+#include "input/ReplayInputBackend.h"
 #if ARX_HAVE_SDL
 #include "input/SDLInputBackend.h"
 #endif
@@ -207,6 +209,11 @@ Input::Input() : backend(NULL) {
 bool Input::init() {
 	arx_assert(backend == NULL);
 	
+	if(replay::isPlaying() || config.window.framework == "headless") {
+		backend = new ReplayInputBackend;
+		return backend->init();
+	}
+	
 	bool autoBackend = (config.input.backend == "auto");
 	
 	for(int i = 0; i < 2 && !backend; i++) {
@@ -229,6 +236,10 @@ bool Input::init() {
 		}
 	}
 	
+	if(backend && replay::isRecording()) {
+		backend = new RecordingInputBackend(backend);
+	}
+	
 	return (backend != NULL);
 }
 
@@ -0,0 +1,238 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "input/ReplayInputBackend.h"
+
+#include <algorithm>
+
+#include "core/Replay.h"
+
+ReplayInputBackend::ReplayInputBackend() : wheel(0), cursorAbs(Vec2i_ZERO), cursorRel(Vec2i_ZERO) {
+	std::fill_n(keyStates, ARRAY_SIZE(keyStates), false);
+	std::fill_n(buttonStates, ARRAY_SIZE(buttonStates), false);
+	std::fill_n(clickCount, ARRAY_SIZE(clickCount), 0);
+	std::fill_n(unclickCount, ARRAY_SIZE(unclickCount), 0);
+}
+
+bool ReplayInputBackend::init() {
+	// Without a replay there are simply no events.
+	return true;
+}
+
+bool ReplayInputBackend::update() {
+	
+	// Movement and clicks only last for one frame.
+	wheel = 0;
+	cursorRel = Vec2i_ZERO;
+	std::fill_n(clickCount, ARRAY_SIZE(clickCount), 0);
+	std::fill_n(unclickCount, ARRAY_SIZE(unclickCount), 0);
+	
+	const replay::InputEvent * begin, * end;
+	replay::getEvents(begin, end);
+	
+	for(const replay::InputEvent * event = begin; event != end; ++event) {
+		switch(event->type) {
+			
+			case replay::InputEvent::Key: {
+				if(event->key >= Mouse::ButtonBase && event->key < Mouse::ButtonMax) {
+					buttonStates[event->key - Mouse::ButtonBase] = (event->data[0] != 0);
+				} else {
+					keyStates[event->key - Keyboard::KeyBase] = (event->data[0] != 0);
+				}
+				break;
+			}
+			
+			case replay::InputEvent::Click: {
+				arx_assert(event->key >= Mouse::ButtonBase && event->key < Mouse::ButtonMax);
+				clickCount[event->key - Mouse::ButtonBase] = event->data[0];
+				unclickCount[event->key - Mouse::ButtonBase] = event->data[1];
+				break;
+			}
+			
+			case replay::InputEvent::Mouse: {
+				cursorAbs = Vec2i(event->data[0], event->data[1]);
+				cursorRel = Vec2i(event->data[2], event->data[3]);
+				break;
+			}
+			
+			case replay::InputEvent::Wheel: {
+				wheel = event->data[0];
+				break;
+			}
+			
+		}
+	}
+	
+	return true;
+}
+
+bool ReplayInputBackend::getAbsoluteMouseCoords(int & absX, int & absY) const {
+	absX = cursorAbs.x, absY = cursorAbs.y;
+	return true;
+}
+
+void ReplayInputBackend::setAbsoluteMouseCoords(int absX, int absY) {
+	cursorAbs = Vec2i(absX, absY);
+}
+
+void ReplayInputBackend::getRelativeMouseCoords(int & relX, int & relY, int & wheelDir) const {
+	relX = cursorRel.x, relY = cursorRel.y, wheelDir = wheel;
+}
+
+bool ReplayInputBackend::isMouseButtonPressed(int buttonId, int & deltaTime) const {
+	arx_assert(buttonId >= Mouse::ButtonBase && buttonId < Mouse::ButtonMax);
+	deltaTime = 0;
+	return buttonStates[buttonId - Mouse::ButtonBase];
+}
+
+void ReplayInputBackend::getMouseButtonClickCount(int buttonId, int & numClick, int & numUnClick) const {
+	arx_assert(buttonId >= Mouse::ButtonBase && buttonId < Mouse::ButtonMax);
+	size_t i = buttonId - Mouse::ButtonBase;
+	numClick = clickCount[i], numUnClick = unclickCount[i];
+}
+
+bool ReplayInputBackend::isKeyboardKeyPressed(int keyId) const {
+	arx_assert(keyId >= Keyboard::KeyBase && keyId < Keyboard::KeyMax);
+	return keyStates[keyId - Keyboard::KeyBase];
+}
+
+bool ReplayInputBackend::getKeyAsText(int keyId, char & result) const {
+	ARX_UNUSED(keyId), ARX_UNUSED(result);
+	// Text input is not recorded.
+	return false;
+}
+
+RecordingInputBackend::RecordingInputBackend(InputBackend * _backend)
+	: backend(_backend), cursorAbs(Vec2i_ZERO) {
+	std::fill_n(keyStates, ARRAY_SIZE(keyStates), false);
+	std::fill_n(buttonStates, ARRAY_SIZE(buttonStates), false);
+}
+
+RecordingInputBackend::~RecordingInputBackend() {
+	delete backend;
+}
+
+bool RecordingInputBackend::init() {
+	return true;
+}
+
+bool RecordingInputBackend::update() {
+	
+	bool result = backend->update();
+	
+	recordChanges();
+	
+	return result;
+}
+
+void RecordingInputBackend::recordChanges() {
+	
+	if(!replay::hasStarted()) {
+		// Record the state at the first frame as changes from the initial state.
+		return;
+	}
+	
+	replay::InputEvent event;
+	std::fill_n(event.data, ARRAY_SIZE(event.data), 0);
+	
+	event.type = replay::InputEvent::Key;
+	for(int key = Keyboard::KeyBase; key < Keyboard::KeyMax; key++) {
+		bool pressed = backend->isKeyboardKeyPressed(key);
+		if(pressed != keyStates[key - Keyboard::KeyBase]) {
+			keyStates[key - Keyboard::KeyBase] = pressed;
+			event.key = key, event.data[0] = pressed ? 1 : 0;
+			replay::record(event);
+		}
+	}
+	
+	for(int button = Mouse::ButtonBase; button < Mouse::ButtonMax; button++) {
+		
+		int deltaTime;
+		bool pressed = backend->isMouseButtonPressed(button, deltaTime);
+		if(pressed != buttonStates[button - Mouse::ButtonBase]) {
+			buttonStates[button - Mouse::ButtonBase] = pressed;
+			event.type = replay::InputEvent::Key;
+			event.key = button, event.data[0] = pressed ? 1 : 0;
+			replay::record(event);
+		}
+		
+		int clicks, unclicks;
+		backend->getMouseButtonClickCount(button, clicks, unclicks);
+		if(clicks || unclicks) {
+			event.type = replay::InputEvent::Click;
+			event.key = button, event.data[0] = clicks, event.data[1] = unclicks;
+			replay::record(event);
+		}
+	}
+	
+	event.key = -1;
+	
+	Vec2i abs, rel;
+	int wheel;
+	backend->getAbsoluteMouseCoords(abs.x, abs.y);
+	backend->getRelativeMouseCoords(rel.x, rel.y, wheel);
+	if(abs != cursorAbs || rel != Vec2i_ZERO) {
+		cursorAbs = abs;
+		event.type = replay::InputEvent::Mouse;
+		event.data[0] = abs.x, event.data[1] = abs.y, event.data[2] = rel.x, event.data[3] = rel.y;
+		replay::record(event);
+	}
+	
+	if(wheel) {
+		event.type = replay::InputEvent::Wheel;
+		event.data[0] = wheel;
+		replay::record(event);
+	}
+}
+
+void RecordingInputBackend::acquireDevices() {
+	backend->acquireDevices();
+}
+
+void RecordingInputBackend::unacquireDevices() {
+	backend->unacquireDevices();
+}
+
+bool RecordingInputBackend::getAbsoluteMouseCoords(int & absX, int & absY) const {
+	return backend->getAbsoluteMouseCoords(absX, absY);
+}
+
+void RecordingInputBackend::setAbsoluteMouseCoords(int absX, int absY) {
+	backend->setAbsoluteMouseCoords(absX, absY);
+}
+
+void RecordingInputBackend::getRelativeMouseCoords(int & relX, int & relY, int & wheelDir) const {
+	backend->getRelativeMouseCoords(relX, relY, wheelDir);
+}
+
+bool RecordingInputBackend::isMouseButtonPressed(int buttonId, int & deltaTime) const {
+	return backend->isMouseButtonPressed(buttonId, deltaTime);
+}
+
+void RecordingInputBackend::getMouseButtonClickCount(int buttonId, int & numClick, int & numUnClick) const {
+	backend->getMouseButtonClickCount(buttonId, numClick, numUnClick);
+}
+
+bool RecordingInputBackend::isKeyboardKeyPressed(int keyId) const {
+	return backend->isKeyboardKeyPressed(keyId);
+}
+
+bool RecordingInputBackend::getKeyAsText(int keyId, char & result) const {
+	return backend->getKeyAsText(keyId, result);
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARX_INPUT_REPLAYINPUTBACKEND_H
+#define ARX_INPUT_REPLAYINPUTBACKEND_H
+
+#include "input/InputBackend.h"
+#include "input/Keyboard.h"
+#include "input/Mouse.h"
+#include "math/Vector.h"
+
+/*!
+ * Input backend that plays back the events of the current replay, see core/Replay.h
+ * Also used for the headless window framework, where it reports no input without a replay.
+ */
+class ReplayInputBackend : public InputBackend {
+	
+public:
+	
+	ReplayInputBackend();
+	
+	bool init();
+	bool update();
+	
+	void acquireDevices() { }
+	void unacquireDevices() { }
+	
+	// Mouse
+	bool getAbsoluteMouseCoords(int & absX, int & absY) const;
+	void setAbsoluteMouseCoords(int absX, int absY);
+	void getRelativeMouseCoords(int & relX, int & relY, int & wheelDir) const;
+	bool isMouseButtonPressed(int buttonId, int & deltaTime) const;
+	void getMouseButtonClickCount(int buttonId, int & numClick, int & numUnClick) const;
+	
+	// Keyboard
+	bool isKeyboardKeyPressed(int keyId) const;
+	bool getKeyAsText(int keyId, char & result) const;
+	
+private:
+	
+	int wheel;
+	Vec2i cursorAbs;
+	Vec2i cursorRel;
+	bool keyStates[Keyboard::KeyCount];
+	bool buttonStates[Mouse::ButtonCount];
+	int clickCount[Mouse::ButtonCount];
+	int unclickCount[Mouse::ButtonCount];
+	
+};
+
+/*!
+ * Input backend that forwards to another backend and records the input
+ * for the current replay, see core/Replay.h
+ */
+class RecordingInputBackend : public InputBackend {
+	
+public:
+	
+	//! Takes ownership of the backend.
+	explicit RecordingInputBackend(InputBackend * backend);
+	~RecordingInputBackend();
+	
+	bool init();
+	bool update();
+	
+	void acquireDevices();
+	void unacquireDevices();
+	
+	// Mouse
+	bool getAbsoluteMouseCoords(int & absX, int & absY) const;
+	void setAbsoluteMouseCoords(int absX, int absY);
+	void getRelativeMouseCoords(int & relX, int & relY, int & wheelDir) const;
+	bool isMouseButtonPressed(int buttonId, int & deltaTime) const;
+	void getMouseButtonClickCount(int buttonId, int & numClick, int & numUnClick) const;
+	
+	// Keyboard
+	bool isKeyboardKeyPressed(int keyId) const;
+	bool getKeyAsText(int keyId, char & result) const;
+	
+private:
+	
+	void recordChanges();
+	
+	InputBackend * backend;
+	
+	Vec2i cursorAbs;
+	bool keyStates[Keyboard::KeyCount];
+	bool buttonStates[Mouse::ButtonCount];
+	
+};
+
+#endif // ARX_INPUT_REPLAYINPUTBACKEND_H
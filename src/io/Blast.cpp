@@ -39,11 +39,13 @@
 
 #include "io/Blast.h"
 
+#include <algorithm>
 #include <csetjmp> /* for setjmp(), longjmp(), and jmp_buf */
 #include <cstring>
 #include <cstdlib>
 
 #include "io/log/Logger.h"
+#include "platform/Platform.h"
 
 #define MAXBITS 13              /* maximum code length */
 #define MAXWIN 4096             /* maximum window size */
@@ -53,7 +55,7 @@ struct state {
 	
 	/* input limit error return state for bits() and decode() */
 	jmp_buf env;
-
+	
 	/* input state */
 	blast_in infun;             /* input function provided by user */
 	void * inhow;               /* opaque information passed to infun() */
@@ -254,6 +256,26 @@ static int construct(huffman * h, const unsigned char * rep, int n) {
 	return left;
 }
 
+/* bit lengths of literal codes */
+static const unsigned char litlen[] = {
+	11, 124, 8, 7, 28, 7, 188, 13, 76, 4, 10, 8, 12, 10, 12, 10, 8, 23, 8,
+	9, 7, 6, 7, 8, 7, 6, 55, 8, 23, 24, 12, 11, 7, 9, 11, 12, 6, 7, 22, 5,
+	7, 24, 6, 11, 9, 6, 7, 22, 7, 11, 38, 7, 9, 8, 25, 11, 8, 11, 9, 12,
+	8, 12, 5, 38, 5, 38, 5, 11, 7, 5, 6, 21, 6, 10, 53, 8, 7, 24, 10, 27,
+	44, 253, 253, 253, 252, 252, 252, 13, 12, 45, 12, 45, 12, 61, 12, 45,
+	44, 173
+};
+/* bit lengths of length codes 0..15 */
+static const unsigned char lenlen[] = {2, 35, 36, 53, 38, 23};
+/* bit lengths of distance codes 0..63 */
+static const unsigned char distlen[] = {2, 20, 53, 230, 247, 151, 248};
+static const short base[16] = {     /* base for length codes */
+	3, 2, 4, 5, 6, 7, 8, 9, 10, 12, 16, 24, 40, 72, 136, 264
+};
+static const char extra[16] = {     /* extra bits for length codes */
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 3, 4, 5, 6, 7, 8
+};
+
 /*
  * Decode PKWare Compression Library stream.
  *
@@ -308,25 +330,6 @@ static BlastResult blastDecompress(state * s) {
 	static huffman litcode = {litcnt, litsym};   /* length code */
 	static huffman lencode = {lencnt, lensym};   /* length code */
 	static huffman distcode = {distcnt, distsym};/* distance code */
-	/* bit lengths of literal codes */
-	static const unsigned char litlen[] = {
-		11, 124, 8, 7, 28, 7, 188, 13, 76, 4, 10, 8, 12, 10, 12, 10, 8, 23, 8,
-		9, 7, 6, 7, 8, 7, 6, 55, 8, 23, 24, 12, 11, 7, 9, 11, 12, 6, 7, 22, 5,
-		7, 24, 6, 11, 9, 6, 7, 22, 7, 11, 38, 7, 9, 8, 25, 11, 8, 11, 9, 12,
-		8, 12, 5, 38, 5, 38, 5, 11, 7, 5, 6, 21, 6, 10, 53, 8, 7, 24, 10, 27,
-		44, 253, 253, 253, 252, 252, 252, 13, 12, 45, 12, 45, 12, 61, 12, 45,
-		44, 173
-	};
-	/* bit lengths of length codes 0..15 */
-	static const unsigned char lenlen[] = {2, 35, 36, 53, 38, 23};
-	/* bit lengths of distance codes 0..63 */
-	static const unsigned char distlen[] = {2, 20, 53, 230, 247, 151, 248};
-	static const short base[16] = {     /* base for length codes */
-		3, 2, 4, 5, 6, 7, 8, 9, 10, 12, 16, 24, 40, 72, 136, 264
-	};
-	static const char extra[16] = {     /* extra bits for length codes */
-		0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 3, 4, 5, 6, 7, 8
-	};
 	
 	/* set up decoding tables (once--might not be thread-safe) */
 	if(virgin) {
@@ -347,12 +350,15 @@ static BlastResult blastDecompress(state * s) {
 		if(bits(s, 1)) {
 			/* get length */
 			symbol = decode(s, &lencode);
+			if (symbol < 0) return BLAST_INVALID_CODE;
 			len = base[symbol] + bits(s, extra[symbol]);
 			if (len == 519) break;              /* end code */
 			
 			/* get distance */
 			symbol = len == 2 ? 2 : dict;
-			dist = decode(s, &distcode) << symbol;
+			dist = decode(s, &distcode);
+			if (dist < 0) return BLAST_INVALID_CODE;
+			dist <<= symbol;
 			dist += bits(s, symbol);
 			dist++;
 			if (s->first && dist > (int)s->next)
@@ -384,6 +390,7 @@ static BlastResult blastDecompress(state * s) {
 		} else {
 			/* get literal and write it */
 			symbol = lit ? decode(s, &litcode) : bits(s, 8);
+			if (symbol < 0) return BLAST_INVALID_CODE;
 			s->out[s->next++] = symbol;
 			if(s->next == MAXWIN) {
 				if(s->outfun(s->outhow, s->out, s->next)) return BLAST_OUTPUT_ERROR;
@@ -412,13 +419,13 @@ BlastResult blast(blast_in infun, void *inhow, blast_out outfun, void *outhow) {
 	s.outhow = outhow;
 	s.next = 0;
 	s.first = 1;
-	
+
 #if ARX_COMPILER_MSVC
 	// Disable warning C4611: interaction between '_setjmp' and C++ object destruction is non-portable
 	#pragma warning(push)
 	#pragma warning(disable:4611)
 #endif
-
+	
 	BlastResult err;
 	// return if bits() or decode() tries to read past available input
 	if(setjmp(s.env) != 0) {
@@ -440,6 +447,258 @@ BlastResult blast(blast_in infun, void *inhow, blast_out outfun, void *outhow) {
 	return err;
 }
 
+// Table-driven decoder for data that is already in memory.
+
+namespace {
+
+/*
+ * Lookup table for one of the Huffman codes, indexed by the next bits in the stream.
+ * Each entry contains the decoded symbol in the low eight bits and the length of its code
+ * above that. Entries for codes with less bits than the table index are duplicated for all
+ * possible values of the remaining bits. An entry of zero marks an invalid code.
+ */
+template <size_t Bits>
+struct BlastTable {
+	
+	u16 entries[size_t(1) << Bits];
+	
+	explicit BlastTable(const unsigned char * rep, int n);
+	
+	u16 operator[](u64 bitbuf) const { return entries[bitbuf & ((u64(1) << Bits) - 1)]; }
+	
+};
+
+template <size_t Bits>
+BlastTable<Bits>::BlastTable(const unsigned char * rep, int n) {
+	
+	std::memset(entries, 0, sizeof(entries));
+	
+	// Expand the compact code lengths, same as construct()
+	unsigned char length[256];
+	int nsymbols = 0;
+	do {
+		int len = *rep++;
+		int left = (len >> 4) + 1;
+		len &= 15;
+		do {
+			length[nsymbols++] = (unsigned char)len;
+		} while(--left);
+	} while(--n);
+	
+	// Assign canonical codes in the same order as decode() steps through them
+	unsigned code = 0;
+	for(unsigned len = 1; len <= MAXBITS; len++) {
+		for(int symbol = 0; symbol < nsymbols; symbol++) {
+			
+			if(length[symbol] != len) {
+				continue;
+			}
+			
+			arx_assert(len <= Bits);
+			
+			// Codes are stored inverted, starting with the most significant bit
+			unsigned pattern = 0;
+			for(unsigned i = 0; i < len; i++) {
+				pattern |= (((code >> (len - 1 - i)) & 1) ^ 1) << i;
+			}
+			
+			for(size_t i = pattern; i < ARRAY_SIZE(entries); i += size_t(1) << len) {
+				entries[i] = u16((len << 8) | symbol);
+			}
+			
+			code++;
+		}
+		code <<= 1;
+	}
+	
+}
+
+struct BlastTables {
+	
+	BlastTable<MAXBITS> literal;
+	BlastTable<7> length;
+	BlastTable<8> distance;
+	
+	BlastTables()
+		: literal(litlen, sizeof(litlen))
+		, length(lenlen, sizeof(lenlen))
+		, distance(distlen, sizeof(distlen))
+		{ }
+		
+};
+
+// Built during static initialization so that decoding is thread-safe.
+const BlastTables blastTables;
+
+/*
+ * Input stream with a 64-bit bit buffer.
+ * Reading past the end of the input yields zero bits, truncated() reports if any of those
+ * have been consumed.
+ */
+class BlastBitReader {
+	
+	const unsigned char * in;
+	const unsigned char * end;
+	
+	u64 bitbuf;
+	unsigned bitcnt;
+	size_t padding; //!< Number of zero bits appended after the end of the input.
+	
+public:
+	
+	BlastBitReader(const char * data, size_t size)
+		: in(reinterpret_cast<const unsigned char *>(data))
+		, end(reinterpret_cast<const unsigned char *>(data) + size)
+		, bitbuf(0), bitcnt(0), padding(0) { }
+	
+	//! Make sure that at least 57 bits are available.
+	void refill() {
+		
+		if(size_t(end - in) >= 8) {
+			// Load eight bytes at once and keep as many as fit. Bits above bitcnt are either
+			// zero or already contain the same input bytes, so there is no need to mask.
+			u64 value = u64(in[0])       | (u64(in[1]) << 8)  | (u64(in[2]) << 16)
+			          | (u64(in[3]) << 24) | (u64(in[4]) << 32) | (u64(in[5]) << 40)
+			          | (u64(in[6]) << 48) | (u64(in[7]) << 56);
+			bitbuf |= value << bitcnt;
+			in += (63 - bitcnt) >> 3;
+			bitcnt |= 56;
+			return;
+		}
+		
+		while(bitcnt <= 56) {
+			if(in != end) {
+				bitbuf |= u64(*in++) << bitcnt;
+			} else {
+				padding += 8;
+			}
+			bitcnt += 8;
+		}
+	}
+	
+	u64 peek() const { return bitbuf; }
+	
+	void drop(unsigned count) {
+		bitbuf >>= count;
+		bitcnt -= count;
+	}
+	
+	unsigned get(unsigned count) {
+		unsigned value = unsigned(bitbuf & ((u64(1) << count) - 1));
+		drop(count);
+		return value;
+	}
+	
+	//! Decode the next symbol, or return -1 if the next bits are not a valid code.
+	template <class Table>
+	int decode(const Table & table) {
+		u16 entry = table[bitbuf];
+		if(entry == 0) {
+			return -1;
+		}
+		drop(entry >> 8);
+		return entry & 0xff;
+	}
+	
+	//! \return true if any padding bits have been consumed or are in the next lookahead bits.
+	bool truncated(unsigned lookahead = 0) const { return padding + lookahead > bitcnt; }
+	
+};
+
+} // anonymous namespace
+
+BlastResult blastDirect(const char * from, size_t fromSize, char * to, size_t & toSize) {
+	
+	BlastBitReader s(from, fromSize);
+	
+	unsigned char * const begin = reinterpret_cast<unsigned char *>(to);
+	unsigned char * const end = begin + toSize;
+	unsigned char * out = begin;
+	
+	BlastResult result = BLAST_SUCCESS;
+	
+	// Read the header
+	s.refill();
+	unsigned lit = s.get(8);
+	unsigned dict = s.get(8);
+	if(s.truncated() && lit <= 1) {
+		result = BLAST_TRUNCATED_INPUT;
+	} else if(lit > 1) {
+		result = BLAST_INVALID_LITERAL_FLAG;
+	} else if(dict < 4 || dict > 6) {
+		result = BLAST_INVALID_DIC_SIZE;
+	}
+	
+	// Decode literals and length/distance pairs. A pair takes at most 30 bits and a literal
+	// at most 14 bits, so one refill per iteration is enough.
+	while(result == BLAST_SUCCESS) {
+		
+		s.refill();
+		
+		if(s.get(1)) {
+			
+			int symbol = s.decode(blastTables.length);
+			if(symbol < 0) {
+				// blast() only gives up after reading MAXBITS bits
+				result = s.truncated(MAXBITS) ? BLAST_TRUNCATED_INPUT : BLAST_INVALID_CODE;
+				break;
+			}
+			size_t len = size_t(base[symbol]) + s.get(unsigned(extra[symbol]));
+			if(s.truncated()) {
+				result = BLAST_TRUNCATED_INPUT;
+				break;
+			}
+			if(len == 519) {
+				break; // End code
+			}
+			
+			unsigned shift = (len == 2) ? 2 : dict;
+			int code = s.decode(blastTables.distance);
+			if(code < 0) {
+				result = s.truncated(MAXBITS) ? BLAST_TRUNCATED_INPUT : BLAST_INVALID_CODE;
+				break;
+			}
+			size_t dist = (size_t(code) << shift) + s.get(shift) + 1;
+			if(s.truncated()) {
+				result = BLAST_TRUNCATED_INPUT;
+			} else if(dist > size_t(out - begin)) {
+				result = BLAST_INVALID_OFFSET;
+			} else if(len > size_t(end - out)) {
+				result = BLAST_OUTPUT_ERROR;
+			} else {
+				// Copy length bytes from distance bytes back, which may overlap
+				const unsigned char * src = out - dist;
+				if(dist >= len) {
+					std::memcpy(out, src, len);
+					out += len;
+				} else {
+					for(size_t i = 0; i < len; i++) {
+						*out++ = *src++;
+					}
+				}
+			}
+			
+		} else {
+			
+			int symbol = lit ? s.decode(blastTables.literal) : int(s.get(8));
+			if(symbol < 0) {
+				result = s.truncated(MAXBITS) ? BLAST_TRUNCATED_INPUT : BLAST_INVALID_CODE;
+			} else if(s.truncated()) {
+				result = BLAST_TRUNCATED_INPUT;
+			} else if(out == end) {
+				result = BLAST_OUTPUT_ERROR;
+			} else {
+				*out++ = (unsigned char)symbol;
+			}
+			
+		}
+	}
+	
+	toSize = size_t(out - begin);
+	
+	return result;
+}
+
 // Additional functions.
 
 int blastOutMem(void * Param, unsigned char * buf, size_t len) {
@@ -467,7 +726,7 @@ size_t blastInMem(void * Param, const unsigned char ** buf) {
 	
 	p->buf += size;
 	p->size = 0;
-
+	
 	return size;
 }
 
@@ -496,33 +755,50 @@ int blastOutMemRealloc(void * Param, unsigned char * buf, size_t len) {
 
 char * blastMemAlloc(const char * from, size_t fromSize, size_t & toSize) {
 	
-	BlastMemInBuffer in(from, fromSize);
-	BlastMemOutBufferRealloc out;
-	
-	BlastResult error = blast(blastInMem, &in, blastOutMemRealloc, &out);
-	if(error) {
-		LogError << "blastMemAlloc error " << error << " for " << fromSize;
-		toSize = 0;
-		return NULL;
+	// The uncompressed size is not known: guess and start over with a larger buffer
+	// if the output does not fit.
+	size_t allocSize = std::max(fromSize * 4, size_t(MAXWIN));
+	
+	while(true) {
+		
+		char * buf = (char *)malloc(allocSize);
+		if(!buf) {
+			LogError << "blastMemAlloc: could not allocate " << allocSize << " bytes";
+			toSize = 0;
+			return NULL;
+		}
+		
+		size_t size = allocSize;
+		BlastResult error = blastDirect(from, fromSize, buf, size);
+		if(error == BLAST_OUTPUT_ERROR) {
+			free(buf);
+			allocSize *= 2;
+			continue;
+		}
+		
+		if(error) {
+			LogError << "blastMemAlloc error " << error << " for " << fromSize;
+			free(buf);
+			toSize = 0;
+			return NULL;
+		}
+		
+		// TODO realloc to fit fill size?
+		
+		toSize = size;
+		return buf;
 	}
-	
-	// TODO realloc to fit fill size?
-	
-	toSize = out.fillSize;
-	return out.buf;
 }
 
 
 size_t blastMem(const char * from, size_t fromSize, char * to, size_t toSize) {
 	
-	BlastMemInBuffer in(from, fromSize);
-	BlastMemOutBuffer out(to, toSize);
-	
-	BlastResult error = blast(blastInMem, &in, blastOutMem, &out);
+	size_t size = toSize;
+	BlastResult error = blastDirect(from, fromSize, to, size);
 	if(error) {
 		LogError << "blastMem error " << error << " for " << fromSize << "/" << toSize;
 		return 0;
 	}
 	
-	return toSize - out.size;
+	return size;
 }
@@ -67,6 +67,7 @@ enum BlastResult {
 	BLAST_INVALID_LITERAL_FLAG = -1, // literal flag not zero or one
 	BLAST_INVALID_DIC_SIZE = -2, // dictionary size not in 4..6
 	BLAST_INVALID_OFFSET = -3, // distance is too far back
+	BLAST_INVALID_CODE = -4, // no valid Huffman code in the input
 };
 
 /*! Decompress input to output using the provided infun() and outfun() calls.
@@ -147,6 +148,19 @@ size_t blastInMem(void * Param, const unsigned char ** buf);
  */
 int blastOutMemRealloc(void * Param, unsigned char * buf, size_t len);
 
+/*!
+ * Decompress data from memory directly into a buffer.
+ *
+ * Produces the same output as blast() with blastInMem() and blastOutMem(), but decodes
+ * using lookup tables and a 64-bit bit buffer, and writes the output without going through
+ * a callback and window buffer.
+ * For invalid or truncated input the reported error may differ from blast() if the output
+ * buffer is also too small.
+ *
+ * @param toSize Size of the output buffer, set to the number of bytes written.
+ */
+BlastResult blastDirect(const char * from, size_t fromSize, char * to, size_t & toSize);
+
 /*!
  * Decompress data and allocate memory as needed.
  * Returned pointer should be deallocated using free(), not delete.
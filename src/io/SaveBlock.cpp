@@ -474,8 +474,38 @@ bool SaveBlock::defragment() {
 	return handle.is_open();
 }
 
+char * SaveBlock::compress(const char * data, size_t size, size_t & compressedSize) {
+	
+	if(size == 0) {
+		return NULL;
+	}
+	
+	uLongf outSize = size - 1;
+	char * compressed = new char[outSize];
+	if(compress2((Bytef*)compressed, &outSize, (const Bytef*)data, size, 1) != Z_OK) {
+		delete[] compressed;
+		return NULL;
+	}
+	
+	compressedSize = outSize;
+	return compressed;
+}
+
 bool SaveBlock::save(const string & name, const char * data, size_t size) {
 	
+	size_t compressedSize = 0;
+	char * compressed = compress(data, size, compressedSize);
+	
+	bool ret = save(name, data, size, compressed, compressedSize);
+	
+	delete[] compressed;
+	
+	return ret;
+}
+
+bool SaveBlock::save(const string & name, const char * data, size_t size,
+                     const char * compressed, size_t compressedSize) {
+	
 	if(!handle) {
 		return false;
 	}
@@ -493,10 +523,8 @@ bool SaveBlock::save(const string & name, const char * data, size_t size) {
 		return true;
 	}
 	
-	uLongf compressedSize = size - 1;
-	char * compressed = new char[compressedSize];
 	const char * p;
-	if(compress2((Bytef*)compressed, &compressedSize, (const Bytef*)data, size, 1) == Z_OK) {
+	if(compressed) {
 		file->comp = File::Deflate;
 		file->storedSize = compressedSize;
 		p = compressed;
@@ -526,7 +554,6 @@ bool SaveBlock::save(const string & name, const char * data, size_t size) {
 		
 		if(remaining == 0) {
 			file->chunks.erase(++chunk, file->chunks.end());
-			delete[] compressed;
 			return true;
 		}
 	}
@@ -536,8 +563,6 @@ bool SaveBlock::save(const string & name, const char * data, size_t size) {
 	handle.write(p, remaining);
 	totalSize += remaining, usedSize += remaining, chunkCount++;
 	
-	delete[] compressed;
-	
 	return !handle.fail();
 }
 
@@ -140,6 +140,20 @@ public:
 	 */
 	bool save(const std::string & name, const char * data, size_t size);
 	
+	/*!
+	 * Save a file that has already been compressed using compress().
+	 * @param compressed the compressed data or NULL to store the file uncompressed
+	 */
+	bool save(const std::string & name, const char * data, size_t size,
+	          const char * compressed, size_t compressedSize);
+	
+	/*!
+	 * Compress a file for save(). This does not access the save block and can be called
+	 * from any thread.
+	 * @return a new[]-allocated buffer or NULL if the data should be stored uncompressed.
+	 */
+	static char * compress(const char * data, size_t size, size_t & compressedSize);
+	
 	char * load(const std::string & name, size_t & size);
 	bool hasFile(const std::string & name) const;
 	
@@ -0,0 +1,207 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "io/SaveBlockWriter.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "io/SaveBlock.h"
+#include "io/fs/Filesystem.h"
+#include "io/log/Logger.h"
+#include "platform/Thread.h"
+#include "platform/WorkerPool.h"
+
+class SaveBlockWriter::CompressThread : public Thread {
+	
+	SaveBlockWriter & writer;
+	
+public:
+	
+	explicit CompressThread(SaveBlockWriter & _writer) : writer(_writer) {
+		setThreadName("Save Compressor");
+	}
+	
+	void run() {
+		writer.compress();
+	}
+	
+};
+
+class SaveBlockWriter::WriteThread : public Thread {
+	
+	SaveBlockWriter & writer;
+	
+public:
+	
+	explicit WriteThread(SaveBlockWriter & _writer) : writer(_writer) {
+		setThreadName("Save Writer");
+	}
+	
+	void run() {
+		
+		bool success = writer.write();
+		
+		Autolock lock(writer.lock);
+		writer.success = success;
+		writer.finished = true;
+	}
+	
+};
+
+SaveBlockWriter::SaveBlockWriter(const fs::path & _savefile)
+	: savefile(_savefile), next(0), finished(false), success(false), thread(NULL) { }
+
+SaveBlockWriter::~SaveBlockWriter() {
+	
+	wait();
+	
+	for(std::vector<File>::iterator file = files.begin(); file != files.end(); ++file) {
+		delete[] file->data;
+		delete[] file->compressed;
+	}
+}
+
+void SaveBlockWriter::save(const std::string & name, const char * data, size_t size) {
+	
+	arx_assert(!thread);
+	
+	File file;
+	file.name = name;
+	file.data = new char[size];
+	std::memcpy(file.data, data, size);
+	file.size = size;
+	file.compressed = NULL;
+	file.compressedSize = 0;
+	
+	files.push_back(file);
+}
+
+void SaveBlockWriter::start(const std::string & _important, const fs::path & _copy) {
+	
+	arx_assert(!thread);
+	
+	important = _important;
+	copy = _copy;
+	
+	thread = new WriteThread(*this);
+	thread->start();
+}
+
+bool SaveBlockWriter::done() {
+	
+	if(!thread) {
+		return true;
+	}
+	
+	Autolock lock(this->lock);
+	return finished;
+}
+
+bool SaveBlockWriter::wait() {
+	
+	if(thread) {
+		thread->waitForCompletion();
+		delete thread, thread = NULL;
+	}
+	
+	return success;
+}
+
+void SaveBlockWriter::compress() {
+	
+	for(;;) {
+		
+		size_t i;
+		{
+			Autolock lock(this->lock);
+			if(next == files.size()) {
+				return;
+			}
+			i = next++;
+		}
+		
+		File & file = files[i];
+		file.compressed = SaveBlock::compress(file.data, file.size, file.compressedSize);
+	}
+}
+
+bool SaveBlockWriter::write() {
+	
+	// The game continues while the save is written, this thread is one of the compressors.
+	size_t count = getBackgroundWorkerCount() - 1;
+	count = std::min(count, files.size());
+	
+	std::vector<Thread *> compressors(count);
+	for(size_t i = 0; i < count; i++) {
+		compressors[i] = new CompressThread(*this);
+		compressors[i]->start();
+	}
+	
+	compress();
+	
+	for(size_t i = 0; i < count; i++) {
+		compressors[i]->waitForCompletion();
+		delete compressors[i];
+	}
+	
+	{
+		SaveBlock block(savefile);
+		
+		if(!block.open(true)) {
+			LogError << "Opening savegame " << savefile;
+			return false;
+		}
+		
+		for(std::vector<File>::const_iterator file = files.begin(); file != files.end(); ++file) {
+			if(!block.save(file->name, file->data, file->size, file->compressed,
+			               file->compressedSize)) {
+				LogError << "Could not save " << file->name << " to " << savefile;
+				return false;
+			}
+		}
+		
+		if(!block.flush(important)) {
+			LogError << "Could not complete the save";
+			return false;
+		}
+	}
+	
+	if(copy.empty()) {
+		return true;
+	}
+	
+	// Copy to a temporary file first so that the previous save stays intact until the
+	// new one is complete.
+	fs::path tempfile = copy;
+	tempfile.append(".tmp");
+	
+	if(!fs::copy_file(savefile, tempfile, true)) {
+		LogWarning << "Failed to copy save " << savefile << " to " << tempfile;
+		return false;
+	}
+	
+	if(!fs::rename(tempfile, copy, true)) {
+		LogWarning << "Failed to move save " << tempfile << " to " << copy;
+		fs::remove(tempfile);
+		return false;
+	}
+	
+	return true;
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARX_IO_SAVEBLOCKWRITER_H
+#define ARX_IO_SAVEBLOCKWRITER_H
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#include "io/fs/FilePath.h"
+#include "platform/Lock.h"
+
+class Thread;
+
+/*!
+ * Writes files to a save block in the background.
+ *
+ * Files are first collected using save(), which only copies the data. After start() has
+ * been called, the files are compressed in parallel and then written to the save block
+ * on a background thread, so that the caller can continue while the save is completed.
+ */
+class SaveBlockWriter : private boost::noncopyable {
+	
+public:
+	
+	explicit SaveBlockWriter(const fs::path & savefile);
+	
+	//! Wait until the save block has been written, if it was started.
+	~SaveBlockWriter();
+	
+	//! Add a file to be written. Only valid before start() has been called.
+	void save(const std::string & name, const char * data, size_t size);
+	
+	/*!
+	 * Start writing the collected files.
+	 * @param important passed to SaveBlock::flush()
+	 * @param copy if not empty, the completed save block is also copied to this path,
+	 *             replacing any existing file atomically
+	 */
+	void start(const std::string & important, const fs::path & copy = fs::path());
+	
+	//! @return true if the save block has been written and wait() will not block.
+	bool done();
+	
+	/*!
+	 * Wait until the save block has been written.
+	 * @return true if all files were saved successfully.
+	 */
+	bool wait();
+	
+	const fs::path & getSaveFile() const { return savefile; }
+	
+private:
+	
+	struct File {
+		
+		std::string name;
+		char * data;
+		size_t size;
+		char * compressed;
+		size_t compressedSize;
+		
+	};
+	
+	class WriteThread;
+	class CompressThread;
+	
+	//! Compress files until there are none left - called by multiple threads.
+	void compress();
+	
+	//! Compress, write and copy the save block - called by the write thread.
+	bool write();
+	
+	fs::path savefile;
+	std::string important;
+	fs::path copy;
+	
+	std::vector<File> files;
+	
+	Lock lock;
+	size_t next; //!< Index of the next file to compress, protected by lock.
+	bool finished; //!< Protected by lock.
+	bool success;
+	
+	Thread * thread;
+	
+};
+
+#endif // ARX_IO_SAVEBLOCKWRITER_H
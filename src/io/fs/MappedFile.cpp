@@ -0,0 +1,141 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "io/fs/MappedFile.h"
+
+#include "Configure.h"
+
+#include "platform/Platform.h"
+
+#if ARX_PLATFORM == ARX_PLATFORM_WIN32
+#include <windows.h>
+#elif ARX_HAVE_MMAP
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "io/fs/FilePath.h"
+
+namespace fs {
+
+mapped_file::mapped_file() : m_data(NULL), m_size(0), m_handle(NULL) { }
+
+#if ARX_PLATFORM == ARX_PLATFORM_WIN32
+
+bool mapped_file::open(const path & p) {
+	
+	close();
+	
+	HANDLE file = CreateFileA(p.string().c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+	                          OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	
+	LARGE_INTEGER size;
+	if(!GetFileSizeEx(file, &size) || size.QuadPart <= 0 || u64(size.QuadPart) > u64(size_t(-1))) {
+		CloseHandle(file);
+		return false;
+	}
+	
+	HANDLE mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(file); // The mapping object keeps its own reference to the file.
+	if(!mapping) {
+		return false;
+	}
+	
+	const void * data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if(!data) {
+		CloseHandle(mapping);
+		return false;
+	}
+	
+	m_data = reinterpret_cast<const char *>(data);
+	m_size = size_t(size.QuadPart);
+	m_handle = mapping;
+	
+	return true;
+}
+
+void mapped_file::close() {
+	
+	if(m_data) {
+		UnmapViewOfFile(m_data);
+		CloseHandle(m_handle);
+	}
+	
+	m_data = NULL, m_size = 0, m_handle = NULL;
+}
+
+#elif ARX_HAVE_MMAP
+
+bool mapped_file::open(const path & p) {
+	
+	close();
+	
+	int fd = ::open(p.string().c_str(), O_RDONLY);
+	if(fd == -1) {
+		return false;
+	}
+	
+	struct stat buf;
+	if(fstat(fd, &buf) || (buf.st_mode & S_IFMT) != S_IFREG || buf.st_size <= 0
+	   || u64(buf.st_size) > u64(size_t(-1))) {
+		::close(fd);
+		return false;
+	}
+	
+	size_t size = size_t(buf.st_size);
+	
+	void * data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd); // The mapping stays valid after the descriptor is closed.
+	if(data == MAP_FAILED) {
+		return false;
+	}
+	
+	m_data = reinterpret_cast<const char *>(data);
+	m_size = size;
+	
+	return true;
+}
+
+void mapped_file::close() {
+	
+	if(m_data) {
+		munmap(const_cast<char *>(m_data), m_size);
+	}
+	
+	m_data = NULL, m_size = 0;
+}
+
+#else
+
+bool mapped_file::open(const path & p) {
+	ARX_UNUSED(p);
+	return false;
+}
+
+void mapped_file::close() { }
+
+#endif
+
+} // namespace fs
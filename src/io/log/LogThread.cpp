@@ -0,0 +1,89 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "io/log/LogThread.h"
+
+#include <cstdlib>
+
+#include "io/log/Logger.h"
+#include "platform/Thread.h"
+
+namespace logger {
+
+namespace {
+
+class LogThread : public StoppableThread {
+	
+public:
+	
+	LogThread() {
+		setThreadName("Logger");
+	}
+	
+	void run() {
+		
+		while(!isStopRequested() && Logger::waitForQueued()) {
+			Logger::processQueued();
+		}
+		
+	}
+	
+};
+
+LogThread * thread = NULL;
+
+void stopThreadAtExit() {
+	stopThread();
+}
+
+} // anonymous namespace
+
+void startThread() {
+	
+	if(thread) {
+		return;
+	}
+	
+	static bool registered = false;
+	if(!registered) {
+		std::atexit(stopThreadAtExit);
+		registered = true;
+	}
+	
+	// Enable queueing first, otherwise the thread would exit right away
+	Logger::setQueued(true);
+	
+	thread = new LogThread;
+	thread->start();
+}
+
+void stopThread() {
+	
+	if(!thread) {
+		return;
+	}
+	
+	// Stop queueing first so that no messages are left behind - this also wakes the thread
+	Logger::setQueued(false);
+	
+	thread->stop();
+	delete thread, thread = NULL;
+}
+
+} // namespace logger
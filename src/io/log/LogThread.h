@@ -0,0 +1,39 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARX_IO_LOG_LOGTHREAD_H
+#define ARX_IO_LOG_LOGTHREAD_H
+
+namespace logger {
+
+/*!
+ * Start a thread that passes queued log messages on to the backends.
+ *
+ * While the thread is running, logging no longer blocks on slow backends or on other
+ * threads that are logging at the same time, see Logger::setQueued().
+ * The thread is stopped automatically on exit if stopThread() is not called.
+ */
+void startThread();
+
+//! Stop the log thread and write all messages that are still queued.
+void stopThread();
+
+} // namespace logger
+
+#endif // ARX_IO_LOG_LOGTHREAD_H
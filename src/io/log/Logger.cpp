@@ -25,21 +25,199 @@
 #include <algorithm>
 
 #include <boost/foreach.hpp>
+#include <boost/interprocess/sync/interprocess_semaphore.hpp>
 #include <boost/unordered_map.hpp>
 
 #include "io/log/ConsoleLogger.h"
 #include "io/log/LogBackend.h"
 #include "io/log/MsvcLogger.h"
 
+#include "platform/Atomic.h"
 #include "platform/Lock.h"
 #include "platform/ProgramOptions.h"
 
 #include "Configure.h"
 
+#if ARX_HAVE_PTHREADS
+#include <pthread.h>
+#elif ARX_PLATFORM == ARX_PLATFORM_WIN32
+#include <windows.h>
+#endif
+
 using std::string;
 
 namespace {
 
+/*!
+ * Lock-free lookup table from source file to log source and level.
+ *
+ * Entries are only added or changed while holding LogManager::lock and are never removed
+ * until shutdown. The file pointer is written last so that readers never see a partially
+ * initialized entry.
+ */
+class SourceCache {
+	
+public:
+	
+	struct Entry {
+		const char * volatile file;
+		const logger::Source * source;
+		volatile u32 level;
+	};
+	
+	SourceCache() {
+		clear();
+	}
+	
+	const Entry * find(const char * file) const {
+		size_t index = hash(file);
+		for(size_t i = 0; i < MaxProbes; i++, index = (index + 1) % Size) {
+			const char * entryFile = atomicLoad(entries[index].file);
+			if(entryFile == file) {
+				return &entries[index];
+			} else if(!entryFile) {
+				break;
+			}
+		}
+		return NULL;
+	}
+	
+	//! Must be called with LogManager::lock held.
+	void insert(const logger::Source * source) {
+		size_t index = hash(source->file);
+		for(size_t i = 0; i < MaxProbes; i++, index = (index + 1) % Size) {
+			Entry & entry = entries[index];
+			const char * entryFile = entry.file;
+			if(entryFile == source->file) {
+				return;
+			} else if(!entryFile) {
+				entry.source = source;
+				atomicStore(entry.level, u32(source->level));
+				atomicStore(entry.file, source->file);
+				return;
+			}
+		}
+		// The table is crowded here - lookups for this file will take the slow path.
+	}
+	
+	//! Must be called with LogManager::lock held after changing the level of any source.
+	void update() {
+		for(size_t i = 0; i < Size; i++) {
+			if(entries[i].file) {
+				atomicStore(entries[i].level, u32(entries[i].source->level));
+			}
+		}
+	}
+	
+	//! Must be called with LogManager::lock held.
+	void clear() {
+		for(size_t i = 0; i < Size; i++) {
+			atomicStore(entries[i].file, static_cast<const char *>(NULL));
+			entries[i].source = NULL;
+			entries[i].level = 0;
+		}
+	}
+	
+private:
+	
+	static const size_t Size = 1024;
+	static const size_t MaxProbes = 8;
+	
+	static size_t hash(const char * file) {
+		// File names are string constants, their addresses are unique
+		u32 value = u32(reinterpret_cast<size_t>(file) >> 2);
+		return size_t((value * u32(0x9e3779b1)) >> 22) % Size;
+	}
+	
+	Entry entries[Size];
+	
+};
+
+struct LogMessage {
+	
+	u32 sequence;
+	const logger::Source * source;
+	int line;
+	Logger::LogLevel level;
+	string str;
+	
+};
+
+/*!
+ * Fixed-size message queue with a single producer and a single consumer.
+ *
+ * Each thread that logs while queueing is enabled gets its own queue, the consumer is
+ * whoever holds the draining flag in LogManager.
+ */
+class MessageQueue {
+	
+public:
+	
+	MessageQueue() : head(0), tail(0), closed(0) { }
+	
+	//! Add a message to the queue. Must only be called by the owning thread.
+	bool push(u32 sequence, const logger::Source * source, int line, Logger::LogLevel level,
+	          const string & str) {
+		
+		u32 h = head;
+		if(h - atomicLoad(tail) >= Size) {
+			return false;
+		}
+		
+		LogMessage & message = messages[h % Size];
+		message.sequence = sequence;
+		message.source = source;
+		message.line = line;
+		message.level = level;
+		message.str = str;
+		
+		atomicStore(head, h + 1);
+		
+		return true;
+	}
+	
+	//! Move all queued messages to the end of the given list. Must only be called by the consumer.
+	void pop(std::vector<LogMessage> & list) {
+		
+		u32 t = tail;
+		u32 h = atomicLoad(head);
+		if(t == h) {
+			return;
+		}
+		
+		for(; t != h; t++) {
+			LogMessage & message = messages[t % Size];
+			list.resize(list.size() + 1);
+			LogMessage & copy = list.back();
+			copy.sequence = message.sequence;
+			copy.source = message.source;
+			copy.line = message.line;
+			copy.level = message.level;
+			copy.str.swap(message.str);
+		}
+		
+		atomicStore(tail, h);
+	}
+	
+	//! Mark the queue as no longer used after the owning thread exited.
+	void close() { atomicStore(closed, u32(1)); }
+	
+	bool isUnused() const {
+		return atomicLoad(closed) && atomicLoad(head) == atomicLoad(tail);
+	}
+	
+private:
+	
+	static const u32 Size = 256;
+	
+	LogMessage messages[Size];
+	
+	volatile u32 head; //!< Index of the next message to write, owned by the producer.
+	volatile u32 tail; //!< Index of the next message to read, owned by the consumer.
+	volatile u32 closed;
+	
+};
+
 struct LogManager {
 	
 	static const Logger::LogLevel defaultLevel;
@@ -50,6 +228,7 @@ struct LogManager {
 	//! note: using the pointer value of a string constant as a hash map index.
 	typedef boost::unordered_map<const char *, logger::Source> Sources;
 	static Sources sources;
+	static SourceCache cache;
 	
 	typedef std::vector<logger::Backend *> Backends;
 	static Backends backends;
@@ -57,17 +236,73 @@ struct LogManager {
 	typedef boost::unordered_map<string, Logger::LogLevel> Rules;
 	static Rules rules;
 	
+	typedef std::vector<MessageQueue *> Queues;
+	static Queues queues;
+	static volatile u32 queueing;
+	static volatile u32 sequence;
+	static volatile u32 draining;
+	static std::vector<LogMessage> pending;
+	
+	//! Posted when the first message is queued after the last waitForQueued() call.
+	static boost::interprocess::interprocess_semaphore queued;
+	static volatile u32 signalled;
+	
+	static const logger::Source * findSource(const char * file);
+	static Logger::LogLevel getLevel(const char * file);
 	static logger::Source * getSource(const char * file);
+	static void updateLevel(logger::Source & source);
+	static void updateAllLevels();
+	static void updateMinimumLevel();
+	
+	static MessageQueue * getQueue();
+	static bool processQueued(bool cleanup = true);
+	static void freeQueues();
+	
+	static void dispatch(const logger::Source & source, int line, Logger::LogLevel level,
+	                     const string & str);
+	
 	static void deleteAllBackends();
 };
 
 const Logger::LogLevel LogManager::defaultLevel = Logger::Info;
 Logger::LogLevel LogManager::minimumLevel = LogManager::defaultLevel;
 LogManager::Sources LogManager::sources;
+SourceCache LogManager::cache;
 LogManager::Backends LogManager::backends;
 LogManager::Rules LogManager::rules;
+LogManager::Queues LogManager::queues;
+volatile u32 LogManager::queueing = 0;
+volatile u32 LogManager::sequence = 0;
+volatile u32 LogManager::draining = 0;
+std::vector<LogMessage> LogManager::pending;
+boost::interprocess::interprocess_semaphore LogManager::queued(0);
+volatile u32 LogManager::signalled = 0;
 Lock LogManager::lock;
 
+const logger::Source * LogManager::findSource(const char * file) {
+	
+	const SourceCache::Entry * entry = cache.find(file);
+	if(entry) {
+		return entry->source;
+	}
+	
+	Autolock autolock(lock);
+	
+	return getSource(file);
+}
+
+Logger::LogLevel LogManager::getLevel(const char * file) {
+	
+	const SourceCache::Entry * entry = cache.find(file);
+	if(entry) {
+		return Logger::LogLevel(atomicLoad(entry->level));
+	}
+	
+	Autolock autolock(lock);
+	
+	return getSource(file)->level;
+}
+
 logger::Source * LogManager::getSource(const char * file) {
 	
 	LogManager::Sources::iterator i = LogManager::sources.find(file);
@@ -77,27 +312,48 @@ logger::Source * LogManager::getSource(const char * file) {
 	
 	logger::Source * source = &LogManager::sources[file];
 	source->file = file;
-	source->level = LogManager::defaultLevel;
 	
 	const char * end = file + strlen(file);
-	bool first = true;
 	for(const char * p = end; p != file; p--) {
 		if(*p == '/' || *p == '\\') {
-			
 			string component(p + 1, end);
+			size_t pos = component.find_last_of('.');
+			if(pos != string::npos) {
+				component.resize(pos);
+			}
+			source->name = component;
+			break;
+		}
+	}
+	
+	updateLevel(*source);
+	
+	cache.insert(source);
+	
+	return source;
+}
+
+void LogManager::updateLevel(logger::Source & source) {
+	
+	source.level = LogManager::defaultLevel;
+	
+	const char * file = source.file;
+	const char * end = file + strlen(file);
+	bool first = true;
+	for(const char * p = end; p != file; p--) {
+		if(*p == '/' || *p == '\\') {
 			
+			string component;
 			if(first) {
-				size_t pos = component.find_last_of('.');
-				if(pos != string::npos) {
-					component.resize(pos);
-				}
-				source->name = component;
+				component = source.name;
 				first = false;
+			} else {
+				component.assign(p + 1, end);
 			}
 			
 			LogManager::Rules::const_iterator i = LogManager::rules.find(component);
 			if(i != LogManager::rules.end()) {
-				source->level = i->second;
+				source.level = i->second;
 				break;
 			}
 			
@@ -109,7 +365,170 @@ logger::Source * LogManager::getSource(const char * file) {
 		}
 	}
 	
-	return source;
+}
+
+void LogManager::updateAllLevels() {
+	
+	BOOST_FOREACH(Sources::value_type & i, sources) {
+		updateLevel(i.second);
+	}
+	
+	cache.update();
+}
+
+void LogManager::updateMinimumLevel() {
+	LogManager::minimumLevel = LogManager::defaultLevel;
+	BOOST_FOREACH(const LogManager::Rules::value_type & i, LogManager::rules) {
+		LogManager::minimumLevel = std::min(LogManager::minimumLevel, i.second);
+	}
+}
+
+#if ARX_HAVE_PTHREADS
+
+static pthread_key_t queueKey;
+
+static void closeQueue(void * queue) {
+	static_cast<MessageQueue *>(queue)->close();
+}
+
+static bool createQueueKey() {
+	return pthread_key_create(&queueKey, closeQueue) == 0;
+}
+
+static MessageQueue * getThreadQueue() {
+	return static_cast<MessageQueue *>(pthread_getspecific(queueKey));
+}
+
+static void setThreadQueue(MessageQueue * queue) {
+	pthread_setspecific(queueKey, queue);
+}
+
+static void deleteQueueKey() {
+	pthread_key_delete(queueKey);
+}
+
+#elif ARX_PLATFORM == ARX_PLATFORM_WIN32
+
+// There is no notification when a thread exits - queues are only freed by freeQueues().
+static DWORD queueKey;
+
+static bool createQueueKey() {
+	queueKey = TlsAlloc();
+	return queueKey != TLS_OUT_OF_INDEXES;
+}
+
+static MessageQueue * getThreadQueue() {
+	return static_cast<MessageQueue *>(TlsGetValue(queueKey));
+}
+
+static void setThreadQueue(MessageQueue * queue) {
+	TlsSetValue(queueKey, queue);
+}
+
+static void deleteQueueKey() {
+	TlsFree(queueKey);
+}
+
+#endif
+
+static bool queueKeyCreated = false;
+
+MessageQueue * LogManager::getQueue() {
+	
+	MessageQueue * queue = getThreadQueue();
+	if(queue) {
+		return queue;
+	}
+	
+	queue = new MessageQueue;
+	setThreadQueue(queue);
+	
+	Autolock autolock(lock);
+	queues.push_back(queue);
+	
+	return queue;
+}
+
+/*!
+ * Write all queued messages to the backends.
+ *
+ * Must be called with LogManager::lock held, except during a crash.
+ * Messages from each thread are kept in order, messages from different threads
+ * are ordered by the time they were logged.
+ */
+bool LogManager::processQueued(bool cleanup) {
+	
+	if(!atomicCompareExchange(draining, 0, 1)) {
+		// Already being processed
+		return false;
+	}
+	
+	BOOST_FOREACH(MessageQueue * queue, queues) {
+		queue->pop(pending);
+	}
+	
+	bool processed = !pending.empty();
+	
+	if(processed) {
+		
+		std::vector< std::pair<s32, size_t> > order(pending.size());
+		u32 base = pending.front().sequence;
+		for(size_t i = 0; i < pending.size(); i++) {
+			order[i] = std::make_pair(s32(pending[i].sequence - base), i);
+		}
+		std::sort(order.begin(), order.end());
+		
+		for(size_t i = 0; i < order.size(); i++) {
+			const LogMessage & message = pending[order[i].second];
+			dispatch(*message.source, message.line, message.level, message.str);
+		}
+		
+		pending.clear();
+	}
+	
+	if(cleanup) {
+		for(Queues::iterator i = queues.begin(); i != queues.end();) {
+			if((*i)->isUnused()) {
+				delete *i;
+				i = queues.erase(i);
+			} else {
+				++i;
+			}
+		}
+	}
+	
+	atomicStore(draining, u32(0));
+	
+	return processed;
+}
+
+/*!
+ * Free all message queues and the thread-local storage key that points to them.
+ *
+ * Must be called with LogManager::lock held, after queueing has been disabled and the queues
+ * have been processed, and only once all other threads that may log have been joined:
+ * Logger::log() reads the thread's queue and pushes to it without taking any locks,
+ * so a thread that is still running could use a freed queue.
+ * Never call this during a crash.
+ */
+void LogManager::freeQueues() {
+	
+	BOOST_FOREACH(MessageQueue * queue, queues) {
+		delete queue;
+	}
+	queues.clear();
+	
+	if(queueKeyCreated) {
+		deleteQueueKey();
+		queueKeyCreated = false;
+	}
+}
+
+void LogManager::dispatch(const logger::Source & source, int line, Logger::LogLevel level,
+                          const string & str) {
+	for(Backends::const_iterator i = backends.begin(); i != backends.end(); ++i) {
+		(*i)->log(source, line, level, str);
+	}
 }
 
 void LogManager::deleteAllBackends() {
@@ -134,6 +553,8 @@ void Logger::remove(logger::Backend * backend) {
 	
 	Autolock lock(LogManager::lock);
 	
+	LogManager::processQueued();
+	
 	LogManager::backends.erase(std::remove(LogManager::backends.begin(),
 	                                       LogManager::backends.end(),
 	                                        backend),
@@ -146,9 +567,7 @@ bool Logger::isEnabled(const char * file, LogLevel level) {
 		return false;
 	}
 	
-	Autolock lock(LogManager::lock);
-	
-	return (LogManager::getSource(file)->level <= level);
+	return (LogManager::getLevel(file) <= level);
 }
 
 void Logger::log(const char * file, int line, LogLevel level, const string & str) {
@@ -157,16 +576,27 @@ void Logger::log(const char * file, int line, LogLevel level, const string & str
 		return;
 	}
 	
-	Autolock lock(LogManager::lock);
-	
-	const logger::Source * source = LogManager::getSource(file);
+	const logger::Source * source = LogManager::findSource(file);
 	
-	for(LogManager::Backends::const_iterator i = LogManager::backends.begin();
-		  i != LogManager::backends.end(); ++i) {
-		(*i)->log(*source, line, level, str);
+	// Critical messages are written immediately so that they are handled before we exit
+	if(level != Critical && atomicLoad(LogManager::queueing)) {
+		u32 sequence = atomicFetchAdd(LogManager::sequence, 1);
+		MessageQueue * queue = LogManager::getQueue();
+		if(queue->push(sequence, source, line, level, str)) {
+			// Wake up the log thread unless that has already been done
+			if(atomicCompareExchange(LogManager::signalled, 0, 1)) {
+				LogManager::queued.post();
+			}
+			return;
+		}
+		// The queue is full - write everything queued so far to keep messages in order
 	}
 	
-	LogManager::lock.unlock();
+	Autolock lock(LogManager::lock);
+	
+	LogManager::processQueued();
+	
+	LogManager::dispatch(*source, line, level, str);
 }
 
 void Logger::set(const string & prefix, Logger::LogLevel level) {
@@ -188,17 +618,14 @@ void Logger::set(const string & prefix, Logger::LogLevel level) {
 		
 		if(level > oldLevel && oldLevel < LogManager::defaultLevel) {
 			// minimum log level may have changed
-			LogManager::minimumLevel = LogManager::defaultLevel;
-			BOOST_FOREACH(const LogManager::Rules::value_type & i, LogManager::rules) {
-				LogManager::minimumLevel = std::min(LogManager::minimumLevel, i.second);
-			}
+			LogManager::updateMinimumLevel();
 		}
 		
 	}
 	
 	LogManager::minimumLevel = std::min(LogManager::minimumLevel, level);
 	
-	LogManager::sources.clear();
+	LogManager::updateAllLevels();
 }
 
 void Logger::reset(const string & prefix) {
@@ -210,29 +637,66 @@ void Logger::reset(const string & prefix) {
 		return;
 	}
 	
-	if(i->second < LogManager::defaultLevel) {
-		// minimum log level may have changed
-		LogManager::minimumLevel = LogManager::defaultLevel;
-		BOOST_FOREACH(const LogManager::Rules::value_type & i, LogManager::rules) {
-			LogManager::minimumLevel = std::min(LogManager::minimumLevel, i.second);
-		}
-	}
+	bool minimumChanged = (i->second < LogManager::defaultLevel);
 	
 	LogManager::rules.erase(i);
 	
-	LogManager::sources.clear();
+	if(minimumChanged) {
+		LogManager::updateMinimumLevel();
+	}
+	
+	LogManager::updateAllLevels();
 }
 
 void Logger::flush() {
 	
 	Autolock lock(LogManager::lock);
 	
+	LogManager::processQueued();
+	
 	for(LogManager::Backends::const_iterator i = LogManager::backends.begin();
 	    i != LogManager::backends.end(); ++i) {
 		(*i)->flush();
 	}
 }
 
+void Logger::setQueued(bool enable) {
+	
+	Autolock lock(LogManager::lock);
+	
+	if(enable && !queueKeyCreated) {
+		queueKeyCreated = createQueueKey();
+		if(!queueKeyCreated) {
+			return;
+		}
+	}
+	
+	atomicStore(LogManager::queueing, u32(enable ? 1 : 0));
+	
+	if(!enable) {
+		LogManager::processQueued();
+		// Let the log thread know that it is no longer needed
+		LogManager::queued.post();
+	}
+}
+
+bool Logger::processQueued() {
+	
+	Autolock lock(LogManager::lock);
+	
+	return LogManager::processQueued();
+}
+
+bool Logger::waitForQueued() {
+	
+	LogManager::queued.wait();
+	
+	// Reset before the caller processes the queues so that new messages post again
+	atomicStore(LogManager::signalled, u32(0));
+	
+	return atomicLoad(LogManager::queueing) != 0;
+}
+
 void Logger::configure(const string config) {
 	
 	size_t start = 0;
@@ -280,7 +744,7 @@ void Logger::configure(const string config) {
 void Logger::initialize() {
 	
 	add(logger::Console::get());
-	
+
 #if ARX_PLATFORM == ARX_PLATFORM_WIN32
 	add(logger::MsvcDebugger::get());
 #endif
@@ -296,6 +760,11 @@ void Logger::shutdown() {
 	
 	Autolock lock(LogManager::lock);
 	
+	atomicStore(LogManager::queueing, u32(0));
+	LogManager::processQueued();
+	LogManager::freeQueues();
+	
+	LogManager::cache.clear();
 	LogManager::sources.clear();
 	LogManager::rules.clear();
 	
@@ -305,6 +774,13 @@ void Logger::shutdown() {
 }
 
 void Logger::quickShutdown() {
+	
+	// We might have crashed while holding the lock, so don't try to acquire it.
+	// Queued messages are still written unless the crash happened while processing them.
+	// Other threads may still be using their queues, so they are not freed here.
+	atomicStore(LogManager::queueing, u32(0));
+	LogManager::processQueued(/* cleanup = */ false);
+	
 	for(LogManager::Backends::const_iterator i = LogManager::backends.begin();
 	    i != LogManager::backends.end(); ++i) {
 		(*i)->quickShutdown();
@@ -162,9 +162,32 @@ public:
 	
 	/*!
 	 * Flush buffered output in all logging backends.
+	 * Queued messages are written first.
 	 */
 	static void flush();
 	
+	/*!
+	 * Enable or disable queued logging.
+	 * While enabled, log messages other than Critical ones are only appended to a queue owned
+	 * by the logging thread without taking any locks, and processQueued() must be called
+	 * whenever waitForQueued() returns to pass them on to the backends,
+	 * see logger::startThread().
+	 * Disabling queued logging writes all messages that are still queued.
+	 */
+	static void setQueued(bool enable);
+	
+	/*!
+	 * Pass all queued log messages to the backends.
+	 * @return true if there were any queued messages.
+	 */
+	static bool processQueued();
+	
+	/*!
+	 * Wait until new messages have been queued or queued logging has been disabled.
+	 * @return false if queued logging is disabled.
+	 */
+	static bool waitForQueued();
+	
 	/*!
 	* Helper class to pass a C string that might be NULL to the logger.
 	* If the pointer is NULL, the string "NULL" is logged.
@@ -184,10 +207,15 @@ public:
 	static void initialize();
 	
 	/*!
-	 * Shutdown the logging and free all registered backends.
+	 * Shutdown the logging and free all registered backends and message queues.
+	 * Must only be called after all other threads that may log have been joined.
 	 */
 	static void shutdown();
 	
+	/*!
+	 * Write queued messages and close backends after a crash, without taking any locks.
+	 * The message queues are not freed as other threads may still be logging.
+	 */
 	static void quickShutdown();
 };
 
@@ -20,6 +20,7 @@
 #include "io/resource/PakEntry.h"
 
 #include <cstdlib>
+#include <cstring>
 #include <algorithm>
 
 #include "io/log/Logger.h"
@@ -29,6 +30,42 @@
 using std::string;
 using std::find_first_of;
 using std::malloc;
+using std::free;
+
+void PakFileView::borrow(const char * data, size_t size) {
+	reset();
+	m_data = data, m_size = size;
+}
+
+void PakFileView::adopt(char * buffer, size_t size) {
+	reset();
+	m_data = m_buffer = buffer, m_size = size;
+}
+
+void PakFileView::reset() {
+	free(m_buffer);
+	m_data = m_buffer = NULL, m_size = 0;
+}
+
+char * PakFileView::release() {
+	
+	char * buffer = m_buffer;
+	if(!buffer) {
+		buffer = (char *)malloc(m_size);
+		std::memcpy(buffer, m_data, m_size);
+	}
+	
+	m_buffer = NULL;
+	reset();
+	
+	return buffer;
+}
+
+void PakFileView::swap(PakFileView & other) {
+	std::swap(m_data, other.m_data);
+	std::swap(m_size, other.m_size);
+	std::swap(m_buffer, other.m_buffer);
+}
 
 PakFile::~PakFile() {
 	delete _alternative;
@@ -43,6 +80,15 @@ char * PakFile::readAlloc() const {
 	return buffer;
 }
 
+void PakFile::readView(PakFileView & view) const {
+	view.adopt(readAlloc(), size());
+}
+
+bool PakFile::readCompressed(PakFileView & view) const {
+	view.reset();
+	return false;
+}
+
 PakDirectory::PakDirectory() { }
 
 PakDirectory::~PakDirectory() {
@@ -29,6 +29,47 @@ namespace res { class path; }
 
 class PakFileHandle;
 
+/*!
+ * Read-only view of the contents of a PakFile.
+ *
+ * Files that are stored uncompressed in a memory-mapped archive are not copied, the view
+ * then points directly into the mapping and stays valid as long as the archive is loaded.
+ * For all other files the view owns a buffer with a copy of the contents.
+ */
+class PakFileView : private boost::noncopyable {
+	
+	const char * m_data;
+	size_t m_size;
+	char * m_buffer;
+	
+public:
+	
+	PakFileView() : m_data(NULL), m_size(0), m_buffer(NULL) { }
+	
+	~PakFileView() { reset(); }
+	
+	inline const char * data() const { return m_data; }
+	inline size_t size() const { return m_size; }
+	
+	//! Point the view to memory that is owned by someone else.
+	void borrow(const char * data, size_t size);
+	
+	//! Point the view to a buffer allocated with malloc(), it will be freed by the view.
+	void adopt(char * buffer, size_t size);
+	
+	void reset();
+	
+	/*!
+	 * Take the contents out of the view.
+	 * If the view does not own its data, a copy is made.
+	 * @return a buffer that must be freed with free().
+	 */
+	char * release();
+	
+	void swap(PakFileView & other);
+	
+};
+
 class PakFile : private boost::noncopyable {
 	
 private:
@@ -54,6 +95,19 @@ public:
 	virtual void read(void * buf) const = 0;
 	char * readAlloc() const;
 	
+	/*!
+	 * Get the contents of the file, without copying them if possible.
+	 * The default implementation reads the file into a buffer owned by the view.
+	 */
+	virtual void readView(PakFileView & view) const;
+	
+	/*!
+	 * Get the data of the file as it is stored in the archive.
+	 * @return true if the file is compressed and the view has been set to the compressed data,
+	 *         false if the file is not compressed.
+	 */
+	virtual bool readCompressed(PakFileView & view) const;
+	
 	virtual PakFileHandle * open() const = 0;
 	
 };
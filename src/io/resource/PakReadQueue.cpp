@@ -0,0 +1,171 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "io/resource/PakReadQueue.h"
+
+#include "platform/Profiler.h"
+
+PakReadRequest::PakReadRequest(PakReadQueue * _queue, const PakFile * _file)
+	: queue(_queue), file(_file), state(Queued), finished(0) { }
+
+PakReadRequest::~PakReadRequest() {
+	
+	{
+		Autolock lock(queue->lock);
+		if(state == Queued) {
+			queue->requests.erase(position);
+			state = Done;
+			return;
+		}
+	}
+	
+	wait();
+}
+
+void PakReadRequest::wait() {
+	
+	queue->lock.lock();
+	
+	if(state == Queued) {
+		// Don't wait for a worker to pick up the request, read the file ourselves.
+		queue->requests.erase(position);
+		state = Running;
+		queue->lock.unlock();
+		{
+			ARX_PROFILE("Pak read");
+			execute();
+		}
+		queue->lock.lock();
+		state = Done;
+		queue->lock.unlock();
+		return;
+	}
+	
+	bool running = (state == Running);
+	
+	queue->lock.unlock();
+	
+	if(running) {
+		ARX_PROFILE("Pak wait");
+		finished.wait();
+		// Make sure the worker is done posting before the request can be deleted.
+		Autolock lock(queue->lock);
+	}
+}
+
+bool PakReadRequest::done() {
+	Autolock lock(queue->lock);
+	return state == Done;
+}
+
+void PakReadRequest::execute() {
+	
+	file->readView(view);
+	
+	// Files in memory-mapped archives are not read until they are accessed.
+	// Touch every page so that any disk access happens on this thread.
+	const size_t pageSize = 4096;
+	volatile char sum = 0;
+	for(size_t i = 0; i < view.size(); i += pageSize) {
+		sum ^= view.data()[i];
+	}
+}
+
+PakReadQueue::PakReadQueue() : pending(0), stopping(false), workers(NULL) { }
+
+PakReadQueue::~PakReadQueue() {
+	
+	arx_assert(requests.empty());
+	
+	{
+		Autolock lock(this->lock);
+		stopping = true;
+	}
+	
+	pending.post();
+	
+	delete workers;
+}
+
+void PakReadQueue::setWorkers(Workers * _workers) {
+	delete workers;
+	workers = _workers;
+}
+
+PakReadRequest * PakReadQueue::submit(const PakFile * file) {
+	
+	PakReadRequest * request = new PakReadRequest(this, file);
+	
+	{
+		Autolock lock(this->lock);
+		request->position = requests.insert(requests.end(), request);
+	}
+	
+	pending.post();
+	
+	return request;
+}
+
+bool PakReadQueue::process() {
+	
+	pending.wait();
+	
+	PakReadRequest * request;
+	{
+		Autolock lock(this->lock);
+		if(stopping) {
+			// Pass the wakeup on to the next worker.
+			pending.post();
+			return false;
+		}
+		request = take();
+	}
+	
+	// The request may have been taken over by a thread waiting for it.
+	if(request) {
+		ARX_PROFILE("Pak read");
+		request->execute();
+		finish(request);
+	}
+	
+	return true;
+}
+
+PakReadRequest * PakReadQueue::take() {
+	
+	if(requests.empty()) {
+		return NULL;
+	}
+	
+	PakReadRequest * request = requests.front();
+	requests.pop_front();
+	request->state = PakReadRequest::Running;
+	
+	return request;
+}
+
+void PakReadQueue::finish(PakReadRequest * request) {
+	
+	Autolock lock(this->lock);
+	
+	request->state = PakReadRequest::Done;
+	
+	// Post while holding the lock: once the state is Done, the owner may delete the request.
+	request->finished.post();
+}
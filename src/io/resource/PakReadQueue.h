@@ -0,0 +1,146 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARX_IO_RESOURCE_PAKREADQUEUE_H
+#define ARX_IO_RESOURCE_PAKREADQUEUE_H
+
+#include <list>
+
+#include <boost/noncopyable.hpp>
+#include <boost/interprocess/sync/interprocess_semaphore.hpp>
+
+#include "io/resource/PakEntry.h"
+#include "platform/Lock.h"
+
+class PakReadQueue;
+
+/*!
+ * Read of a single file that is processed by the worker threads of a PakReadQueue.
+ *
+ * Deleting a request that has not been started yet cancels it, otherwise the destructor
+ * waits until the file has been read.
+ */
+class PakReadRequest : private boost::noncopyable {
+	
+public:
+	
+	~PakReadRequest();
+	
+	/*!
+	 * Wait until the file has been read.
+	 * If no worker has started reading the file yet, it is read on the calling thread instead.
+	 */
+	void wait();
+	
+	//! @return true if the file has been read and wait() will not block.
+	bool done();
+	
+	//! Contents of the file, only valid after wait() has returned.
+	PakFileView & contents() { return view; }
+	
+private:
+	
+	enum State {
+		Queued,
+		Running,
+		Done
+	};
+	
+	PakReadRequest(PakReadQueue * queue, const PakFile * file);
+	
+	void execute();
+	
+	PakReadQueue * queue;
+	const PakFile * file;
+	
+	State state; //!< Protected by the queue lock.
+	std::list<PakReadRequest *>::iterator position; //!< Position in the queue while Queued.
+	boost::interprocess::interprocess_semaphore finished;
+	
+	PakFileView view;
+	
+	friend class PakReadQueue;
+	
+};
+
+/*!
+ * Queue of files to be read and decompressed in the background.
+ *
+ * The queue itself does not create any threads: worker threads are provided by the
+ * application using setWorkers() and call process() in a loop. Without workers, files are
+ * read when the request is waited for.
+ *
+ * Requests are processed in the order they were submitted.
+ * All requests must be deleted before the queue is destroyed.
+ */
+class PakReadQueue : private boost::noncopyable {
+	
+public:
+	
+	/*!
+	 * Threads calling process() until it returns false.
+	 * The destructor must wait for the threads to exit.
+	 */
+	class Workers : private boost::noncopyable {
+		
+	public:
+		
+		virtual ~Workers() { }
+		
+	};
+	
+	PakReadQueue();
+	
+	//! Stop and delete the workers.
+	~PakReadQueue();
+	
+	//! Set the worker threads for this queue, the queue takes ownership.
+	void setWorkers(Workers * workers);
+	
+	//! Queue a file to be read. The returned request is owned by the caller.
+	PakReadRequest * submit(const PakFile * file);
+	
+	/*!
+	 * Wait for a request and process it - to be called by worker threads.
+	 * @return false if the queue is being destroyed and the worker should exit.
+	 */
+	bool process();
+	
+private:
+	
+	typedef std::list<PakReadRequest *> Requests;
+	
+	//! Get the next queued request and mark it as running, or return NULL if there is none.
+	PakReadRequest * take();
+	
+	//! Mark a request as done and wake up the thread waiting for it.
+	void finish(PakReadRequest * request);
+	
+	Lock lock;
+	Requests requests;
+	boost::interprocess::interprocess_semaphore pending;
+	bool stopping;
+	
+	Workers * workers;
+	
+	friend class PakReadRequest;
+	
+};
+
+#endif // ARX_IO_RESOURCE_PAKREADQUEUE_H
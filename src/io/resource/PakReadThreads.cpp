@@ -0,0 +1,60 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "io/resource/PakReadThreads.h"
+
+#include "platform/Thread.h"
+
+namespace {
+
+class PakReadThread : public Thread {
+	
+	PakReadQueue & queue;
+	
+public:
+	
+	explicit PakReadThread(PakReadQueue & _queue) : queue(_queue) {
+		setThreadName("Resource Loader");
+	}
+	
+	void run() {
+		while(queue.process()) { }
+	}
+	
+};
+
+} // anonymous namespace
+
+PakReadThreads::PakReadThreads(PakReadQueue & queue, unsigned count) {
+	
+	threads.resize(count);
+	
+	for(size_t i = 0; i < threads.size(); i++) {
+		threads[i] = new PakReadThread(queue);
+		threads[i]->start();
+	}
+}
+
+PakReadThreads::~PakReadThreads() {
+	
+	for(size_t i = 0; i < threads.size(); i++) {
+		threads[i]->waitForCompletion();
+		delete threads[i];
+	}
+}
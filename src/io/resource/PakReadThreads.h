@@ -0,0 +1,45 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARX_IO_RESOURCE_PAKREADTHREADS_H
+#define ARX_IO_RESOURCE_PAKREADTHREADS_H
+
+#include <vector>
+
+#include "io/resource/PakReadQueue.h"
+
+class Thread;
+
+//! Worker threads reading and decompressing the files in a PakReadQueue.
+class PakReadThreads : public PakReadQueue::Workers {
+	
+public:
+	
+	PakReadThreads(PakReadQueue & queue, unsigned count);
+	
+	//! Wait for the threads to exit - the queue must already be stopping.
+	~PakReadThreads();
+	
+private:
+	
+	std::vector<Thread *> threads;
+	
+};
+
+#endif // ARX_IO_RESOURCE_PAKREADTHREADS_H
@@ -19,6 +19,7 @@
 
 #include "io/resource/PakReader.h"
 
+#include <cstdlib>
 #include <cstring>
 #include <algorithm>
 #include <iomanip>
@@ -33,11 +34,17 @@
 #include "io/fs/FilePath.h"
 #include "io/fs/Filesystem.h"
 #include "io/fs/FileStream.h"
+#include "io/fs/MappedFile.h"
+#include "io/resource/PakReadQueue.h"
+#include "platform/Lock.h"
 
 namespace {
 
 const size_t PAK_READ_BUF_SIZE = 1024;
 
+//! Serializes access to the streams of archives that are not memory-mapped.
+Lock streamLock;
+
 static PakReader::ReleaseType guessReleaseType(u32 first_bytes) {
 	switch(first_bytes) {
 		case 0x46515641:
@@ -111,6 +118,8 @@ public:
 
 void UncompressedFile::read(void * buf) const {
 	
+	Autolock lock(streamLock);
+	
 	archive.seekg(offset);
 	
 	fs::read(archive, buf, size());
@@ -131,6 +140,8 @@ size_t UncompressedFileHandle::read(void * buf, size_t size) {
 		return 0;
 	}
 	
+	Autolock lock(streamLock);
+	
 	file.archive.seekg(file.offset + offset);
 	
 	if(file.size() < offset + size) {
@@ -185,6 +196,8 @@ public:
 	
 	void read(void * buf) const;
 	
+	bool readCompressed(PakFileView & view) const;
+	
 	PakFileHandle * open() const;
 	
 	friend class CompressedFileHandle;
@@ -237,6 +250,8 @@ size_t blastInFile(void * Param, const unsigned char ** buf) {
 
 void CompressedFile::read(void * buf) const {
 	
+	Autolock lock(streamLock);
+	
 	archive.seekg(offset);
 	
 	BlastFileInBuffer in(&archive, storedSize);
@@ -254,6 +269,25 @@ void CompressedFile::read(void * buf) const {
 	archive.clear();
 }
 
+bool CompressedFile::readCompressed(PakFileView & view) const {
+	
+	Autolock lock(streamLock);
+	
+	archive.seekg(offset);
+	
+	char * buf = reinterpret_cast<char *>(malloc(storedSize));
+	fs::read(archive, buf, storedSize);
+	
+	arx_assert(!archive.fail());
+	arx_assert(size_t(archive.gcount()) == storedSize);
+	
+	archive.clear();
+	
+	view.adopt(buf, storedSize);
+	
+	return true;
+}
+
 PakFileHandle * CompressedFile::open() const {
 	return new CompressedFileHandle(this);
 }
@@ -310,6 +344,8 @@ size_t CompressedFileHandle::read(void * buf, size_t size) {
 		           << " offset=" << offset << " total=" << file.size();
 	}
 	
+	Autolock lock(streamLock);
+	
 	file.archive.seekg(file.offset);
 	
 	BlastFileInBuffer in(&file.archive, file.storedSize);
@@ -363,6 +399,141 @@ size_t CompressedFileHandle::tell() {
 	return offset;
 }
 
+/*! In-memory file contents. */
+class MemoryFileHandle : public PakFileHandle {
+	
+	const char * data;
+	size_t size;
+	size_t offset;
+	
+	//! Buffer allocated with malloc() that is freed with the handle, or NULL.
+	char * buffer;
+	
+public:
+	
+	explicit MemoryFileHandle(const char * _data, size_t _size, char * _buffer = NULL)
+		: data(_data), size(_size), offset(0), buffer(_buffer) { }
+	
+	size_t read(void * buf, size_t size);
+	
+	int seek(Whence whence, int offset);
+	
+	size_t tell();
+	
+	~MemoryFileHandle() { free(buffer); }
+	
+};
+
+size_t MemoryFileHandle::read(void * buf, size_t _size) {
+	
+	if(offset >= size) {
+		return 0;
+	}
+	
+	_size = std::min(_size, size - offset);
+	
+	memcpy(buf, data + offset, _size);
+	offset += _size;
+	
+	return _size;
+}
+
+int MemoryFileHandle::seek(Whence whence, int _offset) {
+	
+	size_t base;
+	switch(whence) {
+		case SeekSet: base = 0; break;
+		case SeekEnd: base = size; break;
+		case SeekCur: base = offset; break;
+		default: return -1;
+	}
+	
+	if((int)base + _offset < 0) {
+		return -1;
+	}
+	
+	offset = (int)base + _offset;
+	
+	return offset;
+}
+
+size_t MemoryFileHandle::tell() {
+	return offset;
+}
+
+/*! Uncompressed file in a memory-mapped .pak file archive. */
+class MappedUncompressedFile : public PakFile {
+	
+	const char * data;
+	
+public:
+	
+	explicit MappedUncompressedFile(const char * _data, size_t size)
+		: PakFile(size), data(_data) { }
+	
+	void read(void * buf) const;
+	
+	void readView(PakFileView & view) const;
+	
+	PakFileHandle * open() const;
+	
+};
+
+void MappedUncompressedFile::read(void * buf) const {
+	memcpy(buf, data, size());
+}
+
+void MappedUncompressedFile::readView(PakFileView & view) const {
+	view.borrow(data, size());
+}
+
+PakFileHandle * MappedUncompressedFile::open() const {
+	return new MemoryFileHandle(data, size());
+}
+
+/*! Compressed file in a memory-mapped .pak file archive. */
+class MappedCompressedFile : public PakFile {
+	
+	const char * data;
+	size_t storedSize;
+	
+public:
+	
+	explicit MappedCompressedFile(const char * _data, size_t size, size_t _storedSize)
+		: PakFile(size), data(_data), storedSize(_storedSize) { }
+	
+	void read(void * buf) const;
+	
+	bool readCompressed(PakFileView & view) const;
+	
+	PakFileHandle * open() const;
+	
+};
+
+void MappedCompressedFile::read(void * buf) const {
+	
+	BlastMemInBuffer in(data, storedSize);
+	BlastMemOutBuffer out(reinterpret_cast<char *>(buf), size());
+	
+	int r = blast(blastInMem, &in, blastOutMem, &out);
+	if(r) {
+		LogError << "Blast error " << r << " outSize=" << size();
+	}
+	
+	arx_assert(out.size == 0);
+}
+
+bool MappedCompressedFile::readCompressed(PakFileView & view) const {
+	view.borrow(data, storedSize);
+	return true;
+}
+
+PakFileHandle * MappedCompressedFile::open() const {
+	// Decompressing the whole file once is cheaper than restarting for every partial read.
+	char * buffer = readAlloc();
+	return new MemoryFileHandle(buffer, size(), buffer);
+}
+
 /*! Plain file not in a .pak file archive. */
 class PlainFile : public PakFile {
 	
@@ -436,43 +607,94 @@ size_t PlainFileHandle::tell() {
 
 PakReader::~PakReader() {
 	clear();
+	delete queue;
 }
 
-bool PakReader::addArchive(const fs::path & pakfile) {
-	
-	fs::ifstream * ifs = new fs::ifstream(pakfile, fs::fstream::in | fs::fstream::binary);
-	
-	if(!ifs->is_open()) {
-		delete ifs;
-		return false;
-	}
+//! Read the FAT of a .pak file archive. The returned buffer must be freed with delete[].
+static char * readFat(const fs::path & pakfile, std::istream & ifs, u32 & fat_size) {
 	
 	// Read fat location and size.
 	u32 fat_offset;
-	u32 fat_size;
 	
-	if(fs::read(*ifs, fat_offset).fail()) {
+	if(fs::read(ifs, fat_offset).fail()) {
 		LogError << pakfile << ": error reading FAT offset";
-		delete ifs;
-		return false;
+		return NULL;
 	}
-	if(ifs->seekg(fat_offset).fail()) {
+	if(ifs.seekg(fat_offset).fail()) {
 		LogError << pakfile << ": error seeking to FAT offset " << fat_offset;
-		delete ifs;
-		return false;
+		return NULL;
 	}
-	if(fs::read(*ifs, fat_size).fail()) {
+	if(fs::read(ifs, fat_size).fail()) {
 		LogError << pakfile << ": error reading FAT size at offset " << fat_offset;
-		delete ifs;
-		return false;
+		return NULL;
 	}
 	
 	// Read the whole FAT.
 	char * fat = new char[fat_size];
-	if(ifs->read(fat, fat_size).fail()) {
+	if(ifs.read(fat, fat_size).fail()) {
 		LogError << pakfile << ": error reading FAT at " << fat_offset
 		         << " with size " << fat_size;
 		delete[] fat;
+		return NULL;
+	}
+	
+	return fat;
+}
+
+//! Copy the FAT out of a memory-mapped .pak file archive so that it can be decrypted.
+static char * readFat(const fs::path & pakfile, const fs::mapped_file & mapping,
+                      u32 & fat_size) {
+	
+	const char * pos = mapping.data();
+	size_t size = mapping.size();
+	
+	u32 fat_offset;
+	if(!safeGet(fat_offset, pos, size)) {
+		LogError << pakfile << ": error reading FAT offset";
+		return NULL;
+	}
+	if(fat_offset > mapping.size()) {
+		LogError << pakfile << ": error seeking to FAT offset " << fat_offset;
+		return NULL;
+	}
+	
+	pos = mapping.data() + fat_offset, size = mapping.size() - fat_offset;
+	if(!safeGet(fat_size, pos, size)) {
+		LogError << pakfile << ": error reading FAT size at offset " << fat_offset;
+		return NULL;
+	}
+	if(fat_size > size) {
+		LogError << pakfile << ": error reading FAT at " << fat_offset
+		         << " with size " << fat_size;
+		return NULL;
+	}
+	
+	char * fat = new char[fat_size];
+	memcpy(fat, pos, fat_size);
+	
+	return fat;
+}
+
+bool PakReader::addArchive(const fs::path & pakfile) {
+	
+	// Prefer mapping the whole archive, so that stored files can be accessed without copies.
+	fs::mapped_file * mapping = new fs::mapped_file;
+	fs::ifstream * ifs = NULL;
+	u32 fat_size;
+	char * fat;
+	if(mapping->open(pakfile)) {
+		fat = readFat(pakfile, *mapping, fat_size);
+	} else {
+		delete mapping, mapping = NULL;
+		ifs = new fs::ifstream(pakfile, fs::fstream::in | fs::fstream::binary);
+		if(!ifs->is_open()) {
+			delete ifs;
+			return false;
+		}
+		fat = readFat(pakfile, *ifs, fat_size);
+	}
+	if(!fat) {
+		delete mapping;
 		delete ifs;
 		return false;
 	}
@@ -489,7 +711,11 @@ bool PakReader::addArchive(const fs::path & pakfile) {
 	
 	char * pos = fat;
 	
-	paks.push_back(ifs);
+	if(mapping) {
+		mappings.push_back(mapping);
+	} else {
+		paks.push_back(ifs);
+	}
 	
 	while(fat_size) {
 		
@@ -529,8 +755,20 @@ bool PakReader::addArchive(const fs::path & pakfile) {
 			}
 			
 			const u32 PAK_FILE_COMPRESSED = 1;
+			bool compressed = (flags & PAK_FILE_COMPRESSED) && size != 0;
 			PakFile * file;
-			if((flags & PAK_FILE_COMPRESSED) && size != 0) {
+			if(mapping) {
+				if(offset > mapping->size() || size > mapping->size() - offset) {
+					LogWarning << pakfile << ": ignoring truncated file " << filename;
+					continue;
+				}
+				const char * data = mapping->data() + offset;
+				if(compressed) {
+					file = new MappedCompressedFile(data, uncompressedSize, size);
+				} else {
+					file = new MappedUncompressedFile(data, size);
+				}
+			} else if(compressed) {
 				file = new CompressedFile(ifs, offset, uncompressedSize, size);
 			} else {
 				file = new UncompressedFile(ifs, offset, size);
@@ -556,6 +794,11 @@ error:
 
 void PakReader::clear() {
 	
+	BOOST_FOREACH(const PrefetchedFiles::value_type & entry, prefetched) {
+		delete entry.second;
+	}
+	prefetched.clear();
+	
 	release = 0;
 	
 	files.clear();
@@ -564,10 +807,22 @@ void PakReader::clear() {
 	BOOST_FOREACH(std::istream * is, paks) {
 		delete is;
 	}
+	paks.clear();
+	
+	BOOST_FOREACH(fs::mapped_file * mapping, mappings) {
+		delete mapping;
+	}
+	mappings.clear();
 }
 
 bool PakReader::read(const res::path & name, void * buf) {
 	
+	PakFileView view;
+	if(takePrefetched(name, view)) {
+		memcpy(buf, view.data(), view.size());
+		return true;
+	}
+	
 	PakFile * f = getFile(name);
 	if(!f) {
 		return false;
@@ -580,6 +835,12 @@ bool PakReader::read(const res::path & name, void * buf) {
 
 char * PakReader::readAlloc(const res::path & name, size_t & sizeRead) {
 	
+	PakFileView view;
+	if(takePrefetched(name, view)) {
+		sizeRead = view.size();
+		return view.release();
+	}
+	
 	PakFile * f = getFile(name);
 	if(!f) {
 		return NULL;
@@ -590,6 +851,23 @@ char * PakReader::readAlloc(const res::path & name, size_t & sizeRead) {
 	return f->readAlloc();
 }
 
+bool PakReader::readView(const res::path & name, PakFileView & view) {
+	
+	if(takePrefetched(name, view)) {
+		return true;
+	}
+	
+	PakFile * f = getFile(name);
+	if(!f) {
+		view.reset();
+		return false;
+	}
+	
+	f->readView(view);
+	
+	return true;
+}
+
 PakFileHandle * PakReader::open(const res::path & name) {
 	
 	PakFile * f = getFile(name);
@@ -600,6 +878,73 @@ PakFileHandle * PakReader::open(const res::path & name) {
 	return f->open();
 }
 
+PakReadRequest * PakReader::readAsync(const res::path & name) {
+	
+	PakFile * f = getFile(name);
+	if(!f) {
+		return NULL;
+	}
+	
+	return getReadQueue().submit(f);
+}
+
+PakReadQueue & PakReader::getReadQueue() {
+	
+	if(!queue) {
+		queue = new PakReadQueue;
+	}
+	
+	return *queue;
+}
+
+void PakReader::prefetch(const std::vector<res::path> & names) {
+	BOOST_FOREACH(const res::path & name, names) {
+		prefetch(name);
+	}
+}
+
+void PakReader::prefetch(const res::path & name) {
+	
+	if(prefetched.find(name) != prefetched.end()) {
+		return;
+	}
+	
+	PakReadRequest * request = readAsync(name);
+	if(request) {
+		prefetched[name] = request;
+	}
+}
+
+bool PakReader::takePrefetched(const res::path & name, PakFileView & view) {
+	
+	if(prefetched.empty()) {
+		return false;
+	}
+	
+	PrefetchedFiles::iterator it = prefetched.find(name);
+	if(it == prefetched.end()) {
+		return false;
+	}
+	
+	PakReadRequest * request = it->second;
+	prefetched.erase(it);
+	
+	request->wait();
+	view.swap(request->contents());
+	delete request;
+	
+	return true;
+}
+
+void PakReader::dropPrefetched(const res::path & name) {
+	
+	PrefetchedFiles::iterator it = prefetched.find(name);
+	if(it != prefetched.end()) {
+		delete it->second;
+		prefetched.erase(it);
+	}
+}
+
 bool PakReader::addFiles(const fs::path & path, const res::path & mount) {
 	
 	if(fs::is_directory(path)) {
@@ -625,6 +970,8 @@ bool PakReader::addFiles(const fs::path & path, const res::path & mount) {
 
 void PakReader::removeFile(const res::path & file) {
 	
+	dropPrefetched(file);
+	
 	PakDirectory * dir = getDirectory(file.parent());
 	if(dir) {
 		dir->removeFile(file.filename());
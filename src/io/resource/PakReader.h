@@ -20,6 +20,7 @@
 #ifndef ARX_IO_RESOURCE_PAKREADER_H
 #define ARX_IO_RESOURCE_PAKREADER_H
 
+#include <map>
 #include <vector>
 #include <istream>
 
@@ -29,7 +30,9 @@
 #include "io/resource/ResourcePath.h"
 #include "platform/Flags.h"
 
-namespace fs { class path; }
+namespace fs { class path; class mapped_file; }
+class PakReadQueue;
+class PakReadRequest;
 
 enum Whence {
 	SeekSet,
@@ -62,7 +65,7 @@ public:
 	};
 	DECLARE_FLAGS(ReleaseType, ReleaseFlags)
 	
-	inline PakReader() : release(0) { }
+	inline PakReader() : release(0), queue(NULL) { }
 	~PakReader();
 	
 	void removeFile(const res::path & name);
@@ -93,14 +96,54 @@ public:
 	bool read(const res::path & name, void * buf);
 	char * readAlloc(const res::path & name , size_t & size);
 	
+	/*!
+	 * Get the contents of a file, without copying them if the archive is memory-mapped.
+	 * @return false if the file does not exist.
+	 */
+	bool readView(const res::path & name, PakFileView & view);
+	
 	PakFileHandle * open(const res::path & name);
 	
+	/*!
+	 * Start reading a file on a worker thread.
+	 * The returned request is owned by the caller and must be deleted before the file is
+	 * removed or the reader is cleared.
+	 * @return NULL if the file does not exist.
+	 */
+	PakReadRequest * readAsync(const res::path & name);
+	
+	/*!
+	 * Start reading files on worker threads, so that later calls to read(), readAlloc()
+	 * or readView() for those files don't have to wait for decompression.
+	 * Files that do not exist are ignored.
+	 */
+	void prefetch(const std::vector<res::path> & names);
+	void prefetch(const res::path & name);
+	
+	/*!
+	 * Get the queue used for asynchronous reads.
+	 * Files are only read in the background once worker threads have been set for the queue.
+	 */
+	PakReadQueue & getReadQueue();
+	
 	inline ReleaseFlags getReleaseType() { return release; }
 	
 private:
 	
 	ReleaseFlags release;
 	std::vector<std::istream *> paks;
+	std::vector<fs::mapped_file *> mappings;
+	
+	typedef std::map<res::path, PakReadRequest *> PrefetchedFiles;
+	PakReadQueue * queue;
+	PrefetchedFiles prefetched;
+	
+	/*!
+	 * Get the contents of a file that has been prefetched.
+	 * @return false if the file was not prefetched.
+	 */
+	bool takePrefetched(const res::path & name, PakFileView & view);
+	void dropPrefetched(const res::path & name);
 	
 	bool addFiles(PakDirectory * dir, const fs::path & path);
 	bool addFile(PakDirectory * dir, const fs::path & path, const std::string & name);
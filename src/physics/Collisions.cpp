@@ -46,13 +46,17 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 
 #include "physics/Collisions.h"
 
+#include "ai/PathFinderManager.h"
 #include "core/GameTime.h"
 #include "core/Core.h"
 #include "game/Damage.h"
+#include "game/EntityGrid.h"
 #include "game/EntityManager.h"
 #include "game/NPC.h"
 #include "game/Player.h"
 #include "graphics/Math.h"
+#include "graphics/data/BackgroundBVH.h"
+#include "graphics/data/TileCollision.h"
 #include "physics/Anchors.h"
 #include "scene/Interactive.h"
 
@@ -76,22 +80,25 @@ bool DIRECT_PATH=true;
 
 //-----------------------------------------------------------------------------
 // Added immediate return (return anything;)
-inline float IsPolyInCylinder(EERIEPOLY * ep, EERIE_CYLINDER * cyl, long flag) {
+// The bounds and vertex distance tests only use the collision data, the polygon itself
+// is only read if they pass.
+inline float IsPolyInCylinder(const TileCollision & collision, size_t i, EERIE_CYLINDER * cyl,
+                              long flag) {
 
 	long flags = flag;
 	POLYIN = 0;
 	float minf = cyl->origin.y + cyl->height;
 	float maxf = cyl->origin.y;
 
-	if(minf > ep->max.y || maxf < ep->min.y)
+	if(minf > collision.getMaxY(i) || maxf < collision.getMinY(i))
 		return 999999.f;
 	
-	long to = (ep->type & POLY_QUAD) ? 4 : 3;
+	long to = collision.getVertexCount(i);
 
 	float nearest = 99999999.f;
 
 	for(long num = 0; num < to; num++) {
-		float dd = fdist(Vec2f(ep->v[num].p.x, ep->v[num].p.z), Vec2f(cyl->origin.x, cyl->origin.z));
+		float dd = fdist(collision.getVertex(i, num), Vec2f(cyl->origin.x, cyl->origin.z));
 
 		if(dd < nearest) {
 			nearest = dd;
@@ -100,6 +107,8 @@ inline float IsPolyInCylinder(EERIEPOLY * ep, EERIE_CYLINDER * cyl, long flag) {
 
 	if(nearest > max(82.f, cyl->radius))
 		return 999999.f;
+	
+	const EERIEPOLY * ep = collision.get(i);
 
 	if(cyl->radius < 30.f
 	   || cyl->height > -80.f
@@ -538,18 +547,16 @@ float CheckAnythingInCylinder(EERIE_CYLINDER * cyl,Entity * ioo,long flags) {
 			continue;
 
 
-		FAST_BKG_DATA * feg = &ACTIVEBKG->fastdata[i][j];
-		for(long k = 0; k < feg->nbpoly; k++) {
-			ep = &feg->polydata[k];
-
-			if(ep->type & (POLY_WATER | POLY_TRANS | POLY_NOCOL))
-				continue;
+		const TileCollision * collision = ACTIVEBKG->fastdata[i][j].polydataCollision;
+		if(!collision)
+			continue;
 
-			if(ep->min.y < anything) {
-				anything= min(anything, IsPolyInCylinder(ep, cyl, flags));
+		for(size_t k = 0; k < collision->size(); k++) {
+			if(collision->getMinY(k) < anything) {
+				anything= min(anything, IsPolyInCylinder(*collision, k, cyl, flags));
 
 				if(POLYIN) {
-					if(ep->type & POLY_CLIMB)
+					if(collision->get(k)->type & POLY_CLIMB)
 						COLLIDED_CLIMB_POLY = 1;
 				}
 			}
@@ -567,20 +574,33 @@ float CheckAnythingInCylinder(EERIE_CYLINDER * cyl,Entity * ioo,long flags) {
 	if(!(flags & CFLAG_NO_INTERCOL)) {
 		Entity * io;
 		long FULL_TEST = 0;
-		long AMOUNT = TREATZONE_CUR;
 
 		if(ioo
 			&& (ioo->ioflags & IO_NPC)
 			&& (ioo->_npcdata->pathfind.flags & PATHFIND_ALWAYS))
 		{
 			FULL_TEST = 1;
-			AMOUNT = entities.size();
+		}
+		
+		// Only entities closer than 1000 are tested below
+		std::vector<size_t> found;
+		std::vector<long> slots;
+		size_t count;
+		if(FULL_TEST) {
+			entityGrid.query(cyl->origin, 1000.f, found);
+			count = found.size();
+		} else {
+			TREATZONE_Query(cyl->origin, 1000.f, slots);
+			count = slots.size();
 		}
 
-		for(long i = 0; i < AMOUNT; i++) {
+		for(size_t n = 0; n < count; n++) {
+			long i;
 			if(FULL_TEST) {
+				i = long(found[n]);
 				io = entities[i];
 			} else {
+				i = slots[n];
 				io = treatio[i].io;
 			}
 
@@ -862,10 +882,19 @@ bool CheckEverythingInSphere(EERIE_SPHERE * sphere, long source, long targ, std:
 	float sr30 = sphere->radius + 20.f;
 	float sr40 = sphere->radius + 30.f;
 	float sr180 = sphere->radius + 500.f;
-
-	for(long i = 0; i < TREATZONE_CUR; i++) {
+	
+	// Entities farther away than sr180 (or 440 + radius for platforms) are skipped below
+	std::vector<long> slots;
+	size_t count;
+	if(targ > -1) {
+		count = (TREATZONE_CUR > 0) ? 1 : 0;
+	} else {
+		TREATZONE_Query(sphere->origin, sr180, slots);
+		count = slots.size();
+	}
+	
+	for(size_t n = 0; n < count; n++) {
 		if(targ > -1) {
-			i = TREATZONE_CUR;
 			io = entities[targ];
 
 			if(!io
@@ -880,6 +909,7 @@ bool CheckEverythingInSphere(EERIE_SPHERE * sphere, long source, long targ, std:
 
 			ret_idx = targ;
 		} else {
+			long i = slots[n];
 			if(treatio[i].show != 1
 			   || treatio[i].io == NULL
 			   || treatio[i].num == source
@@ -940,7 +970,8 @@ bool CheckEverythingInSphere(EERIE_SPHERE * sphere, long source, long targ, std:
 			}
 		}
 
-		if(closerThan(io->pos, sphere->origin, sr180)) {
+		if(closerThan(io->pos, sphere->origin, sr180)
+		   && entityGrid.mayTouch(io, sphere->origin, sr40)) {
 
 			long amount = 1;
 			std::vector<EERIE_VERTEX> & vlist = io->obj->vertexlist3;
@@ -1065,8 +1096,14 @@ bool CheckAnythingInSphere(EERIE_SPHERE * sphere, long source, CASFlags flags, l
 	float sr30 = sphere->radius + 20.f;
 	float sr40 = sphere->radius + 30.f;
 	float sr180 = sphere->radius + 500.f;
+	
+	// Entities farther away than sr180 (or 440 + radius for platforms) are skipped below
+	std::vector<long> slots;
+	TREATZONE_Query(sphere->origin, sr180, slots);
 
-	for(long i = 0; i < TREATZONE_CUR; i++) {
+	for(size_t n = 0; n < slots.size(); n++) {
+		
+		long i = slots[n];
 		
 		if(treatio[i].show != 1 || !treatio[i].io || treatio[i].num == source)
 			continue;
@@ -1133,7 +1170,8 @@ bool CheckAnythingInSphere(EERIE_SPHERE * sphere, long source, CASFlags flags, l
 			}
 		}
 
-		if(closerThan(io->pos, sphere->origin, sr180)) {
+		if(closerThan(io->pos, sphere->origin, sr180)
+		   && entityGrid.mayTouch(io, sphere->origin, sr40)) {
 			long amount = 1;
 			std::vector<EERIE_VERTEX> & vlist = io->obj->vertexlist3;
 
@@ -1185,7 +1223,8 @@ bool CheckIOInSphere(EERIE_SPHERE * sphere, long target, bool ignoreNoCollisionF
 	   && (io->gameFlags & GFLAG_ISINTREATZONE)
 	   && (io->obj)
 	) {
-		if(closerThan(io->pos, sphere->origin, sr180)) {
+		if(closerThan(io->pos, sphere->origin, sr180)
+		   && entityGrid.mayTouch(io, sphere->origin, sr30 + 20.f)) {
 			vector<EERIE_VERTEX> & vlist = io->obj->vertexlist3;
 
 			if(io->obj->nbgroups>10) {
@@ -1579,138 +1618,120 @@ bool ARX_COLLISION_Move_Cylinder(IO_PHYSICS * ip, Entity * io, float MOVE_CYLIND
 	return true;
 }
 
-//TODO copy-paste
 bool IO_Visible(Vec3f * orgn, Vec3f * dest, EERIEPOLY * epp, Vec3f * hit)
 {
 	float ix,iy,iz;
-	long px,pz;
-	EERIEPOLY *ep;
-
-	FAST_BKG_DATA *feg;
 	float pas = 35.f;
- 
-	Vec3f found_hit = Vec3f_ZERO;
-	EERIEPOLY *found_ep = NULL;
 	float iter,t;
-
-	//current ray pos
-	float x = orgn->x;
-	float y = orgn->y;
-	float z = orgn->z;
-
+	
 	float distance;
 	float nearest = distance = fdist(*orgn, *dest);
-
-	if(distance < pas)
-		pas = distance * .5f;
-
-	// ray incs
-	float dx = (dest->x - orgn->x);
-	float dy = (dest->y - orgn->y);
-	float dz = (dest->z - orgn->z);
-
-	// absolute ray incs
-	float adx = EEfabs(dx);
-	float ady = EEfabs(dy);
-	float adz = EEfabs(dz);
-
-	if(adx >= ady && adx >= adz) {
-		if(adx != dx)
-			ix = -pas;
-		else
-			ix = pas;
-
-		iter = adx / pas;
-		t = 1.f / (iter);
-		iy = dy * t;
-		iz = dz * t;
-	} else if(ady >= adx && ady >= adz) {
-		if(ady != dy)
-			iy = -pas;
-		else
-			iy = pas;
-
-		iter = ady / pas;
-		t = 1.f / (iter);
-		ix = dx * t;
-		iz = dz * t;
-	} else {
-		if(adz != dz)
-			iz = -pas;
-		else
-			iz = pas;
-
-		iter = adz / pas;
-		t = 1.f / (iter);
-		ix = dx * t;
-		iy = dy * t;
+	
+	EERIEPOLY * found_ep = NULL;
+	Vec3f found_hit = Vec3f_ZERO;
+	
+	if(ACTIVEBKG->bvh) {
+		BackgroundBVH::Hit first = ACTIVEBKG->bvh->intersect(*orgn, *dest,
+		                                                     POLY_WATER | POLY_TRANS | POLY_NOCOL);
+		if(first.poly) {
+			found_ep = first.poly;
+			found_hit = *orgn + (*dest - *orgn) * first.t;
+			nearest = distance * first.t;
+		}
 	}
-
-	float dd;
-	x -= ix;
-	y -= iy;
-	z -= iz;
-
-	while(iter > 0.f) {
-		iter -= 1.f;
-		x += ix;
-		y += iy;
-		z += iz;
-
-		EERIE_SPHERE sphere;
-		sphere.origin.x=x;
-		sphere.origin.y=y;
-		sphere.origin.z=z;
-		sphere.radius=65.f;
-
-		for(size_t num = 0; num < entities.size(); num++) {
-			Entity * io = entities[num];
-
-			if(io && (io->gameFlags & GFLAG_VIEW_BLOCKER)) {
-				if(CheckIOInSphere(&sphere, num)) {
-					dd = fdist(*orgn, sphere.origin);
-
-					if(dd < nearest) {
-						hit->x=x;
-						hit->y=y;
-						hit->z=z;
-						return false;
-					}
-				}
-			}
+	
+	vector<long> blockers;
+	for(size_t num = 0; num < entities.size(); num++) {
+		Entity * io = entities[num];
+		if(io && (io->gameFlags & GFLAG_VIEW_BLOCKER)) {
+			blockers.push_back(num);
 		}
-
-		px = (long)(x * ACTIVEBKG->Xmul);
-		pz = (long)(z * ACTIVEBKG->Zmul);
-
-		if(px < 0 || px >= ACTIVEBKG->Xsize || pz < 0 || pz >= ACTIVEBKG->Zsize)
-			goto fini;
-
-			feg = &ACTIVEBKG->fastdata[px][pz];
-
-			for(long k = 0; k < feg->nbpolyin; k++) {
-				ep = feg->polyin[k];
-
-				if(!(ep->type & (POLY_WATER | POLY_TRANS | POLY_NOCOL)))
-				if((ep->min.y - pas < y) && (ep->max.y + pas > y))
-				if((ep->min.x - pas < x) && (ep->max.x + pas > x))
-				if((ep->min.z - pas < z) && (ep->max.z + pas > z))
-				{
-					if(RayCollidingPoly(orgn, dest, ep, hit)) {
-						dd = fdist(*orgn, *hit);
-						if(dd < nearest) {
-							nearest = dd;
-							found_ep = ep;
-							found_hit = *hit;
-						}
-					}
-				}
-			}
+	}
+	
+	if(!blockers.empty()) {
+		
+		//current ray pos
+		float x = orgn->x;
+		float y = orgn->y;
+		float z = orgn->z;
+		
+		if(distance < pas)
+			pas = distance * .5f;
+		
+		// ray incs
+		float dx = (dest->x - orgn->x);
+		float dy = (dest->y - orgn->y);
+		float dz = (dest->z - orgn->z);
+		
+		// absolute ray incs
+		float adx = EEfabs(dx);
+		float ady = EEfabs(dy);
+		float adz = EEfabs(dz);
+		
+		if(adx >= ady && adx >= adz) {
+			if(adx != dx)
+				ix = -pas;
+			else
+				ix = pas;
+			
+			iter = adx / pas;
+			t = 1.f / (iter);
+			iy = dy * t;
+			iz = dz * t;
+		} else if(ady >= adx && ady >= adz) {
+			if(ady != dy)
+				iy = -pas;
+			else
+				iy = pas;
+			
+			iter = ady / pas;
+			t = 1.f / (iter);
+			ix = dx * t;
+			iz = dz * t;
+		} else {
+			if(adz != dz)
+				iz = -pas;
+			else
+				iz = pas;
 			
+			iter = adz / pas;
+			t = 1.f / (iter);
+			ix = dx * t;
+			iy = dy * t;
 		}
 		
-fini:
-	;
+		x -= ix;
+		y -= iy;
+		z -= iz;
+		
+		// View blocking entities are still tested in fixed steps along the ray,
+		// up to the first background polygon.
+		while(iter > 0.f) {
+			iter -= 1.f;
+			x += ix;
+			y += iy;
+			z += iz;
+			
+			EERIE_SPHERE sphere;
+			sphere.origin.x=x;
+			sphere.origin.y=y;
+			sphere.origin.z=z;
+			sphere.radius=65.f;
+			
+			float dd = fdist(*orgn, sphere.origin);
+			if(dd >= nearest)
+				break;
+			
+			for(size_t i = 0; i < blockers.size(); i++) {
+				if(CheckIOInSphere(&sphere, blockers[i])) {
+					hit->x=x;
+					hit->y=y;
+					hit->z=z;
+					return false;
+				}
+			}
+		}
+	}
 	
 	if(!found_ep)
 		return true;
@@ -1734,6 +1755,8 @@ void ANCHOR_BLOCK_Clear() {
 		ANCHOR_DATA * ad = &eb->anchors[k];
 		ad->flags &= ~ANCHOR_FLAG_BLOCKED;
 	}
+	
+	EERIE_PATHFINDER_Update_All_Anchors();
 }
 
 void ANCHOR_BLOCK_By_IO(Entity * io, long status) {
@@ -1748,6 +1771,8 @@ void ANCHOR_BLOCK_By_IO(Entity * io, long status) {
 
 		if(closerThan(Vec2f(io->pos.x, io->pos.z), Vec2f(ad->pos.x, ad->pos.z), 440.f)) {
 			
+			AnchorFlags oldFlags = ad->flags;
+			
 			EERIEPOLY ep;
 			ep.type = 0;
 
@@ -1777,6 +1802,10 @@ void ANCHOR_BLOCK_By_IO(Entity * io, long status) {
 						ad->flags &= ~ANCHOR_FLAG_BLOCKED;
 				}
 			}
+			
+			if(ad->flags != oldFlags) {
+				EERIE_PATHFINDER_Update_Anchor(k);
+			}
 		}
 	}					
 }
@@ -0,0 +1,90 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARX_PLATFORM_ATOMIC_H
+#define ARX_PLATFORM_ATOMIC_H
+
+#include "platform/Platform.h"
+
+#if ARX_COMPILER_MSVC
+#include <windows.h>
+#include <intrin.h>
+#endif
+
+/*!
+ * Minimal set of atomic operations for simple lock-free data structures.
+ *
+ * Loads have acquire and stores have release semantics. Only naturally aligned values no
+ * larger than a pointer are supported.
+ */
+
+template <class T>
+inline T atomicLoad(const volatile T & value) {
+#if ARX_COMPILER_MSVC
+	T result = value; // Volatile reads have acquire semantics with MSVC
+	_ReadWriteBarrier();
+	return result;
+#elif defined(__ATOMIC_ACQUIRE)
+	return __atomic_load_n(&value, __ATOMIC_ACQUIRE);
+#else
+	T result = value;
+	__sync_synchronize();
+	return result;
+#endif
+}
+
+template <class T>
+inline void atomicStore(volatile T & value, T newValue) {
+#if ARX_COMPILER_MSVC
+	_ReadWriteBarrier();
+	value = newValue; // Volatile writes have release semantics with MSVC
+#elif defined(__ATOMIC_RELEASE)
+	__atomic_store_n(&value, newValue, __ATOMIC_RELEASE);
+#else
+	__sync_synchronize();
+	value = newValue;
+#endif
+}
+
+/*!
+ * Atomically add to a value.
+ * @return the previous value
+ */
+inline u32 atomicFetchAdd(volatile u32 & value, u32 increment) {
+#if ARX_COMPILER_MSVC
+	return u32(InterlockedExchangeAdd(reinterpret_cast<volatile LONG *>(&value), LONG(increment)));
+#else
+	return __sync_fetch_and_add(&value, increment);
+#endif
+}
+
+/*!
+ * Atomically replace a value if it is equal to expected.
+ * @return true if the value was replaced
+ */
+inline bool atomicCompareExchange(volatile u32 & value, u32 expected, u32 desired) {
+#if ARX_COMPILER_MSVC
+	return u32(InterlockedCompareExchange(reinterpret_cast<volatile LONG *>(&value), LONG(desired),
+	                                      LONG(expected))) == expected;
+#else
+	return __sync_bool_compare_and_swap(&value, expected, desired);
+#endif
+}
+
+#endif // ARX_PLATFORM_ATOMIC_H
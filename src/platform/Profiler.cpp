@@ -0,0 +1,296 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "platform/Profiler.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "platform/Lock.h"
+#include "platform/Time.h"
+
+#if ARX_HAVE_PTHREADS
+#include <pthread.h>
+#elif ARX_PLATFORM == ARX_PLATFORM_WIN32
+#include <windows.h>
+#endif
+
+namespace profiler {
+
+namespace detail {
+
+volatile u32 recording = 0;
+
+} // namespace detail
+
+namespace {
+
+struct Event {
+	
+	const char * name;
+	u64 start;
+	u64 duration; //!< Only used for zones
+	s64 value; //!< Only used for counters
+	bool isCounter;
+	
+};
+
+struct ThreadData {
+	
+	Lock lock; //!< Protects the events, which are written by the thread and read by writeTrace()
+	
+	size_t index;
+	std::string name;
+	std::vector<Event> events;
+	
+};
+
+Lock lock; //!< Protects all state except the per-thread events.
+std::vector<ThreadData *> threads;
+bool threadKeyCreated = false;
+
+u64 currentFrame = 0;
+u64 firstFrame = 0;
+u64 lastFrame = 0;
+u64 traceStart = 0;
+
+#if ARX_HAVE_PTHREADS
+
+pthread_key_t threadKey;
+
+bool createThreadKey() {
+	return pthread_key_create(&threadKey, NULL) == 0;
+}
+
+ThreadData * getThread() {
+	return static_cast<ThreadData *>(pthread_getspecific(threadKey));
+}
+
+void setThread(ThreadData * data) {
+	pthread_setspecific(threadKey, data);
+}
+
+#elif ARX_PLATFORM == ARX_PLATFORM_WIN32
+
+DWORD threadKey;
+
+bool createThreadKey() {
+	threadKey = TlsAlloc();
+	return threadKey != TLS_OUT_OF_INDEXES;
+}
+
+ThreadData * getThread() {
+	return static_cast<ThreadData *>(TlsGetValue(threadKey));
+}
+
+void setThread(ThreadData * data) {
+	TlsSetValue(threadKey, data);
+}
+
+#endif
+
+//! Must be called with the lock held.
+ThreadData * getThreadLocked() {
+	
+	if(!threadKeyCreated) {
+		threadKeyCreated = createThreadKey();
+		if(!threadKeyCreated) {
+			return NULL;
+		}
+	}
+	
+	ThreadData * data = getThread();
+	if(!data) {
+		data = new ThreadData;
+		data->index = threads.size() + 1;
+		threads.push_back(data);
+		setThread(data);
+	}
+	
+	return data;
+}
+
+ThreadData * getThreadData() {
+	
+	// The key is always created before recording is enabled
+	ThreadData * data = getThread();
+	if(data) {
+		return data;
+	}
+	
+	Autolock autolock(lock);
+	return getThreadLocked();
+}
+
+void addEvent(const Event & event) {
+	
+	ThreadData * data = getThreadData();
+	if(!data) {
+		return;
+	}
+	
+	Autolock autolock(data->lock);
+	
+	// Drop events that end after the trace has been written
+	if(isRecording()) {
+		data->events.push_back(event);
+	}
+}
+
+void writeString(std::ostream & os, const std::string & str) {
+	os << '"';
+	for(std::string::const_iterator i = str.begin(); i != str.end(); ++i) {
+		if(*i == '"' || *i == '\\') {
+			os << '\\' << *i;
+		} else if(static_cast<unsigned char>(*i) >= 0x20) {
+			os << *i;
+		}
+	}
+	os << '"';
+}
+
+} // anonymous namespace
+
+namespace detail {
+
+void addZone(const char * name, u64 start) {
+	
+	Event event;
+	event.name = name;
+	event.start = start;
+	event.duration = Time::getElapsedUs(start);
+	event.value = 0;
+	event.isCounter = false;
+	
+	addEvent(event);
+}
+
+} // namespace detail
+
+void setFrames(u64 first, u64 last) {
+	
+	Autolock autolock(lock);
+	
+	currentFrame = 0;
+	firstFrame = std::max(first, u64(1));
+	lastFrame = std::max(last, firstFrame);
+	
+	// Frames are started from the thread that selects them
+	ThreadData * data = getThreadLocked();
+	if(data && data->name.empty()) {
+		data->name = "Main";
+	}
+}
+
+bool frame() {
+	
+	Autolock autolock(lock);
+	
+	if(!lastFrame) {
+		return false;
+	}
+	
+	currentFrame++;
+	
+	if(currentFrame == firstFrame) {
+		traceStart = Time::getUs();
+		atomicStore(detail::recording, u32(1));
+	} else if(currentFrame == lastFrame + 1) {
+		atomicStore(detail::recording, u32(0));
+		return true;
+	}
+	
+	return false;
+}
+
+void registerThread(const std::string & name) {
+	
+	Autolock autolock(lock);
+	
+	if(!lastFrame) {
+		// Profiling is disabled
+		return;
+	}
+	
+	ThreadData * data = getThreadLocked();
+	if(data) {
+		data->name = name;
+	}
+}
+
+void counter(const char * name, s64 value) {
+	
+	if(!isRecording()) {
+		return;
+	}
+	
+	Event event;
+	event.name = name;
+	event.start = Time::getUs();
+	event.duration = 0;
+	event.value = value;
+	event.isCounter = true;
+	
+	addEvent(event);
+}
+
+void writeTrace(std::ostream & os) {
+	
+	Autolock autolock(lock);
+	
+	os << "{\"traceEvents\":[\n";
+	os << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,"
+	      "\"args\":{\"name\":\"Arx Libertatis\"}}";
+	
+	for(size_t i = 0; i < threads.size(); i++) {
+		
+		ThreadData & data = *threads[i];
+		
+		Autolock threadLock(data.lock);
+		
+		if(!data.name.empty()) {
+			os << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << data.index
+			   << ",\"args\":{\"name\":";
+			writeString(os, data.name);
+			os << "}}";
+		}
+		
+		for(size_t j = 0; j < data.events.size(); j++) {
+			
+			const Event & event = data.events[j];
+			s64 ts = s64(event.start - traceStart);
+			
+			os << ",\n{\"name\":";
+			writeString(os, event.name);
+			if(event.isCounter) {
+				os << ",\"ph\":\"C\",\"pid\":1,\"tid\":" << data.index << ",\"ts\":" << ts
+				   << ",\"args\":{\"value\":" << event.value << "}}";
+			} else {
+				os << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << data.index << ",\"ts\":" << ts
+				   << ",\"dur\":" << event.duration << "}";
+			}
+		}
+		
+		data.events.clear();
+	}
+	
+	os << "\n]}\n";
+}
+
+} // namespace profiler
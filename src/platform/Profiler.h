@@ -0,0 +1,136 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARX_PLATFORM_PROFILER_H
+#define ARX_PLATFORM_PROFILER_H
+
+#include <ostream>
+#include <string>
+
+#include "Configure.h"
+#include "platform/Platform.h"
+
+/*!
+ * Scoped-zone profiler that records nested zones and counters for a range of frames.
+ *
+ * Each thread records its own timeline. Recording is only compiled in when building
+ * with BUILD_PROFILER, otherwise the macros and functions below do nothing.
+ * The trace is written in the Chrome trace event format (chrome://tracing).
+ */
+
+#if BUILD_PROFILER
+
+#include "platform/Atomic.h"
+#include "platform/Time.h"
+
+//! Record the time until the end of the current scope as a zone with the given name.
+#define ARX_PROFILE(name) ::profiler::Scope ARX_PROFILE_NAME(profileScope, __LINE__)(name)
+
+//! Record the time until the end of the current scope as a zone named after the function.
+#define ARX_PROFILE_FUNC() ARX_PROFILE(__FUNCTION__)
+
+#define ARX_PROFILE_NAME(x, line) ARX_PROFILE_NAME_HELPER(x, line)
+#define ARX_PROFILE_NAME_HELPER(x, line) x ## line
+
+namespace profiler {
+
+namespace detail {
+
+extern volatile u32 recording;
+
+void addZone(const char * name, u64 start);
+
+} // namespace detail
+
+//! @return true if frames are being recorded
+inline bool isRecording() {
+	return atomicLoad(detail::recording) != 0;
+}
+
+class Scope {
+	
+	const char * m_name;
+	u64 m_start;
+	bool m_active;
+	
+public:
+	
+	//! @param name must be a string constant
+	explicit Scope(const char * name) : m_name(name), m_start(0), m_active(isRecording()) {
+		if(m_active) {
+			m_start = Time::getUs();
+		}
+	}
+	
+	~Scope() {
+		if(m_active) {
+			detail::addZone(m_name, m_start);
+		}
+	}
+	
+};
+
+/*!
+ * Select the frames to record.
+ * Frames are counted starting with 1 from the first call to frame().
+ */
+void setFrames(u64 first, u64 last);
+
+/*!
+ * Start a new frame.
+ * @return true if the last selected frame was just completed and the trace can be written.
+ */
+bool frame();
+
+/*!
+ * Set a name for the current thread to be shown in the trace.
+ * Threads that are not named are shown by their index.
+ */
+void registerThread(const std::string & name);
+
+/*!
+ * Record a counter value.
+ * @param name must be a string constant
+ */
+void counter(const char * name, s64 value);
+
+//! Write all recorded zones and counters as a Chrome trace and discard them.
+void writeTrace(std::ostream & os);
+
+} // namespace profiler
+
+#else // !BUILD_PROFILER
+
+#define ARX_PROFILE(name) ((void)0)
+#define ARX_PROFILE_FUNC() ((void)0)
+
+namespace profiler {
+
+inline bool isRecording() { return false; }
+inline void setFrames(u64 first, u64 last) { ARX_UNUSED(first), ARX_UNUSED(last); }
+inline bool frame() { return false; }
+inline void registerThread(const std::string & name) { ARX_UNUSED(name); }
+inline void counter(const char * name, s64 value) { ARX_UNUSED(name), ARX_UNUSED(value); }
+inline void writeTrace(std::ostream & os) { ARX_UNUSED(os); }
+
+} // namespace profiler
+
+#endif // !BUILD_PROFILER
+
+#endif // ARX_PLATFORM_PROFILER_H
@@ -19,7 +19,10 @@
 
 #include "platform/Thread.h"
 
+#include <algorithm>
+
 #include "platform/CrashHandler.h"
+#include "platform/Profiler.h"
 
 void Thread::setThreadName(const std::string & _threadName) {
 	threadName = _threadName;
@@ -113,6 +116,8 @@ void * Thread::entryPoint(void * param) {
 	#pragma message ( "No function available to set thread names!" )
 #endif
 	
+	profiler::registerThread(thread.threadName);
+	
 	CrashHandler::registerThreadCrashHandlers();
 	thread.run();
 	CrashHandler::unregisterThreadCrashHandlers();
@@ -208,6 +213,7 @@ void SetCurrentThreadName(const std::string & threadName) {
 DWORD WINAPI Thread::entryPoint(LPVOID param) {
 	
 	SetCurrentThreadName(((Thread*)param)->threadName);
+	profiler::registerThread(((Thread*)param)->threadName);
 	
 	CrashHandler::registerThreadCrashHandlers();
 	((Thread*)param)->run();
@@ -257,3 +263,33 @@ void Thread::sleep(unsigned milliseconds) {
 #else
 #error "Sleep not supported: need ARX_HAVE_NANOSLEEP in non-Windows systems"
 #endif
+
+#if ARX_HAVE_SYSCONF
+
+#include <unistd.h>
+
+unsigned Thread::getProcessorCount() {
+#ifdef _SC_NPROCESSORS_ONLN
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	if(count > 0) {
+		return unsigned(count);
+	}
+#endif
+	return 1;
+}
+
+#elif ARX_PLATFORM == ARX_PLATFORM_WIN32
+
+unsigned Thread::getProcessorCount() {
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return std::max(unsigned(info.dwNumberOfProcessors), 1u);
+}
+
+#else
+
+unsigned Thread::getProcessorCount() {
+	return 1;
+}
+
+#endif
@@ -105,6 +105,12 @@ public:
 	
 	static thread_id_type getCurrentThreadId();
 	
+	/*!
+	 * Get the number of processors available to this process.
+	 * @return the processor count or 1 if it cannot be determined.
+	 */
+	static unsigned getProcessorCount();
+	
 protected:
 	
 	/*!
@@ -0,0 +1,152 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "platform/WorkerPool.h"
+
+#include <algorithm>
+#include <sstream>
+
+#include "platform/Atomic.h"
+#include "platform/Thread.h"
+
+WorkerPool * g_workerPool = NULL;
+
+class WorkerPool::Worker : public Thread {
+	
+	WorkerPool & pool;
+	size_t index;
+	
+public:
+	
+	Worker(WorkerPool & _pool, size_t _index) : pool(_pool), index(_index) {
+		std::ostringstream name;
+		name << "Worker " << index;
+		setThreadName(name.str());
+	}
+	
+	void run() {
+		pool.work(index);
+	}
+	
+};
+
+WorkerPool::WorkerPool(unsigned count)
+	: started(0), finished(0), stopping(false), task(NULL), count(0), chunkSize(1), nextChunk(0) {
+	
+	workers.resize(count);
+	
+	// Thread 0 is the thread calling run()
+	for(size_t i = 0; i < workers.size(); i++) {
+		workers[i] = new Worker(*this, i + 1);
+		workers[i]->start();
+	}
+}
+
+WorkerPool::~WorkerPool() {
+	
+	stopping = true;
+	for(size_t i = 0; i < workers.size(); i++) {
+		started.post();
+	}
+	
+	for(size_t i = 0; i < workers.size(); i++) {
+		workers[i]->waitForCompletion();
+		delete workers[i];
+	}
+}
+
+void WorkerPool::run(Task & _task, size_t _count, size_t _chunkSize) {
+	
+	arx_assert(task == NULL);
+	arx_assert(_chunkSize > 0);
+	
+	if(_count == 0) {
+		return;
+	}
+	
+	size_t chunks = (_count + _chunkSize - 1) / _chunkSize;
+	size_t helpers = std::min(workers.size(), chunks - 1);
+	if(helpers == 0) {
+		_task.run(0, _count, 0);
+		return;
+	}
+	
+	task = &_task;
+	count = _count;
+	chunkSize = _chunkSize;
+	atomicStore(nextChunk, u32(0));
+	
+	// The semaphores order the writes above before the workers' reads.
+	for(size_t i = 0; i < helpers; i++) {
+		started.post();
+	}
+	
+	process(0);
+	
+	for(size_t i = 0; i < helpers; i++) {
+		finished.wait();
+	}
+	
+	task = NULL;
+}
+
+void WorkerPool::work(size_t thread) {
+	
+	for(;;) {
+		
+		started.wait();
+		if(stopping) {
+			return;
+		}
+		
+		process(thread);
+		
+		finished.post();
+	}
+}
+
+void WorkerPool::process(size_t thread) {
+	
+	for(;;) {
+		
+		size_t begin = size_t(atomicFetchAdd(nextChunk, 1)) * chunkSize;
+		if(begin >= count) {
+			return;
+		}
+		
+		task->run(begin, std::min(begin + chunkSize, count), thread);
+	}
+}
+
+//! Processors that are not used by the main thread
+static unsigned getWorkerProcessorCount() {
+	return std::max(Thread::getProcessorCount(), 2u) - 1;
+}
+
+unsigned getFrameWorkerCount() {
+	return getWorkerProcessorCount() - getBackgroundWorkerCount();
+}
+
+unsigned getBackgroundWorkerCount() {
+	return std::max(getWorkerProcessorCount() / 2, 1u);
+}
+
+unsigned getLoadingWorkerCount() {
+	return getWorkerProcessorCount();
+}
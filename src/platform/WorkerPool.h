@@ -0,0 +1,117 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARX_PLATFORM_WORKERPOOL_H
+#define ARX_PLATFORM_WORKERPOOL_H
+
+#include <stddef.h>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+#include <boost/interprocess/sync/interprocess_semaphore.hpp>
+
+#include "platform/Platform.h"
+
+class Thread;
+
+/*!
+ * Worker threads that split a loop over a range of items with the calling thread.
+ *
+ * The range is cut into chunks that are handed out in order to whichever thread is free,
+ * so uneven chunks balance out. run() returns once all chunks have been processed.
+ *
+ * Only one loop can run at a time: run() must not be called concurrently or from a task.
+ */
+class WorkerPool : private boost::noncopyable {
+	
+public:
+	
+	class Task {
+		
+	public:
+		
+		/*!
+		 * Process the items in [begin, end).
+		 * Called concurrently from different threads for different ranges.
+		 * @param thread index of the calling thread, less than getThreadCount().
+		 *               Can be used to select per-thread output buffers.
+		 */
+		virtual void run(size_t begin, size_t end, size_t thread) = 0;
+		
+	protected:
+		
+		~Task() { }
+		
+	};
+	
+	//! Create a pool with count worker threads - with 0 all tasks run on the calling thread.
+	explicit WorkerPool(unsigned count);
+	
+	//! Wait for the worker threads to exit.
+	~WorkerPool();
+	
+	//! Call task.run() for all items in [0, count), in chunks of chunkSize items.
+	void run(Task & task, size_t count, size_t chunkSize = 1);
+	
+	//! Number of threads that can run tasks, including the calling thread.
+	size_t getThreadCount() const { return workers.size() + 1; }
+	
+private:
+	
+	class Worker;
+	
+	//! Main loop of the worker threads.
+	void work(size_t thread);
+	
+	//! Process chunks until there are none left.
+	void process(size_t thread);
+	
+	std::vector<Thread *> workers;
+	
+	boost::interprocess::interprocess_semaphore started;
+	boost::interprocess::interprocess_semaphore finished;
+	bool stopping;
+	
+	// Current loop, written before the workers are started.
+	Task * task;
+	size_t count;
+	size_t chunkSize;
+	volatile u32 nextChunk;
+	
+};
+
+//! Pool shared by the game's per-frame work, NULL if none has been created.
+extern WorkerPool * g_workerPool;
+
+/*
+ * Per-frame work on g_workerPool, finding paths and compressing saves can all run at the
+ * same time, so they share the processors besides the main thread. Files are only prefetched
+ * while loading a level, when the other pools are idle.
+ */
+
+//! Number of worker threads for g_workerPool.
+unsigned getFrameWorkerCount();
+
+//! Number of threads for work that runs in the background while the game continues.
+unsigned getBackgroundWorkerCount();
+
+//! Number of threads for reading files while loading, when no other pool is busy.
+unsigned getLoadingWorkerCount();
+
+#endif // ARX_PLATFORM_WORKERPOOL_H
@@ -51,6 +51,9 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include <cstdio>
 
 #include <boost/algorithm/string/case_conv.hpp>
+#include <boost/unordered_map.hpp>
+
+#include <zlib.h>
 
 #include "ai/Paths.h"
 
@@ -79,8 +82,11 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include "io/fs/Filesystem.h"
 #include "io/fs/SystemPaths.h"
 #include "io/SaveBlock.h"
+#include "io/SaveBlockWriter.h"
 #include "io/log/Logger.h"
 
+#include "platform/Time.h"
+
 #include "scene/Interactive.h"
 #include "scene/GameSound.h"
 #include "scene/LoadLevel.h"
@@ -131,6 +137,34 @@ static float ARX_CHANGELEVEL_DesiredTime = 0;
 static long CONVERT_CREATED = 0;
 long DONT_WANT_PLAYER_INZONE = 0;
 static SaveBlock * pSaveBlock = NULL;
+static SaveBlockWriter * pSaveWriter = NULL;
+
+struct SavedFileInfo {
+	
+	size_t size;
+	u32 crc;
+	u32 adler;
+	
+	SavedFileInfo() : size(0), crc(0), adler(0) { }
+	
+	SavedFileInfo(const char * data, size_t _size) : size(_size) {
+		crc = crc32(crc32(0, NULL, 0), (const Bytef *)data, size);
+		adler = adler32(adler32(0, NULL, 0), (const Bytef *)data, size);
+	}
+	
+	bool operator==(const SavedFileInfo & o) const {
+		return size == o.size && crc == o.crc && adler == o.adler;
+	}
+	
+};
+
+typedef boost::unordered_map<std::string, SavedFileInfo> SavedFiles;
+
+//! Files that are known to be stored in CURRENT_GAME_FILE with the given contents.
+static SavedFiles savedFiles;
+//! Files queued in pSaveWriter, to be added to savedFiles once the save has been written.
+static SavedFiles pendingFiles;
+static size_t unchangedFiles = 0;
 
 static ARX_CHANGELEVEL_IO_INDEX * idx_io = NULL;
 static ARX_CHANGELEVEL_INVENTORY_DATA_SAVE ** Gaids = NULL;
@@ -206,8 +240,94 @@ long GetIOAnimIdx2(const Entity * io, ANIM_HANDLE * anim) {
 	return -1;
 }
 
+//! Wait for the save block that is being written in the background, if any.
+static bool ARX_CHANGELEVEL_WaitForSave() {
+	
+	if(!pSaveWriter) {
+		return true;
+	}
+	
+	bool blocking = !pSaveWriter->done();
+	u64 start = Time::getUs();
+	
+	bool ret = pSaveWriter->wait();
+	if(ret) {
+		for(SavedFiles::const_iterator i = pendingFiles.begin(); i != pendingFiles.end(); ++i) {
+			savedFiles[i->first] = i->second;
+		}
+	} else {
+		LogError << "Could not complete the save";
+		// We don't know which files made it into the save block.
+		savedFiles.clear();
+	}
+	pendingFiles.clear();
+	
+	if(blocking) {
+		LogInfo << "Waited " << (Time::getElapsedUs(start) / 1000) << " ms for "
+		        << pSaveWriter->getSaveFile() << " to be written";
+	}
+	
+	delete pSaveWriter, pSaveWriter = NULL;
+	
+	return ret;
+}
+
+/*!
+ * Queue a file to be written to CURRENT_GAME_FILE, unless the save block already contains
+ * the same data. Unchanged files keep their existing compressed chunks.
+ */
+static void ARX_CHANGELEVEL_SaveFile(const std::string & name, const char * dat, size_t size) {
+	
+	arx_assert(pSaveWriter);
+	
+	SavedFileInfo info(dat, size);
+	
+	SavedFiles::const_iterator it = savedFiles.find(name);
+	if(it != savedFiles.end() && it->second == info) {
+		unchangedFiles++;
+		return;
+	}
+	
+	pSaveWriter->save(name, dat, size);
+	pendingFiles[name] = info;
+}
+
+//! Load a file from CURRENT_GAME_FILE and remember its contents for the next save.
+static char * ARX_CHANGELEVEL_LoadFile(const std::string & name, size_t & size) {
+	
+	char * dat = pSaveBlock->load(name, size);
+	if(dat) {
+		savedFiles[name] = SavedFileInfo(dat, size);
+	}
+	
+	return dat;
+}
+
+//! Start collecting files to write to CURRENT_GAME_FILE.
+static void ARX_CHANGELEVEL_BeginSave() {
+	
+	ARX_CHANGELEVEL_WaitForSave();
+	
+	pSaveWriter = new SaveBlockWriter(CURRENT_GAME_FILE);
+	unchangedFiles = 0;
+}
+
+bool ARX_CHANGELEVEL_PollSave() {
+	
+	if(!pSaveWriter || !pSaveWriter->done()) {
+		return false;
+	}
+	
+	ARX_CHANGELEVEL_WaitForSave();
+	
+	return true;
+}
+
 bool ARX_Changelevel_CurGame_Clear() {
 	
+	ARX_CHANGELEVEL_WaitForSave();
+	savedFiles.clear();
+	
 	if(CURRENT_GAME_FILE.empty()) {
 		CURRENT_GAME_FILE = fs::paths.user / "current.sav";
 	}
@@ -235,6 +355,8 @@ void ARX_Changelevel_CurGame_Open() {
 		return;
 	}
 	
+	ARX_CHANGELEVEL_WaitForSave();
+	
 	if(CURRENT_GAME_FILE.empty() || !fs::exists(CURRENT_GAME_FILE)) {
 		// TODO this is normal when starting a new game
 		return;
@@ -304,21 +426,15 @@ void ARX_CHANGELEVEL_Change(const string & level, const string & target, long an
 	LoadLevelScreen(num);
 	
 	assert(!CURRENT_GAME_FILE.empty());
-	pSaveBlock = new SaveBlock(CURRENT_GAME_FILE);
-	
-	if(!pSaveBlock->open(true)) {
-		LogError << "Error writing to save block " << CURRENT_GAME_FILE;
-		return;
-	}
+	ARX_CHANGELEVEL_BeginSave();
 	
 	LogDebug("Before ARX_CHANGELEVEL_PushLevel");
 	ARX_CHANGELEVEL_PushLevel(CURRENTLEVEL, num);
 	LogDebug("After  ARX_CHANGELEVEL_PushLevel");
 	
-	if(!pSaveBlock->flush("pld")) {
-		LogError << "Could not complete the save.";
-	}
-	delete pSaveBlock, pSaveBlock = NULL;
+	// The new level is loaded from the save block, so it must be complete.
+	pSaveWriter->start("pld");
+	ARX_CHANGELEVEL_WaitForSave();
 	
 	arxtime.resume();
 	
@@ -508,11 +624,11 @@ static bool ARX_CHANGELEVEL_Push_Index(long num) {
 	
 	char savefile[256];
 	sprintf(savefile, "lvl%03ld", num);
-	bool ret = pSaveBlock->save(savefile, dat, pos);
+	ARX_CHANGELEVEL_SaveFile(savefile, dat, pos);
 	
 	delete[] dat;
 	
-	return ret;
+	return true;
 }
 
 static void ARX_CHANGELEVEL_Push_Globals() {
@@ -597,7 +713,7 @@ static void ARX_CHANGELEVEL_Push_Globals() {
 		}
 	}
 	
-	pSaveBlock->save("globals", dat, pos);
+	ARX_CHANGELEVEL_SaveFile("globals", dat, pos);
 	
 	delete[] dat;
 }
@@ -796,7 +912,7 @@ static long ARX_CHANGELEVEL_Push_Player(long level) {
 	
 	LastValidPlayerPos = asp->LAST_VALID_POS.toVec3();
 	
-	pSaveBlock->save("player", dat, pos);
+	ARX_CHANGELEVEL_SaveFile("player", dat, pos);
 	
 	delete[] dat;
 	
@@ -1445,7 +1561,7 @@ static long ARX_CHANGELEVEL_Push_IO(const Entity * io, long level) {
 		LogError << "SaveBuffer Overflow " << pos << " >> " << allocsize;
 	}
 	
-	pSaveBlock->save(savefile, dat, pos);
+	ARX_CHANGELEVEL_SaveFile(savefile, dat, pos);
 	
 	delete[] dat;
 	
@@ -1462,7 +1578,7 @@ static long ARX_CHANGELEVEL_Pop_Index(ARX_CHANGELEVEL_INDEX * asi, long num) {
 	loadfile = ss.str();
 	
 	size_t size; // TODO size is not used
-	char * dat = pSaveBlock->load(loadfile, size);
+	char * dat = ARX_CHANGELEVEL_LoadFile(loadfile, size);
 	if(!dat) {
 		LogError << "Unable to Open " << loadfile << " for Read...";
 		return -1;
@@ -1505,7 +1621,7 @@ long ARX_CHANGELEVEL_Pop_Zones_n_Lights(ARX_CHANGELEVEL_INDEX * asi, long num) {
 	
 	size_t size; // TODO size not used
 	// TODO this has already been loaded and decompressed in ARX_CHANGELEVEL_Pop_Index!
-	char * dat = pSaveBlock->load(loadfile, size);
+	char * dat = ARX_CHANGELEVEL_LoadFile(loadfile, size);
 	if(!dat) {
 		LogError << "Unable to Open " << loadfile << " for Read...";
 		return -1;
@@ -1616,7 +1732,7 @@ static long ARX_CHANGELEVEL_Pop_Player() {
 	const string & loadfile = "player";
 	
 	size_t size;
-	char * dat = pSaveBlock->load(loadfile, size);
+	char * dat = ARX_CHANGELEVEL_LoadFile(loadfile, size);
 	if(!dat) {
 		LogError << "Unable to Open " << loadfile << " for Read...";
 		return -1;
@@ -1902,6 +2018,7 @@ static bool loadScriptData(EERIE_SCRIPT & script, const char * dat, size_t & pos
 	script.nblvar = ass->nblvar;
 	
 	free(script.lvar), script.lvar = NULL;
+	invalidateLocalVariableIndex(&script);
 	if(ass->nblvar > 0) {
 		script.lvar = (SCRIPT_VAR *)malloc(sizeof(SCRIPT_VAR) * script.nblvar);
 		memset(script.lvar, 0, sizeof(SCRIPT_VAR)* script.nblvar);
@@ -1916,7 +2033,7 @@ static Entity * ARX_CHANGELEVEL_Pop_IO(const string & ident, long num) {
 	LogDebug("--> loading interactive object " << ident);
 	
 	size_t size = 0; // TODO size not used
-	char * dat = pSaveBlock->load(ident, size);
+	char * dat = ARX_CHANGELEVEL_LoadFile(ident, size);
 	if(!dat) {
 		LogError << "Unable to Open " << ident << " for Read...";
 		return NULL;
@@ -2533,7 +2650,7 @@ static void ARX_CHANGELEVEL_Pop_Globals() {
 	ARX_SCRIPT_Free_All_Global_Variables();
 	
 	size_t size;
-	char * dat = pSaveBlock->load("globals", size);
+	char * dat = ARX_CHANGELEVEL_LoadFile("globals", size);
 	if(!dat) {
 		LogError << "Unable to Open globals for Read...";
 		return;
@@ -2769,6 +2886,13 @@ bool ARX_CHANGELEVEL_Save(const string & name, const fs::path & savefile) {
 	
 	LogDebug("ARX_CHANGELEVEL_Save " << savefile << " " << name);
 	
+	u64 start = Time::getUs();
+	
+	// Only one save can be written at a time.
+	if(!ARX_CHANGELEVEL_WaitForSave()) {
+		LogWarning << "Previous save failed, continuing anyway";
+	}
+	
 	arxtime.pause();
 	
 	if(CURRENTLEVEL == -1) {
@@ -2776,17 +2900,14 @@ bool ARX_CHANGELEVEL_Save(const string & name, const fs::path & savefile) {
 		return false;
 	}
 	
-	pSaveBlock = new SaveBlock(CURRENT_GAME_FILE);
-	
-	if(!pSaveBlock->open(true)) {
-		LogError << "Opening savegame " << CURRENT_GAME_FILE;
-		return false;
-	}
+	ARX_CHANGELEVEL_BeginSave();
 	
 	// Save the current level
 	
 	if(!ARX_CHANGELEVEL_PushLevel(CURRENTLEVEL, CURRENTLEVEL)) {
 		LogWarning << "Could not save the level";
+		delete pSaveWriter, pSaveWriter = NULL;
+		pendingFiles.clear();
 		return false;
 	}
 	
@@ -2800,23 +2921,17 @@ bool ARX_CHANGELEVEL_Save(const string & name, const fs::path & savefile) {
 	pld.time = arxtime.get_updated_ul();
 	
 	const char * dat = reinterpret_cast<const char *>(&pld);
-	pSaveBlock->save("pld", dat, sizeof(ARX_CHANGELEVEL_PLAYER_LEVEL_DATA));
+	ARX_CHANGELEVEL_SaveFile("pld", dat, sizeof(ARX_CHANGELEVEL_PLAYER_LEVEL_DATA));
 	
-	// Close the savegame file
-	
-	if(!pSaveBlock->flush("pld")) {
-		LogError << "Could not complete the save";
-		return false;
-	}
-	delete pSaveBlock, pSaveBlock = NULL;
+	// Compress and write the save block in the background, then copy it to the final
+	// destination, overwriting previous files.
+	pSaveWriter->start("pld", savefile);
 	
 	arxtime.resume();
 	
-	// Copy the savegame and screenshot to the final destination, overwriting previous files
-	if(!fs::copy_file(CURRENT_GAME_FILE, savefile, true)) {
-		LogWarning << "Failed to copy save " << CURRENT_GAME_FILE <<" to " << savefile;
-		return false;
-	}
+	LogInfo << "Saving " << savefile << ", game stopped for "
+	        << (Time::getElapsedUs(start) / 1000) << " ms, " << pendingFiles.size()
+	        << " changed and " << unchangedFiles << " unchanged files";
 	
 	return true;
 }
@@ -60,8 +60,19 @@ long ARX_CHANGELEVEL_GetInfo(const fs::path & savefile, std::string & name, floa
  */
 long ARX_CHANGELEVEL_Load(const fs::path & savefile);
 
+/*!
+ * Save the game.
+ * The save is completed in the background - errors after the game state has been
+ * collected are only logged.
+ */
 bool ARX_CHANGELEVEL_Save(const std::string & name, const fs::path & savefile);
 
+/*!
+ * Check if a save started by ARX_CHANGELEVEL_Save() has been written.
+ * @return true if the save completed since the last call.
+ */
+bool ARX_CHANGELEVEL_PollSave();
+
 bool ARX_Changelevel_CurGame_Clear();
 void ARX_Changelevel_CurGame_Open();
 bool ARX_Changelevel_CurGame_Seek(const std::string & ident);
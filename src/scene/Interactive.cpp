@@ -70,6 +70,7 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 
 #include "game/Camera.h"
 #include "game/Damage.h"
+#include "game/EntityGrid.h"
 #include "game/EntityManager.h"
 #include "game/Equipment.h"
 #include "game/Inventory.h"
@@ -154,17 +155,7 @@ bool ValidIONum(long num) {
 }
 
 long ValidIOAddress(const Entity * io) {
-	
-	if(!io)
-		return 0;
-	
-	for(size_t i = 0; i < entities.size(); i++) {
-		if(entities[i] == io) {
-			return 1;
-		}
-	}
-	
-	return 0;
+	return entities.contains(io) ? 1 : 0;
 }
 
 static float ARX_INTERACTIVE_fGetPrice(Entity * io, Entity * shop) {
@@ -427,16 +418,21 @@ void IO_UnlinkAllLinkedObjects(Entity * io) {
 // First is always the player
 TREATZONE_IO * treatio = NULL;
 long TREATZONE_CUR = 0;
+
+//! treatio index for each entity index, or -1
+static std::vector<long> treatzoneSlots;
 static long TREATZONE_MAX = 0;
 
 void TREATZONE_Clear() {
 	TREATZONE_CUR = 0;
+	treatzoneSlots.clear();
 }
 
 void TREATZONE_Release() {
 	free(treatio), treatio = NULL;
 	TREATZONE_MAX = 0;
 	TREATZONE_CUR = 0;
+	treatzoneSlots.clear();
 }
 
 void TREATZONE_RemoveIO(Entity * io)
@@ -473,9 +469,31 @@ void TREATZONE_AddIO(Entity * io, long flag)
 
 	treatio[TREATZONE_CUR].show = io->show;
 	treatio[TREATZONE_CUR].num = io->index();
+	
+	if(io->index() >= treatzoneSlots.size()) {
+		treatzoneSlots.resize(io->index() + 1, -1);
+	}
+	treatzoneSlots[io->index()] = TREATZONE_CUR;
+	
 	TREATZONE_CUR++;
 }
 
+void TREATZONE_Query(const Vec3f & center, float radius, std::vector<long> & slots) {
+	
+	std::vector<size_t> found;
+	entityGrid.query(center, radius, found);
+	
+	slots.clear();
+	for(size_t i = 0; i < found.size(); i++) {
+		if(found[i] < treatzoneSlots.size() && treatzoneSlots[found[i]] >= 0) {
+			slots.push_back(treatzoneSlots[found[i]]);
+		}
+	}
+	
+	// Keep the treat zone order, the player and DRAGINTER come first.
+	std::sort(slots.begin(), slots.end());
+}
+
 void CheckSetAnimOutOfTreatZone(Entity * io, long num)
 {
 	arx_assert(io);
@@ -1516,6 +1534,8 @@ void ARX_INTERACTIVE_Teleport(Entity * io, Vec3f * target, bool flag) {
 		}
 	}
 	
+	entityGrid.update(io);
+	
 	MOLLESS_Clear(io->obj, 1);
 	ResetVVPos(io);
 }
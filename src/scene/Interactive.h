@@ -49,6 +49,7 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 
 #include <stddef.h>
 #include <string>
+#include <vector>
 
 #include "game/Entity.h"
 #include "game/EntityId.h"
@@ -143,7 +144,7 @@ void ARX_INTERACTIVE_DestroyIOdelayedExecute();
  * ValidIONum and ValidIOAddress are fundamentally flawed and vulnerable to
  * index / address aliasing as both indices and memory addresses can be reused.
  *
- * We should instead use a proper weak pointer!
+ * New code should store an EntityHandle instead.
  */
 bool ValidIONum(long num);
 long ValidIOAddress(const Entity * io);
@@ -236,6 +237,15 @@ void TREATZONE_Clear();
 void TREATZONE_Release();
 void TREATZONE_AddIO(Entity * io, long flag = 0);
 void TREATZONE_RemoveIO(Entity * io);
+
+/*!
+ * Find the treat zone entries of all entities that may be horizontally closer than radius
+ * to center, using the entity grid.
+ *
+ * @param slots receives indices into treatio in ascending order
+ */
+void TREATZONE_Query(const Vec3f & center, float radius, std::vector<long> & slots);
+
 bool IsSameObject(Entity * io, Entity * ioo);
 void ARX_INTERACTIVE_ClearAllDynData();
 bool HaveCommonGroup(Entity * io, Entity * ioo);
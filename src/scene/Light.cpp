@@ -44,6 +44,8 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 
 #include "scene/Light.h"
 
+#include <algorithm>
+
 #include "core/Application.h"
 #include "core/GameTime.h"
 #include "core/Core.h"
@@ -55,10 +57,12 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include "graphics/Math.h"
 #include "graphics/Draw.h"
 #include "graphics/DrawLine.h"
+#include "graphics/VertexLighting.h"
 
 #include "scene/Object.h"
 #include "scene/GameSound.h"
 #include "scene/Interactive.h"
+#include "scene/LightGrid.h"
 
 static const float GLOBAL_LIGHT_FACTOR=0.85f;
 
@@ -71,6 +75,13 @@ long TOTPDL = 0;
 EERIE_LIGHT * IO_PDL[MAX_DYNLIGHTS];
 long TOTIOPDL = 0;
 
+//! Lights in PDL by the area of the background tiles they affect
+static LightGrid tileLightGrid;
+
+//! Lights in IO_PDL and PDL by the area of the entities they affect
+static LightGrid entityLightGrid;
+static bool entityLightGridValid = false;
+
 void ColorMod::updateFromEntity(Entity *io, bool inBook) {
 	factor = Color3f::white;
 	term = Color3f::black;
@@ -358,6 +369,14 @@ void PrecalcDynamicLighting(long x0, long z0, long x1, long z1) {
 				el->treat = 0;
 		}
 	}
+	
+	tileLightGrid.clear();
+	for(long i = 0; i < TOTPDL; i++) {
+		tileLightGrid.add(PDL[i], 60.f);
+	}
+	tileLightGrid.build();
+	
+	entityLightGridValid = false;
 }
 
 void PrecalcIOLighting(const Vec3f * pos, float radius) {
@@ -381,6 +400,8 @@ void PrecalcIOLighting(const Vec3f * pos, float radius) {
 			}
 		}
 	}
+	
+	entityLightGridValid = false;
 }
 
 bool ValidDynLight(long num)
@@ -421,6 +442,10 @@ void ClearDynLights() {
 
 	TOTPDL = 0;
 	TOTIOPDL = 0;
+	
+	tileLightGrid.clear();
+	entityLightGrid.clear();
+	entityLightGridValid = false;
 }
 
 long MAX_LLIGHTS = 18;
@@ -474,18 +499,47 @@ void Insertllight(EERIE_LIGHT * el,float dist)
 	}
 }
 
+/*!
+ * Rebuild the entity light grid if the light lists have been updated or replaced since it was
+ * built. The range matches the cutoff in Insertllight().
+ */
+static void UpdateEntityLightGrid() {
+	
+	const std::vector<EERIE_LIGHT *> & lights = entityLightGrid.getLights();
+	if(entityLightGridValid && lights.size() == size_t(TOTIOPDL + TOTPDL)
+	   && std::equal(IO_PDL, IO_PDL + TOTIOPDL, lights.begin())
+	   && std::equal(PDL, PDL + TOTPDL, lights.begin() + TOTIOPDL)) {
+		return;
+	}
+	
+	entityLightGrid.clear();
+	for(long i = 0; i < TOTIOPDL; i++) {
+		entityLightGrid.add(IO_PDL[i], 560.f);
+	}
+	for(long i = 0; i < TOTPDL; i++) {
+		entityLightGrid.add(PDL[i], 560.f);
+	}
+	entityLightGrid.build();
+	
+	entityLightGridValid = true;
+}
+
 void UpdateLlights(Vec3f & tv) {
 	llightsInit();
 
-	for(int i = 0; i < TOTIOPDL; i++) {
-		Insertllight(IO_PDL[i], glm::distance(IO_PDL[i]->pos, tv));
-	}
+	UpdateEntityLightGrid();
 
-	for(int i = 0; i < TOTPDL; i++) {
-		Insertllight(PDL[i], glm::distance(PDL[i]->pos, tv));
+	LightGrid::Range lights = entityLightGrid.query(tv.x, tv.z);
+	for(const LightGrid::Index * i = lights.first; i != lights.second; ++i) {
+		EERIE_LIGHT * el = entityLightGrid.getLight(*i);
+		Insertllight(el, glm::distance(el->pos, tv));
 	}
 }
 
+void LoadLlights(VertexLighting & lighting) {
+	lighting.setLights(llights, MAX_LLIGHTS);
+}
+
 struct TILE_LIGHTS
 {
 	std::vector<EERIE_LIGHT *> el;
@@ -516,10 +570,11 @@ void ComputeTileLights(short x,short z)
 	float xx=((float)x+0.5f)*ACTIVEBKG->Xdiv;
 	float zz=((float)z+0.5f)*ACTIVEBKG->Zdiv;
 
-	for(long i=0; i < TOTPDL; i++) {
-		if(closerThan(Vec2f(xx, zz), Vec2f(PDL[i]->pos.x, PDL[i]->pos.z), PDL[i]->fallend + 60.f)) {
-
-			tilelights[x][z].el.push_back(PDL[i]);
+	// Only lights from the last PrecalcDynamicLighting() call are considered.
+	LightGrid::Range lights = tileLightGrid.query(xx, zz);
+	for(const LightGrid::Index * i = lights.first; i != lights.second; ++i) {
+		if(tileLightGrid.affects(*i, xx, zz)) {
+			tilelights[x][z].el.push_back(tileLightGrid.getLight(*i));
 		}
 	}
 }
@@ -616,56 +671,6 @@ float GetColorz(const Vec3f &pos) {
 	return (std::min(ffr, 255.f) + std::min(ffg, 255.f) + std::min(ffb, 255.f)) * (1.f/3);
 }
 
-ColorBGRA ApplyLight(const EERIE_QUAT * quat, const Vec3f & position, const Vec3f & normal, const ColorMod & colorMod, float materialDiffuse) {
-
-	Color3f tempColor = colorMod.ambientColor;
-
-	// Dynamic lights
-	for(int l = 0; l != MAX_LLIGHTS; l++) {
-		EERIE_LIGHT * light = llights[l];
-
-		if(!light)
-			break;
-
-		Vec3f vLight = glm::normalize(light->pos - position);
-
-		Vec3f Cur_vLights;
-		TransformInverseVertexQuat(quat, &vLight, &Cur_vLights);
-
-		float cosangle = glm::dot(normal, Cur_vLights);
-
-		// If light visible
-		if(cosangle > 0.f) {
-			float distance = fdist(position, light->pos);
-
-			// Evaluate its intensity depending on the distance Light<->Object
-			if(distance <= light->fallstart) {
-				cosangle *= light->precalc;
-			} else {
-				float p = ((light->fallend - distance) * light->falldiffmul);
-
-				if(p <= 0.f)
-					cosangle = 0.f;
-				else
-					cosangle *= p * light->precalc;
-			}
-
-			cosangle *= materialDiffuse;
-
-			tempColor += light->rgb255 * cosangle;
-		}
-	}
-
-	tempColor *= colorMod.factor;
-	tempColor += colorMod.term;
-
-	u8 ir = clipByte255(tempColor.r);
-	u8 ig = clipByte255(tempColor.g);
-	u8 ib = clipByte255(tempColor.b);
-
-	return (0xFF000000L | (ir << 16) | (ig << 8) | (ib));
-}
-
 void ApplyTileLights(EERIEPOLY * ep, short x, short y)
 {
 
@@ -746,9 +751,6 @@ float my_CheckInPoly(float x, float y, float z, EERIEPOLY * mon_ep, EERIE_LIGHT
 	EERIEPOLY * ep;
 	EERIE_BKG_INFO * eg;
 
-	Vec3f dest;
-	Vec3f hit;
-
 	Vec3f orgn = light->pos;
 
 	for (long j = pz - 2; j <= pz + 2; j++)
@@ -778,9 +780,14 @@ float my_CheckInPoly(float x, float y, float z, EERIEPOLY * mon_ep, EERIE_LIGHT
 
 							if(glm::dot(*mon_ep->nrml, *ep->nrml) > 0.0f) {
 								nb_totalvertexinpoly += nbvert;
+								Vec3f dest[4];
+								bool visible[4];
+								for(b = 0; b < nbvert; b++) {
+									dest[b] = ep->v[b].p;
+								}
+								VisibleBatch(orgn, dest, nbvert, ep, visible);
 								for(b = 0; b < nbvert; b++) {
-									dest = ep->v[b].p;
-									if(Visible(&orgn, &dest, ep, &hit)) {
+									if(visible[b]) {
 										nb_shadowvertexinpoly ++;
 									}
 								}
@@ -809,6 +816,26 @@ static void ARX_EERIE_LIGHT_Make(EERIEPOLY * ep, float * epr, float * epg, float
 		distance[i] = glm::distance(light->pos, ep->v[i].p);
 	}
 
+	// trace the rays to all vertices in range together
+	bool visible[4] = { true, true, true, true };
+	if((ModeLight & MODE_RAYLAUNCH) && !(light->extras & EXTRAS_NOCASTED)
+	   && !(ModeLight & MODE_SMOOTH)) {
+		Vec3f dest[4];
+		int index[4];
+		bool result[4];
+		int count = 0;
+		for(int i = 0; i < nbvert; i++) {
+			if(distance[i] < light->fallend) {
+				dest[count] = ep->v[i].p;
+				index[count++] = i;
+			}
+		}
+		VisibleBatch(light->pos, dest, count, ep, result);
+		for(int i = 0; i < count; i++) {
+			visible[index[i]] = result[i];
+		}
+	}
+
 	for(int i = 0; i < nbvert; i++) {
 		// value of light intensity for a given vertex
 		float fRes = 1.0f;
@@ -826,12 +853,10 @@ static void ARX_EERIE_LIGHT_Make(EERIEPOLY * ep, float * epr, float * epg, float
 
 			//MODE_RAYLAUNCH
 			if((ModeLight & MODE_RAYLAUNCH) && !(light->extras & EXTRAS_NOCASTED)) {
-				Vec3f orgn = light->pos, dest = ep->v[i].p, hit;
-
 				if(ModeLight & MODE_SMOOTH)
 					fRes *= my_CheckInPoly(ep->v[i].p.x, ep->v[i].p.y, ep->v[i].p.z, ep, light);
 				else
-					fRes *= Visible(&orgn, &dest, ep, &hit);
+					fRes *= visible[i];
 			}
 
 			float fTemp1 = light->intensity * fRes * GLOBAL_LIGHT_FACTOR;
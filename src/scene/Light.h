@@ -57,9 +57,9 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 
 struct EERIE_LIGHT;
 struct EERIEPOLY;
-struct EERIE_QUAT;
 struct SMY_VERTEX;
 class Entity;
+class VertexLighting;
 
 const size_t MAX_LIGHTS = 1200;
 const size_t MAX_DYNLIGHTS = 500;
@@ -151,13 +151,15 @@ void PrecalcDynamicLighting(long x0,long x1,long z0,long z1);
 
 void UpdateLlights(Vec3f & tv);
 
+//! Use the lights selected by the last UpdateLlights() call for a lighting batch
+void LoadLlights(VertexLighting & lighting);
+
 void InitTileLights();
 void ResetTileLights();
 void ComputeTileLights(short x,short z);
 void ClearTileLights();
 
 float GetColorz(const Vec3f &pos);
-ColorBGRA ApplyLight(const EERIE_QUAT * quat, const Vec3f & position, const Vec3f & normal, const ColorMod & colorMod, float materialDiffuse = 1.f);
 void ApplyTileLights(EERIEPOLY * ep, short x, short y);
 
 
@@ -0,0 +1,161 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "scene/LightGrid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "scene/Light.h"
+
+const float LightGrid::CellSize = 256.f;
+const float LightGrid::Margin = 100.f;
+
+//! Larger areas use bigger cells
+static const int MaxCells = 128;
+
+//! Check if the area affected by a light can be represented by a finite box
+static bool isBounded(float x, float z, float radius) {
+	const float limit = std::numeric_limits<float>::max();
+	// This also catches invalid (NaN) positions.
+	return radius < limit && x > -limit && x < limit && z > -limit && z < limit;
+}
+
+LightGrid::LightGrid() : m_minx(0.f), m_minz(0.f), m_cellSize(CellSize), m_width(0), m_height(0) { }
+
+void LightGrid::clear() {
+	
+	m_lights.clear();
+	m_x.clear();
+	m_z.clear();
+	m_radius.clear();
+	m_radius2.clear();
+	
+	m_width = m_height = 0;
+	m_cellStart.clear();
+	m_cellLights.clear();
+}
+
+void LightGrid::add(EERIE_LIGHT * light, float range) {
+	
+	float radius = light->fallend + range;
+	
+	m_lights.push_back(light);
+	m_x.push_back(light->pos.x);
+	m_z.push_back(light->pos.z);
+	m_radius.push_back(std::abs(radius) + Margin);
+	m_radius2.push_back(radius * radius);
+}
+
+int LightGrid::getCellX(float x) const {
+	float cell = std::floor((x - m_minx) / m_cellSize);
+	return int(std::max(0.f, std::min(cell, float(m_width - 1))));
+}
+
+int LightGrid::getCellZ(float z) const {
+	float cell = std::floor((z - m_minz) / m_cellSize);
+	return int(std::max(0.f, std::min(cell, float(m_height - 1))));
+}
+
+void LightGrid::build() {
+	
+	m_width = m_height = 0;
+	m_cellStart.clear();
+	m_cellLights.clear();
+	
+	if(m_lights.empty()) {
+		return;
+	}
+	
+	arx_assert(m_lights.size() - 1 <= size_t(Index(-1)));
+	
+	const float limit = std::numeric_limits<float>::max();
+	
+	float minx = limit, minz = limit, maxx = -limit, maxz = -limit;
+	for(size_t i = 0; i < m_lights.size(); i++) {
+		if(isBounded(m_x[i], m_z[i], m_radius[i])) {
+			minx = std::min(minx, m_x[i] - m_radius[i]), maxx = std::max(maxx, m_x[i] + m_radius[i]);
+			minz = std::min(minz, m_z[i] - m_radius[i]), maxz = std::max(maxz, m_z[i] + m_radius[i]);
+		}
+	}
+	
+	float extent = std::max(maxx - minx, maxz - minz);
+	if(extent >= 0.f && extent < limit) {
+		m_minx = minx, m_minz = minz;
+		m_cellSize = std::max(CellSize, extent / float(MaxCells - 1));
+		m_width = std::min(int((maxx - minx) / m_cellSize) + 1, MaxCells);
+		m_height = std::min(int((maxz - minz) / m_cellSize) + 1, MaxCells);
+	} else {
+		m_minx = m_minz = 0.f;
+		m_cellSize = CellSize;
+		m_width = m_height = 1;
+	}
+	
+	// Lights with invalid positions are stored in every cell and left to the exact checks.
+	
+	m_cellStart.assign(size_t(m_width * m_height) + 1, 0);
+	
+	for(int pass = 0; pass < 2; pass++) {
+		
+		std::vector<u32> cursor;
+		if(pass == 1) {
+			for(size_t cell = 1; cell < m_cellStart.size(); cell++) {
+				m_cellStart[cell] += m_cellStart[cell - 1];
+			}
+			m_cellLights.resize(m_cellStart.back());
+			cursor.assign(m_cellStart.begin(), m_cellStart.end() - 1);
+		}
+		
+		for(size_t i = 0; i < m_lights.size(); i++) {
+			
+			int x0 = 0, x1 = m_width - 1, z0 = 0, z1 = m_height - 1;
+			if(isBounded(m_x[i], m_z[i], m_radius[i])) {
+				x0 = getCellX(m_x[i] - m_radius[i]), x1 = getCellX(m_x[i] + m_radius[i]);
+				z0 = getCellZ(m_z[i] - m_radius[i]), z1 = getCellZ(m_z[i] + m_radius[i]);
+			}
+			
+			for(int z = z0; z <= z1; z++) {
+				for(int x = x0; x <= x1; x++) {
+					size_t cell = size_t(z * m_width + x);
+					if(pass == 0) {
+						m_cellStart[cell + 1]++;
+					} else {
+						m_cellLights[cursor[cell]++] = Index(i);
+					}
+				}
+			}
+			
+		}
+		
+	}
+	
+}
+
+LightGrid::Range LightGrid::query(float x, float z) const {
+	
+	if(m_cellLights.empty()) {
+		return Range(NULL, NULL);
+	}
+	
+	size_t cell = size_t(getCellZ(z) * m_width + getCellX(x));
+	
+	const Index * lights = &m_cellLights[0];
+	return Range(lights + m_cellStart[cell], lights + m_cellStart[cell + 1]);
+}
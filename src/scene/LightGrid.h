@@ -0,0 +1,106 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARX_SCENE_LIGHTGRID_H
+#define ARX_SCENE_LIGHTGRID_H
+
+#include <stddef.h>
+#include <utility>
+#include <vector>
+
+#include "platform/Platform.h"
+
+struct EERIE_LIGHT;
+
+/*!
+ * Uniform grid over the horizontal (x/z) area affected by a set of lights.
+ *
+ * Each light is stored in every cell touched by the square around its position that extends
+ * fallend plus a light-independent range in each direction, enlarged by a margin so that lights
+ * that move or grow a little before the grid is queried are still found.
+ *
+ * The grid is rebuilt from scratch whenever the light set changes, usually once per frame.
+ * Cells store indices into compact per-light arrays instead of the lights themselves, and the
+ * light order within each cell is the order the lights were added in, so that code iterating
+ * over the candidates gives the same results as code iterating over the full light list.
+ */
+class LightGrid {
+	
+public:
+	
+	typedef u16 Index;
+	typedef std::pair<const Index *, const Index *> Range;
+	
+	//! Minimum size of a grid cell
+	static const float CellSize;
+	
+	//! How far a light may move or grow between build() and query() and still be found
+	static const float Margin;
+	
+	LightGrid();
+	
+	void clear();
+	
+	//! Add a light that affects everything horizontally closer than its fallend plus range
+	void add(EERIE_LIGHT * light, float range);
+	
+	//! Sort the added lights into cells - must be called before query()
+	void build();
+	
+	size_t size() const { return m_lights.size(); }
+	const std::vector<EERIE_LIGHT *> & getLights() const { return m_lights; }
+	EERIE_LIGHT * getLight(Index i) const { return m_lights[i]; }
+	
+	//! Find all lights that may affect the horizontal position (x, z), in the order they were added
+	Range query(float x, float z) const;
+	
+	/*!
+	 * Check if a light affects the horizontal position (x, z).
+	 * Uses the light position and radius from the time the light was added.
+	 */
+	bool affects(Index i, float x, float z) const {
+		float dx = x - m_x[i];
+		float dz = z - m_z[i];
+		return dx * dx + dz * dz < m_radius2[i];
+	}
+	
+private:
+	
+	int getCellX(float x) const;
+	int getCellZ(float z) const;
+	
+	std::vector<EERIE_LIGHT *> m_lights;
+	
+	// Light positions and radii at the time they were added, in the same order as m_lights
+	std::vector<float> m_x;
+	std::vector<float> m_z;
+	std::vector<float> m_radius;
+	std::vector<float> m_radius2;
+	
+	float m_minx, m_minz;
+	float m_cellSize;
+	int m_width, m_height;
+	
+	//! Start of the light list for each cell in m_cellLights, followed by the total size
+	std::vector<u32> m_cellStart;
+	std::vector<Index> m_cellLights;
+	
+};
+
+#endif // ARX_SCENE_LIGHTGRID_H
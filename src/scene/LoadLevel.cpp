@@ -617,6 +617,10 @@ long DanaeLoadLevel(const res::path & file, bool loadEntities) {
 	}
 	
 	PakFile * lightingFile = resources->getFile(lightingFileName);
+	if(lightingFile) {
+		// Read the lighting file in the background while the scene is loaded.
+		resources->prefetch(lightingFileName);
+	}
 	
 	PROGRESS_BAR_COUNT += 1.f;
 	LoadLevelScreen();
@@ -962,12 +966,12 @@ long DanaeLoadLevel(const res::path & file, bool loadEntities) {
 		
 		// using compression
 		if(dlh.version >= 1.44f) {
-			char * compressed = lightingFile->readAlloc();
-			dat = (char*)blastMemAlloc(compressed, lightingFile->size(), FileSize);
+			size_t compressedSize;
+			char * compressed = resources->readAlloc(lightingFileName, compressedSize);
+			dat = (char*)blastMemAlloc(compressed, compressedSize, FileSize);
 			free(compressed);
 		} else {
-			dat = lightingFile->readAlloc();
-			FileSize = lightingFile->size();
+			dat = resources->readAlloc(lightingFileName, FileSize);
 		}
 	}
 	// TODO size ignored
@@ -46,6 +46,7 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 
 #include "scene/Scene.h"
 
+#include <algorithm>
 #include <cstdio>
 
 #include "ai/Paths.h"
@@ -68,6 +69,7 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include "graphics/DrawLine.h"
 #include "graphics/GraphicsModes.h"
 #include "graphics/Math.h"
+#include "graphics/RenderQueue.h"
 #include "graphics/VertexBuffer.h"
 #include "graphics/data/TextureContainer.h"
 #include "graphics/effects/DrawEffects.h"
@@ -79,6 +81,10 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 
 #include "io/log/Logger.h"
 
+#include "platform/Atomic.h"
+#include "platform/Profiler.h"
+#include "platform/WorkerPool.h"
+
 #include "scene/Light.h"
 #include "scene/Interactive.h"
 
@@ -1097,29 +1103,93 @@ void RenderLava() {
 	vPolyLava.clear();
 }
 
-void ARX_PORTALS_Frustrum_RenderRoomTCullSoft(long room_num, const EERIE_FRUSTRUM_DATA & frustrums, long tim) {
-	if(!RoomDraw[room_num].count)
-		return;
+namespace {
 
-	EERIE_ROOM_DATA & room = portals->room[room_num];
+//! Results of updating one room that have to be applied on the main thread.
+struct RoomCullOutput {
+	
+	std::vector<std::pair<TextureContainer *, EERIEPOLY *> > zmaps;
+	std::vector<EERIEPOLY *> lava;
+	std::vector<EERIEPOLY *> water;
+	std::vector<EERIEPOLY *> wired;
+	
+	//! Tiles whose lights were computed for this room.
+	std::vector<FAST_BKG_DATA *> tiles;
+	
+	void clear() {
+		zmaps.clear();
+		lava.clear();
+		water.clear();
+		wired.clear();
+		tiles.clear();
+	}
+	
+};
 
-	if(!room.pVertexBuffer) {
-		// No need to spam this for every frame as there will already be an
-		// earlier warning
-		LogDebug("no vertex data for room " << room_num);
-		return;
+std::vector<RoomCullOutput> roomCullOutputs;
+
+/*!
+ * Tile light state for the current frame: tileLightGeneration if the lights are ready,
+ * tileLightGeneration + 1 while they are being computed, anything else if they are stale.
+ */
+volatile u32 tileLightState[MAX_BKGX][MAX_BKGZ];
+u32 tileLightGeneration = 0;
+
+//! Invalidate the tile lights of the previous frame.
+void ResetTileLightState() {
+	tileLightGeneration += 2;
+}
+
+/*!
+ * Compute the lights for a tile unless another room already did so this frame.
+ * If another thread is currently computing them, wait until they are ready.
+ * @return true if the lights were computed by this call.
+ */
+bool EnsureTileLights(short x, short z) {
+	
+	volatile u32 & state = tileLightState[x][z];
+	const u32 ready = tileLightGeneration;
+	
+	for(u32 current = atomicLoad(state); current != ready; current = atomicLoad(state)) {
+		if(current != ready + 1 && atomicCompareExchange(state, current, ready + 1)) {
+			ComputeTileLights(x, z);
+			atomicStore(state, ready);
+			return true;
+		}
 	}
+	
+	return false;
+}
 
-	SMY_VERTEX * pMyVertex = room.pVertexBuffer->lock(NoOverwrite);
+} // anonymous namespace
+
+/*!
+ * Cull the polygons of a room, build its index lists and update its vertex colors.
+ *
+ * Rooms do not share polygons, tile lights, index lists or vertices, so different rooms can be
+ * processed in parallel. Everything else that is modified is collected in output instead.
+ * Tiles are only considered untreated if they were untreated at the start of the frame so that
+ * the set of tiles whose lights are computed does not depend on the order rooms are processed in.
+ */
+static void ARX_PORTALS_Frustrum_RenderRoomTCullSoft(long room_num,
+                                                     const EERIE_FRUSTRUM_DATA & frustrums,
+                                                     long tim, SMY_VERTEX * pMyVertex,
+                                                     RoomCullOutput & output) {
+	
+	EERIE_ROOM_DATA & room = portals->room[room_num];
 
 	unsigned short *pIndices=room.pussIndice;
 
 	EP_DATA *pEPDATA = &room.epdata[0];
+	
+	const FAST_BKG_DATA * lastTile = NULL;
 
 	for(long lll=0; lll<room.nb_polys; lll++, pEPDATA++) {
 		FAST_BKG_DATA *feg = &ACTIVEBKG->fastdata[pEPDATA->px][pEPDATA->py];
 
-		if(!feg->treat) {
+		if(!feg->treat && feg != lastTile) {
+			lastTile = feg;
+			
 			short ix = std::max(pEPDATA->px - 1, 0);
 			short ax = std::min(pEPDATA->px + 1, ACTIVEBKG->Xsize - 1);
 			short iz = std::max(pEPDATA->py - 1, 0);
@@ -1129,9 +1199,8 @@ void ARX_PORTALS_Frustrum_RenderRoomTCullSoft(long room_num, const EERIE_FRUSTRU
 			for(short nx=ix; nx<=ax; nx++) {
 				FAST_BKG_DATA * feg2 = &ACTIVEBKG->fastdata[nx][nz];
 
-				if(!feg2->treat) {
-					feg2->treat=1;
-					ComputeTileLights(nx, nz);
+				if(!feg2->treat && EnsureTileLights(nx, nz)) {
+					output.tiles.push_back(feg2);
 				}
 			}
 		}
@@ -1185,7 +1254,7 @@ void ARX_PORTALS_Frustrum_RenderRoomTCullSoft(long room_num, const EERIE_FRUSTRU
 
 			if(ZMAPMODE) {
 				if(fDist < 200 && ep->tex->TextureRefinement) {
-					ep->tex->TextureRefinement->vPolyZMap.push_back(ep);
+					output.zmaps.push_back(std::make_pair(ep->tex->TextureRefinement, ep));
 				}
 			}
 		}
@@ -1233,15 +1302,15 @@ void ARX_PORTALS_Frustrum_RenderRoomTCullSoft(long room_num, const EERIE_FRUSTRU
 
 				if(ep->type & POLY_LAVA) {
 					ManageLava_VertexBuffer(ep, to, tim, pMyVertexCurr);
-					vPolyLava.push_back(ep);
+					output.lava.push_back(ep);
 				} else if(ep->type & POLY_WATER) {
 					ManageWater_VertexBuffer(ep, to, tim, pMyVertexCurr);
-					vPolyWater.push_back(ep);
+					output.water.push_back(ep);
 				}
 			}
 
 			if((ViewMode & VIEWMODE_WIRE) && EERIERTPPoly(ep))
-				EERIEPOLY_DrawWired(ep);
+				output.wired.push_back(ep);
 
 		} else { // Improve Vision Activated
 			if(!(ep->type & POLY_TRANS)) {
@@ -1289,18 +1358,115 @@ void ARX_PORTALS_Frustrum_RenderRoomTCullSoft(long room_num, const EERIE_FRUSTRU
 			}
 		}
 	}
+}
+
+namespace {
 
-	room.pVertexBuffer->unlock();
+//! Updates the rooms in RoomDrawList, largest first.
+class RoomCullTask : public WorkerPool::Task {
+	
+public:
+	
+	struct Room {
+		
+		long num;
+		SMY_VERTEX * vertices;
+		
+		bool operator<(const Room & o) const {
+			return portals->room[num].nb_polys > portals->room[o.num].nb_polys;
+		}
+		
+	};
+	
+	std::vector<Room> rooms;
+	long tim;
+	
+	void run(size_t begin, size_t end, size_t /* thread */) {
+		for(size_t i = begin; i < end; i++) {
+			long room_num = rooms[i].num;
+			ARX_PORTALS_Frustrum_RenderRoomTCullSoft(room_num, RoomDraw[room_num].frustrum, tim,
+			                                         rooms[i].vertices, roomCullOutputs[room_num]);
+		}
+	}
+	
+} roomCullTask;
+
+} // anonymous namespace
+
+static void ARX_PORTALS_UpdateRooms(long tim) {
+	
+	roomCullTask.rooms.clear();
+	roomCullTask.tim = tim;
+	
+	if(roomCullOutputs.size() < RoomDraw.size()) {
+		roomCullOutputs.resize(RoomDraw.size());
+	}
+	
+	// Vertex buffers can only be locked from the main thread.
+	for(size_t i = 0; i < RoomDrawList.size(); i++) {
+		long room_num = RoomDrawList[i];
+		if(!RoomDraw[room_num].count) {
+			continue;
+		}
+		EERIE_ROOM_DATA & room = portals->room[room_num];
+		if(!room.pVertexBuffer) {
+			// No need to spam this for every frame as there will already be an
+			// earlier warning
+			LogDebug("no vertex data for room " << room_num);
+			continue;
+		}
+		RoomCullTask::Room entry;
+		entry.num = room_num;
+		entry.vertices = room.pVertexBuffer->lock(NoOverwrite);
+		roomCullTask.rooms.push_back(entry);
+		roomCullOutputs[room_num].clear();
+	}
+	
+	std::sort(roomCullTask.rooms.begin(), roomCullTask.rooms.end());
+	
+	if(g_workerPool) {
+		g_workerPool->run(roomCullTask, roomCullTask.rooms.size());
+	} else {
+		roomCullTask.run(0, roomCullTask.rooms.size(), 0);
+	}
+	
+	// Apply the results in the same order as the rooms would be updated sequentially.
+	for(size_t i = 0; i < RoomDrawList.size(); i++) {
+		long room_num = RoomDrawList[i];
+		if(!RoomDraw[room_num].count || !portals->room[room_num].pVertexBuffer) {
+			continue;
+		}
+		
+		portals->room[room_num].pVertexBuffer->unlock();
+		
+		const RoomCullOutput & output = roomCullOutputs[room_num];
+		for(size_t j = 0; j < output.zmaps.size(); j++) {
+			output.zmaps[j].first->vPolyZMap.push_back(output.zmaps[j].second);
+		}
+		vPolyLava.insert(vPolyLava.end(), output.lava.begin(), output.lava.end());
+		vPolyWater.insert(vPolyWater.end(), output.water.begin(), output.water.end());
+		for(size_t j = 0; j < output.wired.size(); j++) {
+			EERIEPOLY_DrawWired(output.wired[j]);
+		}
+		for(size_t j = 0; j < output.tiles.size(); j++) {
+			output.tiles[j]->treat = 1;
+		}
+	}
+	
 }
 
 
-void ARX_PORTALS_Frustrum_RenderRoomTCullSoftRender(long room_num) {
+//! Distance used to sort the geometry of a room
+static float GetRoomDepth(long room_num) {
+	const EERIE_ROOM_DATA & room = portals->room[room_num];
+	return std::max(0.f, fdist(ACTIVECAM->orgTrans.pos, room.center) - room.radius);
+}
+
+static void ARX_PORTALS_Frustrum_QueueRoomTCullSoftRender(long room_num) {
 
 	EERIE_ROOM_DATA & room = portals->room[room_num];
 
-	//render opaque
-	GRenderer->SetCulling(Renderer::CullNone);
-	GRenderer->SetAlphaFunc(Renderer::CmpGreater, .5f);
+	float depth = GetRoomDepth(room_num);
 
 	int iNbTex = room.usNbTextures;
 	TextureContainer **ppTexCurr = room.ppTextureContainer;
@@ -1310,42 +1476,33 @@ void ARX_PORTALS_Frustrum_RenderRoomTCullSoftRender(long room_num) {
 
 		SMY_ARXMAT & roomMat = pTexCurr->tMatRoom[room_num];
 
-		if(ViewMode & VIEWMODE_FLAT)
-			GRenderer->ResetTexture(0);
-		else
-			GRenderer->SetTexture(0, pTexCurr);
-
 		if(roomMat.count[SMY_ARXMAT::Opaque]) {
-			if (pTexCurr->userflags & POLY_METAL)
-				GRenderer->GetTextureStage(0)->setColorOp(TextureStage::OpModulate2X);
-			else
-				GRenderer->GetTextureStage(0)->setColorOp(TextureStage::OpModulate);
-
-			
+			RenderQueue::Material material((ViewMode & VIEWMODE_FLAT) ? NULL : pTexCurr);
+			material.blend = RenderQueue::NoBlending;
+			if(pTexCurr->userflags & POLY_METAL) {
+				material.colorOp = TextureStage::OpModulate2X;
+			} else {
+				material.colorOp = TextureStage::OpModulate;
+			}
 
-			room.pVertexBuffer->drawIndexed(
-				Renderer::TriangleList,
-				roomMat.uslNbVertex,
-				roomMat.uslStartVertex,
-				&room.pussIndice[roomMat.offset[SMY_ARXMAT::Opaque]],
-				roomMat.count[SMY_ARXMAT::Opaque]);
+			g_renderQueue.add(material, depth, room.pVertexBuffer,
+			                  roomMat.uslStartVertex, roomMat.uslNbVertex,
+			                  &room.pussIndice[roomMat.offset[SMY_ARXMAT::Opaque]],
+			                  roomMat.count[SMY_ARXMAT::Opaque]);
 
 			EERIEDrawnPolys += roomMat.count[SMY_ARXMAT::Opaque];
 		}
 
 		ppTexCurr++;
 	}
+}
 
-	//////////////////////////////
-	// ZMapp
-	GRenderer->GetTextureStage(0)->setColorOp(TextureStage::OpModulate);
+static void ARX_PORTALS_Frustrum_RenderRoomZMapp(long room_num) {
 
-	GRenderer->SetAlphaFunc(Renderer::CmpNotEqual, 0.f);
-	GRenderer->SetRenderState(Renderer::AlphaBlending, true);
-	GRenderer->SetRenderState(Renderer::DepthWrite, false);
+	EERIE_ROOM_DATA & room = portals->room[room_num];
 
-	iNbTex=room.usNbTextures;
-	ppTexCurr=room.ppTextureContainer;
+	int iNbTex = room.usNbTextures;
+	TextureContainer **ppTexCurr = room.ppTextureContainer;
 
 	// For each tex in portals->room[room_num]
 	while(iNbTex--) {
@@ -1438,9 +1595,6 @@ void ARX_PORTALS_Frustrum_RenderRoomTCullSoftRender(long room_num) {
 
 		ppTexCurr++;
 	}
-
-	GRenderer->SetRenderState(Renderer::DepthWrite, true);
-	GRenderer->SetRenderState(Renderer::AlphaBlending, false);
 }
 
 //-----------------------------------------------------------------------------
@@ -1453,18 +1607,21 @@ static const SMY_ARXMAT::TransparencyType transRenderOrder[] = {
 };
 
 
-void ARX_PORTALS_Frustrum_RenderRoom_TransparencyTSoftCull(long room_num)
+static void ARX_PORTALS_Frustrum_QueueRoom_TransparencyTSoftCull(long room_num)
 {
 	//render transparency
 	EERIE_ROOM_DATA & room = portals->room[room_num];
 
+	// Sorted back to front together with the transparent polys of all other rooms. All
+	// polys of the room share its depth, so they are only ordered by transRenderOrder.
+	float depth = GetRoomDepth(room_num);
+
 	int iNbTex = room.usNbTextures;
 	TextureContainer **ppTexCurr = room.ppTextureContainer;
 
 	while(iNbTex--) {
 
 		TextureContainer * pTexCurr = *ppTexCurr;
-		GRenderer->SetTexture(0, pTexCurr);
 
 		SMY_ARXMAT & roomMat = pTexCurr->tMatRoom[room_num];
 
@@ -1474,6 +1631,9 @@ void ARX_PORTALS_Frustrum_RenderRoom_TransparencyTSoftCull(long room_num)
 			if(!roomMat.count[transType])
 				continue;
 
+			RenderQueue::Material material(pTexCurr);
+			material.order = unsigned(i);
+
 			switch(transType) {
 			case SMY_ARXMAT::Opaque: {
 				// This should currently not happen
@@ -1481,33 +1641,31 @@ void ARX_PORTALS_Frustrum_RenderRoom_TransparencyTSoftCull(long room_num)
 				continue;
 			}
 			case SMY_ARXMAT::Blended: {
-				SetZBias(2);
-				GRenderer->SetBlendFunc(Renderer::BlendSrcColor, Renderer::BlendDstColor);
+				material.depthBias = 2;
+				material.setBlendFunc(Renderer::BlendSrcColor, Renderer::BlendDstColor);
 				break;
 			}
 			case SMY_ARXMAT::Multiplicative: {
-				SetZBias(2);
-				GRenderer->SetBlendFunc(Renderer::BlendOne, Renderer::BlendOne);
+				material.depthBias = 2;
+				material.setBlendFunc(Renderer::BlendOne, Renderer::BlendOne);
 				break;
 			}
 			case SMY_ARXMAT::Additive: {
-				SetZBias(2);
-				GRenderer->SetBlendFunc(Renderer::BlendOne, Renderer::BlendOne);
+				material.depthBias = 2;
+				material.setBlendFunc(Renderer::BlendOne, Renderer::BlendOne);
 				break;
 			}
 			case SMY_ARXMAT::Subtractive: {
-				SetZBias(8);
-				GRenderer->SetBlendFunc(Renderer::BlendZero, Renderer::BlendInvSrcColor);
+				material.depthBias = 8;
+				material.setBlendFunc(Renderer::BlendZero, Renderer::BlendInvSrcColor);
 				break;
 			}
 			}
 
-			room.pVertexBuffer->drawIndexed(
-				Renderer::TriangleList,
-				roomMat.uslNbVertex,
-				roomMat.uslStartVertex,
-				&room.pussIndice[roomMat.offset[transType]],
-				roomMat.count[transType]);
+			g_renderQueue.add(material, depth, room.pVertexBuffer,
+			                  roomMat.uslStartVertex, roomMat.uslNbVertex,
+			                  &room.pussIndice[roomMat.offset[transType]],
+			                  roomMat.count[transType]);
 
 			EERIEDrawnPolys += roomMat.count[transType];
 		}
@@ -1587,6 +1745,8 @@ void ARX_PORTALS_Frustrum_ComputeRoom(long room_num, const EERIE_FRUSTRUM & frus
 
 void ARX_SCENE_Update() {
 	arx_assert(USE_PORTALS && portals);
+	
+	ARX_PROFILE_FUNC();
 
 	unsigned long tim = (unsigned long)(arxtime);
 
@@ -1607,8 +1767,11 @@ void ARX_SCENE_Update() {
 	long z1 = std::min(camZsnap + lcval, ACTIVEBKG->Zsize - 1L);
 
 	ACTIVEBKG->Backg[camXsnap + camZsnap * ACTIVEBKG->Xsize].treat = 1;
-	TreatBackgroundDynlights();
-	PrecalcDynamicLighting(x0, z0, x1, z1);
+	{
+		ARX_PROFILE("Dynamic lights");
+		TreatBackgroundDynlights();
+		PrecalcDynamicLighting(x0, z0, x1, z1);
+	}
 
 	// Go for a growing-square-spirallike-render around the camera position
 	// (To maximize Z-Buffer efficiency)
@@ -1621,18 +1784,21 @@ void ARX_SCENE_Update() {
 	}
 
 	ResetTileLights();
+	ResetTileLightState();
 
 	long room_num=ARX_PORTALS_GetRoomNumForPosition(&ACTIVECAM->orgTrans.pos,1);
 	if(room_num>-1) {
 
-		ARX_PORTALS_InitDrawnRooms();
-		EERIE_FRUSTRUM frustrum;
-		CreateScreenFrustrum(&frustrum);
-		ARX_PORTALS_Frustrum_ComputeRoom(room_num, frustrum);
-
-		for(size_t i = 0; i < RoomDrawList.size(); i++) {
-			ARX_PORTALS_Frustrum_RenderRoomTCullSoft(RoomDrawList[i], RoomDraw[RoomDrawList[i]].frustrum, tim);
+		{
+			ARX_PROFILE("Portal culling");
+			ARX_PORTALS_InitDrawnRooms();
+			EERIE_FRUSTRUM frustrum;
+			CreateScreenFrustrum(&frustrum);
+			ARX_PORTALS_Frustrum_ComputeRoom(room_num, frustrum);
 		}
+
+		ARX_PROFILE("Room update");
+		ARX_PORTALS_UpdateRooms(tim);
 	}
 
 	ARX_THROWN_OBJECT_Manage(checked_range_cast<unsigned long>(framedelay));
@@ -1649,15 +1815,33 @@ extern long SPECIAL_DRAGINTER_RENDER;
 //*************************************************************************************
 ///////////////////////////////////////////////////////////
 void ARX_SCENE_Render() {
+	
+	ARX_PROFILE_FUNC();
 
 	if(uw_mode)
 		GRenderer->GetTextureStage(0)->setMipMapLODBias(10.f);
 
 	GRenderer->SetBlendFunc(Renderer::BlendZero, Renderer::BlendInvSrcColor);
+
+	g_renderQueue.setMaxDepth(ACTIVECAM->cdepth);
+
+	// Opaque room geometry, sorted by texture across all rooms
+	GRenderer->SetCulling(Renderer::CullNone);
+	GRenderer->SetAlphaFunc(Renderer::CmpGreater, .5f);
 	for(size_t i = 0; i < RoomDrawList.size(); i++) {
+		ARX_PORTALS_Frustrum_QueueRoomTCullSoftRender(RoomDrawList[i]);
+	}
+	g_renderQueue.flush();
 
-		ARX_PORTALS_Frustrum_RenderRoomTCullSoftRender(RoomDrawList[i]);
+	GRenderer->GetTextureStage(0)->setColorOp(TextureStage::OpModulate);
+	GRenderer->SetAlphaFunc(Renderer::CmpNotEqual, 0.f);
+	GRenderer->SetRenderState(Renderer::AlphaBlending, true);
+	GRenderer->SetRenderState(Renderer::DepthWrite, false);
+	for(size_t i = 0; i < RoomDrawList.size(); i++) {
+		ARX_PORTALS_Frustrum_RenderRoomZMapp(RoomDrawList[i]);
 	}
+	GRenderer->SetRenderState(Renderer::DepthWrite, true);
+	GRenderer->SetRenderState(Renderer::AlphaBlending, false);
 
 	if(!Project.improve) {
 		ARXDRAW_DrawInterShadows();
@@ -1698,9 +1882,9 @@ void ARX_SCENE_Render() {
 	GRenderer->SetAlphaFunc(Renderer::CmpGreater, .5f);
 
 	for(size_t i = 0; i < RoomDrawList.size(); i++) {
-
-		ARX_PORTALS_Frustrum_RenderRoom_TransparencyTSoftCull(RoomDrawList[i]);
+		ARX_PORTALS_Frustrum_QueueRoom_TransparencyTSoftCull(RoomDrawList[i]);
 	}
+	g_renderQueue.flush();
 
 	SetZBias(8);
 	GRenderer->SetRenderState(Renderer::DepthWrite, false);
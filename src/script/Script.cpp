@@ -51,6 +51,9 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include <sstream>
 #include <cstdio>
 #include <algorithm>
+#include <deque>
+#include <limits>
+#include <vector>
 
 #include <boost/algorithm/string/predicate.hpp>
 
@@ -77,9 +80,13 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 #include "io/resource/PakReader.h"
 #include "io/log/Logger.h"
 
+#include "platform/Profiler.h"
+#include "platform/Time.h"
+
 #include "scene/Scene.h"
 #include "scene/Interactive.h"
 
+#include "script/ScriptCache.h"
 #include "script/ScriptEvent.h"
 
 using std::sprintf;
@@ -96,6 +103,7 @@ extern Entity * pIOChangeWeapon;
 Entity * LASTSPAWNED = NULL;
 Entity * EVENT_SENDER = NULL;
 SCRIPT_VAR * svar = NULL;
+static script::VariableIndex svarIndex;
 
 static char SSEPARAMS[MAX_SSEPARAMS][64];
 long FORBID_SCRIPT_IO_CREATION = 0;
@@ -122,11 +130,8 @@ long FindScriptPos(const EERIE_SCRIPT * es, const string & str) {
 			continue;
 		}
 		
-		// Check if the line is commented out!
-		for(const char * search = dat; search[0] != '/' || search[1] != '/'; search--) {
-			if(*search == '\n' || search == es->data) {
-				return dat - es->data;
-			}
+		if(!isScriptPosCommentedOut(es, dat - es->data)) {
+			return dat - es->data;
 		}
 		
 	}
@@ -134,6 +139,17 @@ long FindScriptPos(const EERIE_SCRIPT * es, const string & str) {
 	return -1;
 }
 
+bool isScriptPosCommentedOut(const EERIE_SCRIPT * es, size_t pos) {
+	
+	for(const char * search = es->data + pos; search[0] != '/' || search[1] != '/'; search--) {
+		if(*search == '\n' || search == es->data) {
+			return false;
+		}
+	}
+	
+	return true;
+}
+
 ScriptResult SendMsgToAllIO(ScriptMessage msg, const string & params) {
 	
 	ScriptResult ret = ACCEPT;
@@ -305,6 +321,8 @@ void ReleaseScript(EERIE_SCRIPT * es) {
 	
 	free(es->data), es->data = NULL;
 	
+	delete es->cache, es->cache = NULL;
+	
 	ARX_SCRIPT_ReleaseLabels(es);
 	memset(es->shortcut, 0, sizeof(long) * MAX_SHORTCUT);
 }
@@ -1135,6 +1153,21 @@ void ARX_SCRIPT_Free_All_Global_Variables() {
 		free(svar), svar = NULL, NB_GLOBALS = 0;
 	}
 	
+	svarIndex.clear();
+}
+
+script::VariableIndex * globalVariableIndex() {
+	return &svarIndex;
+}
+
+script::VariableIndex * localVariableIndex(const EERIE_SCRIPT * es) {
+	return es->cache ? &es->cache->getLocalVariables() : NULL;
+}
+
+void invalidateLocalVariableIndex(EERIE_SCRIPT * es) {
+	if(es->cache) {
+		es->cache->getLocalVariables().clear();
+	}
 }
 
 void CloneLocalVars(Entity * ioo, Entity * io) {
@@ -1150,6 +1183,8 @@ void CloneLocalVars(Entity * ioo, Entity * io) {
 		free(ioo->script.lvar), ioo->script.lvar = NULL, ioo->script.nblvar = 0;
 	}
 	
+	invalidateLocalVariableIndex(&ioo->script);
+	
 	if (io->script.lvar)
 	{
 		ioo->script.nblvar = io->script.nblvar;
@@ -1179,7 +1214,12 @@ SCRIPT_VAR * GetFreeVarSlot(SCRIPT_VAR*& _svff, long& _nb)
 	return &svf[_nb-1];
 }
 
-SCRIPT_VAR * GetVarAddress(SCRIPT_VAR svf[], size_t nb, const string & name) {
+static SCRIPT_VAR * GetVarAddress(SCRIPT_VAR svf[], size_t nb, const string & name,
+                                  script::VariableIndex * index) {
+	
+	if(index) {
+		return index->find(svf, nb, name);
+	}
 	
 	for(size_t i = 0; i < nb; i++) {
 		if(svf[i].type != TYPE_UNKNOWN) {
@@ -1192,27 +1232,30 @@ SCRIPT_VAR * GetVarAddress(SCRIPT_VAR svf[], size_t nb, const string & name) {
 	return NULL;
 }
 
-long GETVarValueLong(SCRIPT_VAR svf[], size_t nb, const string & name) {
+long GETVarValueLong(SCRIPT_VAR svf[], size_t nb, const string & name,
+                     script::VariableIndex * index) {
 	
-	const SCRIPT_VAR * tsv = GetVarAddress(svf, nb, name);
+	const SCRIPT_VAR * tsv = GetVarAddress(svf, nb, name, index);
 
 	if (tsv == NULL) return 0;
 
 	return tsv->ival;
 }
 
-float GETVarValueFloat(SCRIPT_VAR svf[], size_t nb, const string & name) {
+float GETVarValueFloat(SCRIPT_VAR svf[], size_t nb, const string & name,
+                       script::VariableIndex * index) {
 	
-	const SCRIPT_VAR * tsv = GetVarAddress(svf, nb, name);
+	const SCRIPT_VAR * tsv = GetVarAddress(svf, nb, name, index);
 
 	if (tsv == NULL) return 0;
 
 	return tsv->fval;
 }
 
-std::string GETVarValueText(SCRIPT_VAR svf[], size_t nb, const string & name) {
+std::string GETVarValueText(SCRIPT_VAR svf[], size_t nb, const string & name,
+                            script::VariableIndex * index) {
 	
-	const SCRIPT_VAR* tsv = GetVarAddress(svf, nb, name);
+	const SCRIPT_VAR* tsv = GetVarAddress(svf, nb, name, index);
 
 	if (!tsv) return "";
 
@@ -1250,28 +1293,28 @@ string GetVarValueInterpretedAsText(const string & temp1, const EERIE_SCRIPT * e
 		}
 		else if (temp1[0] == '#')
 		{
-			long l1 = GETVarValueLong(svar, NB_GLOBALS, temp1);
+			long l1 = GETVarValueLong(svar, NB_GLOBALS, temp1, globalVariableIndex());
 			sprintf(var_text, "%ld", l1);
 			return var_text;
 		}
 		else if (temp1[0] == '\xA7')
 		{
-			long l1 = GETVarValueLong(esss->lvar, esss->nblvar, temp1);
+			long l1 = GETVarValueLong(esss->lvar, esss->nblvar, temp1, localVariableIndex(esss));
 			sprintf(var_text, "%ld", l1);
 			return var_text;
 		}
-		else if (temp1[0] == '&') t1 = GETVarValueFloat(svar, NB_GLOBALS, temp1);
-		else if (temp1[0] == '@') t1 = GETVarValueFloat(esss->lvar, esss->nblvar, temp1);
+		else if (temp1[0] == '&') t1 = GETVarValueFloat(svar, NB_GLOBALS, temp1, globalVariableIndex());
+		else if (temp1[0] == '@') t1 = GETVarValueFloat(esss->lvar, esss->nblvar, temp1, localVariableIndex(esss));
 		else if (temp1[0] == '$')
 		{
-			SCRIPT_VAR * var = GetVarAddress(svar, NB_GLOBALS, temp1);
+			SCRIPT_VAR * var = GetVarAddress(svar, NB_GLOBALS, temp1, globalVariableIndex());
 
 			if (!var) return "void";
 			else return var->text;
 		}
 		else if (temp1[0] == '\xA3')
 		{
-			SCRIPT_VAR * var = GetVarAddress(esss->lvar, esss->nblvar, temp1);
+			SCRIPT_VAR * var = GetVarAddress(esss->lvar, esss->nblvar, temp1, localVariableIndex(esss));
 
 			if (!var) return "void";
 			else return var->text;
@@ -1307,21 +1350,22 @@ float GetVarValueInterpretedAsFloat(const string & temp1, const EERIE_SCRIPT * e
 				break;
 		}
 	} else if(temp1[0] == '#') {
-		return (float)GETVarValueLong(svar, NB_GLOBALS, temp1);
+		return (float)GETVarValueLong(svar, NB_GLOBALS, temp1, globalVariableIndex());
 	} else if(temp1[0] == '\xA7') {
-		return (float)GETVarValueLong(esss->lvar, esss->nblvar, temp1);
+		return (float)GETVarValueLong(esss->lvar, esss->nblvar, temp1, localVariableIndex(esss));
 	} else if(temp1[0] == '&') {
-		return GETVarValueFloat(svar, NB_GLOBALS, temp1);
+		return GETVarValueFloat(svar, NB_GLOBALS, temp1, globalVariableIndex());
 	} else if(temp1[0] == '@') {
-		return GETVarValueFloat(esss->lvar, esss->nblvar, temp1);
+		return GETVarValueFloat(esss->lvar, esss->nblvar, temp1, localVariableIndex(esss));
 	}
 	
 	return (float)atof(temp1.c_str());
 }
 
-SCRIPT_VAR* SETVarValueLong(SCRIPT_VAR*& svf, long& nb, const std::string& name, long val)
+SCRIPT_VAR* SETVarValueLong(SCRIPT_VAR*& svf, long& nb, const std::string& name, long val,
+                            script::VariableIndex * index)
 {
-	SCRIPT_VAR* tsv = GetVarAddress(svf, nb, name);
+	SCRIPT_VAR* tsv = GetVarAddress(svf, nb, name, index);
 
 	if (!tsv)
 	{
@@ -1331,15 +1375,20 @@ SCRIPT_VAR* SETVarValueLong(SCRIPT_VAR*& svf, long& nb, const std::string& name,
 			return NULL;
 
 		strcpy(tsv->name, name.c_str());
+		
+		if(index) {
+			index->add(svf, nb);
+		}
 	}
 
 	tsv->ival = val;
 	return tsv;
 }
 
-SCRIPT_VAR* SETVarValueFloat(SCRIPT_VAR*& svf, long& nb, const std::string& name, float val)
+SCRIPT_VAR* SETVarValueFloat(SCRIPT_VAR*& svf, long& nb, const std::string& name, float val,
+                             script::VariableIndex * index)
 {
-	SCRIPT_VAR* tsv = GetVarAddress(svf, nb, name);
+	SCRIPT_VAR* tsv = GetVarAddress(svf, nb, name, index);
 
 	if (!tsv)
 	{
@@ -1349,15 +1398,20 @@ SCRIPT_VAR* SETVarValueFloat(SCRIPT_VAR*& svf, long& nb, const std::string& name
 			return NULL;
 
 		strcpy(tsv->name, name.c_str());
+		
+		if(index) {
+			index->add(svf, nb);
+		}
 	}
 
 	tsv->fval = val;
 	return tsv;
 }
 
-SCRIPT_VAR* SETVarValueText(SCRIPT_VAR*& svf, long& nb, const std::string& name, const std::string& val)
+SCRIPT_VAR* SETVarValueText(SCRIPT_VAR*& svf, long& nb, const std::string& name, const std::string& val,
+                            script::VariableIndex * index)
 {
-	SCRIPT_VAR* tsv = GetVarAddress(svf, nb, name);
+	SCRIPT_VAR* tsv = GetVarAddress(svf, nb, name, index);
 
 	if (!tsv)
 	{
@@ -1367,6 +1421,10 @@ SCRIPT_VAR* SETVarValueText(SCRIPT_VAR*& svf, long& nb, const std::string& name,
 			return NULL;
 
 		strcpy(tsv->name, name.c_str());
+		
+		if(index) {
+			index->add(svf, nb);
+		}
 	}
 	
 	
@@ -1499,116 +1557,152 @@ void MakeSSEPARAMS(const char * params)
 	}
 }
 
-#define MAX_EVENT_STACK 800
-struct STACKED_EVENT {
-	Entity * sender;
-	long              exist;
-	Entity * io;
-	ScriptMessage     msg;
-	std::string       params;
-	std::string       eventname;
+//! Minimum number of queued events to execute each frame, regardless of the time budget
+static const size_t MIN_EVENTS_PER_FRAME = 20;
+
+//! Maximum number of passes over the queue when executing all events, guards against event loops
+static const size_t MAX_EVENT_QUEUE_PASSES = 100;
+
+struct QueuedEvent {
+	EntityHandle sender;
+	EntityHandle io;
+	unsigned epoch; //!< Value of eventCancelEpochs for io when the event was queued
+	ScriptMessage msg;
+	std::string params;
+	std::string eventname;
+	u64 time; //!< When the event was queued, in microseconds
 };
 
-STACKED_EVENT eventstack[MAX_EVENT_STACK];
+//! Pending events in the order they were sent
+static std::deque<QueuedEvent> eventQueue;
+
+/*!
+ * Incremented for an entity index to cancel all events queued for that entity so far,
+ * without having to search the queue.
+ */
+static std::vector<unsigned> eventCancelEpochs;
+
+static ScriptEventQueueStats eventQueueStats;
+
+static unsigned & getEventCancelEpoch(size_t index) {
+	if(index >= eventCancelEpochs.size()) {
+		eventCancelEpochs.resize(index + 1, 0);
+	}
+	return eventCancelEpochs[index];
+}
 
 void ARX_SCRIPT_EventStackInit()
 {
-	ARX_SCRIPT_EventStackClear( false ); // Clear everything in the stack
+	ARX_SCRIPT_EventStackClear(); // Clear everything in the stack
 }
-void ARX_SCRIPT_EventStackClear( bool check_exist )
+void ARX_SCRIPT_EventStackClear()
 {
 	LogDebug("Event Stack Clear");
-	for (long i = 0; i < MAX_EVENT_STACK; i++)
-	{
-		if ( check_exist ) // If we're not blatantly clearing everything
-			if ( !eventstack[i].exist ) // If the Stacked_Event is not being used
-				continue; // Continue on to the next one
-
-			// Otherwise, clear all the fields in this stacked_event
-			eventstack[i].sender = NULL;
-			eventstack[i].exist = 0;
-			eventstack[i].io = NULL;
-			eventstack[i].msg = SM_NULL;
-			eventstack[i].params.clear();
-			eventstack[i].eventname.clear();
-	}
+	eventQueue.clear();
+	eventQueueStats.depth = 0;
 }
 
-long STACK_FLOW = 8;
-
 void ARX_SCRIPT_EventStackClearForIo(Entity * io)
 {
-	for (long i = 0; i < MAX_EVENT_STACK; i++)
-	{
-		if (eventstack[i].exist)
-		{
-			if (eventstack[i].io == io)
-			{
-				eventstack[i].sender = NULL;
-				eventstack[i].exist = 0;
-				eventstack[i].io = NULL;
-				eventstack[i].msg = SM_NULL;
-				eventstack[i].params.clear();
-				eventstack[i].eventname.clear();
-			}
+	EntityHandle handle = entities.getHandle(io);
+	if(handle.index != size_t(-1)) {
+		getEventCancelEpoch(handle.index)++;
+	}
+}
+
+/*!
+ * Execute events from the front of the queue.
+ * Events queued while executing are left for the next call.
+ * @param budget time in microseconds after which to stop once MIN_EVENTS_PER_FRAME
+ *               events have been executed
+ */
+static void executeQueuedEvents(u64 budget) {
+	
+	ARX_PROFILE("Script events");
+	
+	u64 start = Time::getUs();
+	
+	size_t count = eventQueue.size();
+	for(size_t i = 0; i < count; i++) {
+		
+		if(i >= MIN_EVENTS_PER_FRAME && Time::getElapsedUs(start) >= budget) {
+			break;
+		}
+		
+		// Take the event out of the queue first as executing it may queue new events
+		QueuedEvent & event = eventQueue.front();
+		Entity * io = entities.get(event.io);
+		if(io && event.epoch != getEventCancelEpoch(event.io.index)) {
+			io = NULL;
+		}
+		EntityHandle sender = event.sender;
+		ScriptMessage msg = event.msg;
+		u64 time = event.time;
+		std::string params, eventname;
+		params.swap(event.params);
+		eventname.swap(event.eventname);
+		eventQueue.pop_front();
+		
+		if(!io) {
+			continue;
 		}
+		
+		u64 latency = Time::getElapsedUs(time);
+		eventQueueStats.maxLatency = std::max(eventQueueStats.maxLatency, latency);
+		eventQueueStats.totalLatency += latency;
+		eventQueueStats.executed++;
+		
+		EVENT_SENDER = entities.get(sender);
+		
+		SendIOScriptEvent(io, msg, params, eventname);
 	}
+	
+	eventQueueStats.depth = eventQueue.size();
 }
 
 void ARX_SCRIPT_EventStackExecute()
 {
-	long count = 0;
-
-	for (long i = 0; i < MAX_EVENT_STACK; i++)
-	{
-		if (eventstack[i].exist)
-		{
-			if(ValidIOAddress(eventstack[i].io)) {
-
-			if (ValidIOAddress(eventstack[i].sender))
-				EVENT_SENDER = eventstack[i].sender;
-			else
-				EVENT_SENDER = NULL;
-
-			SendIOScriptEvent(eventstack[i].io, eventstack[i].msg, eventstack[i].params, eventstack[i].eventname);
-			}
-
-			eventstack[i].sender = NULL;
-			eventstack[i].exist = 0;
-			eventstack[i].io = NULL;
-			eventstack[i].msg = SM_NULL;
-			eventstack[i].params.clear();
-			eventstack[i].eventname.clear();
-			count++;
-
-			if (count >= STACK_FLOW) return;
-		}
+	if(arxtime.has_fixed_step()) {
+		// The wall clock must not decide which events run when the game time is simulated.
+		executeQueuedEvents(std::numeric_limits<u64>::max());
+		return;
 	}
+	
+	executeQueuedEvents(u64(std::max(config.misc.scriptEventBudget, 0)));
 }
 
 void ARX_SCRIPT_EventStackExecuteAll()
 {
-	STACK_FLOW = 9999999;
-	ARX_SCRIPT_EventStackExecute();
-	STACK_FLOW = 20;
+	// Also execute the events queued by the executed events.
+	for(size_t pass = 0; !eventQueue.empty(); pass++) {
+		if(pass == MAX_EVENT_QUEUE_PASSES) {
+			LogWarning << "Script events keep queueing new events, leaving " << eventQueue.size()
+			           << " queued";
+			break;
+		}
+		executeQueuedEvents(std::numeric_limits<u64>::max());
+	}
+}
+
+const ScriptEventQueueStats & ARX_SCRIPT_EventStackGetStats() {
+	return eventQueueStats;
 }
 
 void Stack_SendIOScriptEvent(Entity * io, ScriptMessage msg, const std::string& params, const std::string& eventname)
 {
-	for (long i = 0; i < MAX_EVENT_STACK; i++)
-	{
-		if (!eventstack[i].exist)
-		{
-			eventstack[i].sender = EVENT_SENDER;
-			eventstack[i].io = io;
-			eventstack[i].msg = msg;
-			eventstack[i].exist = 1;
-			eventstack[i].params = params;
-			eventstack[i].eventname = eventname;
-
-			return;
-		}
-	}
+	eventQueue.push_back(QueuedEvent());
+	
+	QueuedEvent & event = eventQueue.back();
+	event.sender = entities.getHandle(EVENT_SENDER);
+	event.io = entities.getHandle(io);
+	event.epoch = (event.io.index == size_t(-1)) ? 0 : getEventCancelEpoch(event.io.index);
+	event.msg = msg;
+	event.params = params;
+	event.eventname = eventname;
+	event.time = Time::getUs();
+	
+	eventQueueStats.depth = eventQueue.size();
+	eventQueueStats.peakDepth = std::max(eventQueueStats.peakDepth, eventQueueStats.depth);
 }
 
 ScriptResult SendIOScriptEventReverse(Entity * io, ScriptMessage msg, const std::string& params, const std::string& eventname)
@@ -1904,6 +1998,8 @@ long Manage_Specific_RAT_Timer(SCR_TIMER * st)
 
 void ARX_SCRIPT_Timer_Check() {
 	
+	ARX_PROFILE_FUNC();
+	
 	if(!ActiveTimers) {
 		return;
 	}
@@ -1961,6 +2057,11 @@ void ARX_SCRIPT_Init_Event_Stats() {
 	
 	ScriptEvent::totalCount = 0;
 	
+	eventQueueStats.peakDepth = eventQueueStats.depth;
+	eventQueueStats.maxLatency = 0;
+	eventQueueStats.totalLatency = 0;
+	eventQueueStats.executed = 0;
+	
 	for(size_t i = 0; i < entities.size(); i++) {
 		if(entities[i]) {
 			entities[i]->stat_count = 0;
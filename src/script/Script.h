@@ -54,6 +54,7 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 
 class PakFile;
 class Entity;
+namespace script { class ScriptCache; class VariableIndex; }
 
 const size_t MAX_SHORTCUT = 80;
 const size_t MAX_SCRIPTTIMERS = 5;
@@ -115,6 +116,7 @@ struct EERIE_SCRIPT {
 	long shortcut[MAX_SHORTCUT];
 	long nb_labels;
 	LABEL_INFO * labels;
+	script::ScriptCache * cache; //!< Decoded script, owned by the script.
 };
 
 struct SCR_TIMER {
@@ -422,9 +424,10 @@ long ARX_SCRIPT_Timer_GetFree();
  
 void ARX_SCRIPT_SetMainEvent(Entity * io, const std::string & newevent);
 void ARX_SCRIPT_EventStackExecute();
+//! Execute all queued events, including those queued by the executed events
 void ARX_SCRIPT_EventStackExecuteAll();
 void ARX_SCRIPT_EventStackInit();
-void ARX_SCRIPT_EventStackClear(bool check_exist = true);
+void ARX_SCRIPT_EventStackClear();
 void ARX_SCRIPT_ResetObject(Entity * io, long flags);
 void ARX_SCRIPT_Reset(Entity * io, long flags);
 long ARX_SCRIPT_GetSystemIOScript(Entity * io, const std::string & name);
@@ -434,6 +437,17 @@ long ARX_SCRIPT_CountTimers();
 void ARX_SCRIPT_Timer_ClearByNum(long num);
 void ARX_SCRIPT_ResetAll(long flags);
 void ARX_SCRIPT_EventStackClearForIo(Entity * io);
+
+struct ScriptEventQueueStats {
+	size_t depth; //!< Number of events currently queued
+	size_t peakDepth; //!< Maximum number of queued events since the last stats reset
+	u64 maxLatency; //!< Longest time an executed event spent in the queue, in microseconds
+	u64 totalLatency; //!< Combined queue time of all executed events, in microseconds
+	size_t executed; //!< Number of queued events executed since the last stats reset
+};
+
+//! Statistics for events sent with Stack_SendIOScriptEvent, reset by ARX_SCRIPT_Init_Event_Stats
+const ScriptEventQueueStats & ARX_SCRIPT_EventStackGetStats();
 Entity * ARX_SCRIPT_Get_IO_Max_Events();
 Entity * ARX_SCRIPT_Get_IO_Max_Events_Sent();
 
@@ -450,15 +464,29 @@ std::string GetVarValueInterpretedAsText(const std::string & temp1, const EERIE_
 //! Generates a random name for an unnamed timer
 std::string ARX_SCRIPT_Timer_GetDefaultName();
 
+//! @return the name index for the global variables in svar
+script::VariableIndex * globalVariableIndex();
+//! @return the name index for the local variables of a script, or NULL if it has none
+script::VariableIndex * localVariableIndex(const EERIE_SCRIPT * es);
+//! Must be called when es->lvar is replaced without using the SETVarValue* functions
+void invalidateLocalVariableIndex(EERIE_SCRIPT * es);
+
 // Use to set the value of a script variable
-SCRIPT_VAR * SETVarValueText(SCRIPT_VAR *& svf, long & nb, const std::string &  name, const std::string & val);
-SCRIPT_VAR * SETVarValueLong(SCRIPT_VAR *& svf, long & nb, const std::string & name, long val);
-SCRIPT_VAR * SETVarValueFloat(SCRIPT_VAR *& svf, long & nb, const std::string & name, float val);
+// index is the name index for the variable array, or NULL to search the array linearly
+SCRIPT_VAR * SETVarValueText(SCRIPT_VAR *& svf, long & nb, const std::string &  name, const std::string & val,
+                             script::VariableIndex * index);
+SCRIPT_VAR * SETVarValueLong(SCRIPT_VAR *& svf, long & nb, const std::string & name, long val,
+                             script::VariableIndex * index);
+SCRIPT_VAR * SETVarValueFloat(SCRIPT_VAR *& svf, long & nb, const std::string & name, float val,
+                              script::VariableIndex * index);
 
 // Use to get the value of a script variable
-long GETVarValueLong(SCRIPT_VAR svf[], size_t nb, const std::string & name);
-float GETVarValueFloat(SCRIPT_VAR svf[], size_t nb, const std::string & name);
-std::string GETVarValueText(SCRIPT_VAR svf[], size_t nb, const std::string & name);
+long GETVarValueLong(SCRIPT_VAR svf[], size_t nb, const std::string & name,
+                     script::VariableIndex * index);
+float GETVarValueFloat(SCRIPT_VAR svf[], size_t nb, const std::string & name,
+                       script::VariableIndex * index);
+std::string GETVarValueText(SCRIPT_VAR svf[], size_t nb, const std::string & name,
+                            script::VariableIndex * index);
 
 ValueType getSystemVar(const EERIE_SCRIPT * es, Entity * io, const std::string & name, std::string & txtcontent, float * fcontent, long * lcontent);
 void ARX_SCRIPT_Timer_Clear_All_Locals_For_IO(Entity * io);
@@ -478,6 +506,9 @@ void Stack_SendIOScriptEvent(Entity * io, ScriptMessage msg, const std::string &
  */
 long FindScriptPos(const EERIE_SCRIPT * es, const std::string & str);
 
+//! @return true if a line comment starts before pos on the same line
+bool isScriptPosCommentedOut(const EERIE_SCRIPT * es, size_t pos);
+
 void CloneLocalVars(Entity * ioo, Entity * io);
 void ARX_SCRIPT_Free_All_Global_Variables();
 void MakeLocalText(EERIE_SCRIPT * es, std::string & tx);
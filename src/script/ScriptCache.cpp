@@ -0,0 +1,85 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "script/ScriptCache.h"
+
+#include "platform/Platform.h"
+#include "script/Script.h"
+
+namespace script {
+
+ScriptCache::ScriptCache(const EERIE_SCRIPT * _script) : script(_script) {
+	
+	const char * data = script->data;
+	size_t size = script->size;
+	
+	// Collect the first valid definition of each label, using the same rules as FindScriptPos:
+	// the name is terminated by a separator that is still inside the script, and the label
+	// must not be commented out.
+	for(size_t pos = 0; pos + 1 < size; pos++) {
+		
+		if(data[pos] != '>' || data[pos + 1] != '>') {
+			continue;
+		}
+		
+		size_t end = pos + 2;
+		while(end < size && ((unsigned char)data[end]) > 32) {
+			end++;
+		}
+		if(end >= size) {
+			break;
+		}
+		
+		std::string name(data + pos + 2, data + end);
+		if(labels.find(name) != labels.end() || isScriptPosCommentedOut(script, pos)) {
+			continue;
+		}
+		
+		labels[name] = long(pos);
+	}
+	
+}
+
+long ScriptCache::findLabel(const std::string & name) const {
+	
+	for(std::string::const_iterator i = name.begin(); i != name.end(); ++i) {
+		if(((unsigned char)*i) <= 32) {
+			// Names containing separators can only be found by a full text search.
+			return FindScriptPos(script, ">>" + name);
+		}
+	}
+	
+	Positions::const_iterator it = labels.find(name);
+	return (it == labels.end()) ? -1 : it->second;
+}
+
+long ScriptCache::findEvent(const std::string & eventname) {
+	
+	Positions::const_iterator it = events.find(eventname);
+	if(it != events.end()) {
+		return it->second;
+	}
+	
+	long pos = FindScriptPos(script, eventname);
+	events[eventname] = pos;
+	
+	return pos;
+}
+
+} // namespace script
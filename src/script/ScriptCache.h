@@ -0,0 +1,126 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARX_SCRIPT_SCRIPTCACHE_H
+#define ARX_SCRIPT_SCRIPTCACHE_H
+
+#include <stddef.h>
+#include <string>
+
+#include <boost/unordered_map.hpp>
+
+#include "script/VariableIndex.h"
+
+struct EERIE_SCRIPT;
+
+namespace script {
+
+class Command;
+
+/*!
+ * Pre-decoded form of a loaded script.
+ *
+ * The script text is never modified after it has been loaded, so everything that is derived
+ * from it only needs to be computed once:
+ *  - label positions are collected in a single pass when the cache is built
+ *  - custom event entry points are looked up on first use and then remembered
+ *  - commands are tokenized and resolved the first time they are executed, later executions
+ *    only need a lookup by script position
+ *
+ * Positions and semantics are exactly those of the text-based parser, so timers, suppressions
+ * and saved script positions stay valid.
+ *
+ * The cache also holds the name index for the local variables of the script.
+ */
+class ScriptCache {
+	
+public:
+	
+	enum InstructionType {
+		EndOfScript, //!< No more commands in the script or on the line.
+		CommandCall, //!< A registered command, resolved to Instruction::command.
+		Label,       //!< A ">>label" definition.
+		Timer,       //!< A "timer..." command.
+		BlockStart,  //!< An opening bracket.
+		BlockEnd,    //!< A closing bracket.
+		Unknown      //!< Anything else.
+	};
+	
+	struct Instruction {
+		
+		InstructionType type;
+		
+		//! Script position directly after the command name.
+		size_t end;
+		
+		Command * command;
+		
+		//! Command name with underscores removed.
+		std::string word;
+		
+	};
+	
+	explicit ScriptCache(const EERIE_SCRIPT * script);
+	
+	/*!
+	 * Find a label definition.
+	 * Equivalent to FindScriptPos(script, ">>" + name).
+	 */
+	long findLabel(const std::string & name) const;
+	
+	/*!
+	 * Find a custom event handler.
+	 * Equivalent to FindScriptPos(script, eventname), but only searches the script once
+	 * for each event name.
+	 */
+	long findEvent(const std::string & eventname);
+	
+	/*!
+	 * Get the decoded command starting at (or after whitespace starting at) pos.
+	 * @return the cached instruction or NULL if the command has not been decoded yet.
+	 */
+	const Instruction * getInstruction(size_t pos) const {
+		Instructions::const_iterator it = instructions.find(pos);
+		return (it == instructions.end()) ? NULL : &it->second;
+	}
+	
+	//! Remember a decoded command. The returned reference stays valid until the cache is destroyed.
+	const Instruction & addInstruction(size_t pos, const Instruction & instruction) {
+		return instructions.insert(std::make_pair(pos, instruction)).first->second;
+	}
+	
+	VariableIndex & getLocalVariables() { return localVariables; }
+	
+private:
+	
+	typedef boost::unordered_map<std::string, long> Positions;
+	typedef boost::unordered_map<size_t, Instruction> Instructions;
+	
+	const EERIE_SCRIPT * script;
+	
+	Positions labels;
+	Positions events;
+	Instructions instructions;
+	VariableIndex localVariables;
+	
+};
+
+} // namespace script
+
+#endif // ARX_SCRIPT_SCRIPTCACHE_H
@@ -51,6 +51,7 @@ ZeniMax Media Inc., Suite 120, Rockville, Maryland 20850 USA.
 
 #include "io/log/Logger.h"
 
+#include "script/ScriptCache.h"
 #include "script/ScriptUtils.h"
 #include "script/ScriptedAnimation.h"
 #include "script/ScriptedCamera.h"
@@ -160,6 +161,10 @@ void ARX_SCRIPT_ComputeShortcuts(EERIE_SCRIPT& es)
 	for (long j = 1; j < nb; j++) {
 		es.shortcut[j] = FindScriptPos(&es, AS_EVENT[j].name);
 	}
+	
+	// The script text may have changed, drop everything that was decoded from it.
+	delete es.cache;
+	es.cache = new script::ScriptCache(&es);
 }
 
 ScriptEvent::ScriptEvent() {
@@ -282,7 +287,7 @@ ScriptResult ScriptEvent::send(EERIE_SCRIPT * es, ScriptMessage msg, const std::
 	// Finds script position to execute code...
 	if (!evname.empty()) {
 		eventname = "on " + evname;
-		pos = FindScriptPos(es, eventname);
+		pos = es->cache ? es->cache->findEvent(eventname) : FindScriptPos(es, eventname);
 	} else {
 		if (msg == SM_EXECUTELINE) {
 			pos = info;
@@ -385,10 +390,15 @@ ScriptResult ScriptEvent::send(EERIE_SCRIPT * es, ScriptMessage msg, const std::
 	
 	size_t brackets = 1;
 	
+	script::ScriptCache::Instruction decoded;
+	
 	for(;;) {
 		
-		string word = context.getCommand(msg != SM_EXECUTELINE);
-		if(word.empty()) {
+		const script::ScriptCache::Instruction & instruction
+			= fetchInstruction(context, msg != SM_EXECUTELINE, decoded);
+		const string & word = instruction.word;
+		
+		if(instruction.type == script::ScriptCache::EndOfScript) {
 			if(msg == SM_EXECUTELINE && context.pos != es->size) {
 				arx_assert(es->data[context.pos] == '\n');
 				LogDebug("--> line end");
@@ -398,14 +408,9 @@ ScriptResult ScriptEvent::send(EERIE_SCRIPT * es, ScriptMessage msg, const std::
 			return ACCEPT;
 		}
 		
-		// Remove all underscores from the command.
-		word.resize(std::remove(word.begin(), word.end(), '_') - word.begin());
-		
-		Commands::const_iterator it = commands.find(word);
-		
-		if(it != commands.end()) {
+		if(instruction.type == script::ScriptCache::CommandCall) {
 			
-			script::Command & command = *(it->second);
+			script::Command & command = *instruction.command;
 			
 			script::Command::Result res;
 			if(command.getEntityFlags()
@@ -416,7 +421,7 @@ ScriptResult ScriptEvent::send(EERIE_SCRIPT * es, ScriptMessage msg, const std::
 				context.skipCommand();
 				res = script::Command::Failed;
 			} else {
-				res = it->second->execute(context);
+				res = command.execute(context);
 			}
 			
 			if(res == script::Command::AbortAccept) {
@@ -435,15 +440,15 @@ ScriptResult ScriptEvent::send(EERIE_SCRIPT * es, ScriptMessage msg, const std::
 				brackets = (size_t)-1;
 			}
 			
-		} else if(!word.compare(0, 2, ">>", 2)) {
+		} else if(instruction.type == script::ScriptCache::Label) {
 			context.skipCommand(); // labels
-		} else if(!word.compare(0, 5, "timer", 5)) {
+		} else if(instruction.type == script::ScriptCache::Timer) {
 			script::timerCommand(word.substr(5), context);
-		} else if(word == "{") {
+		} else if(instruction.type == script::ScriptCache::BlockStart) {
 			if(brackets != (size_t)-1) {
 				brackets++;
 			}
-		} else if(word == "}") {
+		} else if(instruction.type == script::ScriptCache::BlockEnd) {
 			if(brackets != (size_t)-1) {
 				brackets--;
 				if(brackets == 0) {
@@ -487,6 +492,55 @@ ScriptResult ScriptEvent::send(EERIE_SCRIPT * es, ScriptMessage msg, const std::
 	return ret;
 }
 
+const script::ScriptCache::Instruction & ScriptEvent::fetchInstruction(script::Context & context,
+                                                                      bool skipNewlines,
+                                                                      script::ScriptCache::Instruction & buffer) {
+	
+	typedef script::ScriptCache::Instruction Instruction;
+	
+	// Single lines are executed from arbitrary positions, don't pollute the cache with them.
+	script::ScriptCache * cache = skipNewlines ? context.script->cache : NULL;
+	
+	size_t start = context.pos;
+	
+	if(cache) {
+		if(const Instruction * cached = cache->getInstruction(start)) {
+			context.pos = cached->end;
+			return *cached;
+		}
+	}
+	
+	string word = context.getCommand(skipNewlines);
+	
+	// Remove all underscores from the command.
+	word.resize(std::remove(word.begin(), word.end(), '_') - word.begin());
+	
+	buffer.end = context.pos;
+	buffer.command = NULL;
+	
+	Commands::const_iterator it;
+	if(word.empty()) {
+		buffer.type = script::ScriptCache::EndOfScript;
+	} else if((it = commands.find(word)) != commands.end()) {
+		buffer.type = script::ScriptCache::CommandCall;
+		buffer.command = it->second;
+	} else if(!word.compare(0, 2, ">>", 2)) {
+		buffer.type = script::ScriptCache::Label;
+	} else if(!word.compare(0, 5, "timer", 5)) {
+		buffer.type = script::ScriptCache::Timer;
+	} else if(word == "{") {
+		buffer.type = script::ScriptCache::BlockStart;
+	} else if(word == "}") {
+		buffer.type = script::ScriptCache::BlockEnd;
+	} else {
+		buffer.type = script::ScriptCache::Unknown;
+	}
+	
+	buffer.word = word;
+	
+	return cache ? cache->addInstruction(start, buffer) : buffer;
+}
+
 void ScriptEvent::registerCommand(script::Command * command) {
 	
 	typedef std::pair<Commands::iterator, bool> Res;
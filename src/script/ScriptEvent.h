@@ -23,6 +23,7 @@
 #include <map>
 
 #include "script/Script.h"
+#include "script/ScriptCache.h"
 
 struct SCRIPT_EVENT {
 	explicit SCRIPT_EVENT(const std::string & str): name(str) {}
@@ -35,6 +36,7 @@ namespace script {
 std::string loadUnlocalized(const std::string & str);
 
 class Command;
+class Context;
 
 } // namespace script
 
@@ -58,6 +60,15 @@ private:
 	typedef std::map<std::string, script::Command *> Commands;
 	static Commands commands;
 	
+	/*!
+	 * Read and resolve the next command.
+	 * Commands are only decoded once per script position, later calls return the cached result.
+	 * @param buffer storage for the result if it cannot be cached
+	 */
+	static const script::ScriptCache::Instruction & fetchInstruction(script::Context & context,
+	                                                                  bool skipNewlines,
+	                                                                  script::ScriptCache::Instruction & buffer);
+	
 };
 
 #endif // ARX_SCRIPT_SCRIPTEVENT_H
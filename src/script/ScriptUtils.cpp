@@ -23,6 +23,7 @@
 
 #include "game/Entity.h"
 #include "graphics/data/Mesh.h"
+#include "script/ScriptCache.h"
 
 using std::string;
 
@@ -260,7 +261,8 @@ bool Context::jumpToLabel(const string & target, bool substack) {
 		stack.push_back(pos);
 	}
 	
-	long targetpos = FindScriptPos(script, ">>" + target);
+	long targetpos = script->cache ? script->cache->findLabel(target)
+	                               : FindScriptPos(script, ">>" + target);
 	if(targetpos == -1) {
 		return false;
 	}
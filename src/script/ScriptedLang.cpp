@@ -484,32 +484,32 @@ class IfCommand : public Command {
 			}
 			
 			case '#': {
-				f = GETVarValueLong(svar, NB_GLOBALS, var);
+				f = GETVarValueLong(svar, NB_GLOBALS, var, globalVariableIndex());
 				return TYPE_FLOAT;
 			}
 			
 			case '\xA7': {
-				f = GETVarValueLong(es->lvar, es->nblvar, var);
+				f = GETVarValueLong(es->lvar, es->nblvar, var, localVariableIndex(es));
 				return TYPE_FLOAT;
 			}
 			
 			case '&': {
-				f = GETVarValueFloat(svar, NB_GLOBALS, var);
+				f = GETVarValueFloat(svar, NB_GLOBALS, var, globalVariableIndex());
 				return TYPE_FLOAT;
 			}
 			
 			case '@': {
-				f = GETVarValueFloat(es->lvar, es->nblvar, var);
+				f = GETVarValueFloat(es->lvar, es->nblvar, var, localVariableIndex(es));
 				return TYPE_FLOAT;
 			}
 			
 			case '$': {
-				s = GETVarValueText(svar, NB_GLOBALS, var);
+				s = GETVarValueText(svar, NB_GLOBALS, var, globalVariableIndex());
 				return TYPE_TEXT;
 			}
 			
 			case '\xA3': {
-				s = GETVarValueText(es->lvar, es->nblvar, var);
+				s = GETVarValueText(es->lvar, es->nblvar, var, localVariableIndex(es));
 				return TYPE_TEXT;
 			}
 			
@@ -87,7 +87,7 @@ public:
 			
 			case '$': { // global text
 				string v = context.getStringVar(val);
-				SCRIPT_VAR * sv = SETVarValueText(svar, NB_GLOBALS, var, v);
+				SCRIPT_VAR * sv = SETVarValueText(svar, NB_GLOBALS, var, v, globalVariableIndex());
 				if(!sv) {
 					ScriptWarning << "unable to set var " << var << " to \"" << v << '"';
 					return Failed;
@@ -98,7 +98,8 @@ public:
 			
 			case '\xA3': { // local text
 				string v = context.getStringVar(val);
-				SCRIPT_VAR * sv = SETVarValueText(es.lvar, es.nblvar, var, v);
+				SCRIPT_VAR * sv = SETVarValueText(es.lvar, es.nblvar, var, v,
+				                                  localVariableIndex(&es));
 				if(!sv) {
 					ScriptWarning << "unable to set var " << var << " to \"" << v << '"';
 					return Failed;
@@ -109,7 +110,7 @@ public:
 			
 			case '#': { // global long
 				long v = (long)context.getFloatVar(val);
-				SCRIPT_VAR * sv = SETVarValueLong(svar, NB_GLOBALS, var, v);
+				SCRIPT_VAR * sv = SETVarValueLong(svar, NB_GLOBALS, var, v, globalVariableIndex());
 				if(!sv) {
 					ScriptWarning << "unable to set var " << var << " to " << v;
 					return Failed;
@@ -120,7 +121,8 @@ public:
 			
 			case '\xA7': { // local long
 				long v = (long)context.getFloatVar(val);
-				SCRIPT_VAR * sv = SETVarValueLong(es.lvar, es.nblvar, var, v);
+				SCRIPT_VAR * sv = SETVarValueLong(es.lvar, es.nblvar, var, v,
+				                                  localVariableIndex(&es));
 				if(!sv) {
 					ScriptWarning << "unable to set var " << var << " to " << v;
 					return Failed;
@@ -131,7 +133,7 @@ public:
 			
 			case '&': { // global float
 				float v = context.getFloatVar(val);
-				SCRIPT_VAR * sv = SETVarValueFloat(svar, NB_GLOBALS, var, v);
+				SCRIPT_VAR * sv = SETVarValueFloat(svar, NB_GLOBALS, var, v, globalVariableIndex());
 				if(!sv) {
 					ScriptWarning << "unable to set var " << var << " to " << v;
 					return Failed;
@@ -142,7 +144,8 @@ public:
 			
 			case '@': { // local float
 				float v = context.getFloatVar(val);
-				SCRIPT_VAR * sv = SETVarValueFloat(es.lvar, es.nblvar, var, v);
+				SCRIPT_VAR * sv = SETVarValueFloat(es.lvar, es.nblvar, var, v,
+				                                   localVariableIndex(&es));
 				if(!sv) {
 					ScriptWarning << "unable to set var " << var << " to " << v;
 					return Failed;
@@ -216,8 +219,9 @@ public:
 			}
 			
 			case '#':  {// global long
-				float old = (float)GETVarValueLong(svar, NB_GLOBALS, var);
-				SCRIPT_VAR * sv = SETVarValueLong(svar, NB_GLOBALS, var, (long)calculate(old, val));
+				float old = (float)GETVarValueLong(svar, NB_GLOBALS, var, globalVariableIndex());
+				SCRIPT_VAR * sv = SETVarValueLong(svar, NB_GLOBALS, var, (long)calculate(old, val),
+				                                  globalVariableIndex());
 				if(!sv) {
 					ScriptWarning << "unable to set var " << var;
 					return Failed;
@@ -227,8 +231,10 @@ public:
 			}
 			
 			case '\xA7': { // local long
-				float old = (float)GETVarValueLong(es->lvar, es->nblvar, var);
-				SCRIPT_VAR * sv = SETVarValueLong(es->lvar, es->nblvar, var, (long)calculate(old, val));
+				float old = (float)GETVarValueLong(es->lvar, es->nblvar, var,
+				                                   localVariableIndex(es));
+				SCRIPT_VAR * sv = SETVarValueLong(es->lvar, es->nblvar, var, (long)calculate(old, val),
+				                                  localVariableIndex(es));
 				if(!sv) {
 					ScriptWarning << "unable to set var " << var;
 					return Failed;
@@ -238,8 +244,9 @@ public:
 			}
 			
 			case '&': { // global float
-				float old = GETVarValueFloat(svar, NB_GLOBALS, var);
-				SCRIPT_VAR * sv = SETVarValueFloat(svar, NB_GLOBALS, var, calculate(old, val));
+				float old = GETVarValueFloat(svar, NB_GLOBALS, var, globalVariableIndex());
+				SCRIPT_VAR * sv = SETVarValueFloat(svar, NB_GLOBALS, var, calculate(old, val),
+				                                   globalVariableIndex());
 				if(!sv) {
 					ScriptWarning << "unable to set var " << var;
 					return Failed;
@@ -249,8 +256,9 @@ public:
 			}
 			
 			case '@': { // local float
-				float old = GETVarValueFloat(es->lvar, es->nblvar, var);
-				SCRIPT_VAR * sv = SETVarValueFloat(es->lvar, es->nblvar, var, calculate(old, val));
+				float old = GETVarValueFloat(es->lvar, es->nblvar, var, localVariableIndex(es));
+				SCRIPT_VAR * sv = SETVarValueFloat(es->lvar, es->nblvar, var, calculate(old, val),
+				                                   localVariableIndex(es));
 				if(!sv) {
 					ScriptWarning << "unable to set var " << var;
 					return Failed;
@@ -361,26 +369,27 @@ public:
 		switch(var[0]) {
 			
 			case '#': {
-				long ival = GETVarValueLong(svar, NB_GLOBALS, var);
-				SETVarValueLong(svar, NB_GLOBALS, var, ival + (long)diff);
+				long ival = GETVarValueLong(svar, NB_GLOBALS, var, globalVariableIndex());
+				SETVarValueLong(svar, NB_GLOBALS, var, ival + (long)diff, globalVariableIndex());
 				break;
 			}
 			
 			case '\xA3': {
-				long ival = GETVarValueLong(es.lvar, es.nblvar, var);
-				SETVarValueLong(es.lvar, es.nblvar, var, ival + (long)diff);
+				long ival = GETVarValueLong(es.lvar, es.nblvar, var, localVariableIndex(&es));
+				SETVarValueLong(es.lvar, es.nblvar, var, ival + (long)diff,
+				                localVariableIndex(&es));
 				break;
 			}
 			
 			case '&': {
-				float fval = GETVarValueFloat(svar, NB_GLOBALS, var);
-				SETVarValueFloat(svar, NB_GLOBALS, var, fval + diff);
+				float fval = GETVarValueFloat(svar, NB_GLOBALS, var, globalVariableIndex());
+				SETVarValueFloat(svar, NB_GLOBALS, var, fval + diff, globalVariableIndex());
 				break;
 			}
 			
 			case '@': {
-				float fval = GETVarValueFloat(es.lvar, es.nblvar, var);
-				SETVarValueFloat(es.lvar, es.nblvar, var, fval + diff);
+				float fval = GETVarValueFloat(es.lvar, es.nblvar, var, localVariableIndex(&es));
+				SETVarValueFloat(es.lvar, es.nblvar, var, fval + diff, localVariableIndex(&es));
 				break;
 			}
 			
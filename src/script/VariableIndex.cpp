@@ -0,0 +1,88 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "script/VariableIndex.h"
+
+#include "platform/Platform.h"
+#include "script/Script.h"
+
+namespace script {
+
+SCRIPT_VAR * VariableIndex::find(SCRIPT_VAR * _vars, size_t _count, const std::string & name) {
+	
+	if(_vars != vars || _count != count) {
+		rebuild(_vars, _count);
+	}
+	
+	Slots::const_iterator it = slots.find(name);
+	if(it == slots.end()) {
+		return NULL;
+	}
+	
+	size_t i = it->second;
+	if(name != _vars[i].name) {
+		// The array was modified in place, start over.
+		rebuild(_vars, _count);
+		it = slots.find(name);
+		if(it == slots.end()) {
+			return NULL;
+		}
+		i = it->second;
+	}
+	
+	// Skip slots that have been added but not typed yet, like the linear search does.
+	for(; i < _count; i++) {
+		if(_vars[i].type != TYPE_UNKNOWN && name == _vars[i].name) {
+			return &_vars[i];
+		}
+	}
+	
+	return NULL;
+}
+
+void VariableIndex::add(SCRIPT_VAR * _vars, size_t _count) {
+	
+	arx_assert(_count > 0);
+	
+	if(count + 1 != _count) {
+		rebuild(_vars, _count);
+		return;
+	}
+	
+	vars = _vars, count = _count;
+	slots.insert(std::make_pair(std::string(_vars[_count - 1].name), _count - 1));
+}
+
+void VariableIndex::clear() {
+	slots.clear();
+	vars = NULL, count = 0;
+}
+
+void VariableIndex::rebuild(SCRIPT_VAR * _vars, size_t _count) {
+	
+	slots.clear();
+	vars = _vars, count = _count;
+	
+	// Keep the first slot if there are duplicates, typed or not.
+	for(size_t i = 0; i < _count; i++) {
+		slots.insert(std::make_pair(std::string(_vars[i].name), i));
+	}
+}
+
+} // namespace script
@@ -0,0 +1,71 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARX_SCRIPT_VARIABLEINDEX_H
+#define ARX_SCRIPT_VARIABLEINDEX_H
+
+#include <stddef.h>
+#include <string>
+
+#include <boost/unordered_map.hpp>
+
+struct SCRIPT_VAR;
+
+namespace script {
+
+/*!
+ * Name lookup table for a SCRIPT_VAR array.
+ *
+ * The array itself stays the canonical storage so that saving and loading is unaffected.
+ * The table is rebuilt automatically if the array is reallocated or resized without going
+ * through add(), code that replaces the contents in place must call clear().
+ */
+class VariableIndex {
+	
+public:
+	
+	VariableIndex() : vars(NULL), count(0) { }
+	
+	/*!
+	 * Find a variable with the given name.
+	 * Equivalent to a linear search for the first variable of known type with that name.
+	 * Variables that have been added but do not have a type yet are skipped.
+	 */
+	SCRIPT_VAR * find(SCRIPT_VAR * vars, size_t count, const std::string & name);
+	
+	//! Register the variable that was just appended at the end of the array.
+	void add(SCRIPT_VAR * vars, size_t count);
+	
+	void clear();
+	
+private:
+	
+	typedef boost::unordered_map<std::string, size_t> Slots;
+	
+	void rebuild(SCRIPT_VAR * vars, size_t count);
+	
+	Slots slots;
+	const SCRIPT_VAR * vars;
+	size_t count;
+	
+};
+
+} // namespace script
+
+#endif // ARX_SCRIPT_VARIABLEINDEX_H
@@ -0,0 +1,127 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "window/HeadlessWindow.h"
+
+#include <algorithm>
+
+#include "graphics/null/NullRenderer.h"
+#include "io/log/Logger.h"
+#include "math/Rectangle.h"
+
+HeadlessWindow::HeadlessWindow() { }
+
+HeadlessWindow::~HeadlessWindow() {
+	
+	if(renderer) {
+		onRendererShutdown();
+		delete renderer, renderer = NULL;
+	}
+	
+}
+
+bool HeadlessWindow::initializeFramework() {
+	
+	arx_assert(displayModes.empty());
+	
+	displayModes.push_back(DisplayMode(Vec2i(640, 480), 32));
+	displayModes.push_back(DisplayMode(Vec2i(800, 600), 32));
+	displayModes.push_back(DisplayMode(Vec2i(1024, 768), 32));
+	displayModes.push_back(DisplayMode(Vec2i(1280, 720), 32));
+	displayModes.push_back(DisplayMode(Vec2i(1920, 1080), 32));
+	
+	std::sort(displayModes.begin(), displayModes.end());
+	
+	return true;
+}
+
+bool HeadlessWindow::initialize(const std::string & title, Vec2i size, bool fullscreen,
+                                unsigned depth) {
+	
+	arx_assert(!displayModes.empty());
+	
+	if(size == Vec2i_ZERO) {
+		size = displayModes.back().resolution;
+	}
+	
+	title_ = title;
+	isFullscreen_ = fullscreen;
+	size_ = Vec2i_ZERO;
+	depth_ = (depth == 0) ? 32 : depth;
+	
+	onCreate();
+	
+	LogInfo << "Using null renderer, nothing will be drawn";
+	
+	renderer = new NullRenderer;
+	renderer->Initialize();
+	
+	renderer->SetViewport(Rect(size.x, size.y));
+	onResize(size.x, size.y);
+	
+	onShow(true);
+	onFocus(true);
+	
+	onRendererInit();
+	
+	return true;
+}
+
+void HeadlessWindow::setFullscreenMode(Vec2i resolution, unsigned _depth) {
+	
+	if(resolution == Vec2i_ZERO) {
+		resolution = displayModes.back().resolution;
+	}
+	
+	if(_depth) {
+		depth_ = _depth;
+	}
+	
+	if(size_ != resolution) {
+		renderer->SetViewport(Rect(resolution.x, resolution.y));
+		onResize(resolution.x, resolution.y);
+	}
+	
+	if(!isFullscreen_) {
+		isFullscreen_ = true;
+		onToggleFullscreen();
+	}
+}
+
+void HeadlessWindow::setWindowSize(Vec2i size) {
+	
+	if(size_ != size) {
+		renderer->SetViewport(Rect(size.x, size.y));
+		onResize(size.x, size.y);
+	}
+	
+	if(isFullscreen_) {
+		isFullscreen_ = false;
+		onToggleFullscreen();
+	}
+}
+
+Vec2i HeadlessWindow::getCursorPosition() const {
+	return size_ / 2;
+}
+
+void HeadlessWindow::showFrame() {
+	// The renderer is always created by initialize()
+	static_cast<NullRenderer *>(renderer)->endFrame();
+}
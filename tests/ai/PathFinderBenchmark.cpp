@@ -0,0 +1,372 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Benchmark for PathFinder::move().
+ *
+ * Builds a synthetic level of square rooms connected by doors, then runs the same random
+ * searches with the old A* implementation (linear scans of the open and closed lists) and
+ * with PathFinder, checks that both find the same paths and reports the time per search.
+ *
+ * The searches are then repeated using a PathHierarchy with one cluster per room. Those
+ * paths may be longer than the optimal ones, so only their total length is compared.
+ *
+ * Usage: pathfinderbench [reference|pathfinder|hierarchy]
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "ai/PathFinder.h"
+#include "ai/PathHierarchy.h"
+#include "bench/Benchmark.h"
+#include "graphics/Math.h"
+#include "physics/Anchors.h"
+#include "platform/Platform.h"
+
+namespace {
+
+const int RoomsX = 12;
+const int RoomsZ = 12;
+const int RoomSize = 8; //!< Anchors per room side
+const float AnchorSpacing = 60.f;
+const size_t SearchCount = 300;
+
+const int AnchorsX = RoomsX * RoomSize;
+const int AnchorsZ = RoomsZ * RoomSize;
+
+std::vector<ANCHOR_DATA> anchors;
+std::vector<std::vector<long> > links;
+std::vector<long> rooms; //!< Room index for each anchor
+
+void link(long a, long b) {
+	links[a].push_back(b);
+	links[b].push_back(a);
+}
+
+//! Rooms with a few blocked anchors, connected to their neighbors by a single door each.
+void buildLevel() {
+	
+	std::srand(42);
+	anchors.resize(AnchorsX * AnchorsZ);
+	links.resize(anchors.size());
+	rooms.resize(anchors.size());
+	
+	for(int z = 0; z < AnchorsZ; z++) {
+		for(int x = 0; x < AnchorsX; x++) {
+			
+			long i = x + z * AnchorsX;
+			ANCHOR_DATA & anchor = anchors[i];
+			anchor.pos = Vec3f(x * AnchorSpacing, float(std::rand() % 40), z * AnchorSpacing);
+			anchor.flags = (std::rand() % 20) ? AnchorFlags() : AnchorFlags(ANCHOR_FLAG_BLOCKED);
+			anchor.radius = 40.f;
+			anchor.height = -160.f;
+			rooms[i] = x / RoomSize + (z / RoomSize) * RoomsX;
+			
+			if((x + 1) % RoomSize != 0) {
+				link(i, i + 1);
+			}
+			if((z + 1) % RoomSize != 0) {
+				link(i, i + AnchorsX);
+			}
+		}
+	}
+	
+	for(int rz = 0; rz < RoomsZ; rz++) {
+		for(int rx = 0; rx < RoomsX; rx++) {
+			long corner = rx * RoomSize + rz * RoomSize * AnchorsX;
+			if(rx + 1 < RoomsX) {
+				long door = corner + (std::rand() % RoomSize) * AnchorsX + RoomSize - 1;
+				anchors[door].flags = anchors[door + 1].flags = AnchorFlags();
+				link(door, door + 1);
+			}
+			if(rz + 1 < RoomsZ) {
+				long door = corner + (RoomSize - 1) * AnchorsX + std::rand() % RoomSize;
+				anchors[door].flags = anchors[door + AnchorsX].flags = AnchorFlags();
+				link(door, door + AnchorsX);
+			}
+		}
+	}
+	
+	for(size_t i = 0; i < anchors.size(); i++) {
+		anchors[i].nblinked = short(links[i].size());
+		anchors[i].linked = links[i].empty() ? NULL : &links[i][0];
+	}
+}
+
+/*!
+ * Reference implementation, copied from the old PathFinder::move() with the linear
+ * open and closed lists.
+ */
+class ReferencePathFinder {
+	
+	struct Node {
+		
+		long id;
+		const Node * parent;
+		float cost;
+		float distance;
+		
+		Node(long _id, const Node * _parent, float _distance, float _remaining)
+			: id(_id), parent(_parent), cost(_distance + _remaining), distance(_distance) { }
+		
+	};
+	
+	float heuristic;
+	
+public:
+	
+	explicit ReferencePathFinder(float _heuristic) : heuristic(_heuristic) { }
+	
+	bool move(long from, long to, PathFinder::Result & rlist) const;
+	
+};
+
+bool ReferencePathFinder::move(long from, long to, PathFinder::Result & rlist) const {
+	
+	if(from == to) {
+		rlist.push_back(to);
+		return true;
+	}
+	
+	std::vector<Node *> open, closed;
+	Node * node = new Node(from, NULL, 0.f, 0.f);
+	bool found = false;
+	
+	do {
+		
+		closed.push_back(node);
+		
+		long nid = node->id;
+		if(nid == to) {
+			size_t s = rlist.size();
+			for(const Node * n = node; n; n = n->parent) {
+				rlist.push_back(n->id);
+			}
+			std::reverse(rlist.begin() + s, rlist.end());
+			found = true;
+			break;
+		}
+		
+		for(short i = 0; i < anchors[nid].nblinked; i++) {
+			
+			long cid = anchors[nid].linked[i];
+			if(anchors[cid].flags & ANCHOR_FLAG_BLOCKED) {
+				continue;
+			}
+			
+			bool isClosed = false;
+			for(size_t j = 0; j < closed.size() && !isClosed; j++) {
+				isClosed = (closed[j]->id == cid);
+			}
+			if(isClosed) {
+				continue;
+			}
+			
+			float distance = fdist(anchors[cid].pos, anchors[nid].pos) * heuristic
+			                 + node->distance;
+			float remaining = (1.0f - heuristic) * fdist(anchors[cid].pos, anchors[to].pos);
+			
+			bool isOpen = false;
+			for(size_t j = 0; j < open.size() && !isOpen; j++) {
+				Node * other = open[j];
+				if(other->id == cid) {
+					if(other->distance > distance) {
+						other->parent = node;
+						other->cost = other->cost - other->distance + distance;
+						other->distance = distance;
+					}
+					isOpen = true;
+				}
+			}
+			if(!isOpen) {
+				open.push_back(new Node(cid, node, distance, remaining));
+			}
+		}
+		
+		node = NULL;
+		if(!open.empty()) {
+			size_t best = 0;
+			for(size_t j = 1; j < open.size(); j++) {
+				if(open[j]->cost < open[best]->cost) {
+					best = j;
+				}
+			}
+			node = open[best];
+			open.erase(open.begin() + best);
+		}
+		
+	} while(node);
+	
+	for(size_t j = 0; j < open.size(); j++) {
+		delete open[j];
+	}
+	for(size_t j = 0; j < closed.size(); j++) {
+		delete closed[j];
+	}
+	
+	return found;
+}
+
+struct Search {
+	
+	long from;
+	long to;
+	float heuristic;
+	
+};
+
+std::vector<Search> searches;
+
+void buildSearches() {
+	
+	searches.resize(SearchCount);
+	for(size_t i = 0; i < SearchCount; i++) {
+		
+		Search & search = searches[i];
+		do {
+			search.from = std::rand() % long(anchors.size());
+			search.to = std::rand() % long(anchors.size());
+		} while((anchors[search.from].flags | anchors[search.to].flags) & ANCHOR_FLAG_BLOCKED);
+		
+		// Same as EERIE_PATHFINDER_Get_Heuristic()
+		float distance = fdist(anchors[search.from].pos, anchors[search.to].pos);
+		search.heuristic = 0.2f + 0.3f * std::min(distance / 5000.f, 1.f);
+	}
+}
+
+struct Results {
+	
+	std::vector<PathFinder::Result> paths;
+	
+	u64 time; //!< Microseconds for all searches
+	
+	size_t found() const {
+		size_t count = 0;
+		for(size_t i = 0; i < paths.size(); i++) {
+			count += paths[i].empty() ? 0 : 1;
+		}
+		return count;
+	}
+	
+	float length() const {
+		float total = 0.f;
+		for(size_t i = 0; i < paths.size(); i++) {
+			for(size_t j = 1; j < paths[i].size(); j++) {
+				total += fdist(anchors[paths[i][j - 1]].pos, anchors[paths[i][j]].pos);
+			}
+		}
+		return total;
+	}
+	
+};
+
+void runReference(Results & r) {
+	r.paths.assign(SearchCount, PathFinder::Result());
+	bench::Timer timer;
+	for(size_t i = 0; i < SearchCount; i++) {
+		ReferencePathFinder pathfinder(searches[i].heuristic);
+		pathfinder.move(searches[i].from, searches[i].to, r.paths[i]);
+	}
+	r.time = timer.elapsed();
+}
+
+void runPathFinder(Results & r, const PathHierarchy * hierarchy) {
+	r.paths.assign(SearchCount, PathFinder::Result());
+	PathFinder pathfinder(anchors.size(), &anchors[0], 0, NULL);
+	pathfinder.setHierarchy(hierarchy);
+	bench::Timer timer;
+	for(size_t i = 0; i < SearchCount; i++) {
+		pathfinder.setHeuristic(searches[i].heuristic);
+		pathfinder.move(searches[i].from, searches[i].to, r.paths[i]);
+	}
+	r.time = timer.elapsed();
+}
+
+void print(const char * name, const Results & r) {
+	bench::printTime(name, r.time, SearchCount, "search");
+	std::printf("%-16s %10lu paths found\n", "", (unsigned long)r.found());
+}
+
+} // anonymous namespace
+
+int main(int argc, char ** argv) {
+	
+	bench::init();
+	
+	const char * variants[] = { "reference", "pathfinder", "hierarchy" };
+	bool enabled[ARRAY_SIZE(variants)];
+	if(!bench::selectVariants(argc, argv, "pathfinderbench [reference|pathfinder|hierarchy]",
+	                          variants, enabled, ARRAY_SIZE(variants))) {
+		return 1;
+	}
+	bool reference = enabled[0], pathfinder = enabled[1], hierarchical = enabled[2];
+	
+	buildLevel();
+	buildSearches();
+	
+	std::printf("%lu anchors in %d rooms, %lu searches\n", (unsigned long)anchors.size(),
+	            RoomsX * RoomsZ, (unsigned long)SearchCount);
+	
+	Results referenceResults, pathfinderResults, hierarchyResults;
+	
+	if(reference) {
+		runReference(referenceResults);
+		print("reference", referenceResults);
+	}
+	
+	if(pathfinder) {
+		runPathFinder(pathfinderResults, NULL);
+		print("PathFinder", pathfinderResults);
+	}
+	
+	if(hierarchical) {
+		PathHierarchy hierarchy;
+		bench::Timer timer;
+		hierarchy.build(anchors.size(), &anchors[0], rooms);
+		u64 buildTime = timer.elapsed();
+		std::printf("%lu clusters built in %lu us\n", (unsigned long)hierarchy.getClusterCount(),
+		            (unsigned long)buildTime);
+		runPathFinder(hierarchyResults, &hierarchy);
+		print("hierarchy", hierarchyResults);
+	}
+	
+	size_t mismatches = 0;
+	
+	if(reference && pathfinder) {
+		for(size_t i = 0; i < SearchCount; i++) {
+			if(referenceResults.paths[i] != pathfinderResults.paths[i]) {
+				mismatches++;
+			}
+		}
+		bench::printMismatches(mismatches);
+	}
+	
+	if(pathfinder && hierarchical) {
+		if(hierarchyResults.found() != pathfinderResults.found()) {
+			mismatches++;
+		}
+		std::printf("hierarchy paths are %.1f%% longer\n",
+		            (hierarchyResults.length() / pathfinderResults.length() - 1.f) * 100.f);
+	}
+	
+	return mismatches ? 1 : 0;
+}
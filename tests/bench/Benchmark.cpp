@@ -0,0 +1,87 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bench/Benchmark.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "io/log/Logger.h"
+#include "platform/Time.h"
+
+namespace bench {
+
+void init() {
+	Logger::initialize();
+	Time::init();
+}
+
+bool selectVariants(int argc, char ** argv, const char * usage,
+                    const char * const * names, bool * enabled, size_t count) {
+	
+	bool found = false;
+	for(size_t i = 0; i < count; i++) {
+		enabled[i] = (argc < 2 || !std::strcmp(argv[1], names[i]));
+		found = found || enabled[i];
+	}
+	
+	if(!found) {
+		std::printf("usage: %s\n", usage);
+	}
+	
+	return found;
+}
+
+float randomFloat(float min, float max) {
+	return min + (max - min) * (float(std::rand()) / float(RAND_MAX));
+}
+
+Timer::Timer() : m_start(Time::getUs()) { }
+
+u64 Timer::elapsed() const {
+	return Time::getElapsedUs(m_start);
+}
+
+void printTime(const char * name, u64 time, size_t count, const char * item) {
+	std::printf("%-16s %10.1f us/%s\n", name, double(time) / double(std::max(count, size_t(1))),
+	            item);
+}
+
+void printTimeNs(const char * name, u64 time, size_t count, const char * item) {
+	std::printf("%-16s %10.1f ns/%s\n", name,
+	            double(time) * 1000.0 / double(std::max(count, size_t(1))), item);
+}
+
+void printRate(const char * name, u64 time, size_t count, const char * item) {
+	std::printf("%-16s %10.0f %s/s\n", name,
+	            double(count) * 1000000.0 / double(std::max(time, u64(1))), item);
+}
+
+void printThroughput(const char * name, u64 time, u64 bytes) {
+	std::printf("%-16s %10.1f MB/s\n", name, double(bytes) / double(std::max(time, u64(1))));
+}
+
+int printMismatches(size_t mismatches) {
+	std::printf("%lu mismatches\n", (unsigned long)mismatches);
+	return mismatches ? 1 : 0;
+}
+
+} // namespace bench
@@ -0,0 +1,86 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARX_TESTS_BENCH_BENCHMARK_H
+#define ARX_TESTS_BENCH_BENCHMARK_H
+
+#include <stddef.h>
+
+#include "platform/Platform.h"
+
+/*!
+ * Helpers shared by the benchmark programs.
+ *
+ * Each benchmark runs the same workload with an old reference implementation and with the
+ * code that replaced it, compares the results and prints the time taken by each variant.
+ */
+namespace bench {
+
+//! Initialize logging and the timer, call this first in main().
+void init();
+
+/*!
+ * Select the variants to run from the first command-line argument.
+ *
+ * Without an argument all variants are enabled, otherwise only the named one.
+ * With an unknown argument, the usage is printed and false is returned.
+ *
+ * \param names   names of the variants
+ * \param enabled receives which variants should be run
+ */
+bool selectVariants(int argc, char ** argv, const char * usage,
+                    const char * const * names, bool * enabled, size_t count);
+
+//! Uniformly distributed random number between min and max, using std::rand().
+float randomFloat(float min, float max);
+
+//! Measures the wall clock time of a benchmark run.
+class Timer {
+
+public:
+	
+	Timer();
+	
+	//! Microseconds since the timer was created.
+	u64 elapsed() const;
+
+private:
+	
+	u64 m_start;
+	
+};
+
+//! Print the average time per item in microseconds, for example "12.3 us/search".
+void printTime(const char * name, u64 time, size_t count, const char * item);
+
+//! Print the average time per item in nanoseconds, for example "45.6 ns/query".
+void printTimeNs(const char * name, u64 time, size_t count, const char * item);
+
+//! Print the number of items per second, for example "123456 rays/s".
+void printRate(const char * name, u64 time, size_t count, const char * item);
+
+//! Print the throughput in MB/s.
+void printThroughput(const char * name, u64 time, u64 bytes);
+
+//! Print the number of mismatches and return the exit code for main().
+int printMismatches(size_t mismatches);
+
+} // namespace bench
+
+#endif // ARX_TESTS_BENCH_BENCHMARK_H
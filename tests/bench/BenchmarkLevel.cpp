@@ -0,0 +1,269 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bench/BenchmarkLevel.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include <boost/scoped_array.hpp>
+
+#include "bench/Benchmark.h"
+#include "graphics/Math.h"
+#include "graphics/data/FastSceneFormat.h"
+#include "graphics/data/Mesh.h"
+#include "io/fs/FilePath.h"
+#include "io/fs/Filesystem.h"
+#include "io/log/Logger.h"
+#include "io/resource/PakReader.h"
+#include "io/resource/ResourcePath.h"
+
+namespace bench {
+
+size_t Level::polyCount() const {
+	size_t count = 0;
+	for(size_t i = 0; i < tiles.size(); i++) {
+		count += tiles[i].polydata.size();
+	}
+	return count;
+}
+
+size_t Level::polyinCount() const {
+	size_t count = 0;
+	for(size_t i = 0; i < tiles.size(); i++) {
+		count += tiles[i].polyin.size();
+	}
+	return count;
+}
+
+EERIE_BACKGROUND * Level::createBackground() {
+	
+	EERIE_BACKGROUND * bkg = new EERIE_BACKGROUND;
+	bkg->Xsize = short(sizeX), bkg->Zsize = short(sizeZ);
+	bkg->Xdiv = short(tileSize), bkg->Zdiv = short(tileSize);
+	bkg->Xmul = bkg->Zmul = 1.f / tileSize;
+	
+	bkg->Backg = new EERIE_BKG_INFO[tiles.size()];
+	std::memset(bkg->Backg, 0, sizeof(EERIE_BKG_INFO) * tiles.size());
+	for(size_t i = 0; i < tiles.size(); i++) {
+		LevelTile & tile = tiles[i];
+		EERIE_BKG_INFO & info = bkg->Backg[i];
+		info.nbpoly = short(tile.polydata.size());
+		info.polydata = tile.polydata.empty() ? NULL : &tile.polydata[0];
+		info.nbpolyin = short(tile.polyin.size());
+		info.polyin = tile.polyin.empty() ? NULL : &tile.polyin[0];
+		info.nothing = tile.polyin.empty() ? 1 : 0;
+	}
+	
+	return bkg;
+}
+
+void Level::freeBackground(EERIE_BACKGROUND * bkg) {
+	delete[] bkg->Backg;
+	delete bkg;
+}
+
+namespace {
+
+bool pointInTile(const Vec3f & p, float minx, float maxx, float minz, float maxz) {
+	return p.x >= minx && p.x <= maxx && p.z >= minz && p.z <= maxz;
+}
+
+//! Same selection as EERIEPOLY_Compute_PolyIn()
+void computePolyIn(Level & level) {
+	
+	for(int j = 0; j < level.sizeZ; j++) {
+		for(int i = 0; i < level.sizeX; i++) {
+			
+			LevelTile & tile = level.tile(i, j);
+			tile.polyin.clear();
+			
+			float minx = float(i) * level.tileSize - 10.f, maxx = minx + level.tileSize + 20.f;
+			float minz = float(j) * level.tileSize - 10.f, maxz = minz + level.tileSize + 20.f;
+			Vec2f center((minx + maxx) * .5f, (minz + maxz) * .5f);
+			
+			int aj = std::min(j + 2, level.sizeZ - 1), ai = std::min(i + 2, level.sizeX - 1);
+			for(int cj = std::max(j - 2, 0); cj < aj; cj++) {
+				for(int ci = std::max(i - 2, 0); ci < ai; ci++) {
+					std::vector<EERIEPOLY> & polys = level.tile(ci, cj).polydata;
+					for(size_t k = 0; k < polys.size(); k++) {
+						
+						EERIEPOLY & ep = polys[k];
+						if(fartherThan(center, Vec2f(ep.center.x, ep.center.z), 120.f)) {
+							continue;
+						}
+						
+						bool inside = pointInTile(ep.center, minx, maxx, minz, maxz);
+						size_t nbvert = (ep.type & POLY_QUAD) ? 4 : 3;
+						for(size_t n = 0; !inside && n < nbvert; n++) {
+							Vec3f half = (ep.v[n].p + ep.center) * .5f;
+							inside = pointInTile(ep.v[n].p, minx, maxx, minz, maxz)
+							         || pointInTile(half, minx, maxx, minz, maxz);
+						}
+						if(inside) {
+							tile.polyin.push_back(&ep);
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+void finishPoly(EERIEPOLY & ep, bool quad) {
+	
+	size_t to = quad ? 4 : 3;
+	ep.min = ep.max = ep.center = ep.v[0].p;
+	for(size_t i = 1; i < to; i++) {
+		ep.min = Vec3f(std::min(ep.min.x, ep.v[i].p.x), std::min(ep.min.y, ep.v[i].p.y),
+		               std::min(ep.min.z, ep.v[i].p.z));
+		ep.max = Vec3f(std::max(ep.max.x, ep.v[i].p.x), std::max(ep.max.y, ep.v[i].p.y),
+		               std::max(ep.max.z, ep.v[i].p.z));
+		ep.center += ep.v[i].p;
+	}
+	ep.center *= 1.f / float(to);
+	
+	ep.area = (ep.max.x - ep.min.x) * (ep.max.z - ep.min.z);
+	ep.norm = Vec3f(0.f, (ep.max.y - ep.min.y < 20.f) ? 1.f : 0.3f, 0.f);
+	
+	// Fake texture, only compared against NULL
+	ep.tex = (std::rand() % 8) ? reinterpret_cast<TextureContainer *>(&ep) : NULL;
+	
+	int kind = std::rand() % 20;
+	ep.type = quad ? PolyType(POLY_QUAD) : PolyType();
+	if(kind == 0) {
+		ep.type |= POLY_WATER;
+	} else if(kind == 1) {
+		ep.type |= POLY_TRANS;
+	} else if(kind == 2) {
+		ep.type |= POLY_NOCOL;
+	} else if(kind == 3) {
+		ep.type |= POLY_CLIMB;
+	}
+}
+
+} // anonymous namespace
+
+void buildSyntheticLevel(Level & level, int sizeX, int sizeZ, float tileSize) {
+	
+	std::srand(42);
+	level.sizeX = sizeX, level.sizeZ = sizeZ, level.tileSize = tileSize;
+	level.tiles.assign(size_t(sizeX * sizeZ), LevelTile());
+	
+	for(int z = 0; z < sizeZ; z++) {
+		for(int x = 0; x < sizeX; x++) {
+			
+			LevelTile & tile = level.tile(x, z);
+			float x0 = x * tileSize, z0 = z * tileSize;
+			
+			size_t count = 4 + std::rand() % 12;
+			tile.polydata.resize(count);
+			for(size_t i = 0; i < count; i++) {
+				
+				EERIEPOLY & ep = tile.polydata[i];
+				
+				float y = randomFloat(-400.f, 200.f);
+				float cx = x0 + randomFloat(0.f, tileSize), cz = z0 + randomFloat(0.f, tileSize);
+				float sx = randomFloat(10.f, 80.f), sz = randomFloat(10.f, 80.f);
+				bool wall = (std::rand() % 4) == 0;
+				bool quad = (std::rand() % 2) == 0;
+				
+				ep.v[0].p = Vec3f(cx - sx, y + randomFloat(-10.f, 10.f), cz - sz);
+				ep.v[1].p = Vec3f(cx + sx, y + randomFloat(-10.f, 10.f), cz - sz);
+				ep.v[2].p = Vec3f(cx - sx, y + randomFloat(-10.f, 10.f), cz + sz);
+				ep.v[3].p = Vec3f(cx + sx, y + randomFloat(-10.f, 10.f), cz + sz);
+				if(wall) {
+					ep.v[2].p = Vec3f(ep.v[0].p.x, y - 150.f, ep.v[0].p.z + 1.f);
+					ep.v[3].p = Vec3f(ep.v[1].p.x, y - 150.f, ep.v[1].p.z + 1.f);
+				}
+				
+				finishPoly(ep, quad);
+			}
+		}
+	}
+	
+	computePolyIn(level);
+}
+
+bool loadLevel(Level & level, const std::string & name, const std::vector<std::string> & paths) {
+	
+	PakReader resources;
+	for(size_t i = 0; i < paths.size(); i++) {
+		fs::path path = paths[i];
+		if(fs::is_directory(path)) {
+			resources.addFiles(path / "game", "game");
+		} else if(!resources.addArchive(path)) {
+			LogError << "Could not open PAK file " << path;
+			return false;
+		}
+	}
+	
+	res::path file = res::path("game/graph/levels") / name / "fast.fts";
+	
+	boost::scoped_array<char> bytes;
+	const char * data = NULL, * end = NULL;
+	if(!FastSceneDecompress(resources, file, bytes, data, end)) {
+		return false;
+	}
+	
+	try {
+		
+		const FAST_SCENE_HEADER * fsh = fts_read<FAST_SCENE_HEADER>(data, end);
+		if(fsh->version != FTS_VERSION || fsh->sizex <= 0 || fsh->sizez <= 0) {
+			LogError << "FTS: bad scene header in " << file;
+			return false;
+		}
+		
+		// Textures are not needed
+		size_t nbtextures = size_t(std::max(fsh->nb_textures, s32(0)));
+		(void)fts_read<FAST_TEXTURE_CONTAINER>(data, end, nbtextures);
+		
+		level.sizeX = fsh->sizex, level.sizeZ = fsh->sizez, level.tileSize = BKG_SIZX;
+		level.tiles.assign(size_t(fsh->sizex * fsh->sizez), LevelTile());
+		
+		for(int j = 0; j < fsh->sizez; j++) {
+			for(int i = 0; i < fsh->sizex; i++) {
+				
+				const FAST_SCENE_INFO * fsi = fts_read<FAST_SCENE_INFO>(data, end);
+				
+				size_t nbpoly = size_t(std::max(fsi->nbpoly, s32(0)));
+				const FAST_EERIEPOLY * eps = fts_read<FAST_EERIEPOLY>(data, end, nbpoly);
+				LevelTile & tile = level.tile(i, j);
+				tile.polydata.resize(nbpoly);
+				for(size_t k = 0; k < nbpoly; k++) {
+					FastSceneLoadPoly(tile.polydata[k], eps[k]);
+				}
+				
+				// Anchors are not needed
+				(void)fts_read<s32>(data, end, size_t(std::max(fsi->nbianchors, s32(0))));
+			}
+		}
+		
+	} catch(file_truncated_exception) {
+		LogError << "FTS: truncated compressed data in " << file;
+		return false;
+	}
+	
+	computePolyIn(level);
+	
+	return true;
+}
+
+} // namespace bench
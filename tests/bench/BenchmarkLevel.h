@@ -0,0 +1,91 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARX_TESTS_BENCH_BENCHMARKLEVEL_H
+#define ARX_TESTS_BENCH_BENCHMARKLEVEL_H
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#include "graphics/GraphicsTypes.h"
+
+struct EERIE_BACKGROUND;
+
+namespace bench {
+
+//! The background polygons of one tile, like EERIE_BKG_INFO.
+struct LevelTile {
+	
+	std::vector<EERIEPOLY> polydata;
+	
+	//! Polygons touching this tile, like EERIE_BKG_INFO::polyin
+	std::vector<EERIEPOLY *> polyin;
+	
+};
+
+//! Background polygons for the benchmarks, without the rest of the game state.
+struct Level {
+	
+	int sizeX;
+	int sizeZ;
+	float tileSize;
+	
+	std::vector<LevelTile> tiles;
+	
+	Level() : sizeX(0), sizeZ(0), tileSize(0.f) { }
+	
+	LevelTile & tile(int x, int z) { return tiles[x + z * sizeX]; }
+	const LevelTile & tile(int x, int z) const { return tiles[x + z * sizeX]; }
+	
+	size_t polyCount() const;
+	size_t polyinCount() const;
+	
+	/*!
+	 * Create an EERIE_BACKGROUND that uses the polygons of this level.
+	 *
+	 * Only the size and the tile polygon lists are set up. The result must be freed with
+	 * freeBackground() and is only valid as long as the level is not changed.
+	 */
+	EERIE_BACKGROUND * createBackground();
+	
+	static void freeBackground(EERIE_BACKGROUND * bkg);
+	
+};
+
+/*!
+ * Floors, ceilings, ramps and walls with a few random polygons per tile.
+ *
+ * The polygons have random types and fake textures. The same level is built every time.
+ */
+void buildSyntheticLevel(Level & level, int sizeX, int sizeZ, float tileSize);
+
+/*!
+ * Load the polygons of a real level using the game's scene loader.
+ *
+ * \param name  name of the level, for example "level1"
+ * \param paths PAK files or data directories to load the level from
+ *
+ * \return false if the level could not be loaded.
+ */
+bool loadLevel(Level & level, const std::string & name, const std::vector<std::string> & paths);
+
+} // namespace bench
+
+#endif // ARX_TESTS_BENCH_BENCHMARKLEVEL_H
@@ -0,0 +1,261 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Benchmark for the mesh overlap test of area damages (DoSphericDamage).
+ *
+ * Builds a synthetic fight with many NPCs and props, then lets a large number of spell
+ * impacts (fireballs, explosions) hit it. The overlap of every entity near an impact is
+ * measured with the old vertex pair loop and with ARX_DAMAGES_GetAreaOverlap(), both
+ * results are compared and the time per impact is reported.
+ *
+ * Usage: damageareabench [reference|clusters]
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <vector>
+
+#include "bench/Benchmark.h"
+#include "game/DamageArea.h"
+#include "graphics/Math.h"
+#include "graphics/Vertex.h"
+#include "platform/Platform.h"
+
+namespace {
+
+const size_t NPCCount = 60;
+const size_t PropCount = 240;
+const size_t ImpactCount = 5000;
+const float ArenaSize = 3000.f;
+
+struct Mesh {
+	
+	std::vector<EERIE_VERTEX> vertices;
+	Vec3f min;
+	Vec3f max;
+	
+};
+
+std::vector<Mesh> meshes;
+
+using bench::randomFloat;
+
+//! Random points on an ellipsoid, roughly the shape of a character or a barrel
+void addMesh(const Vec3f & center, const Vec3f & size, size_t count) {
+	
+	meshes.push_back(Mesh());
+	Mesh & mesh = meshes.back();
+	
+	mesh.vertices.resize(count);
+	mesh.min = mesh.max = center;
+	for(size_t i = 0; i < count; i++) {
+		Vec3f dir(randomFloat(-1.f, 1.f), randomFloat(-1.f, 1.f), randomFloat(-1.f, 1.f));
+		float len = std::sqrt(dir.x * dir.x + dir.y * dir.y + dir.z * dir.z) + 0.001f;
+		Vec3f v = center + Vec3f(dir.x * size.x, dir.y * size.y, dir.z * size.z) * (1.f / len);
+		mesh.vertices[i].v = v;
+		mesh.min = glm::min(mesh.min, v);
+		mesh.max = glm::max(mesh.max, v);
+	}
+}
+
+void buildScene() {
+	
+	std::srand(42);
+	
+	for(size_t i = 0; i < NPCCount; i++) {
+		Vec3f pos(randomFloat(0.f, ArenaSize), -90.f, randomFloat(0.f, ArenaSize));
+		addMesh(pos, Vec3f(40.f, 90.f, 30.f), 300 + std::rand() % 1200);
+	}
+	
+	for(size_t i = 0; i < PropCount; i++) {
+		Vec3f pos(randomFloat(0.f, ArenaSize), randomFloat(-60.f, 0.f), randomFloat(0.f, ArenaSize));
+		float size = randomFloat(10.f, 80.f);
+		addMesh(pos, Vec3f(size, size * randomFloat(0.5f, 1.5f), size), 8 + std::rand() % 112);
+	}
+}
+
+struct Impact {
+	
+	Vec3f pos;
+	float radius;
+	
+	//! Meshes whose bounding box is within the radius, like the entity grid candidates
+	std::vector<size_t> targets;
+	
+};
+
+std::vector<Impact> impacts;
+
+float getBoxDist(const Mesh & mesh, const Vec3f & pos) {
+	Vec3f d = glm::max(Vec3f(0.f), glm::max(mesh.min - pos, pos - mesh.max));
+	return std::sqrt(d.x * d.x + d.y * d.y + d.z * d.z);
+}
+
+void buildImpacts() {
+	
+	impacts.resize(ImpactCount);
+	
+	for(size_t i = 0; i < ImpactCount; i++) {
+		
+		Impact & impact = impacts[i];
+		
+		// Most spells are aimed at an NPC
+		const Mesh & target = meshes[std::rand() % NPCCount];
+		impact.pos = (target.min + target.max) * 0.5f
+		             + Vec3f(randomFloat(-80.f, 80.f), randomFloat(-80.f, 80.f), randomFloat(-80.f, 80.f));
+		impact.radius = randomFloat(50.f, 400.f);
+		
+		for(size_t j = 0; j < meshes.size(); j++) {
+			if(getBoxDist(meshes[j], impact.pos) <= impact.radius + 1.f) {
+				impact.targets.push_back(j);
+			}
+		}
+	}
+}
+
+//! The loop previously used in DoSphericDamage()
+DamageAreaOverlap referenceOverlap(const EERIE_VERTEX * vertices, size_t count,
+                                   const Vec3f & pos, float radius) {
+	
+	DamageAreaOverlap result;
+	result.count = 0;
+	result.count2 = 0;
+	result.mindist = std::numeric_limits<float>::max();
+	
+	for(size_t k = 0; k < count; k += 1) {
+		if(count < 120) {
+			for(size_t kk = 0; kk < count; kk += 1) {
+				if(kk != k) {
+					Vec3f posi = (vertices[k].v + vertices[kk].v) * 0.5f;
+					float dist = fdist(pos, posi);
+					if(dist <= radius) {
+						result.count2++;
+						if(dist < result.mindist)
+							result.mindist = dist;
+					}
+				}
+			}
+		}
+		
+		{
+			float dist = fdist(pos, vertices[k].v);
+			
+			if(dist <= radius) {
+				result.count++;
+				
+				if(dist < result.mindist)
+					result.mindist = dist;
+			}
+		}
+	}
+	
+	// Only this much is used by the damage ratio
+	result.count2 = std::min(result.count2, long(count));
+	
+	return result;
+}
+
+typedef DamageAreaOverlap (*OverlapFunction)(const EERIE_VERTEX *, size_t, const Vec3f &, float);
+
+struct Results {
+	
+	std::vector<DamageAreaOverlap> overlaps;
+	
+	u64 time;
+	
+};
+
+void run(Results & r, OverlapFunction overlap) {
+	
+	r.overlaps.clear();
+	
+	bench::Timer timer;
+	for(size_t i = 0; i < ImpactCount; i++) {
+		const Impact & impact = impacts[i];
+		for(size_t j = 0; j < impact.targets.size(); j++) {
+			const Mesh & mesh = meshes[impact.targets[j]];
+			r.overlaps.push_back(overlap(&mesh.vertices[0], mesh.vertices.size(),
+			                             impact.pos, impact.radius));
+		}
+	}
+	r.time = timer.elapsed();
+}
+
+void print(const char * name, const Results & r) {
+	bench::printTime(name, r.time, ImpactCount, "impact");
+}
+
+size_t compare(const Results & a, const Results & b) {
+	size_t mismatches = 0;
+	for(size_t i = 0; i < a.overlaps.size(); i++) {
+		const DamageAreaOverlap & x = a.overlaps[i];
+		const DamageAreaOverlap & y = b.overlaps[i];
+		if(x.count != y.count || x.count2 != y.count2 || x.mindist != y.mindist) {
+			mismatches++;
+		}
+	}
+	return mismatches;
+}
+
+} // anonymous namespace
+
+int main(int argc, char ** argv) {
+	
+	bench::init();
+	
+	const char * variants[] = { "reference", "clusters" };
+	bool enabled[ARRAY_SIZE(variants)];
+	if(!bench::selectVariants(argc, argv, "damageareabench [reference|clusters]", variants,
+	                          enabled, ARRAY_SIZE(variants))) {
+		return 1;
+	}
+	bool reference = enabled[0], clusters = enabled[1];
+	
+	buildScene();
+	buildImpacts();
+	
+	size_t tests = 0;
+	for(size_t i = 0; i < impacts.size(); i++) {
+		tests += impacts[i].targets.size();
+	}
+	std::printf("%lu NPCs, %lu props, %lu impacts, %lu entity tests\n",
+	            (unsigned long)NPCCount, (unsigned long)PropCount, (unsigned long)ImpactCount,
+	            (unsigned long)tests);
+	
+	Results referenceResults, clusterResults;
+	
+	if(reference) {
+		run(referenceResults, referenceOverlap);
+		print("pairs", referenceResults);
+	}
+	
+	if(clusters) {
+		run(clusterResults, ARX_DAMAGES_GetAreaOverlap);
+		print("clusters", clusterResults);
+	}
+	
+	if(reference && clusters) {
+		return bench::printMismatches(compare(referenceResults, clusterResults));
+	}
+	
+	return 0;
+}
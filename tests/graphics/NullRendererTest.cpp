@@ -0,0 +1,144 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "NullRendererTest.h"
+
+#include <cppunit/TestAssert.h>
+
+#include "graphics/Renderer.h"
+#include "graphics/Vertex.h"
+#include "graphics/VertexBuffer.h"
+#include "graphics/null/NullRenderer.h"
+#include "graphics/texture/Texture.h"
+
+void NullRendererTest::setUp() {
+	renderer = new NullRenderer;
+	renderer->Initialize();
+	wall = renderer->CreateTexture2D();
+	floor = renderer->CreateTexture2D();
+}
+
+void NullRendererTest::tearDown() {
+	delete wall;
+	delete floor;
+	delete renderer;
+}
+
+void NullRendererTest::renderScene() {
+
+	renderer->Clear(Renderer::ColorBuffer | Renderer::DepthBuffer);
+
+	SMY_VERTEX vertices[6];
+	VertexBuffer<SMY_VERTEX> * buffer = renderer->createVertexBuffer(64, Renderer::Stream);
+	buffer->setData(vertices, 6);
+
+	// Opaque geometry
+	renderer->SetRenderState(Renderer::AlphaBlending, false);
+	renderer->SetTexture(0, wall);
+	buffer->draw(Renderer::TriangleList, 6);
+	renderer->SetTexture(0, floor);
+	buffer->draw(Renderer::TriangleList, 3, 3);
+
+	// Transparent overlay
+	renderer->SetRenderState(Renderer::AlphaBlending, true);
+	renderer->SetBlendFunc(Renderer::BlendSrcAlpha, Renderer::BlendInvSrcAlpha);
+	renderer->ResetTexture(0);
+	TexturedVertex quad[4];
+	unsigned short indices[6] = { 0, 1, 2, 2, 1, 3 };
+	renderer->drawIndexed(Renderer::TriangleList, quad, 4, indices, 6);
+
+	delete buffer;
+}
+
+void NullRendererTest::drawCounts() {
+
+	renderScene();
+
+	const NullRenderer::Stats & stats = renderer->getStats();
+	CPPUNIT_ASSERT_EQUAL(size_t(3), stats.draws);
+	CPPUNIT_ASSERT_EQUAL(size_t(13), stats.vertices);
+	CPPUNIT_ASSERT_EQUAL(size_t(6), stats.indices);
+	CPPUNIT_ASSERT_EQUAL(size_t(3), stats.textureBinds);
+	CPPUNIT_ASSERT_EQUAL(size_t(3), stats.stateChanges);
+	CPPUNIT_ASSERT_EQUAL(size_t(0), stats.redundantStateChanges);
+	CPPUNIT_ASSERT_EQUAL(size_t(1), stats.clears);
+}
+
+void NullRendererTest::redundantState() {
+
+	renderer->SetRenderState(Renderer::DepthTest, true);
+	renderer->SetRenderState(Renderer::DepthTest, true);
+	renderer->SetRenderState(Renderer::DepthWrite, true);
+	renderer->SetCulling(Renderer::CullNone);
+	renderer->SetCulling(Renderer::CullCW);
+	renderer->SetTexture(0, wall);
+	renderer->SetTexture(0, wall);
+	renderer->SetTexture(1, wall);
+
+	const NullRenderer::Stats & stats = renderer->getStats();
+	CPPUNIT_ASSERT_EQUAL(size_t(5), stats.stateChanges);
+	CPPUNIT_ASSERT_EQUAL(size_t(1), stats.redundantStateChanges);
+	CPPUNIT_ASSERT_EQUAL(size_t(3), stats.textureBinds);
+	CPPUNIT_ASSERT_EQUAL(size_t(1), stats.redundantTextureBinds);
+}
+
+void NullRendererTest::commandLog() {
+
+	renderScene();
+	CPPUNIT_ASSERT(renderer->getCommands().empty());
+
+	renderer->setRecording(true);
+	renderScene();
+
+	const NullRenderer::CommandLog & commands = renderer->getCommands();
+	CPPUNIT_ASSERT_EQUAL(size_t(10), commands.size());
+
+	CPPUNIT_ASSERT_EQUAL(NullRenderer::ClearCommand, commands[0].type);
+
+	CPPUNIT_ASSERT_EQUAL(NullRenderer::TextureCommand, commands[2].type);
+	CPPUNIT_ASSERT_EQUAL(u32(0), commands[2].arg0);
+	CPPUNIT_ASSERT(commands[2].arg1 != 0);
+
+	CPPUNIT_ASSERT_EQUAL(NullRenderer::DrawCommand, commands[3].type);
+	CPPUNIT_ASSERT_EQUAL(u32(Renderer::TriangleList), commands[3].arg0);
+	CPPUNIT_ASSERT_EQUAL(u32(6), commands[3].arg1);
+	CPPUNIT_ASSERT_EQUAL(u32(0), commands[3].arg2);
+
+	CPPUNIT_ASSERT_EQUAL(NullRenderer::TextureCommand, commands[8].type);
+	CPPUNIT_ASSERT_EQUAL(u32(0), commands[8].arg1);
+
+	CPPUNIT_ASSERT_EQUAL(NullRenderer::DrawCommand, commands[9].type);
+	CPPUNIT_ASSERT_EQUAL(u32(4), commands[9].arg1);
+	CPPUNIT_ASSERT_EQUAL(u32(6), commands[9].arg2);
+}
+
+void NullRendererTest::endFrame() {
+
+	renderer->setRecording(true);
+	renderScene();
+	renderer->endFrame();
+
+	CPPUNIT_ASSERT_EQUAL(size_t(0), renderer->getStats().draws);
+	CPPUNIT_ASSERT(renderer->getCommands().empty());
+	CPPUNIT_ASSERT_EQUAL(size_t(3), renderer->getLastFrameStats().draws);
+
+	// The state carries over into the next frame, setting the same blend function is redundant
+	renderScene();
+	CPPUNIT_ASSERT_EQUAL(size_t(1), renderer->getStats().redundantStateChanges);
+}
@@ -0,0 +1,267 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Benchmark for the background ray queries.
+ *
+ * Builds a synthetic level or loads a real one, then traces the same random rays between
+ * polygons with the old fixed-step marching over the tile polygon lists (as used by Visible()
+ * before the BVH) and with BackgroundBVH. Reports the number of rays per second and how often
+ * both agree on whether the target polygon is visible.
+ *
+ * The marching can step over thin polygons, so some disagreement is expected.
+ *
+ * Usage: raybench [reference|bvh] [<level> <pakfile|datadir>...]
+ *
+ * With a variant argument only that variant is run. With a level name like "level1" and the
+ * game's PAK files or data directories, that level is loaded instead of the synthetic one.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "bench/Benchmark.h"
+#include "bench/BenchmarkLevel.h"
+#include "graphics/GraphicsTypes.h"
+#include "graphics/data/BackgroundBVH.h"
+#include "graphics/data/Mesh.h"
+#include "platform/Platform.h"
+
+namespace {
+
+const int TilesX = 120;
+const int TilesZ = 120;
+const float TileSize = 100.f;
+const size_t RayCount = 20000;
+
+bench::Level level;
+
+struct Ray {
+	
+	Vec3f orgn;
+	Vec3f dest;
+	EERIEPOLY * target;
+	
+};
+
+std::vector<Ray> rays;
+
+//! Rays between random polygons, starting slightly above the first one.
+void buildRays() {
+	
+	std::srand(42);
+	
+	std::vector<EERIEPOLY *> polys;
+	for(size_t i = 0; i < level.tiles.size(); i++) {
+		for(size_t k = 0; k < level.tiles[i].polydata.size(); k++) {
+			polys.push_back(&level.tiles[i].polydata[k]);
+		}
+	}
+	
+	while(rays.size() < RayCount) {
+		EERIEPOLY * a = polys[size_t(std::rand()) % polys.size()];
+		EERIEPOLY * b = polys[size_t(std::rand()) % polys.size()];
+		float dist = glm::length(a->center - b->center);
+		if(a == b || dist < 50.f || dist > 3000.f) {
+			continue;
+		}
+		Ray ray;
+		ray.orgn = a->center - Vec3f(0.f, 80.f, 0.f);
+		ray.dest = b->center;
+		ray.target = b;
+		rays.push_back(ray);
+	}
+}
+
+// Reference implementation, copied from Visible() before the BVH
+
+//! Double-sided segment / triangle test, returns the distance along the segment.
+bool segmentHitsTriangle(const Vec3f & orgn, const Vec3f & dest, const Vec3f & v0,
+                         const Vec3f & v1, const Vec3f & v2, float * dist) {
+	
+	Vec3f dir = dest - orgn;
+	Vec3f e1 = v1 - v0, e2 = v2 - v0;
+	Vec3f p = glm::cross(dir, e2);
+	float det = glm::dot(e1, p);
+	if(det == 0.f) {
+		return false;
+	}
+	
+	float inv = 1.f / det;
+	Vec3f s = orgn - v0;
+	float u = glm::dot(s, p) * inv;
+	if(u < 0.f || u > 1.f) {
+		return false;
+	}
+	
+	Vec3f q = glm::cross(s, e1);
+	float v = glm::dot(dir, q) * inv;
+	if(v < 0.f || u + v > 1.f) {
+		return false;
+	}
+	
+	float t = glm::dot(e2, q) * inv;
+	if(t < 0.f || t > 1.f) {
+		return false;
+	}
+	
+	*dist = t * glm::length(dir);
+	return true;
+}
+
+bool RayCollidingPoly(const Vec3f & orgn, const Vec3f & dest, const EERIEPOLY * ep,
+                      float * dist) {
+	if(segmentHitsTriangle(orgn, dest, ep->v[0].p, ep->v[1].p, ep->v[2].p, dist)) {
+		return true;
+	}
+	return (ep->type & POLY_QUAD)
+	       && segmentHitsTriangle(orgn, dest, ep->v[1].p, ep->v[2].p, ep->v[3].p, dist);
+}
+
+bool referenceVisible(const Ray & ray) {
+	
+	float pas = 35.f;
+	
+	EERIEPOLY * found_ep = NULL;
+	
+	float nearest, distance;
+	nearest = distance = glm::length(ray.dest - ray.orgn);
+	if(distance < pas) {
+		pas = distance * .5f;
+	}
+	
+	Vec3f d = ray.dest - ray.orgn;
+	Vec3f ad(std::fabs(d.x), std::fabs(d.y), std::fabs(d.z));
+	
+	float major = std::max(ad.x, std::max(ad.y, ad.z));
+	float iter = major / pas;
+	Vec3f i = d * (1.f / iter);
+	
+	Vec3f p = ray.orgn - i;
+	while(iter > 0.f) {
+		iter -= 1.f;
+		p += i;
+		
+		long px = long(p.x * (1.f / level.tileSize));
+		long pz = long(p.z * (1.f / level.tileSize));
+		if(px < 0 || px > level.sizeX - 1 || pz < 0 || pz > level.sizeZ - 1) {
+			break;
+		}
+		
+		const bench::LevelTile & tile = level.tile(px, pz);
+		for(size_t k = 0; k < tile.polyin.size(); k++) {
+			EERIEPOLY * ep = tile.polyin[k];
+			float dd;
+			if(ep->min.y - pas < p.y && ep->max.y + pas > p.y
+			   && ep->min.x - pas < p.x && ep->max.x + pas > p.x
+			   && ep->min.z - pas < p.z && ep->max.z + pas > p.z
+			   && RayCollidingPoly(ray.orgn, ray.dest, ep, &dd)) {
+				if(dd < nearest) {
+					nearest = dd;
+					found_ep = ep;
+				}
+			}
+		}
+	}
+	
+	return !found_ep || found_ep == ray.target;
+}
+
+// The same query using the BVH
+
+BackgroundBVH bvh;
+
+bool bvhVisible(const Ray & ray) {
+	BackgroundBVH::Hit first = bvh.intersect(ray.orgn, ray.dest);
+	return !first.poly || first.poly == ray.target;
+}
+
+typedef bool (*VisibleQuery)(const Ray &);
+
+u64 run(std::vector<char> & results, VisibleQuery visible) {
+	results.resize(RayCount);
+	bench::Timer timer;
+	for(size_t i = 0; i < RayCount; i++) {
+		results[i] = visible(rays[i]);
+	}
+	return timer.elapsed();
+}
+
+} // anonymous namespace
+
+int main(int argc, char ** argv) {
+	
+	bench::init();
+	
+	bool reference = true, hierarchy = true;
+	int first = 1;
+	if(argc > 1 && (!std::strcmp(argv[1], "reference") || !std::strcmp(argv[1], "bvh"))) {
+		reference = !std::strcmp(argv[1], "reference");
+		hierarchy = !reference;
+		first = 2;
+	}
+	
+	if(first + 1 < argc) {
+		std::vector<std::string> paths(argv + first + 1, argv + argc);
+		if(!bench::loadLevel(level, argv[first], paths)) {
+			return 1;
+		}
+	} else if(first < argc) {
+		std::printf("usage: raybench [reference|bvh] [<level> <pakfile|datadir>...]\n");
+		return 1;
+	} else {
+		bench::buildSyntheticLevel(level, TilesX, TilesZ, TileSize);
+	}
+	
+	buildRays();
+	
+	EERIE_BACKGROUND * bkg = level.createBackground();
+	bench::Timer timer;
+	bvh.build(*bkg);
+	u64 buildTime = timer.elapsed();
+	bench::Level::freeBackground(bkg);
+	
+	std::printf("%lu polygons, %lu rays, BVH built in %lu us\n", (unsigned long)level.polyCount(),
+	            (unsigned long)RayCount, (unsigned long)buildTime);
+	
+	std::vector<char> referenceResults, bvhResults;
+	
+	if(reference) {
+		bench::printRate("fixed steps", run(referenceResults, referenceVisible), RayCount, "rays");
+	}
+	
+	if(hierarchy) {
+		bench::printRate("BVH", run(bvhResults, bvhVisible), RayCount, "rays");
+	}
+	
+	if(reference && hierarchy) {
+		size_t same = 0;
+		for(size_t i = 0; i < RayCount; i++) {
+			same += (referenceResults[i] == bvhResults[i]) ? 1 : 0;
+		}
+		std::printf("%lu/%lu identical\n", (unsigned long)same, (unsigned long)RayCount);
+	}
+	
+	return 0;
+}
@@ -0,0 +1,383 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Benchmark for the background collision queries.
+ *
+ * Builds a synthetic level, then runs the same random queries against the polygon lists
+ * (the old per-EERIEPOLY loops) and against the TileCollision mirrors, checks that both
+ * give the same results and reports the time per query.
+ *
+ * Usage: tilecollisionbench [reference|mirror]
+ *
+ * With an argument only that variant is run, so that the cache misses of each can be
+ * compared with an external tool like `perf stat -e cache-misses`.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "bench/Benchmark.h"
+#include "bench/BenchmarkLevel.h"
+#include "graphics/GraphicsTypes.h"
+#include "graphics/data/TileCollision.h"
+#include "platform/Platform.h"
+
+namespace {
+
+const int TilesX = 120;
+const int TilesZ = 120;
+const float TileSize = 100.f;
+const size_t QueryCount = 200000;
+
+bench::Level level;
+
+struct Tile {
+	
+	bench::LevelTile * polys;
+	TileCollision polyinCollision;
+	TileCollision polydataCollision;
+	
+};
+
+std::vector<Tile> tiles;
+
+//! Collision mirrors of the polygon lists, like EERIEPOLY_Compute_PolyIn()
+void buildTiles() {
+	tiles.resize(level.tiles.size());
+	for(size_t i = 0; i < tiles.size(); i++) {
+		bench::LevelTile & polys = level.tiles[i];
+		tiles[i].polys = &polys;
+		for(size_t k = 0; k < polys.polyin.size(); k++) {
+			tiles[i].polyinCollision.add(polys.polyin[k]);
+		}
+		for(size_t k = 0; k < polys.polydata.size(); k++) {
+			tiles[i].polydataCollision.add(&polys.polydata[k]);
+		}
+	}
+}
+
+// Reference implementations, copied from the polygon-based queries
+
+bool isSolid(const EERIEPOLY * ep) {
+	return !(ep->type & (POLY_WATER | POLY_TRANS | POLY_NOCOL));
+}
+
+int PointIn2DPolyXZ(const EERIEPOLY * ep, float x, float z) {
+	
+	int i, j, c = 0, d = 0;
+	
+	for(i = 0, j = 2; i < 3; j = i++) {
+		if((((ep->v[i].p.z <= z) && (z < ep->v[j].p.z)) ||
+		    ((ep->v[j].p.z <= z) && (z < ep->v[i].p.z))) &&
+		   (x < (ep->v[j].p.x - ep->v[i].p.x) *(z - ep->v[i].p.z) / (ep->v[j].p.z - ep->v[i].p.z) + ep->v[i].p.x))
+			c = !c;
+	}
+	
+	if(ep->type & POLY_QUAD) {
+		for(i = 1, j = 3; i < 4; j = i++) {
+			if((((ep->v[i].p.z <= z) && (z < ep->v[j].p.z)) ||
+			    ((ep->v[j].p.z <= z) && (z < ep->v[i].p.z))) &&
+			   (x < (ep->v[j].p.x - ep->v[i].p.x) *(z - ep->v[i].p.z) / (ep->v[j].p.z - ep->v[i].p.z) + ep->v[i].p.x))
+				d = !d;
+		}
+	}
+	
+	return c + d;
+}
+
+bool GetTruePolyY(const EERIEPOLY * ep, const Vec3f * pos, float * ret) {
+	
+	Vec3f s21 = ep->v[1].p - ep->v[0].p;
+	Vec3f s31 = ep->v[2].p - ep->v[0].p;
+	
+	Vec3f n;
+	n.y = (s21.z * s31.x) - (s21.x * s31.z);
+	if(n.y == 0.f) return false;
+	n.x = (s21.y * s31.z) - (s21.z * s31.y);
+	n.z = (s21.x * s31.y) - (s21.y * s31.x);
+	
+	s21.x = ep->v[0].p.x * n.x + ep->v[0].p.y * n.y + ep->v[0].p.z * n.z;
+	s21.x = (s21.x - (n.x * pos->x) - (n.z * pos->z)) / n.y;
+	
+	if(s21.x < ep->min.y) s21.x = ep->min.y;
+	else if(s21.x > ep->max.y) s21.x = ep->max.y;
+	
+	*ret = s21.x;
+	return true;
+}
+
+void referenceFloor(const Tile & tile, const Vec3f & pos, EERIEPOLY *& found, float & foundY) {
+	for(size_t k = 0; k < tile.polys->polyin.size(); k++) {
+		EERIEPOLY * ep = tile.polys->polyin[k];
+		float rz;
+		if(pos.x >= ep->min.x && pos.x <= ep->max.x && pos.z >= ep->min.z && pos.z <= ep->max.z
+		   && isSolid(ep) && ep->max.y >= pos.y && ep != found
+		   && PointIn2DPolyXZ(ep, pos.x, pos.z) && GetTruePolyY(ep, &pos, &rz)
+		   && rz >= pos.y && (!found || rz <= foundY)) {
+			found = ep;
+			foundY = rz;
+		}
+	}
+}
+
+EERIEPOLY * referenceTop(const Tile & tile, const Vec3f & pos) {
+	EERIEPOLY * found = NULL;
+	for(size_t k = 0; k < tile.polys->polyin.size(); k++) {
+		EERIEPOLY * ep = tile.polys->polyin[k];
+		if(isSolid(ep) && ep->min.y < pos.y
+		   && pos.x >= ep->min.x && pos.x <= ep->max.x && pos.z >= ep->min.z && pos.z <= ep->max.z
+		   && PointIn2DPolyXZ(ep, pos.x, pos.z)) {
+			if(float(std::fabs(ep->max.y - ep->min.y)) > 50.f && pos.y - ep->center.y < 60.f) {
+				continue;
+			}
+			if(ep->tex != NULL && (found == NULL || ep->min.y > found->min.y)) {
+				found = ep;
+			}
+		}
+	}
+	return found;
+}
+
+EERIEPOLY * referenceMinMax(const Tile & tile, const Vec3f & pos, bool largest) {
+	EERIEPOLY * found = NULL;
+	float foundy = 0.f;
+	for(size_t k = 0; k < tile.polys->polyin.size(); k++) {
+		EERIEPOLY * ep = tile.polys->polyin[k];
+		float ret;
+		if(isSolid(ep) && PointIn2DPolyXZ(ep, pos.x, pos.z) && GetTruePolyY(ep, &pos, &ret)) {
+			if(!found || (largest ? ret > foundy : ret < foundy)) {
+				found = ep;
+				foundy = ret;
+			}
+		}
+	}
+	return found;
+}
+
+//! Number of polygons that pass the early rejection in IsPolyInCylinder().
+size_t referenceCylinder(const Tile & tile, const EERIE_CYLINDER & cyl) {
+	size_t count = 0;
+	for(size_t k = 0; k < tile.polys->polydata.size(); k++) {
+		const EERIEPOLY * ep = &tile.polys->polydata[k];
+		if(!isSolid(ep)
+		   || cyl.origin.y + cyl.height > ep->max.y || cyl.origin.y < ep->min.y) {
+			continue;
+		}
+		size_t to = (ep->type & POLY_QUAD) ? 4 : 3;
+		float nearest = 99999999.f;
+		for(size_t n = 0; n < to; n++) {
+			Vec2f d(ep->v[n].p.x - cyl.origin.x, ep->v[n].p.z - cyl.origin.z);
+			nearest = std::min(nearest, std::sqrt(d.x * d.x + d.y * d.y));
+		}
+		count += (nearest <= std::max(82.f, cyl.radius)) ? 1 : 0;
+	}
+	return count;
+}
+
+// The same queries using the collision mirrors
+
+void mirrorFloor(const Tile & tile, const Vec3f & pos, EERIEPOLY *& found, float & foundY) {
+	tile.polyinCollision.findFloor(pos.x, pos.y, pos.z, found, foundY);
+}
+
+EERIEPOLY * mirrorTop(const Tile & tile, const Vec3f & pos) {
+	return tile.polyinCollision.findTop(pos.x, pos.y, pos.z);
+}
+
+EERIEPOLY * mirrorMinMax(const Tile & tile, const Vec3f & pos, bool largest) {
+	return largest ? tile.polyinCollision.findMinPoly(pos.x, pos.z)
+	               : tile.polyinCollision.findMaxPoly(pos.x, pos.z);
+}
+
+size_t mirrorCylinder(const Tile & tile, const EERIE_CYLINDER & cyl) {
+	const TileCollision & collision = tile.polydataCollision;
+	size_t count = 0;
+	for(size_t k = 0; k < collision.size(); k++) {
+		if(cyl.origin.y + cyl.height > collision.getMaxY(k) || cyl.origin.y < collision.getMinY(k)) {
+			continue;
+		}
+		float nearest = 99999999.f;
+		for(size_t n = 0; n < collision.getVertexCount(k); n++) {
+			Vec2f v = collision.getVertex(k, n);
+			Vec2f d(v.x - cyl.origin.x, v.y - cyl.origin.z);
+			nearest = std::min(nearest, std::sqrt(d.x * d.x + d.y * d.y));
+		}
+		count += (nearest <= std::max(82.f, cyl.radius)) ? 1 : 0;
+	}
+	return count;
+}
+
+struct Query {
+	
+	Vec3f pos;
+	const Tile * tile;
+	
+};
+
+std::vector<Query> queries;
+
+void buildQueries() {
+	queries.resize(QueryCount);
+	for(size_t i = 0; i < QueryCount; i++) {
+		int x = 1 + std::rand() % (TilesX - 2), z = 1 + std::rand() % (TilesZ - 2);
+		queries[i].pos = Vec3f(x * TileSize + bench::randomFloat(0.f, TileSize),
+		                       bench::randomFloat(-450.f, 250.f),
+		                       z * TileSize + bench::randomFloat(0.f, TileSize));
+		queries[i].tile = &tiles[x + z * TilesX];
+	}
+}
+
+struct Results {
+	
+	std::vector<EERIEPOLY *> floor;
+	std::vector<float> floorY;
+	std::vector<EERIEPOLY *> top;
+	std::vector<EERIEPOLY *> min;
+	std::vector<EERIEPOLY *> max;
+	std::vector<size_t> cylinder;
+	
+	//! Microseconds per query type.
+	u64 time[5];
+	
+};
+
+typedef void (*FloorQuery)(const Tile &, const Vec3f &, EERIEPOLY *&, float &);
+typedef EERIEPOLY * (*TopQuery)(const Tile &, const Vec3f &);
+typedef EERIEPOLY * (*MinMaxQuery)(const Tile &, const Vec3f &, bool);
+typedef size_t (*CylinderQuery)(const Tile &, const EERIE_CYLINDER &);
+
+void run(Results & r, FloorQuery floor, TopQuery top, MinMaxQuery minmax,
+         CylinderQuery cylinder) {
+	
+	r.floor.resize(QueryCount), r.floorY.resize(QueryCount), r.top.resize(QueryCount);
+	r.min.resize(QueryCount), r.max.resize(QueryCount), r.cylinder.resize(QueryCount);
+	
+	bench::Timer timer;
+	for(size_t i = 0; i < QueryCount; i++) {
+		// CheckInPoly() searches up to four tiles
+		EERIEPOLY * found = NULL;
+		float foundY = 0.f;
+		const Tile * tile = queries[i].tile;
+		floor(tile[0], queries[i].pos, found, foundY);
+		floor(tile[1], queries[i].pos, found, foundY);
+		floor(tile[TilesX], queries[i].pos, found, foundY);
+		floor(tile[TilesX + 1], queries[i].pos, found, foundY);
+		r.floor[i] = found, r.floorY[i] = foundY;
+	}
+	r.time[0] = timer.elapsed();
+	
+	timer = bench::Timer();
+	for(size_t i = 0; i < QueryCount; i++) {
+		r.top[i] = top(*queries[i].tile, queries[i].pos);
+	}
+	r.time[1] = timer.elapsed();
+	
+	timer = bench::Timer();
+	for(size_t i = 0; i < QueryCount; i++) {
+		r.min[i] = minmax(*queries[i].tile, queries[i].pos, true);
+	}
+	r.time[2] = timer.elapsed();
+	
+	timer = bench::Timer();
+	for(size_t i = 0; i < QueryCount; i++) {
+		r.max[i] = minmax(*queries[i].tile, queries[i].pos, false);
+	}
+	r.time[3] = timer.elapsed();
+	
+	timer = bench::Timer();
+	for(size_t i = 0; i < QueryCount; i++) {
+		// CheckAnythingInCylinder() tests all tiles within the cylinder radius
+		EERIE_CYLINDER cyl;
+		cyl.origin = queries[i].pos, cyl.radius = 40.f, cyl.height = -160.f;
+		const Tile * tile = queries[i].tile;
+		size_t count = 0;
+		for(int z = -1; z <= 1; z++) {
+			for(int x = -1; x <= 1; x++) {
+				count += cylinder(tile[x + z * TilesX], cyl);
+			}
+		}
+		r.cylinder[i] = count;
+	}
+	r.time[4] = timer.elapsed();
+}
+
+void print(const char * name, const Results & r) {
+	const char * queryNames[] = { "CheckInPoly", "CheckTopPoly", "GetMinPoly", "GetMaxPoly",
+	                              "cylinder" };
+	std::printf("%s:\n", name);
+	for(size_t i = 0; i < ARRAY_SIZE(queryNames); i++) {
+		bench::printTimeNs(queryNames[i], r.time[i], QueryCount, "query");
+	}
+}
+
+size_t compare(const Results & a, const Results & b) {
+	size_t mismatches = 0;
+	for(size_t i = 0; i < QueryCount; i++) {
+		if(a.floor[i] != b.floor[i] || a.floorY[i] != b.floorY[i] || a.top[i] != b.top[i]
+		   || a.min[i] != b.min[i] || a.max[i] != b.max[i] || a.cylinder[i] != b.cylinder[i]) {
+			mismatches++;
+		}
+	}
+	return mismatches;
+}
+
+} // anonymous namespace
+
+int main(int argc, char ** argv) {
+	
+	bench::init();
+	
+	const char * variants[] = { "reference", "mirror" };
+	bool enabled[ARRAY_SIZE(variants)];
+	if(!bench::selectVariants(argc, argv, "tilecollisionbench [reference|mirror]", variants,
+	                          enabled, ARRAY_SIZE(variants))) {
+		return 1;
+	}
+	bool reference = enabled[0], mirror = enabled[1];
+	
+	bench::buildSyntheticLevel(level, TilesX, TilesZ, TileSize);
+	buildTiles();
+	buildQueries();
+	
+	std::printf("%lu tiles, %lu polygons, %lu polygon references, %lu queries\n",
+	            (unsigned long)level.tiles.size(), (unsigned long)level.polyCount(),
+	            (unsigned long)level.polyinCount(), (unsigned long)QueryCount);
+	
+	Results referenceResults, mirrorResults;
+	
+	if(reference) {
+		run(referenceResults, referenceFloor, referenceTop, referenceMinMax, referenceCylinder);
+		print("EERIEPOLY lists", referenceResults);
+	}
+	
+	if(mirror) {
+		run(mirrorResults, mirrorFloor, mirrorTop, mirrorMinMax, mirrorCylinder);
+		print("TileCollision", mirrorResults);
+	}
+	
+	if(reference && mirror) {
+		return bench::printMismatches(compare(referenceResults, mirrorResults));
+	}
+	
+	return 0;
+}
@@ -0,0 +1,213 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "VertexLightingTest.h"
+
+#include <cstdlib>
+#include <vector>
+
+#include <cppunit/TestAssert.h>
+
+#include "graphics/Math.h"
+#include "scene/Light.h"
+
+static float random(float min, float max) {
+	return min + (max - min) * (float(std::rand()) / float(RAND_MAX));
+}
+
+static Vec3f randomVector(float min, float max) {
+	return Vec3f(random(min, max), random(min, max), random(min, max));
+}
+
+//! Per-vertex lighting as done by ApplyLight() before VertexLighting replaced it
+static ColorBGRA referenceLight(const std::vector<EERIE_LIGHT *> & lights, const EERIE_QUAT * quat,
+                                const Vec3f & position, const Vec3f & normal,
+                                const ColorMod & colorMod, float materialDiffuse) {
+
+	Color3f tempColor = colorMod.ambientColor;
+
+	for(size_t l = 0; l < lights.size(); l++) {
+		EERIE_LIGHT * light = lights[l];
+
+		Vec3f vLight = glm::normalize(light->pos - position);
+
+		Vec3f Cur_vLights;
+		TransformInverseVertexQuat(quat, &vLight, &Cur_vLights);
+
+		float cosangle = glm::dot(normal, Cur_vLights);
+
+		if(cosangle > 0.f) {
+			float distance = fdist(position, light->pos);
+
+			if(distance <= light->fallstart) {
+				cosangle *= light->precalc;
+			} else {
+				float p = ((light->fallend - distance) * light->falldiffmul);
+
+				if(p <= 0.f)
+					cosangle = 0.f;
+				else
+					cosangle *= p * light->precalc;
+			}
+
+			cosangle *= materialDiffuse;
+
+			tempColor += light->rgb255 * cosangle;
+		}
+	}
+
+	tempColor *= colorMod.factor;
+	tempColor += colorMod.term;
+
+	u8 ir = clipByte255(tempColor.r);
+	u8 ig = clipByte255(tempColor.g);
+	u8 ib = clipByte255(tempColor.b);
+
+	return (0xFF000000L | (ir << 16) | (ig << 8) | (ib));
+}
+
+//! Same as RecalcLight()
+static void updateLight(EERIE_LIGHT & light) {
+	light.rgb255 = light.rgb * 255.f;
+	light.falldiff = light.fallend - light.fallstart;
+	light.falldiffmul = 1.f / light.falldiff;
+	light.precalc = light.intensity * 0.85f;
+}
+
+static int channelDifference(ColorBGRA a, ColorBGRA b) {
+	int result = 0;
+	for(int shift = 0; shift < 32; shift += 8) {
+		int d = int((a >> shift) & 0xff) - int((b >> shift) & 0xff);
+		result = std::max(result, std::abs(d));
+	}
+	return result;
+}
+
+void VertexLightingTest::compare(VertexLighting::Implementation implementation) {
+
+	std::srand(42);
+
+	VertexLighting lighting;
+	lighting.setImplementation(implementation);
+	CPPUNIT_ASSERT_EQUAL(implementation, lighting.getImplementation());
+
+	std::vector<EERIE_LIGHT> lightData(18);
+	std::vector<ColorBGRA> colors;
+
+	for(int object = 0; object < 50; object++) {
+
+		// Objects have up to 18 lights, some of them close enough to be at full intensity.
+		std::vector<EERIE_LIGHT *> lights(size_t(std::rand() % 19));
+		for(size_t l = 0; l < lights.size(); l++) {
+			EERIE_LIGHT & light = lightData[l];
+			light.pos = randomVector(-800.f, 800.f);
+			light.fallstart = random(0.f, 300.f);
+			light.fallend = light.fallstart + random(10.f, 1000.f);
+			light.rgb = Color3f(random(0.f, 1.f), random(0.f, 1.f), random(0.f, 1.f));
+			light.intensity = random(0.2f, 2.f);
+			updateLight(light);
+			lights[l] = &light;
+		}
+
+		ColorMod colorMod;
+		colorMod.ambientColor = Color3f(random(0.f, 60.f), random(0.f, 60.f), random(0.f, 60.f));
+		colorMod.factor = Color3f(random(0.5f, 1.5f), random(0.5f, 1.5f), random(0.5f, 1.5f));
+		colorMod.term = Color3f(random(0.f, 20.f), random(0.f, 20.f), random(0.f, 20.f));
+
+		float materialDiffuse = (object & 1) ? 0.5f : 1.f;
+
+		if(!lights.empty()) {
+			lighting.setLights(&lights[0], lights.size());
+		} else {
+			lighting.setLights(NULL, 0);
+		}
+		lighting.clear();
+
+		// Several bones, each with its own rotation
+		std::vector<EERIE_QUAT> quats(size_t(1 + std::rand() % 5));
+		std::vector<size_t> bones;
+		std::vector<Vec3f> positions, normals;
+		for(size_t b = 0; b < quats.size(); b++) {
+			Anglef angle(random(0.f, 360.f), random(0.f, 360.f), random(0.f, 360.f));
+			QuatFromAngles(&quats[b], &angle);
+			size_t count = size_t(std::rand() % 40);
+			for(size_t v = 0; v < count; v++) {
+				bones.push_back(b);
+				positions.push_back(randomVector(-300.f, 300.f));
+				normals.push_back(glm::normalize(randomVector(-1.f, 1.f)));
+				lighting.add(&quats[b], positions.back(), normals.back());
+			}
+		}
+
+		CPPUNIT_ASSERT_EQUAL(positions.size(), lighting.size());
+
+		colors.resize(positions.size() + 1);
+		lighting.apply(colorMod, materialDiffuse, &colors[0]);
+
+		for(size_t v = 0; v < positions.size(); v++) {
+			ColorBGRA expected = referenceLight(lights, &quats[bones[v]], positions[v], normals[v],
+			                                    colorMod, materialDiffuse);
+			CPPUNIT_ASSERT(channelDifference(expected, colors[v]) <= 1);
+		}
+	}
+}
+
+void VertexLightingTest::matchesScalar() {
+	compare(VertexLighting::Scalar);
+}
+
+void VertexLightingTest::matchesSSE2() {
+	if(VertexLighting::isSupported(VertexLighting::SSE2)) {
+		compare(VertexLighting::SSE2);
+	}
+}
+
+void VertexLightingTest::lightListEnd() {
+
+	EERIE_LIGHT light;
+	light.pos = Vec3f(0.f, 0.f, 100.f);
+	light.fallstart = 200.f;
+	light.fallend = 400.f;
+	light.rgb = Color3f(1.f, 0.f, 0.f);
+	light.intensity = 1.f;
+	updateLight(light);
+
+	EERIE_LIGHT * lights[] = { &light, NULL, &light };
+
+	ColorMod colorMod;
+	colorMod.ambientColor = Color3f::black;
+	colorMod.factor = Color3f::white;
+	colorMod.term = Color3f::black;
+
+	EERIE_QUAT identity;
+	Quat_Init(&identity);
+
+	VertexLighting lighting;
+	lighting.setLights(lights, 3);
+	lighting.add(&identity, Vec3f_ZERO, Vec3f(0.f, 0.f, 1.f));
+	lighting.add(&identity, Vec3f_ZERO, Vec3f(0.f, 0.f, -1.f));
+
+	ColorBGRA colors[2];
+	lighting.apply(colorMod, 1.f, colors);
+
+	// Only the first light is used: the facing vertex is lit at full intensity (0.85 * 255),
+	// the other one is black.
+	CPPUNIT_ASSERT_EQUAL(ColorBGRA(0xFFD80000), colors[0]);
+	CPPUNIT_ASSERT_EQUAL(ColorBGRA(0xFF000000), colors[1]);
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARX_GRAPHICS_VERTEXLIGHTINGTEST_H
+#define ARX_GRAPHICS_VERTEXLIGHTINGTEST_H
+
+#include <cppunit/TestCase.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "graphics/VertexLighting.h"
+
+class VertexLightingTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(VertexLightingTest);
+	CPPUNIT_TEST(matchesScalar);
+	CPPUNIT_TEST(matchesSSE2);
+	CPPUNIT_TEST(lightListEnd);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void matchesScalar();
+	void matchesSSE2();
+	void lightListEnd();
+
+private:
+	//! Compare an implementation against per-vertex lighting for random objects and lights
+	void compare(VertexLighting::Implementation implementation);
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(VertexLightingTest);
+
+#endif
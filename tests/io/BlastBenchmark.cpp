@@ -0,0 +1,165 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Throughput benchmark for the Blast decoders.
+ *
+ * Decompresses every compressed file in the given PAK archives with both blast() and
+ * blastDirect(), checks that the results are identical and reports the speed of each.
+ *
+ * Usage: blastbench <pakfile> [<pakfile>...]
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "bench/Benchmark.h"
+#include "io/Blast.h"
+#include "io/fs/FilePath.h"
+#include "io/resource/PakEntry.h"
+#include "io/resource/PakReader.h"
+#include "platform/Platform.h"
+
+namespace {
+
+struct CompressedEntry {
+	
+	std::string name;
+	std::vector<char> data;
+	size_t size;
+	
+};
+
+typedef std::vector<CompressedEntry> Entries;
+
+void collect(Entries & entries, PakDirectory & dir, const std::string & dirname) {
+	
+	for(PakDirectory::files_iterator i = dir.files_begin(); i != dir.files_end(); ++i) {
+		
+		PakFileView view;
+		if(!i->second->readCompressed(view)) {
+			continue;
+		}
+		
+		entries.resize(entries.size() + 1);
+		CompressedEntry & entry = entries.back();
+		entry.name = dirname + i->first;
+		entry.data.assign(view.data(), view.data() + view.size());
+		entry.size = i->second->size();
+	}
+	
+	for(PakDirectory::dirs_iterator i = dir.dirs_begin(); i != dir.dirs_end(); ++i) {
+		collect(entries, i->second, dirname + i->first + '/');
+	}
+	
+}
+
+BlastResult decodeCallback(const CompressedEntry & entry, char * out, size_t & size) {
+	BlastMemInBuffer in(&entry.data[0], entry.data.size());
+	BlastMemOutBuffer outbuf(out, size);
+	BlastResult r = blast(blastInMem, &in, blastOutMem, &outbuf);
+	size -= outbuf.size;
+	return r;
+}
+
+BlastResult decodeDirect(const CompressedEntry & entry, char * out, size_t & size) {
+	return blastDirect(&entry.data[0], entry.data.size(), out, size);
+}
+
+//! Decode all entries repeatedly and print the throughput of uncompressed data.
+void benchmark(const char * name, const Entries & entries,
+               BlastResult (*decode)(const CompressedEntry &, char *, size_t &),
+               std::vector<char> & buffer, u64 minTime) {
+	
+	u64 bytes = 0;
+	bench::Timer timer;
+	u64 elapsed;
+	do {
+		for(Entries::const_iterator i = entries.begin(); i != entries.end(); ++i) {
+			size_t size = i->size;
+			decode(*i, &buffer[0], size);
+			bytes += size;
+		}
+		elapsed = timer.elapsed();
+	} while(elapsed < minTime);
+	
+	bench::printThroughput(name, elapsed, bytes);
+}
+
+} // anonymous namespace
+
+int main(int argc, char ** argv) {
+	
+	bench::init();
+	
+	if(argc < 2) {
+		std::printf("usage: blastbench <pakfile> [<pakfile>...]\n");
+		return 1;
+	}
+	
+	Entries entries;
+	for(int i = 1; i < argc; i++) {
+		PakReader pak;
+		if(!pak.addArchive(argv[i])) {
+			std::printf("error opening PAK file %s\n", argv[i]);
+			return 1;
+		}
+		collect(entries, pak, std::string());
+	}
+	
+	size_t maxSize = 1, compressed = 0, uncompressed = 0;
+	for(Entries::const_iterator i = entries.begin(); i != entries.end(); ++i) {
+		maxSize = std::max(maxSize, i->size);
+		compressed += i->data.size(), uncompressed += i->size;
+	}
+	
+	std::printf("%lu compressed files, %lu -> %lu bytes\n", (unsigned long)entries.size(),
+	            (unsigned long)compressed, (unsigned long)uncompressed);
+	
+	// Validate the table-driven decoder against the reference implementation.
+	std::vector<char> expected(maxSize), actual(maxSize);
+	size_t mismatches = 0;
+	for(Entries::const_iterator i = entries.begin(); i != entries.end(); ++i) {
+		
+		size_t expectedSize = i->size, actualSize = i->size;
+		BlastResult expectedResult = decodeCallback(*i, &expected[0], expectedSize);
+		BlastResult actualResult = decodeDirect(*i, &actual[0], actualSize);
+		
+		if(expectedResult != actualResult || expectedSize != actualSize
+		   || std::memcmp(&expected[0], &actual[0], expectedSize) != 0) {
+			std::printf("mismatch in %s: blast() = %d with %lu bytes, blastDirect() = %d with %lu bytes\n",
+			            i->name.c_str(), int(expectedResult), (unsigned long)expectedSize,
+			            int(actualResult), (unsigned long)actualSize);
+			mismatches++;
+		}
+	}
+	
+	int result = bench::printMismatches(mismatches);
+	
+	if(!entries.empty()) {
+		const u64 minTime = 2000000;
+		benchmark("blast()", entries, decodeCallback, actual, minTime);
+		benchmark("blastDirect()", entries, decodeDirect, actual, minTime);
+	}
+	
+	return result;
+}
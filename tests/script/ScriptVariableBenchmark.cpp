@@ -0,0 +1,236 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Benchmark for the script variable lookup (GetVarAddress).
+ *
+ * Builds the local variables of a variable-heavy entity script and a large set of global
+ * variables, then replays the variable accesses of a synthetic script: mostly reads of
+ * variables that are set, some of variables that do not exist yet. Each access is resolved
+ * with the old linear search and with script::VariableIndex, both results are compared and
+ * the time per lookup is reported.
+ *
+ * Usage: scriptvarbench [reference|index]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "bench/Benchmark.h"
+#include "platform/Platform.h"
+#include "script/Script.h"
+#include "script/VariableIndex.h"
+
+namespace {
+
+const size_t LocalCount = 180;
+const size_t GlobalCount = 400;
+const size_t StatementCount = 20000;
+const size_t Runs = 50;
+
+const char * const words[] = {
+	"count", "state", "timer", "target", "enemy", "door", "lever", "gold", "quest", "talk",
+	"fight", "spell", "dead", "open", "key", "speed", "angle", "text", "name", "step"
+};
+
+struct Variables {
+	
+	SCRIPT_VAR * vars;
+	size_t count;
+	script::VariableIndex index;
+	
+	Variables() : vars(NULL), count(0) { }
+	~Variables() { std::free(vars); }
+	
+};
+
+Variables locals;
+Variables globals;
+
+//! A variable access in the script, with the name already extracted from the source
+struct Access {
+	
+	bool global;
+	std::string name;
+	
+};
+
+std::vector<Access> accesses;
+
+std::string makeName(const char * prefix, size_t i) {
+	char buf[64];
+	std::sprintf(buf, "%s%s_%lu", prefix, words[i % ARRAY_SIZE(words)], (unsigned long)i);
+	return buf;
+}
+
+const char * localPrefix(size_t i) {
+	const char * const prefixes[] = { "\xA7", "@", "\xA3" };
+	return prefixes[i % ARRAY_SIZE(prefixes)];
+}
+
+const char * globalPrefix(size_t i) {
+	const char * const prefixes[] = { "#", "&", "$" };
+	return prefixes[i % ARRAY_SIZE(prefixes)];
+}
+
+void fill(Variables & v, size_t count, const char * (*prefix)(size_t)) {
+	
+	v.vars = (SCRIPT_VAR *)std::malloc(sizeof(SCRIPT_VAR) * count);
+	std::memset(v.vars, 0, sizeof(SCRIPT_VAR) * count);
+	v.count = count;
+	
+	for(size_t i = 0; i < count; i++) {
+		std::strcpy(v.vars[i].name, makeName(prefix(i), i).c_str());
+		v.vars[i].type = TYPE_L_LONG;
+		v.vars[i].ival = long(i);
+	}
+}
+
+void buildScript() {
+	
+	std::srand(42);
+	
+	fill(locals, LocalCount, localPrefix);
+	fill(globals, GlobalCount, globalPrefix);
+	
+	for(size_t i = 0; i < StatementCount; i++) {
+		
+		// Conditions and assignments use a few variables each
+		size_t n = 1 + std::rand() % 3;
+		for(size_t j = 0; j < n; j++) {
+			
+			Access access;
+			access.global = (std::rand() % 3) == 0;
+			
+			size_t count = access.global ? GlobalCount : LocalCount;
+			size_t k = size_t(std::rand()) % count;
+			const char * prefix = access.global ? globalPrefix(k) : localPrefix(k);
+			if(std::rand() % 20 == 0) {
+				// Not set yet, the search goes through all variables
+				k += count;
+			}
+			access.name = makeName(prefix, k);
+			
+			accesses.push_back(access);
+		}
+	}
+}
+
+//! The search previously used in GetVarAddress()
+SCRIPT_VAR * referenceFind(Variables & v, const std::string & name) {
+	for(size_t i = 0; i < v.count; i++) {
+		if(v.vars[i].type != TYPE_UNKNOWN) {
+			if(name == v.vars[i].name) {
+				return &v.vars[i];
+			}
+		}
+	}
+	return NULL;
+}
+
+SCRIPT_VAR * indexFind(Variables & v, const std::string & name) {
+	return v.index.find(v.vars, v.count, name);
+}
+
+typedef SCRIPT_VAR * (*FindFunction)(Variables &, const std::string &);
+
+struct Results {
+	
+	std::vector<SCRIPT_VAR *> found;
+	
+	u64 time;
+	
+};
+
+void run(Results & r, FindFunction find) {
+	
+	r.found.resize(accesses.size());
+	
+	bench::Timer timer;
+	for(size_t pass = 0; pass < Runs; pass++) {
+		for(size_t i = 0; i < accesses.size(); i++) {
+			const Access & access = accesses[i];
+			r.found[i] = find(access.global ? globals : locals, access.name);
+		}
+	}
+	r.time = timer.elapsed();
+}
+
+void print(const char * name, const Results & r) {
+	bench::printTimeNs(name, r.time, accesses.size() * Runs, "lookup");
+}
+
+size_t compare(const Results & a, const Results & b) {
+	size_t mismatches = 0;
+	for(size_t i = 0; i < a.found.size(); i++) {
+		if(a.found[i] != b.found[i]) {
+			mismatches++;
+		}
+	}
+	return mismatches;
+}
+
+} // anonymous namespace
+
+int main(int argc, char ** argv) {
+	
+	bench::init();
+	
+	const char * variants[] = { "reference", "index" };
+	bool enabled[ARRAY_SIZE(variants)];
+	if(!bench::selectVariants(argc, argv, "scriptvarbench [reference|index]", variants,
+	                          enabled, ARRAY_SIZE(variants))) {
+		return 1;
+	}
+	bool reference = enabled[0], index = enabled[1];
+	
+	buildScript();
+	
+	size_t misses = 0;
+	for(size_t i = 0; i < accesses.size(); i++) {
+		Variables & v = accesses[i].global ? globals : locals;
+		if(!referenceFind(v, accesses[i].name)) {
+			misses++;
+		}
+	}
+	std::printf("%lu locals, %lu globals, %lu lookups, %lu misses\n",
+	            (unsigned long)LocalCount, (unsigned long)GlobalCount,
+	            (unsigned long)accesses.size(), (unsigned long)misses);
+	
+	Results referenceResults, indexResults;
+	
+	if(reference) {
+		run(referenceResults, referenceFind);
+		print("linear", referenceResults);
+	}
+	
+	if(index) {
+		run(indexResults, indexFind);
+		print("index", indexResults);
+	}
+	
+	if(reference && index) {
+		return bench::printMismatches(compare(referenceResults, indexResults));
+	}
+	
+	return 0;
+}
@@ -0,0 +1,172 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "VariableIndexTest.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <cppunit/TestAssert.h>
+
+#include "script/Script.h"
+
+static const char * const names[] = {
+	"\xA7" "count", "\xA7state", "@speed", "$target", "\xA7" "count", "&delay", "\xA3text", "@speed"
+};
+
+static const size_t nameCount = sizeof(names) / sizeof(*names);
+
+//! The lookup done by GetVarAddress() without an index
+static SCRIPT_VAR * linearFind(SCRIPT_VAR * vars, size_t count, const std::string & name) {
+	for(size_t i = 0; i < count; i++) {
+		if(vars[i].type != TYPE_UNKNOWN && name == vars[i].name) {
+			return &vars[i];
+		}
+	}
+	return NULL;
+}
+
+//! Append an untyped variable like GetFreeVarSlot() and SETVarValueLong() do
+static SCRIPT_VAR * appendVar(SCRIPT_VAR *& vars, long & count, const char * name,
+                              script::VariableIndex & index) {
+	vars = (SCRIPT_VAR *)std::realloc(vars, sizeof(SCRIPT_VAR) * (count + 1));
+	std::memset(&vars[count], 0, sizeof(SCRIPT_VAR));
+	std::strcpy(vars[count].name, name);
+	count++;
+	index.add(vars, count);
+	return &vars[count - 1];
+}
+
+static void fillVars(SCRIPT_VAR * vars, size_t count, size_t offset) {
+	std::memset(vars, 0, sizeof(SCRIPT_VAR) * count);
+	for(size_t i = 0; i < count; i++) {
+		std::strcpy(vars[i].name, names[(i + offset) % nameCount]);
+		vars[i].type = TYPE_L_LONG;
+		vars[i].ival = long(i);
+	}
+}
+
+static void checkAgainstLinear(script::VariableIndex & index, SCRIPT_VAR * vars, size_t count) {
+	for(size_t i = 0; i < nameCount; i++) {
+		CPPUNIT_ASSERT_EQUAL(linearFind(vars, count, names[i]), index.find(vars, count, names[i]));
+	}
+	CPPUNIT_ASSERT(index.find(vars, count, "\xA7missing") == NULL);
+}
+
+void VariableIndexTest::firstOfDuplicates() {
+
+	SCRIPT_VAR * vars = NULL;
+	long count = 0;
+	script::VariableIndex index;
+
+	for(size_t i = 0; i < nameCount; i++) {
+		appendVar(vars, count, names[i], index)->type = TYPE_L_LONG;
+	}
+
+	CPPUNIT_ASSERT_EQUAL(&vars[0], index.find(vars, count, names[0]));
+	CPPUNIT_ASSERT_EQUAL(&vars[2], index.find(vars, count, names[2]));
+
+	// A later duplicate must not replace the first one
+	appendVar(vars, count, names[1], index)->type = TYPE_L_LONG;
+	CPPUNIT_ASSERT_EQUAL(&vars[1], index.find(vars, count, names[1]));
+
+	checkAgainstLinear(index, vars, count);
+
+	std::free(vars);
+}
+
+void VariableIndexTest::untypedSlots() {
+
+	SCRIPT_VAR * vars = NULL;
+	long count = 0;
+	script::VariableIndex index;
+
+	appendVar(vars, count, "\xA7" "a", index)->type = TYPE_L_LONG;
+
+	// Added but not typed yet
+	appendVar(vars, count, "\xA7" "b", index);
+	CPPUNIT_ASSERT(index.find(vars, count, "\xA7" "b") == NULL);
+	vars[1].type = TYPE_L_LONG;
+	CPPUNIT_ASSERT_EQUAL(&vars[1], index.find(vars, count, "\xA7" "b"));
+
+	// An untyped slot is skipped in favor of a later typed one with the same name
+	appendVar(vars, count, "\xA7" "c", index);
+	appendVar(vars, count, "\xA7" "c", index)->type = TYPE_L_LONG;
+	CPPUNIT_ASSERT_EQUAL(&vars[3], index.find(vars, count, "\xA7" "c"));
+
+	// Untyped slots that are present when the table is rebuilt can still get a type later
+	script::VariableIndex rebuilt;
+	CPPUNIT_ASSERT_EQUAL(&vars[3], rebuilt.find(vars, count, "\xA7" "c"));
+	vars[2].type = TYPE_L_FLOAT;
+	CPPUNIT_ASSERT_EQUAL(&vars[2], rebuilt.find(vars, count, "\xA7" "c"));
+
+	std::free(vars);
+}
+
+void VariableIndexTest::cloneLocalVars() {
+
+	size_t count = 6;
+	SCRIPT_VAR * vars = (SCRIPT_VAR *)std::malloc(sizeof(SCRIPT_VAR) * count);
+	fillVars(vars, count, 0);
+
+	script::VariableIndex index;
+	checkAgainstLinear(index, vars, count);
+
+	// CloneLocalVars() frees the array and copies the other entity's variables. If the
+	// allocation returns the same address with the same size, only clear() notices.
+	fillVars(vars, count, 3);
+	index.clear();
+	checkAgainstLinear(index, vars, count);
+
+	// A new allocation is noticed even without clear()
+	size_t newCount = 5;
+	SCRIPT_VAR * newVars = (SCRIPT_VAR *)std::malloc(sizeof(SCRIPT_VAR) * newCount);
+	fillVars(newVars, newCount, 1);
+	std::free(vars);
+	checkAgainstLinear(index, newVars, newCount);
+
+	std::free(newVars);
+}
+
+void VariableIndexTest::saveLoad() {
+
+	long count = 0;
+	SCRIPT_VAR * vars = NULL;
+	script::VariableIndex index;
+	for(size_t i = 0; i < nameCount; i++) {
+		appendVar(vars, count, names[i], index)->type = TYPE_L_LONG;
+	}
+	checkAgainstLinear(index, vars, count);
+
+	// Loading a save frees the variables, allocates a cleared array and fills it in place
+	std::free(vars);
+	index.clear();
+	count = 4;
+	vars = (SCRIPT_VAR *)std::malloc(sizeof(SCRIPT_VAR) * count);
+	fillVars(vars, count, 2);
+	checkAgainstLinear(index, vars, count);
+
+	// New variables can be added after loading
+	appendVar(vars, count, "\xA7new", index)->type = TYPE_L_LONG;
+	CPPUNIT_ASSERT_EQUAL(&vars[count - 1], index.find(vars, count, "\xA7new"));
+	checkAgainstLinear(index, vars, count);
+
+	std::free(vars);
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright 2013 Arx Libertatis Team (see the AUTHORS file)
+ *
+ * This file is part of Arx Libertatis.
+ *
+ * Arx Libertatis is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Arx Libertatis is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Arx Libertatis.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARX_SCRIPT_VARIABLEINDEXTEST_H
+#define ARX_SCRIPT_VARIABLEINDEXTEST_H
+
+#include <cppunit/TestCase.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "script/VariableIndex.h"
+
+class VariableIndexTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(VariableIndexTest);
+	CPPUNIT_TEST(firstOfDuplicates);
+	CPPUNIT_TEST(untypedSlots);
+	CPPUNIT_TEST(cloneLocalVars);
+	CPPUNIT_TEST(saveLoad);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void firstOfDuplicates();
+	void untypedSlots();
+	void cloneLocalVars();
+	void saveLoad();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(VariableIndexTest);
+
+#endif
@@ -4,6 +4,8 @@
 
 #include "graphics/ColorTest.h"
 #include "graphics/GraphicsUtilityTest.h"
+#include "graphics/NullRendererTest.h"
+#include "graphics/VertexLightingTest.h"
 
 int main(int argc, char *argv[]) {
 	CppUnit::TextUi::TestRunner testRunner;